@@ -4,10 +4,14 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
+#include "db/trace.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
@@ -33,16 +37,28 @@
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
+//      multireadrandom -- read N times in random order, in MultiGet()
+//                         calls of --multiget_size keys each
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      seekordered   -- N ordered seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      replay        -- re-issue the operations recorded in --replay_file
+//      ycsbload      -- load N records for the ycsb workloads below
+//      ycsba         -- YCSB workload A: 50% reads, 50% updates, zipfian
+//      ycsbb         -- YCSB workload B: 95% reads, 5% updates, zipfian
+//      ycsbc         -- YCSB workload C: 100% reads, zipfian
+//      ycsbd         -- YCSB workload D: 95% reads, 5% inserts, latest
+//      ycsbe         -- YCSB workload E: 95% scans, 5% inserts, zipfian
+//      ycsbf         -- YCSB workload F: 50% reads, 50% read-modify-writes
+//      ycsb          -- a workload mixed by the --ycsb_*_proportion flags
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
+//      writestats  -- Print write group and log sync stats
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks =
     "fillseq,"
@@ -68,6 +84,13 @@ static int FLAGS_num = 1000000;
 // Number of read operations to do.  If negative, do FLAGS_num reads.
 static int FLAGS_reads = -1;
 
+// Number of keys looked up by each MultiGet() of multireadrandom.
+static int FLAGS_multiget_size = 200;
+
+// Bytes iterators read ahead of the blocks they need (see
+// ReadOptions::readahead_size).  Zero reads ahead adaptively.
+static int FLAGS_readahead_size = 0;
+
 // Number of concurrent threads to run.
 static int FLAGS_threads = 1;
 
@@ -88,6 +111,19 @@ static bool FLAGS_comparisons = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Number of memtables that may be held in memory at once
+// (initialized to default value by "main")
+static int FLAGS_max_write_buffer_number = 0;
+
+// Rate, in bytes per second, writes are first slowed down to when
+// compactions fall behind
+// (initialized to default value by "main")
+static long long FLAGS_delayed_write_rate = 0;
+
+// Estimated compaction backlog in bytes past which writes are slowed down
+// (initialized to default value by "main")
+static long long FLAGS_soft_pending_compaction_bytes_limit = 0;
+
 // Number of bytes written to each file.
 // (initialized to default value by "main")
 static int FLAGS_max_file_size = 0;
@@ -96,6 +132,17 @@ static int FLAGS_max_file_size = 0;
 // (initialized to default value by "main")
 static int FLAGS_block_size = 0;
 
+// If true, data blocks end in a hash index for point lookups.
+static bool FLAGS_data_block_hash_index = false;
+
+// If non-zero, table indexes and filters are split into partitions of
+// about this many bytes.
+static int FLAGS_index_partition_size = 0;
+
+// Values of at least this many bytes are kept in value logs instead of the
+// tables (zero disables value logs)
+static int FLAGS_value_log_threshold = 0;
+
 // Number of bytes to use as a cache of uncompressed data.
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
@@ -107,6 +154,16 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, use a blocked bloom filter instead of the standard one.
+static bool FLAGS_blocked_bloom = false;
+
+// If true, use a Ribbon filter with the false positive rate of a bloom
+// filter of --bloom_bits bits per key instead.
+static bool FLAGS_ribbon_filter = false;
+
+// If true, each table has a single filter instead of one per 2KB of blocks.
+static bool FLAGS_whole_table_filter = false;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
@@ -118,9 +175,71 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// Number of obsolete log files to keep and overwrite with new logs.
+static int FLAGS_recycle_log_file_num = 0;
+
+// If true, snappy-compress large log records.
+static bool FLAGS_wal_compression = false;
+
+// If true, overlap logging of a write group with the memtable insert of
+// the previous one.
+static bool FLAGS_pipelined_write = false;
+
+// If true (with --pipelined_write), insert write groups into the memtable
+// concurrently.
+static bool FLAGS_concurrent_memtable_write = false;
+
+// Commit delay for sync writes, and the number of queued writes above
+// which it is skipped.
+static int FLAGS_sync_commit_delay_micros = 0;
+static int FLAGS_sync_commit_min_writers = 4;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
+// If non-null, record every operation issued against the db into this
+// trace file.  The trace restarts whenever a benchmark reopens the db.
+static const char* FLAGS_trace_file = nullptr;
+
+// Trace whose operations are re-issued by the "replay" benchmark.
+static const char* FLAGS_replay_file = nullptr;
+
+// Rate at which "replay" re-issues operations relative to the rate at
+// which they were recorded, e.g. 2.0 replays twice as fast.  Zero replays
+// as fast as possible.
+static double FLAGS_replay_speed = 1.0;
+
+// Proportions of the operations issued by the "ycsb" benchmark.  For
+// ycsba..ycsbf a non-negative value overrides the workload's own.
+static double FLAGS_ycsb_read_proportion = -1;
+static double FLAGS_ycsb_update_proportion = -1;
+static double FLAGS_ycsb_insert_proportion = -1;
+static double FLAGS_ycsb_scan_proportion = -1;
+static double FLAGS_ycsb_rmw_proportion = -1;
+
+// Popularity of the keys accessed by the ycsb benchmarks: "zipfian",
+// "latest" or "uniform".  If null, use the workload's default.
+static const char* FLAGS_ycsb_distribution = nullptr;
+
+// Skew of the zipfian and latest distributions, in (0, 1).
+static double FLAGS_ycsb_zipfian_constant = 0.99;
+
+// Scans read a uniformly distributed number of entries in
+// [1, ycsb_max_scan_length].
+static int FLAGS_ycsb_max_scan_length = 100;
+
+// If positive, the ycsb benchmarks issue this many operations per second
+// across all threads at fixed intervals, whether or not earlier operations
+// have completed (open loop), and latencies are measured from the time at
+// which each operation was due.
+static int FLAGS_ycsb_target_throughput = 0;
+
+// Size of the values written by the ycsb benchmarks: "fixed" (value_size),
+// "uniform" or "zipfian" in [min_value_size, value_size], the latter
+// favoring small values.
+static const char* FLAGS_value_size_distribution = "fixed";
+static int FLAGS_min_value_size = 1;
+
 namespace leveldb {
 
 namespace {
@@ -364,6 +483,142 @@ struct ThreadState {
   ThreadState(int index, int seed) : tid(index), rand(seed), shared(nullptr) {}
 };
 
+// Returns a uniformly distributed double in [0, 1).
+static double NextDouble(Random* rnd) {
+  return (rnd->Next() - 1) / 2147483646.0;
+}
+
+// Zipfian distribution over [0, n), generated as described in Gray et al.,
+// "Quickly Generating Billion-Record Synthetic Databases", as YCSB does.
+// n may grow between calls, in which case zeta(n) is extended
+// incrementally rather than recomputed.
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t n, double theta)
+      : theta_(theta),
+        alpha_(1.0 / (1.0 - theta)),
+        zeta2_(Zeta(0, 2, theta, 0)),
+        n_(0),
+        zetan_(0) {
+    Resize(n);
+  }
+
+  // REQUIRES: n > 0
+  uint64_t Next(Random* rnd, uint64_t n) {
+    if (n != n_) Resize(n);
+    const double u = NextDouble(rnd);
+    const double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+    const uint64_t result =
+        static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return result < n_ ? result : n_ - 1;
+  }
+
+ private:
+  // Returns sum + sum(1 / i^theta) for i in [start + 1, n].
+  static double Zeta(uint64_t start, uint64_t n, double theta, double sum) {
+    for (uint64_t i = start; i < n; i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+    }
+    return sum;
+  }
+
+  void Resize(uint64_t n) {
+    zetan_ = (n > n_) ? Zeta(n_, n, theta_, zetan_) : Zeta(0, n, theta_, 0);
+    n_ = n;
+    eta_ = (1 - std::pow(2.0 / n_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+  }
+
+  const double theta_;
+  const double alpha_;
+  const double zeta2_;
+  uint64_t n_;
+  double zetan_;
+  double eta_;
+};
+
+enum YCSBOp {
+  kYCSBRead,
+  kYCSBUpdate,
+  kYCSBInsert,
+  kYCSBScan,
+  kYCSBReadModifyWrite,
+  kYCSBNumOps
+};
+
+static const char* const kYCSBOpNames[kYCSBNumOps] = {"read", "update",
+                                                      "insert", "scan", "rmw"};
+
+enum YCSBDistribution { kYCSBUniform, kYCSBZipfian, kYCSBLatest };
+
+struct YCSBWorkload {
+  double proportion[kYCSBNumOps];  // Indexed by YCSBOp
+  YCSBDistribution distribution;
+};
+
+// Picks the keys accessed by a ycsb benchmark.
+class YCSBKeyChooser {
+ public:
+  YCSBKeyChooser(YCSBDistribution distribution, int n)
+      : distribution_(distribution),
+        zipf_(distribution == kYCSBUniform ? 1 : n,
+              FLAGS_ycsb_zipfian_constant) {}
+
+  // Returns a key in [0, n), where n is the number of keys inserted so far.
+  int Next(Random* rnd, int n) {
+    switch (distribution_) {
+      case kYCSBZipfian:
+        // Scatter the popular keys over the key space rather than
+        // clustering them at its start.
+        return static_cast<int>(FNVHash64(zipf_.Next(rnd, n)) % n);
+      case kYCSBLatest:
+        return n - 1 - static_cast<int>(zipf_.Next(rnd, n));
+      case kYCSBUniform:
+        break;
+    }
+    return rnd->Uniform(n);
+  }
+
+ private:
+  static uint64_t FNVHash64(uint64_t v) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int i = 0; i < 8; i++) {
+      hash ^= v & 0xff;
+      hash *= 0x100000001b3ull;
+      v >>= 8;
+    }
+    return hash;
+  }
+
+  const YCSBDistribution distribution_;
+  ZipfianGenerator zipf_;
+};
+
+// Picks the size of the values written by a ycsb benchmark according to
+// --value_size_distribution.
+class ValueSizeChooser {
+ public:
+  explicit ValueSizeChooser(int max_size)
+      : min_(std::min(FLAGS_min_value_size, max_size)),
+        max_(max_size),
+        zipf_(max_ - min_ + 1, FLAGS_ycsb_zipfian_constant) {}
+
+  int Next(Random* rnd) {
+    if (strcmp(FLAGS_value_size_distribution, "uniform") == 0) {
+      return min_ + rnd->Uniform(max_ - min_ + 1);
+    } else if (strcmp(FLAGS_value_size_distribution, "zipfian") == 0) {
+      return min_ + static_cast<int>(zipf_.Next(rnd, max_ - min_ + 1));
+    }
+    return max_;
+  }
+
+ private:
+  const int min_;
+  const int max_;
+  ZipfianGenerator zipf_;
+};
+
 }  // namespace
 
 class Benchmark {
@@ -380,6 +635,23 @@ class Benchmark {
   CountComparator count_comparator_;
   int total_thread_count_;
 
+  // State of the "replay" benchmark, shared by all of its threads.
+  std::vector<TraceRecord> replay_records_;
+  std::atomic<size_t> replay_next_;
+  std::atomic<uint64_t> replay_start_;
+  port::Mutex replay_mu_;
+  Histogram replay_hist_[kMaxTraceType + 1] GUARDED_BY(replay_mu_);
+  int64_t replay_count_[kMaxTraceType + 1] GUARDED_BY(replay_mu_);
+
+  // State of the ycsb benchmarks.  Keys [0, ycsb_insert_key_) have been
+  // inserted; the latency of each operation type issued by thread t is
+  // recorded in ycsb_hist_[t * kYCSBNumOps + op].
+  YCSBWorkload ycsb_workload_;
+  std::atomic<int> ycsb_insert_key_;
+  port::Mutex ycsb_mu_;
+  std::vector<Histogram> ycsb_hist_ GUARDED_BY(ycsb_mu_);
+  std::vector<int64_t> ycsb_count_ GUARDED_BY(ycsb_mu_);
+
   void PrintHeader() {
     const int kKeySize = 16 + FLAGS_key_prefix;
     PrintEnvironment();
@@ -461,9 +733,12 @@ class Benchmark {
  public:
   Benchmark()
       : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-        filter_policy_(FLAGS_bloom_bits >= 0
-                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                           : nullptr),
+        filter_policy_(FLAGS_bloom_bits < 0 ? nullptr
+                       : FLAGS_ribbon_filter
+                           ? NewRibbonFilterPolicy(FLAGS_bloom_bits)
+                       : FLAGS_blocked_bloom
+                           ? NewBlockedBloomFilterPolicy(FLAGS_bloom_bits)
+                           : NewBloomFilterPolicy(FLAGS_bloom_bits)),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -471,7 +746,10 @@ class Benchmark {
         reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
         heap_counter_(0),
         count_comparator_(BytewiseComparator()),
-        total_thread_count_(0) {
+        total_thread_count_(0),
+        replay_next_(0),
+        replay_start_(0),
+        ycsb_insert_key_(FLAGS_num) {
     std::vector<std::string> files;
     g_env->GetChildren(FLAGS_db, &files);
     for (size_t i = 0; i < files.size(); i++) {
@@ -550,6 +828,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -570,6 +850,19 @@ class Benchmark {
         method = &Benchmark::ReadWhileWriting;
       } else if (name == Slice("compact")) {
         method = &Benchmark::Compact;
+      } else if (name == Slice("replay")) {
+        if (LoadReplay()) {
+          method = &Benchmark::Replay;
+        }
+      } else if (name == Slice("ycsbload")) {
+        fresh_db = true;
+        ycsb_insert_key_.store(num_, std::memory_order_relaxed);
+        method = &Benchmark::YCSBLoad;
+      } else if (name.starts_with("ycsb")) {
+        reads_ = (FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads);
+        if (SetupYCSB(name, num_threads)) {
+          method = &Benchmark::YCSB;
+        }
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
       } else if (name == Slice("snappycomp")) {
@@ -582,6 +875,8 @@ class Benchmark {
         PrintStats("leveldb.stats");
       } else if (name == Slice("sstables")) {
         PrintStats("leveldb.sstables");
+      } else if (name == Slice("writestats")) {
+        PrintStats("leveldb.write-stats");
       } else {
         if (!name.empty()) {  // No error message for empty name
           std::fprintf(stderr, "unknown benchmark '%s'\n",
@@ -604,6 +899,11 @@ class Benchmark {
 
       if (method != nullptr) {
         RunBenchmark(num_threads, name, method);
+        if (method == &Benchmark::Replay) {
+          PrintReplayStats();
+        } else if (method == &Benchmark::YCSB) {
+          PrintYCSBStats(num_threads);
+        }
       }
     }
   }
@@ -763,19 +1063,41 @@ class Benchmark {
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.max_write_buffer_number = FLAGS_max_write_buffer_number;
+    options.delayed_write_rate = FLAGS_delayed_write_rate;
+    options.soft_pending_compaction_bytes_limit =
+        FLAGS_soft_pending_compaction_bytes_limit;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
+    options.index_partition_size = FLAGS_index_partition_size;
+    options.whole_table_filter = FLAGS_whole_table_filter;
+    options.value_log_threshold = FLAGS_value_log_threshold;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.recycle_log_file_num = FLAGS_recycle_log_file_num;
+    options.wal_compression =
+        FLAGS_wal_compression ? kSnappyCompression : kNoCompression;
+    options.enable_pipelined_write = FLAGS_pipelined_write;
+    options.allow_concurrent_memtable_write = FLAGS_concurrent_memtable_write;
+    options.sync_commit_delay_micros = FLAGS_sync_commit_delay_micros;
+    options.sync_commit_min_writers = FLAGS_sync_commit_min_writers;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       std::fprintf(stderr, "open error: %s\n", s.ToString().c_str());
       std::exit(1);
     }
+    if (FLAGS_trace_file != nullptr) {
+      s = db_->StartTrace(FLAGS_trace_file);
+      if (!s.ok()) {
+        std::fprintf(stderr, "trace error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+    }
   }
 
   void OpenBench(ThreadState* thread) {
@@ -821,7 +1143,9 @@ class Benchmark {
   }
 
   void ReadSequential(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = FLAGS_readahead_size;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
@@ -864,6 +1188,35 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    ReadOptions options;
+    std::vector<std::string> key_data;
+    std::vector<Slice> keys;
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    int found = 0;
+    KeyBuffer key;
+    for (int i = 0; i < reads_; i += FLAGS_multiget_size) {
+      const int n = std::min(FLAGS_multiget_size, reads_ - i);
+      key_data.clear();
+      for (int j = 0; j < n; j++) {
+        key.Set(thread->rand.Uniform(FLAGS_num));
+        key_data.push_back(key.slice().ToString());
+      }
+      keys.assign(key_data.begin(), key_data.end());
+      db_->MultiGet(options, keys, &values, &statuses);
+      for (int j = 0; j < n; j++) {
+        if (statuses[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -985,6 +1338,321 @@ class Benchmark {
 
   void Compact(ThreadState* thread) { db_->CompactRange(nullptr, nullptr); }
 
+  bool LoadReplay() {
+    if (FLAGS_replay_file == nullptr) {
+      std::fprintf(stderr, "replay requires --replay_file\n");
+      return false;
+    }
+    Status s = ReadTrace(g_env, FLAGS_replay_file, &replay_records_);
+    if (!s.ok()) {
+      std::fprintf(stderr, "replay error: %s\n", s.ToString().c_str());
+      return false;
+    }
+    num_ = reads_ = static_cast<int>(replay_records_.size());
+    replay_next_.store(0, std::memory_order_relaxed);
+    replay_start_.store(0, std::memory_order_relaxed);
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      replay_hist_[t].Clear();
+      replay_count_[t] = 0;
+    }
+    return true;
+  }
+
+  // Threads claim records in trace order and issue each one no earlier
+  // than its recorded offset (scaled by --replay_speed) from the start.
+  void Replay(ThreadState* thread) {
+    uint64_t start = 0;
+    replay_start_.compare_exchange_strong(start, g_env->NowMicros());
+    start = replay_start_.load();
+
+    Histogram hist[kMaxTraceType + 1];
+    int64_t count[kMaxTraceType + 1] = {0};
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      hist[t].Clear();
+    }
+    int64_t bytes = 0;
+    while (true) {
+      const size_t i = replay_next_.fetch_add(1, std::memory_order_relaxed);
+      if (i >= replay_records_.size()) {
+        break;
+      }
+      const TraceRecord& record = replay_records_[i];
+      if (FLAGS_replay_speed > 0) {
+        const uint64_t due =
+            start +
+            static_cast<uint64_t>(record.timestamp / FLAGS_replay_speed);
+        const uint64_t now = g_env->NowMicros();
+        if (due > now) {
+          g_env->SleepForMicroseconds(static_cast<int>(due - now));
+        }
+      }
+      const uint64_t op_start = g_env->NowMicros();
+      Status s = ReplayTraceRecord(db_, record);
+      if (!s.ok()) {
+        std::fprintf(stderr, "replay error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      hist[record.type].Add(g_env->NowMicros() - op_start);
+      count[record.type]++;
+      bytes += record.payload.size();
+      thread->stats.FinishedSingleOp();
+    }
+    thread->stats.AddBytes(bytes);
+
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      replay_hist_[t].Merge(hist[t]);
+      replay_count_[t] += count[t];
+    }
+  }
+
+  void PrintReplayStats() {
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      if (replay_count_[t] == 0) {
+        continue;
+      }
+      std::fprintf(stdout, "%s: %lld ops, microseconds per op:\n%s\n",
+                   TraceTypeName(static_cast<TraceType>(t)),
+                   static_cast<long long>(replay_count_[t]),
+                   replay_hist_[t].ToString().c_str());
+    }
+    std::fflush(stdout);
+  }
+
+  // Each thread loads every n-th key of [0, num_).
+  void YCSBLoad(ThreadState* thread) {
+    RandomGenerator gen;
+    ValueSizeChooser value_sizes(value_size_);
+    KeyBuffer key;
+    int64_t bytes = 0;
+    for (int k = thread->tid; k < num_; k += thread->shared->total) {
+      key.Set(k);
+      const int value_size = value_sizes.Next(&thread->rand);
+      Status s =
+          db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+      if (!s.ok()) {
+        std::fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      bytes += value_size + key.slice().size();
+      thread->stats.FinishedSingleOp();
+    }
+    thread->stats.AddBytes(bytes);
+  }
+
+  bool SetupYCSB(const Slice& name, int num_threads) {
+    //                              read update insert scan  rmw
+    static const YCSBWorkload kWorkloads[] = {
+        {{0.50, 0.50, 0.00, 0.00, 0.00}, kYCSBZipfian},  // ycsba
+        {{0.95, 0.05, 0.00, 0.00, 0.00}, kYCSBZipfian},  // ycsbb
+        {{1.00, 0.00, 0.00, 0.00, 0.00}, kYCSBZipfian},  // ycsbc
+        {{0.95, 0.00, 0.05, 0.00, 0.00}, kYCSBLatest},   // ycsbd
+        {{0.00, 0.00, 0.05, 0.95, 0.00}, kYCSBZipfian},  // ycsbe
+        {{0.50, 0.00, 0.00, 0.00, 0.50}, kYCSBZipfian},  // ycsbf
+    };
+    if (name == Slice("ycsb")) {
+      ycsb_workload_ = YCSBWorkload{{0, 0, 0, 0, 0}, kYCSBZipfian};
+    } else if (name.size() == 5 && name[4] >= 'a' && name[4] <= 'f') {
+      ycsb_workload_ = kWorkloads[name[4] - 'a'];
+    } else {
+      std::fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
+      return false;
+    }
+
+    const double overrides[kYCSBNumOps] = {
+        FLAGS_ycsb_read_proportion, FLAGS_ycsb_update_proportion,
+        FLAGS_ycsb_insert_proportion, FLAGS_ycsb_scan_proportion,
+        FLAGS_ycsb_rmw_proportion};
+    double total = 0;
+    for (int op = 0; op < kYCSBNumOps; op++) {
+      if (overrides[op] >= 0) {
+        ycsb_workload_.proportion[op] = overrides[op];
+      }
+      total += ycsb_workload_.proportion[op];
+    }
+    if (total <= 0) {
+      std::fprintf(stderr, "%s requires a --ycsb_*_proportion flag\n",
+                   name.ToString().c_str());
+      return false;
+    }
+
+    if (FLAGS_ycsb_distribution == nullptr) {
+      // Keep the workload's default
+    } else if (strcmp(FLAGS_ycsb_distribution, "zipfian") == 0) {
+      ycsb_workload_.distribution = kYCSBZipfian;
+    } else if (strcmp(FLAGS_ycsb_distribution, "latest") == 0) {
+      ycsb_workload_.distribution = kYCSBLatest;
+    } else if (strcmp(FLAGS_ycsb_distribution, "uniform") == 0) {
+      ycsb_workload_.distribution = kYCSBUniform;
+    } else {
+      std::fprintf(stderr, "unknown --ycsb_distribution '%s'\n",
+                   FLAGS_ycsb_distribution);
+      return false;
+    }
+    if (ycsb_insert_key_.load(std::memory_order_relaxed) <= 0) {
+      std::fprintf(stderr, "%s requires --num > 0\n", name.ToString().c_str());
+      return false;
+    }
+
+    MutexLock l(&ycsb_mu_);
+    ycsb_hist_.assign(num_threads * kYCSBNumOps, Histogram());
+    for (Histogram& hist : ycsb_hist_) {
+      hist.Clear();
+    }
+    ycsb_count_.assign(num_threads * kYCSBNumOps, 0);
+    return true;
+  }
+
+  void YCSB(ThreadState* thread) {
+    double cdf[kYCSBNumOps];
+    double total = 0;
+    for (int op = 0; op < kYCSBNumOps; op++) {
+      total += ycsb_workload_.proportion[op];
+      cdf[op] = total;
+    }
+
+    YCSBKeyChooser keys(ycsb_workload_.distribution,
+                        ycsb_insert_key_.load(std::memory_order_relaxed));
+    ValueSizeChooser value_sizes(value_size_);
+    RandomGenerator gen;
+    Histogram hist[kYCSBNumOps];
+    int64_t count[kYCSBNumOps] = {0};
+    for (int op = 0; op < kYCSBNumOps; op++) {
+      hist[op].Clear();
+    }
+
+    const double interval =
+        FLAGS_ycsb_target_throughput > 0
+            ? 1e6 * thread->shared->total / FLAGS_ycsb_target_throughput
+            : 0;
+    const uint64_t start = g_env->NowMicros();
+    ReadOptions options;
+    std::string value;
+    KeyBuffer key;
+    int found = 0;
+    int64_t bytes = 0;
+    for (int i = 0; i < reads_; i++) {
+      uint64_t op_start;
+      if (interval > 0) {
+        op_start = start + static_cast<uint64_t>(i * interval);
+        const uint64_t now = g_env->NowMicros();
+        if (op_start > now) {
+          g_env->SleepForMicroseconds(static_cast<int>(op_start - now));
+        }
+      } else {
+        op_start = g_env->NowMicros();
+      }
+
+      const double r = NextDouble(&thread->rand) * total;
+      int op = 0;
+      while (op < kYCSBNumOps - 1 && r >= cdf[op]) {
+        op++;
+      }
+      const int n = ycsb_insert_key_.load(std::memory_order_relaxed);
+      Status s;
+      switch (op) {
+        case kYCSBRead:
+          key.Set(keys.Next(&thread->rand, n));
+          s = db_->Get(options, key.slice(), &value);
+          if (s.ok()) {
+            found++;
+            bytes += key.slice().size() + value.size();
+          }
+          break;
+        case kYCSBUpdate:
+        case kYCSBInsert: {
+          key.Set(op == kYCSBInsert
+                      ? ycsb_insert_key_.fetch_add(1, std::memory_order_relaxed)
+                      : keys.Next(&thread->rand, n));
+          const int value_size = value_sizes.Next(&thread->rand);
+          s = db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+          bytes += key.slice().size() + value_size;
+          break;
+        }
+        case kYCSBScan: {
+          key.Set(keys.Next(&thread->rand, n));
+          const int length =
+              1 + thread->rand.Uniform(std::max(FLAGS_ycsb_max_scan_length, 1));
+          Iterator* iter = db_->NewIterator(options);
+          int j = 0;
+          for (iter->Seek(key.slice()); j < length && iter->Valid();
+               iter->Next()) {
+            bytes += iter->key().size() + iter->value().size();
+            j++;
+          }
+          if (j > 0) found++;
+          s = iter->status();
+          delete iter;
+          break;
+        }
+        case kYCSBReadModifyWrite: {
+          key.Set(keys.Next(&thread->rand, n));
+          s = db_->Get(options, key.slice(), &value);
+          if (s.ok()) {
+            found++;
+            bytes += key.slice().size() + value.size();
+          }
+          if (s.ok() || s.IsNotFound()) {
+            const int value_size = value_sizes.Next(&thread->rand);
+            s = db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+            bytes += key.slice().size() + value_size;
+          }
+          break;
+        }
+      }
+      if (!s.ok() && !s.IsNotFound()) {
+        std::fprintf(stderr, "%s error: %s\n", kYCSBOpNames[op],
+                     s.ToString().c_str());
+        std::exit(1);
+      }
+      hist[op].Add(g_env->NowMicros() - op_start);
+      count[op]++;
+      thread->stats.FinishedSingleOp();
+    }
+    thread->stats.AddBytes(bytes);
+    char msg[100];
+    std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+    thread->stats.AddMessage(msg);
+
+    MutexLock l(&ycsb_mu_);
+    for (int op = 0; op < kYCSBNumOps; op++) {
+      ycsb_hist_[thread->tid * kYCSBNumOps + op].Merge(hist[op]);
+      ycsb_count_[thread->tid * kYCSBNumOps + op] += count[op];
+    }
+  }
+
+  void PrintYCSBStats(int num_threads) {
+    MutexLock l(&ycsb_mu_);
+    for (int op = 0; op < kYCSBNumOps; op++) {
+      Histogram merged;
+      merged.Clear();
+      int64_t total = 0;
+      for (int t = 0; t < num_threads; t++) {
+        const Histogram& hist = ycsb_hist_[t * kYCSBNumOps + op];
+        const int64_t count = ycsb_count_[t * kYCSBNumOps + op];
+        if (count == 0) {
+          continue;
+        }
+        std::fprintf(stdout,
+                     "%-6s thread %2d: %9lld ops; micros/op avg %9.1f "
+                     "p50 %9.1f p99 %9.1f p99.9 %9.1f\n",
+                     kYCSBOpNames[op], t, static_cast<long long>(count),
+                     hist.Average(), hist.Median(), hist.Percentile(99),
+                     hist.Percentile(99.9));
+        merged.Merge(hist);
+        total += count;
+      }
+      if (total > 0) {
+        std::fprintf(stdout, "%s: %lld ops, microseconds per op:\n%s\n",
+                     kYCSBOpNames[op], static_cast<long long>(total),
+                     merged.ToString().c_str());
+      }
+    }
+    std::fflush(stdout);
+  }
+
   void PrintStats(const char* key) {
     std::string stats;
     if (!db_->GetProperty(key, &stats)) {
@@ -1020,6 +1688,10 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_max_write_buffer_number = leveldb::Options().max_write_buffer_number;
+  FLAGS_delayed_write_rate = leveldb::Options().delayed_write_rate;
+  FLAGS_soft_pending_compaction_bytes_limit =
+      leveldb::Options().soft_pending_compaction_bytes_limit;
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
@@ -1028,6 +1700,7 @@ int main(int argc, char** argv) {
   for (int i = 1; i < argc; i++) {
     double d;
     int n;
+    long long ll;
     char junk;
     if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
       FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
@@ -1045,30 +1718,120 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--recycle_log_file_num=%d%c", &n, &junk) == 1) {
+      FLAGS_recycle_log_file_num = n;
+    } else if (sscanf(argv[i], "--wal_compression=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_wal_compression = n;
+    } else if (sscanf(argv[i], "--pipelined_write=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pipelined_write = n;
+    } else if (sscanf(argv[i], "--concurrent_memtable_write=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_concurrent_memtable_write = n;
+    } else if (sscanf(argv[i], "--sync_commit_delay_micros=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_sync_commit_delay_micros = n;
+    } else if (sscanf(argv[i], "--sync_commit_min_writers=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_sync_commit_min_writers = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
       FLAGS_reads = n;
+    } else if (sscanf(argv[i], "--multiget_size=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_multiget_size = n;
+    } else if (sscanf(argv[i], "--readahead_size=%d%c", &n, &junk) == 1) {
+      FLAGS_readahead_size = n;
     } else if (sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1) {
       FLAGS_threads = n;
     } else if (sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--max_write_buffer_number=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_write_buffer_number = n;
+    } else if (sscanf(argv[i], "--delayed_write_rate=%lld%c", &ll, &junk) ==
+               1) {
+      FLAGS_delayed_write_rate = ll;
+    } else if (sscanf(argv[i], "--soft_pending_compaction_bytes_limit=%lld%c",
+                      &ll, &junk) == 1) {
+      FLAGS_soft_pending_compaction_bytes_limit = ll;
     } else if (sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
       FLAGS_max_file_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
+    } else if (sscanf(argv[i], "--index_partition_size=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_index_partition_size = n;
+    } else if (sscanf(argv[i], "--value_log_threshold=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_value_log_threshold = n;
     } else if (sscanf(argv[i], "--key_prefix=%d%c", &n, &junk) == 1) {
       FLAGS_key_prefix = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--blocked_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_blocked_bloom = n;
+    } else if (sscanf(argv[i], "--ribbon_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_ribbon_filter = n;
+    } else if (sscanf(argv[i], "--whole_table_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_whole_table_filter = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
+    } else if (strncmp(argv[i], "--trace_file=", 13) == 0) {
+      FLAGS_trace_file = argv[i] + 13;
+    } else if (strncmp(argv[i], "--replay_file=", 14) == 0) {
+      FLAGS_replay_file = argv[i] + 14;
+    } else if (sscanf(argv[i], "--replay_speed=%lf%c", &d, &junk) == 1) {
+      FLAGS_replay_speed = d;
+    } else if (sscanf(argv[i], "--ycsb_read_proportion=%lf%c", &d, &junk) ==
+               1) {
+      FLAGS_ycsb_read_proportion = d;
+    } else if (sscanf(argv[i], "--ycsb_update_proportion=%lf%c", &d, &junk) ==
+               1) {
+      FLAGS_ycsb_update_proportion = d;
+    } else if (sscanf(argv[i], "--ycsb_insert_proportion=%lf%c", &d, &junk) ==
+               1) {
+      FLAGS_ycsb_insert_proportion = d;
+    } else if (sscanf(argv[i], "--ycsb_scan_proportion=%lf%c", &d, &junk) ==
+               1) {
+      FLAGS_ycsb_scan_proportion = d;
+    } else if (sscanf(argv[i], "--ycsb_rmw_proportion=%lf%c", &d, &junk) ==
+               1) {
+      FLAGS_ycsb_rmw_proportion = d;
+    } else if (strncmp(argv[i], "--ycsb_distribution=", 20) == 0) {
+      FLAGS_ycsb_distribution = argv[i] + 20;
+    } else if (sscanf(argv[i], "--ycsb_zipfian_constant=%lf%c", &d, &junk) ==
+                   1 &&
+               d > 0 && d < 1) {
+      FLAGS_ycsb_zipfian_constant = d;
+    } else if (sscanf(argv[i], "--ycsb_max_scan_length=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_ycsb_max_scan_length = n;
+    } else if (sscanf(argv[i], "--ycsb_target_throughput=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_ycsb_target_throughput = n;
+    } else if (strcmp(argv[i], "--value_size_distribution=fixed") == 0 ||
+               strcmp(argv[i], "--value_size_distribution=uniform") == 0 ||
+               strcmp(argv[i], "--value_size_distribution=zipfian") == 0) {
+      FLAGS_value_size_distribution = argv[i] + 26;
+    } else if (sscanf(argv[i], "--min_value_size=%d%c", &n, &junk) == 1) {
+      FLAGS_min_value_size = n;
     } else {
       std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
       std::exit(1);
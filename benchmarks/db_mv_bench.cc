@@ -15,6 +15,7 @@
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "db/db_impl.h"
+#include "db/trace.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/write_batch.h"
@@ -43,6 +44,7 @@
 //      seekordered   -- N ordered seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      replay        -- re-issue the operations recorded in --replay_file
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
@@ -145,6 +147,18 @@ static bool FLAGS_reuse_logs = false;
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
+// If non-null, record every operation issued against the db into this
+// trace file.  The trace restarts whenever a benchmark reopens the db.
+static const char* FLAGS_trace_file = nullptr;
+
+// Trace whose operations are re-issued by the "replay" benchmark.
+static const char* FLAGS_replay_file = nullptr;
+
+// Rate at which "replay" re-issues operations relative to the rate at
+// which they were recorded, e.g. 2.0 replays twice as fast.  Zero replays
+// as fast as possible.
+static double FLAGS_replay_speed = 1.0;
+
 namespace leveldb {
 
 namespace {
@@ -404,6 +418,14 @@ class Benchmark {
   CountComparator count_comparator_;
   int total_thread_count_;
 
+  // State of the "replay" benchmark, shared by all of its threads.
+  std::vector<TraceRecord> replay_records_;
+  std::atomic<size_t> replay_next_;
+  std::atomic<uint64_t> replay_start_;
+  port::Mutex replay_mu_;
+  Histogram replay_hist_[kMaxTraceType + 1] GUARDED_BY(replay_mu_);
+  int64_t replay_count_[kMaxTraceType + 1] GUARDED_BY(replay_mu_);
+
   ValidTime time_lo_ = 0;
   ValidTime time_hi_ = 0;
   ValidTime current_ = 0;
@@ -499,7 +521,9 @@ class Benchmark {
         reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
         heap_counter_(0),
         count_comparator_(BytewiseComparator()),
-        total_thread_count_(0) {
+        total_thread_count_(0),
+        replay_next_(0),
+        replay_start_(0) {
     std::vector<std::string> files;
     g_env->GetChildren(FLAGS_db, &files);
     for (size_t i = 0; i < files.size(); i++) {
@@ -617,6 +641,10 @@ class Benchmark {
         method = &Benchmark::ReadWhileWriting;
       } else if (name == Slice("compact")) {
         method = &Benchmark::Compact;
+      } else if (name == Slice("replay")) {
+        if (LoadReplay()) {
+          method = &Benchmark::Replay;
+        }
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
       } else if (name == Slice("snappycomp")) {
@@ -651,6 +679,9 @@ class Benchmark {
 
       if (method != nullptr) {
         RunBenchmark(num_threads, name, method);
+        if (method == &Benchmark::Replay) {
+          PrintReplayStats();
+        }
       }
     }
   }
@@ -826,6 +857,13 @@ class Benchmark {
       std::fprintf(stderr, "open error: %s\n", s.ToString().c_str());
       std::exit(1);
     }
+    if (FLAGS_trace_file != nullptr) {
+      s = db_->StartTrace(FLAGS_trace_file);
+      if (!s.ok()) {
+        std::fprintf(stderr, "trace error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+    }
   }
 
   void OpenBench(ThreadState* thread) {
@@ -1155,6 +1193,89 @@ class Benchmark {
 
   void Compact(ThreadState* thread) { db_->CompactRange(nullptr, nullptr); }
 
+  bool LoadReplay() {
+    if (FLAGS_replay_file == nullptr) {
+      std::fprintf(stderr, "replay requires --replay_file\n");
+      return false;
+    }
+    Status s = ReadTrace(g_env, FLAGS_replay_file, &replay_records_);
+    if (!s.ok()) {
+      std::fprintf(stderr, "replay error: %s\n", s.ToString().c_str());
+      return false;
+    }
+    num_ = reads_ = static_cast<int>(replay_records_.size());
+    replay_next_.store(0, std::memory_order_relaxed);
+    replay_start_.store(0, std::memory_order_relaxed);
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      replay_hist_[t].Clear();
+      replay_count_[t] = 0;
+    }
+    return true;
+  }
+
+  // Threads claim records in trace order and issue each one no earlier
+  // than its recorded offset (scaled by --replay_speed) from the start.
+  void Replay(ThreadState* thread) {
+    uint64_t start = 0;
+    replay_start_.compare_exchange_strong(start, g_env->NowMicros());
+    start = replay_start_.load();
+
+    Histogram hist[kMaxTraceType + 1];
+    int64_t count[kMaxTraceType + 1] = {0};
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      hist[t].Clear();
+    }
+    int64_t bytes = 0;
+    while (true) {
+      const size_t i = replay_next_.fetch_add(1, std::memory_order_relaxed);
+      if (i >= replay_records_.size()) {
+        break;
+      }
+      const TraceRecord& record = replay_records_[i];
+      if (FLAGS_replay_speed > 0) {
+        const uint64_t due =
+            start +
+            static_cast<uint64_t>(record.timestamp / FLAGS_replay_speed);
+        const uint64_t now = g_env->NowMicros();
+        if (due > now) {
+          g_env->SleepForMicroseconds(static_cast<int>(due - now));
+        }
+      }
+      const uint64_t op_start = g_env->NowMicros();
+      Status s = ReplayTraceRecord(db_, record);
+      if (!s.ok()) {
+        std::fprintf(stderr, "replay error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      hist[record.type].Add(g_env->NowMicros() - op_start);
+      count[record.type]++;
+      bytes += record.payload.size();
+      thread->stats.FinishedSingleOp();
+    }
+    thread->stats.AddBytes(bytes);
+
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      replay_hist_[t].Merge(hist[t]);
+      replay_count_[t] += count[t];
+    }
+  }
+
+  void PrintReplayStats() {
+    MutexLock l(&replay_mu_);
+    for (int t = 0; t <= kMaxTraceType; t++) {
+      if (replay_count_[t] == 0) {
+        continue;
+      }
+      std::fprintf(stdout, "%s: %lld ops, microseconds per op:\n%s\n",
+                   TraceTypeName(static_cast<TraceType>(t)),
+                   static_cast<long long>(replay_count_[t]),
+                   replay_hist_[t].ToString().c_str());
+    }
+    std::fflush(stdout);
+  }
+
   void PrintStats(const char* key) {
     std::string stats;
     if (!db_->GetProperty(key, &stats)) {
@@ -1240,6 +1361,12 @@ int main(int argc, char** argv) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
+    } else if (strncmp(argv[i], "--trace_file=", 13) == 0) {
+      FLAGS_trace_file = argv[i] + 13;
+    } else if (strncmp(argv[i], "--replay_file=", 14) == 0) {
+      FLAGS_replay_file = argv[i] + 14;
+    } else if (sscanf(argv[i], "--replay_speed=%lf%c", &d, &junk) == 1) {
+      FLAGS_replay_speed = d;
     } else if (sscanf(argv[i], "--gtest_color=%c", &junk) == 1) {
       // Dummy flag because CLion adds --gtest_color=no argument to non-gtests
     } else if (sscanf(argv[i], "--rand_key_range=%d%c", &n, &junk) == 1) {
@@ -0,0 +1,414 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Microbenchmarks for the kernels that dominate LevelDB's CPU profile.
+// Unlike db_bench, which measures whole-database workloads, every benchmark
+// here exercises a single component in isolation so that changes to it can
+// be measured (and regressions caught) without noise from the rest of the
+// stack.
+//
+// Example:
+//   ./leveldb_microbench --benchmark_filter=BM_Block
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "db/dbformat.h"
+#include "db/skiplist.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/hash.h"
+#include "util/random.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+namespace {
+
+// Returns "n" distinct, increasing keys of the form "key%016d".
+std::vector<std::string> SequentialKeys(int n) {
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  char buf[32];
+  for (int i = 0; i < n; i++) {
+    std::snprintf(buf, sizeof(buf), "key%016d", i);
+    keys.push_back(buf);
+  }
+  return keys;
+}
+
+// Builds a block holding "num_entries" sorted keys with 100-byte values.
+std::string BuildBlock(int num_entries, int restart_interval) {
+  Options options;
+  options.block_restart_interval = restart_interval;
+  BlockBuilder builder(&options);
+  std::vector<std::string> keys = SequentialKeys(num_entries);
+  std::string value(100, 'v');
+  for (const std::string& key : keys) {
+    builder.Add(key, value);
+  }
+  return builder.Finish().ToString();
+}
+
+Block* NewBlockFrom(const std::string& contents) {
+  BlockContents block_contents;
+  block_contents.data = contents;
+  block_contents.cachable = false;
+  block_contents.heap_allocated = false;
+  return new Block(block_contents);
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Block / BlockBuilder
+// ---------------------------------------------------------------------------
+
+static void BM_BlockBuilderAdd(benchmark::State& state) {
+  const int num_entries = state.range(0);
+  std::vector<std::string> keys = SequentialKeys(num_entries);
+  std::string value(100, 'v');
+  Options options;
+  BlockBuilder builder(&options);
+  for (auto _ : state) {
+    builder.Reset();
+    for (const std::string& key : keys) {
+      builder.Add(key, value);
+    }
+    benchmark::DoNotOptimize(builder.Finish());
+  }
+  state.SetItemsProcessed(state.iterations() * num_entries);
+}
+BENCHMARK(BM_BlockBuilderAdd)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_BlockIterSeek(benchmark::State& state) {
+  const int num_entries = state.range(0);
+  std::string contents = BuildBlock(num_entries, 16);
+  Block* block = NewBlockFrom(contents);
+  Iterator* iter = block->NewIterator(BytewiseComparator());
+  std::vector<std::string> keys = SequentialKeys(num_entries);
+  Random rnd(301);
+  for (auto _ : state) {
+    iter->Seek(keys[rnd.Uniform(num_entries)]);
+    benchmark::DoNotOptimize(iter->Valid());
+  }
+  state.SetItemsProcessed(state.iterations());
+  delete iter;
+  delete block;
+}
+BENCHMARK(BM_BlockIterSeek)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_BlockIterNext(benchmark::State& state) {
+  const int num_entries = state.range(0);
+  std::string contents = BuildBlock(num_entries, 16);
+  Block* block = NewBlockFrom(contents);
+  Iterator* iter = block->NewIterator(BytewiseComparator());
+  for (auto _ : state) {
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      benchmark::DoNotOptimize(iter->value());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_entries);
+  delete iter;
+  delete block;
+}
+BENCHMARK(BM_BlockIterNext)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_BlockIterPrev(benchmark::State& state) {
+  const int num_entries = state.range(0);
+  std::string contents = BuildBlock(num_entries, 16);
+  Block* block = NewBlockFrom(contents);
+  Iterator* iter = block->NewIterator(BytewiseComparator());
+  for (auto _ : state) {
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      benchmark::DoNotOptimize(iter->value());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_entries);
+  delete iter;
+  delete block;
+}
+BENCHMARK(BM_BlockIterPrev)->Arg(16)->Arg(64)->Arg(256);
+
+// ---------------------------------------------------------------------------
+// SkipList / Arena
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Uint64Comparator {
+  int operator()(const uint64_t& a, const uint64_t& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef SkipList<uint64_t, Uint64Comparator> U64SkipList;
+
+}  // namespace
+
+static void BM_SkipListInsert(benchmark::State& state) {
+  const int num_keys = state.range(0);
+  std::vector<uint64_t> keys(num_keys);
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < num_keys; i++) {
+    keys[i] = (static_cast<uint64_t>(rnd.Next()) << 32) | i;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    Arena* arena = new Arena;
+    U64SkipList* list = new U64SkipList(Uint64Comparator(), arena);
+    state.ResumeTiming();
+    for (uint64_t key : keys) {
+      list->Insert(key);
+    }
+    state.PauseTiming();
+    delete list;
+    delete arena;
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * num_keys);
+}
+BENCHMARK(BM_SkipListInsert)->Arg(1 << 10)->Arg(1 << 16);
+
+static void BM_SkipListSeek(benchmark::State& state) {
+  const int num_keys = state.range(0);
+  Arena arena;
+  U64SkipList list(Uint64Comparator(), &arena);
+  std::vector<uint64_t> keys(num_keys);
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < num_keys; i++) {
+    keys[i] = (static_cast<uint64_t>(rnd.Next()) << 32) | i;
+    list.Insert(keys[i]);
+  }
+  U64SkipList::Iterator iter(&list);
+  for (auto _ : state) {
+    iter.Seek(keys[rnd.Uniform(num_keys)]);
+    benchmark::DoNotOptimize(iter.Valid());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SkipListSeek)->Arg(1 << 10)->Arg(1 << 16);
+
+static void BM_ArenaAllocate(benchmark::State& state) {
+  const size_t bytes = state.range(0);
+  const int kAllocsPerIteration = 1024;
+  for (auto _ : state) {
+    Arena arena;
+    for (int i = 0; i < kAllocsPerIteration; i++) {
+      benchmark::DoNotOptimize(arena.Allocate(bytes));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kAllocsPerIteration);
+}
+BENCHMARK(BM_ArenaAllocate)->Arg(16)->Arg(128)->Arg(1024);
+
+// ---------------------------------------------------------------------------
+// Checksums, hashing and coding
+// ---------------------------------------------------------------------------
+
+static void BM_Crc32cExtend(benchmark::State& state) {
+  std::string data(state.range(0), 'x');
+  uint32_t crc = 0;
+  for (auto _ : state) {
+    crc = crc32c::Extend(crc, data.data(), data.size());
+    benchmark::DoNotOptimize(crc);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32cExtend)->Arg(64)->Arg(4096)->Arg(65536);
+
+static void BM_Hash(benchmark::State& state) {
+  std::string data(state.range(0), 'x');
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Hash(data.data(), data.size(), 0xbc9f1d34));
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Hash)->Arg(16)->Arg(64)->Arg(1024);
+
+static void BM_VarintEncode(benchmark::State& state) {
+  const int kCount = 1024;
+  std::vector<uint64_t> values(kCount);
+  Random rnd(301);
+  for (int i = 0; i < kCount; i++) {
+    // Spread the values over every encoded length.
+    values[i] = static_cast<uint64_t>(rnd.Next()) >> rnd.Uniform(32);
+  }
+  std::string dst;
+  for (auto _ : state) {
+    dst.clear();
+    for (uint64_t v : values) {
+      PutVarint64(&dst, v);
+    }
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kCount);
+}
+BENCHMARK(BM_VarintEncode);
+
+static void BM_VarintDecode(benchmark::State& state) {
+  const int kCount = 1024;
+  Random rnd(301);
+  std::string encoded;
+  for (int i = 0; i < kCount; i++) {
+    PutVarint32(&encoded, rnd.Next() >> rnd.Uniform(32));
+  }
+  for (auto _ : state) {
+    const char* p = encoded.data();
+    const char* limit = p + encoded.size();
+    uint32_t v;
+    while (p < limit) {
+      p = GetVarint32Ptr(p, limit, &v);
+      benchmark::DoNotOptimize(v);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kCount);
+}
+BENCHMARK(BM_VarintDecode);
+
+// ---------------------------------------------------------------------------
+// Bloom filter
+// ---------------------------------------------------------------------------
+
+static void BM_BloomCreateFilter(benchmark::State& state) {
+  const int num_keys = state.range(0);
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  std::vector<std::string> key_storage = SequentialKeys(num_keys);
+  std::vector<Slice> keys(key_storage.begin(), key_storage.end());
+  std::string filter;
+  for (auto _ : state) {
+    filter.clear();
+    policy->CreateFilter(keys.data(), num_keys, &filter);
+    benchmark::DoNotOptimize(filter.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_keys);
+  delete policy;
+}
+BENCHMARK(BM_BloomCreateFilter)->Arg(100)->Arg(10000);
+
+static void BM_BloomKeyMayMatch(benchmark::State& state) {
+  const int num_keys = state.range(0);
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  std::vector<std::string> key_storage = SequentialKeys(2 * num_keys);
+  std::vector<Slice> keys(key_storage.begin(),
+                          key_storage.begin() + num_keys);
+  std::string filter;
+  policy->CreateFilter(keys.data(), num_keys, &filter);
+  // Half of the probes hit, half of them miss.
+  Random rnd(301);
+  for (auto _ : state) {
+    const std::string& probe = key_storage[rnd.Uniform(2 * num_keys)];
+    benchmark::DoNotOptimize(policy->KeyMayMatch(probe, filter));
+  }
+  state.SetItemsProcessed(state.iterations());
+  delete policy;
+}
+BENCHMARK(BM_BloomKeyMayMatch)->Arg(100)->Arg(10000);
+
+// ---------------------------------------------------------------------------
+// Internal key comparison
+// ---------------------------------------------------------------------------
+
+static void BM_InternalKeyCompare(benchmark::State& state) {
+  const int kCount = 1024;
+  InternalKeyComparator cmp(BytewiseComparator());
+  std::vector<std::string> user_keys = SequentialKeys(kCount / 2);
+  std::vector<InternalKey> keys;
+  for (int i = 0; i < kCount; i++) {
+    // Pairs of entries share a user key so the sequence tie-break runs.
+    keys.emplace_back(user_keys[i / 2], 100 + i, kTypeValue);
+  }
+  Random rnd(301);
+  for (auto _ : state) {
+    const InternalKey& a = keys[rnd.Uniform(kCount)];
+    const InternalKey& b = keys[rnd.Uniform(kCount)];
+    benchmark::DoNotOptimize(cmp.Compare(a.Encode(), b.Encode()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_InternalKeyCompare);
+
+static void BM_MVInternalKeyCompare(benchmark::State& state) {
+  const int kCount = 1024;
+  InternalKeyComparator cmp(BytewiseComparator(), true);
+  std::vector<std::string> user_keys = SequentialKeys(kCount / 4);
+  std::vector<MVInternalKey> keys;
+  for (int i = 0; i < kCount; i++) {
+    // Groups of four versions share a user key so that both the sequence
+    // and the valid time tie-breaks are exercised.
+    keys.emplace_back(user_keys[i / 4], 100 + i / 2, kTypeValue,
+                      static_cast<ValidTime>(i % 2));
+  }
+  Random rnd(301);
+  for (auto _ : state) {
+    const MVInternalKey& a = keys[rnd.Uniform(kCount)];
+    const MVInternalKey& b = keys[rnd.Uniform(kCount)];
+    benchmark::DoNotOptimize(cmp.Compare(a.Encode(), b.Encode()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MVInternalKeyCompare);
+
+// ---------------------------------------------------------------------------
+// ShardedLRUCache
+// ---------------------------------------------------------------------------
+
+namespace {
+
+void DeleteNothing(const Slice& key, void* value) {}
+
+Cache* g_cache = nullptr;
+const int kCacheKeys = 4096;
+
+}  // namespace
+
+// Lookup/Release of resident entries from a cache shared by all threads.
+static void BM_CacheLookup(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    g_cache = NewLRUCache(kCacheKeys * 2);
+    for (int i = 0; i < kCacheKeys; i++) {
+      char buf[sizeof(uint32_t)];
+      EncodeFixed32(buf, i);
+      g_cache->Release(g_cache->Insert(Slice(buf, sizeof(buf)), nullptr, 1,
+                                       &DeleteNothing));
+    }
+  }
+  Random rnd(301 + state.thread_index());
+  char buf[sizeof(uint32_t)];
+  for (auto _ : state) {
+    EncodeFixed32(buf, rnd.Uniform(kCacheKeys));
+    Cache::Handle* handle = g_cache->Lookup(Slice(buf, sizeof(buf)));
+    if (handle != nullptr) {
+      g_cache->Release(handle);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    delete g_cache;
+    g_cache = nullptr;
+  }
+}
+BENCHMARK(BM_CacheLookup)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
@@ -7,6 +7,7 @@
 #include "db/dbformat.h"
 #include "db/filename.h"
 #include "db/table_cache.h"
+#include "db/value_log.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
@@ -15,7 +16,8 @@
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  ValueLogBuilder* value_log) {
   Status s;
   meta->file_size = 0;
   iter->SeekToFirst();
@@ -37,9 +39,22 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
       meta->smallest.DecodeFrom(iter->key());
     }
     Slice key;
+    std::string separated_key, index;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
-      builder->Add(key, iter->value());
+      Slice value = iter->value();
+      if (value_log != nullptr && value_log->ShouldStore(value.size()) &&
+          ExtractValueType(key, options.multi_version) == kTypeValue) {
+        s = value_log->Add(value, &index);
+        if (!s.ok()) {
+          break;
+        }
+        separated_key.assign(key.data(), key.size());
+        SetValueType(&separated_key, kTypeValueIndex, options.multi_version);
+        builder->Add(separated_key, index);
+      } else {
+        builder->Add(key, value);
+      }
     }
     if (!key.empty()) {
       // TODO: MVLevelDB version MVInternalKey
@@ -52,12 +67,19 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     }
 
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
     }
     delete builder;
+    if (s.ok() && value_log != nullptr) {
+      s = value_log->Finish();
+    }
 
     // Finish and check for file errors
     if (s.ok()) {
@@ -87,6 +109,9 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     // Keep it
   } else {
     env->RemoveFile(fname);
+    if (value_log != nullptr) {
+      value_log->Abandon();
+    }
   }
   return s;
 }
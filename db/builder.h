@@ -15,6 +15,7 @@ struct FileMetaData;
 class Env;
 class Iterator;
 class TableCache;
+class ValueLogBuilder;
 class VersionEdit;
 
 // Build a Table file from the contents of *iter.  The generated file
@@ -22,8 +23,11 @@ class VersionEdit;
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
 // zero, and no Table file will be produced.
+// If "value_log" is non-null, values it should store are moved there and
+// the table refers to them instead.  It is finished along with the table.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  ValueLogBuilder* value_log);
 
 }  // namespace leveldb
 
@@ -261,6 +261,33 @@ TEST_F(CorruptionTest, TableFileIndexData) {
   Check(5000, 9999);
 }
 
+TEST_F(CorruptionTest, MultiGetTableBlock) {
+  options_.block_size = 2 * kValueSize;  // Limit scope of corruption
+  Reopen();
+  Build(100);
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+  dbi->TEST_CompactMemTable();
+  Corrupt(kTableFile, 60000, 4000);  // Blocks of keys around 60
+
+  // Only the keys in the corrupted block fail, as they would with Get().
+  ReadOptions options;
+  options.verify_checksums = true;
+  std::string tmp1, tmp2, tmp3, tmp4;
+  std::vector<Slice> keys = {Key(0, &tmp1), Key(60, &tmp2), Key(95, &tmp3)};
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  db_->MultiGet(options, keys, &values, &statuses);
+  ASSERT_LEVELDB_OK(statuses[0]);
+  ASSERT_EQ(Value(0, &tmp4).ToString(), values[0]);
+  ASSERT_TRUE(statuses[1].IsCorruption()) << statuses[1].ToString();
+  ASSERT_LEVELDB_OK(statuses[2]);
+  ASSERT_EQ(Value(95, &tmp4).ToString(), values[2]);
+
+  std::string value;
+  ASSERT_LEVELDB_OK(db_->Get(options, keys[2], &value));
+  ASSERT_EQ(values[2], value);
+}
+
 TEST_F(CorruptionTest, MissingDescriptor) {
   Build(1000);
   RepairDB();
@@ -12,12 +12,14 @@
 #include "db/log_writer.h"
 #include "db/memtable.h"
 #include "db/table_cache.h"
+#include "db/value_log.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
 #include <set>
 #include <string>
 #include <vector>
@@ -33,6 +35,7 @@
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/io_stats.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
 
@@ -52,18 +55,118 @@ struct DBImpl::Writer {
   port::CondVar cv;
 };
 
+// A group of writes, led by "leader", that has been appended to the log by
+// PipelinedWriteImpl() and still has to be inserted into the memtable.
+struct DBImpl::MemTableWriteGroup {
+  Writer* leader;
+  std::vector<Writer*> followers;
+  WriteBatch* batch;  // null if the group failed before reaching the log
+  SequenceNumber last_sequence;
+  Status status;
+  bool log_sync_pending;   // In deferred_log_syncs_
+  Status log_sync_status;  // Result of the deferred log sync
+};
+
 // MVLevelDB: Writer
 struct DBImpl::WriterMV {
   explicit WriterMV(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr), sync(false), done(false), insert_group(nullptr),
+        cv(mu) {}
 
   Status status;
   WriteBatchMV* batch;
   bool sync;
   bool done;
+  MemTableInsertGroupMV* insert_group;  // Set while batch awaits insertion
   port::CondVar cv;
 };
 
+// MVLevelDB: a logged group whose writers insert their own batches
+struct DBImpl::MemTableInsertGroupMV {
+  WriterMV* leader;
+  MemTable* mem;
+  int pending;    // Followers that have not inserted their batch yet
+  Status status;  // First error a follower ran into
+};
+
+struct DBImpl::MemTableList {
+  explicit MemTableList(const std::vector<MemTable*>& m) : mems(m), refs(0) {
+    for (MemTable* mem : mems) {
+      mem->Ref();
+    }
+  }
+
+  MemTableList(const MemTableList&) = delete;
+  MemTableList& operator=(const MemTableList&) = delete;
+
+  ~MemTableList() {
+    for (MemTable* mem : mems) {
+      mem->Unref();
+    }
+  }
+
+  void Ref() { ++refs; }
+
+  void Unref() {
+    assert(refs >= 1);
+    if (--refs == 0) {
+      delete this;
+    }
+  }
+
+  // Look "key" up in the memtables, newest first.  Same contract as
+  // MemTable::Get(); "value" is either a std::string* or a Slice*.
+  template <typename Value>
+  bool Get(const LookupKey& key, Value* value, Status* s) {
+    for (size_t i = mems.size(); i > 0; i--) {
+      if (mems[i - 1]->Get(key, value, s)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename Value>
+  bool GetMV(const MVLookupKey& key, Value* value, ValidTimePeriod* period,
+             Status* s) {
+    for (size_t i = mems.size(); i > 0; i--) {
+      if (mems[i - 1]->GetMV(key, value, period, s)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t ApproximateMemoryUsage() const {
+    size_t usage = 0;
+    for (MemTable* mem : mems) {
+      usage += mem->ApproximateMemoryUsage();
+    }
+    return usage;
+  }
+
+  const std::vector<MemTable*> mems;  // Oldest first
+  int refs;                           // Protected by DBImpl::mutex_
+};
+
+struct DBImpl::SuperVersion {
+  SuperVersion(MemTable* mem, MemTableList* imm, Version* current)
+      : mem(mem), imm(imm), current(current), refs(1) {}
+
+  // Each referenced by the SuperVersion.  Only unreferenced once the
+  // SuperVersion is deleted, which happens with DBImpl::mutex_ held.
+  MemTable* const mem;
+  MemTableList* const imm;  // May be nullptr
+  Version* const current;
+
+  std::atomic<int> refs;
+};
+
+// Held in DBImpl::local_super_version_ by a thread while it reads through
+// the SuperVersion it took from there.
+static char super_version_in_use;
+static void* const kSuperVersionInUse = &super_version_in_use;
+
 struct DBImpl::CompactionState {
   // Files produced by compaction
   struct Output {
@@ -79,7 +182,9 @@ struct DBImpl::CompactionState {
         smallest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        value_log(nullptr),
+        value_log_gc_cutoff(0) {}
 
   Compaction* const compaction;
 
@@ -96,6 +201,17 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // Value log receiving the large values of all outputs, if any
+  ValueLogBuilder* value_log;
+
+  // Values still in use in value logs numbered up to this one are moved
+  // to value_log, or back into the tables if they no longer belong in a
+  // value log.
+  uint64_t value_log_gc_cutoff;
+
+  // Bytes of records in each value log the outputs no longer refer to
+  std::map<uint64_t, uint64_t> value_log_garbage;
 };
 
 // Fix user-supplied options to be reasonable
@@ -115,8 +231,15 @@ Options SanitizeOptions(const std::string& dbname,
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  if (result.multi_version) {
+    // Multi-version keys end in 16 bytes, not the 8 the hash index and
+    // the prefix filters strip.
+    result.data_block_hash_index = false;
+    result.prefix_extractor = nullptr;
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -140,12 +263,23 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Returns a copy of "src" that uses "env".
+static Options OptionsWithEnv(const Options& src, Env* env) {
+  Options result = src;
+  result.env = env;
+  return result;
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
-    : env_(raw_options.env),
+    : io_stats_env_(raw_options.collect_io_stats
+                        ? new IOStatsEnv(raw_options.env)
+                        : nullptr),
+      env_(io_stats_env_ != nullptr ? io_stats_env_ : raw_options.env),
       internal_comparator_(raw_options.comparator, raw_options.multi_version),
       internal_filter_policy_(raw_options.filter_policy),
       options_(SanitizeOptions(dbname, &internal_comparator_,
-                               &internal_filter_policy_, raw_options)),
+                               &internal_filter_policy_,
+                               OptionsWithEnv(raw_options, env_))),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
@@ -160,12 +294,20 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
+      first_recyclable_log_(0),
       tmp_batch_(new WriteBatch),
-      tmp_batch_mv_(new WriteBatchMV),  // MVLevelDB
+      memtable_writers_drained_(&mutex_),
+      super_version_(nullptr),
+      local_super_version_(&DBImpl::UnrefLocalSuperVersion),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      write_controller_(options_.delayed_write_rate,
+                        options_.soft_pending_compaction_bytes_limit),
+      tmp_batch_mv_(new WriteBatchMV),  // MVLevelDB
+      tracer_(nullptr),
+      tracing_(false) {}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -174,6 +316,18 @@ DBImpl::~DBImpl() {
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
   }
+  // Drop the references threads cache, then the SuperVersion itself.
+  std::vector<void*> cached;
+  local_super_version_.Scrape(&cached, nullptr);
+  for (void* ptr : cached) {
+    assert(ptr != kSuperVersionInUse);
+    UnrefLocalSuperVersion(ptr);
+  }
+  if (super_version_ != nullptr &&
+      super_version_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    DeleteSuperVersion(super_version_);
+  }
+  super_version_ = nullptr;
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -187,6 +341,7 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete tracer_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -194,6 +349,7 @@ DBImpl::~DBImpl() {
   if (owns_cache_) {
     delete options_.block_cache;
   }
+  delete io_stats_env_;
 }
 
 Status DBImpl::NewDB() {
@@ -203,6 +359,7 @@ Status DBImpl::NewDB() {
   new_db.SetNextFile(2);
   new_db.SetLastSequence(0);
 
+  IOCategoryScope io_category(kIOManifest);
   const std::string manifest = DescriptorFileName(dbname_, 1);
   WritableFile* file;
   Status s = env_->NewWritableFile(manifest, &file);
@@ -240,6 +397,46 @@ void DBImpl::MaybeIgnoreError(Status* s) const {
   }
 }
 
+Status DBImpl::NewLogFile(uint64_t number, WritableFile** file,
+                          log::Writer** log) {
+  mutex_.AssertHeld();
+  IOCategoryScope io_category(kIOWAL);
+  const std::string fname = LogFileName(dbname_, number);
+  Status s;
+  *file = nullptr;
+  if (!recycled_logs_.empty()) {
+    const std::string old_fname = LogFileName(dbname_, recycled_logs_.front());
+    recycled_logs_.pop_front();
+    s = env_->ReuseWritableFile(fname, old_fname, file);
+    if (s.ok()) {
+      Log(options_.info_log, "Recycling log %s as %s", old_fname.c_str(),
+          fname.c_str());
+    } else {
+      env_->RemoveFile(old_fname);
+    }
+  }
+  if (*file == nullptr) {
+    s = env_->NewWritableFile(fname, file);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  // A log holds about as much as a memtable.
+  (*file)->SetPreallocationBlockSize(options_.write_buffer_size +
+                                     options_.write_buffer_size / 10);
+  if (options_.recycle_log_file_num > 0) {
+    if (first_recyclable_log_ == 0) {
+      first_recyclable_log_ = number;
+    }
+    *log = new log::Writer(*file, 0, number);
+  } else {
+    *log = new log::Writer(*file);
+  }
+  (*log)->SetCompression(options_.wal_compression);
+  return s;
+}
+
 void DBImpl::RemoveObsoleteFiles() {
   mutex_.AssertHeld();
 
@@ -264,7 +461,17 @@ void DBImpl::RemoveObsoleteFiles() {
       switch (type) {
         case kLogFile:
           keep = ((number >= versions_->LogNumber()) ||
-                  (number == versions_->PrevLogNumber()));
+                  (number == versions_->PrevLogNumber()) ||
+                  (std::find(recycled_logs_.begin(), recycled_logs_.end(),
+                             number) != recycled_logs_.end()));
+          if (!keep && first_recyclable_log_ != 0 &&
+              number >= first_recyclable_log_ &&
+              recycled_logs_.size() <
+                  static_cast<size_t>(options_.recycle_log_file_num)) {
+            // Keep the file to be overwritten by a later log.
+            recycled_logs_.push_back(number);
+            keep = true;
+          }
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -272,6 +479,7 @@ void DBImpl::RemoveObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kValueLogFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -290,6 +498,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kValueLogFile) {
+          table_cache_->EvictValueLog(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -339,7 +549,10 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     }
   }
 
-  s = versions_->Recover(save_manifest);
+  {
+    IOCategoryScope io_category(kIOManifest);
+    s = versions_->Recover(save_manifest);
+  }
   if (!s.ok()) {
     return s;
   }
@@ -417,6 +630,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   };
 
   mutex_.AssertHeld();
+  IOCategoryScope io_category(kIOWAL);
 
   // Open the log file
   std::string fname = LogFileName(dbname_, log_number);
@@ -437,7 +651,8 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   // paranoid_checks==false so that corruptions cause entire commits
   // to be skipped instead of propagating bad information (like overly
   // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                     log_number);
   Log(options_.info_log, "Recovering log #%llu",
       (unsigned long long)log_number);
 
@@ -473,7 +688,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table({mem}, edit, nullptr);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -486,8 +701,11 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 
   delete file;
 
-  // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
+  // See if we should keep reusing the last log file.  A log in the
+  // recyclable format may be followed by leftovers of a previous use of
+  // the file, so it cannot be appended to.
+  if (status.ok() && options_.reuse_logs && last_log && compactions == 0 &&
+      !reader.recyclable()) {
     assert(logfile_ == nullptr);
     assert(log_ == nullptr);
     assert(mem_ == nullptr);
@@ -496,6 +714,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         env_->NewAppendableFile(fname, &logfile_).ok()) {
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
       log_ = new log::Writer(logfile_, lfile_size);
+      log_->SetCompression(options_.wal_compression);
       logfile_number_ = log_number;
       if (mem != nullptr) {
         mem_ = mem;
@@ -512,7 +731,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table({mem}, edit, nullptr);
     }
     mem->Unref();
   }
@@ -520,24 +739,41 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+Status DBImpl::WriteLevel0Table(const std::vector<MemTable*>& mems,
+                                VersionEdit* edit, Version* base) {
   mutex_.AssertHeld();
+  assert(!mems.empty());
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator();
-  Log(options_.info_log, "Level-0 table #%llu: started",
-      (unsigned long long)meta.number);
+  std::vector<Iterator*> list;
+  for (MemTable* mem : mems) {
+    list.push_back(mem->NewIterator());
+  }
+  Iterator* iter =
+      NewMergingIterator(&internal_comparator_, &list[0], list.size());
+  Log(options_.info_log, "Level-0 table #%llu: started (%d memtables)",
+      (unsigned long long)meta.number, static_cast<int>(mems.size()));
+
+  // Large values go to a value log written alongside the table.
+  ValueLogBuilder* value_log = nullptr;
+  if (options_.value_log_threshold > 0 && !options_.multi_version) {
+    value_log = new ValueLogBuilder(dbname_, options_,
+                                    versions_->NewFileNumber());
+    pending_outputs_.insert(value_log->number());
+  }
 
   Status s;
   {
+    IOCategoryScope io_category(kIOFlush);
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta,
+                   value_log);
     if (options_.multi_version) {
-      meta.start_time = mem->GetStartValidTime();
-      meta.end_time = mem->GetEndValidTime();
+      // The memtables cover consecutive valid time periods.
+      meta.start_time = mems.front()->GetStartValidTime();
+      meta.end_time = mems.back()->GetEndValidTime();
     }
     mutex_.Lock();
   }
@@ -548,6 +784,16 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   delete iter;
   pending_outputs_.erase(meta.number);
 
+  uint64_t value_log_size = 0;
+  if (value_log != nullptr) {
+    if (s.ok() && value_log->NumEntries() > 0) {
+      value_log_size = value_log->FileSize();
+      edit->AddValueLog(value_log->number(), value_log_size);
+    }
+    pending_outputs_.erase(value_log->number());
+    delete value_log;
+  }
+
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
   int level = 0;
@@ -570,7 +816,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + value_log_size;
   stats_[level].Add(stats);
   return s;
 }
@@ -579,33 +825,71 @@ void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
   assert(imm_ != nullptr);
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of the immutable memtables as a new Table.  Ones
+  // that become immutable while it is written are left for the next call.
+  MemTableList* imm = imm_;
+  imm->Ref();
+  // The memtable following the newest one being flushed is mem_, which
+  // is the only one still needing earlier logs once the table is in.
+  const uint64_t log_number = logfile_number_;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(imm->mems, &edit, base);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
     s = Status::IOError("Deleting DB during memtable compaction");
   }
 
-  // Replace immutable memtable with the generated Table
+  // Replace immutable memtables with the generated Table
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    edit.SetLogNumber(log_number);  // Earlier logs no longer needed
+    IOCategoryScope io_category(kIOManifest);
     s = versions_->LogAndApply(&edit, &mutex_);
   }
 
   if (s.ok()) {
-    // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    // Commit to the new state.  Memtables are only appended to imm_
+    // meanwhile, so the flushed ones are still its oldest.
+    assert(imm_->mems.size() >= imm->mems.size());
+    InstallImmutableMemTables(std::vector<MemTable*>(
+        imm_->mems.begin() + imm->mems.size(), imm_->mems.end()));
+    InstallSuperVersion();
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
   }
+  imm->Unref();
+}
+
+void DBImpl::InstallImmutableMemTables(const std::vector<MemTable*>& mems) {
+  mutex_.AssertHeld();
+  MemTableList* list = nullptr;
+  if (!mems.empty()) {
+    list = new MemTableList(mems);
+    list->Ref();
+  }
+  if (imm_ != nullptr) {
+    imm_->Unref();
+  }
+  imm_ = list;
+  has_imm_.store(list != nullptr, std::memory_order_release);
+}
+
+void DBImpl::SwitchMemTable() {
+  mutex_.AssertHeld();
+  std::vector<MemTable*> mems;
+  if (imm_ != nullptr) {
+    mems = imm_->mems;
+  }
+  mems.push_back(mem_);
+  InstallImmutableMemTables(mems);
+  mem_->Unref();  // Now referenced by imm_
+  mem_ = new MemTable(internal_comparator_);
+  mem_->Ref();
+  InstallSuperVersion();
 }
 
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
@@ -736,7 +1020,7 @@ void DBImpl::BackgroundCall() {
   } else if (options_.multi_version) {
     // MVLevelDB: We only have 1 on-disk level.
     if (imm_ != nullptr) {
-      if (!imm_->GetDuplicateStatus()) {
+      if (!imm_->mems.back()->GetDuplicateStatus()) {
         // DuplicateFromImmutableMemTable();
         // imm_->FinishDuplicate();
       }
@@ -791,8 +1075,11 @@ void DBImpl::BackgroundCompaction() {
     c->edit()->RemoveFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
                        f->largest);
+    IOCategoryScope io_category(kIOManifest);
     status = versions_->LogAndApply(c->edit(), &mutex_);
-    if (!status.ok()) {
+    if (status.ok()) {
+      InstallSuperVersion();
+    } else {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
@@ -849,6 +1136,10 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  if (compact->value_log != nullptr) {
+    pending_outputs_.erase(compact->value_log->number());
+    delete compact->value_log;
+  }
   delete compact;
 }
 
@@ -869,6 +1160,7 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   }
 
   // Make the output file
+  IOCategoryScope io_category(kIOCompactionOutput);
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
@@ -885,6 +1177,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   const uint64_t output_number = compact->current_output()->number;
   assert(output_number != 0);
+  IOCategoryScope io_category(kIOCompactionOutput);
 
   // Check for iterator errors
   Status s = input->status();
@@ -941,7 +1234,68 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
                                          out.smallest, out.largest);
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  if (compact->value_log != nullptr && compact->value_log->NumEntries() > 0) {
+    compact->compaction->edit()->AddValueLog(compact->value_log->number(),
+                                             compact->value_log->FileSize());
+  }
+  for (const auto& garbage : compact->value_log_garbage) {
+    compact->compaction->edit()->AddValueLogGarbage(garbage.first,
+                                                    garbage.second);
+  }
+  IOCategoryScope io_category(kIOManifest);
+  Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  if (s.ok()) {
+    InstallSuperVersion();
+  }
+  return s;
+}
+
+Status DBImpl::SeparateCompactionValue(CompactionState* compact,
+                                       ValueType type, bool drop, Slice* key,
+                                       Slice* value, std::string* key_buf,
+                                       std::string* value_buf) {
+  ValueIndex index;
+  if (type == kTypeValueIndex) {
+    Status s = index.DecodeFrom(*value);
+    if (!s.ok()) {
+      return s;
+    }
+    if (drop) {
+      compact->value_log_garbage[index.file_number] += index.record_size();
+      return s;
+    }
+    if (index.file_number > compact->value_log_gc_cutoff) {
+      return s;  // Leave the value where it is
+    }
+    // Move the value out of the old value log
+    s = table_cache_->GetValue(*value, value_buf);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->value_log_garbage[index.file_number] += index.record_size();
+    *value = *value_buf;
+    key_buf->assign(key->data(), key->size());
+    SetValueType(key_buf, kTypeValue, false);
+    *key = *key_buf;
+  } else if (type != kTypeValue || drop) {
+    return Status::OK();
+  }
+
+  if (compact->value_log == nullptr ||
+      !compact->value_log->ShouldStore(value->size())) {
+    return Status::OK();
+  }
+  IOCategoryScope output_category(kIOCompactionOutput);
+  std::string new_index;
+  Status s = compact->value_log->Add(*value, &new_index);
+  if (s.ok()) {
+    value_buf->swap(new_index);
+    *value = *value_buf;
+    key_buf->assign(key->data(), key->size());
+    SetValueType(key_buf, kTypeValueIndex, false);
+    *key = *key_buf;
+  }
+  return s;
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -961,7 +1315,16 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
+  compact->value_log_gc_cutoff =
+      versions_->ValueLogGCCutoff(options_.value_log_gc_age_cutoff);
+  if (options_.value_log_threshold > 0) {
+    compact->value_log = new ValueLogBuilder(dbname_, options_,
+                                             versions_->NewFileNumber());
+    pending_outputs_.insert(compact->value_log->number());
+  }
 
+  // Opening the input tables reads their index and filter blocks.
+  IOCategoryScope io_category(kIOCompactionInput);
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
@@ -973,6 +1336,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  std::string rewritten_key, rewritten_value;
   while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
@@ -998,7 +1362,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {
+    bool valid_key = ParseInternalKey(key, &ikey);
+    if (!valid_key) {
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -1041,6 +1406,15 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
+    Slice value = input->value();
+    if (valid_key) {
+      status = SeparateCompactionValue(compact, ikey.type, drop, &key, &value,
+                                       &rewritten_key, &rewritten_value);
+      if (!status.ok()) {
+        break;
+      }
+    }
+
     if (!drop) {
       // Open output file if necessary
       if (compact->builder == nullptr) {
@@ -1053,7 +1427,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      {
+        IOCategoryScope output_category(kIOCompactionOutput);
+        compact->builder->Add(key, value);
+      }
 
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
@@ -1077,6 +1454,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok()) {
     status = input->status();
   }
+  if (status.ok() && compact->value_log != nullptr) {
+    IOCategoryScope output_category(kIOCompactionOutput);
+    status = compact->value_log->Finish();
+  }
   delete input;
   input = nullptr;
 
@@ -1090,6 +1471,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  if (compact->value_log != nullptr) {
+    stats.bytes_written += compact->value_log->FileSize();
+  }
 
   mutex_.Lock();
   stats_[compact->compaction->level() + 1].Add(stats);
@@ -1105,29 +1489,114 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   return status;
 }
 
-namespace {
-
-struct IterState {
-  port::Mutex* const mu;
-  Version* const version GUARDED_BY(mu);
-  MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+struct DBImpl::IterState {
+  DBImpl* const db;
+  Version* const version GUARDED_BY(db->mutex_);
+  MemTable* const mem GUARDED_BY(db->mutex_);
+  MemTableList* const imm GUARDED_BY(db->mutex_);
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  IterState(DBImpl* db, MemTable* mem, MemTableList* imm, Version* version)
+      : db(db), version(version), mem(mem), imm(imm) {}
 };
 
-static void CleanupIteratorState(void* arg1, void* arg2) {
+void DBImpl::CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
-  state->mu->Lock();
+  DBImpl* db = state->db;
+  db->mutex_.Lock();
+  db->live_iterators_.erase(state);
   state->mem->Unref();
   if (state->imm != nullptr) state->imm->Unref();
   state->version->Unref();
-  state->mu->Unlock();
+  db->mutex_.Unlock();
   delete state;
 }
 
-}  // anonymous namespace
+void DBImpl::InstallSuperVersion() {
+  mutex_.AssertHeld();
+  Version* current = versions_->current();
+  SuperVersion* old = super_version_;
+  if (old != nullptr && old->mem == mem_ && old->imm == imm_ &&
+      old->current == current) {
+    return;
+  }
+  mem_->Ref();
+  if (imm_ != nullptr) imm_->Ref();
+  current->Ref();
+  super_version_ = new SuperVersion(mem_, imm_, current);
+  if (old == nullptr) {
+    return;
+  }
+
+  // Take back the references threads cache to the old SuperVersion, so
+  // that their next read picks up the new one.  A thread reading through
+  // it right now drops its reference once it is done.
+  std::vector<void*> cached;
+  local_super_version_.Scrape(&cached, nullptr);
+  for (void* ptr : cached) {
+    if (ptr != kSuperVersionInUse) {
+      assert(ptr == old);
+      UnrefLocalSuperVersion(ptr);
+    }
+  }
+  if (old->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    DeleteSuperVersion(old);
+  } else {
+    old_super_versions_.insert(old);
+  }
+}
+
+DBImpl::SuperVersion* DBImpl::GetSuperVersion() {
+  void* ptr = local_super_version_.Swap(kSuperVersionInUse);
+  assert(ptr != kSuperVersionInUse);
+  SuperVersion* sv = reinterpret_cast<SuperVersion*>(ptr);
+  if (sv == nullptr) {
+    // First read by this thread since the SuperVersion was installed.
+    MutexLock l(&mutex_);
+    sv = super_version_;
+    sv->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  return sv;
+}
+
+void DBImpl::ReturnSuperVersion(SuperVersion* sv) {
+  void* expected = kSuperVersionInUse;
+  if (!local_super_version_.CompareAndSwap(sv, expected)) {
+    // A newer SuperVersion was installed meanwhile.
+    assert(expected == nullptr);
+    UnrefSuperVersion(sv);
+  }
+}
+
+void DBImpl::UnrefSuperVersion(SuperVersion* sv) {
+  if (sv->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    MutexLock l(&mutex_);
+    DeleteSuperVersion(sv);
+  }
+}
+
+void DBImpl::DeleteSuperVersion(SuperVersion* sv) {
+  mutex_.AssertHeld();
+  old_super_versions_.erase(sv);
+  sv->mem->Unref();
+  if (sv->imm != nullptr) sv->imm->Unref();
+  sv->current->Unref();
+  delete sv;
+}
+
+void DBImpl::UnrefPinnedSuperVersion(void* arg1, void* arg2) {
+  DBImpl* db = reinterpret_cast<DBImpl*>(arg1);
+  db->UnrefSuperVersion(reinterpret_cast<SuperVersion*>(arg2));
+}
+
+void DBImpl::UnrefLocalSuperVersion(void* ptr) {
+  // Never the last reference: a SuperVersion is only unreferenced by
+  // super_version_ after the references threads cache have been taken
+  // back.
+  SuperVersion* sv = reinterpret_cast<SuperVersion*>(ptr);
+  const int refs = sv->refs.fetch_sub(1, std::memory_order_acq_rel);
+  assert(refs > 1);
+  (void)refs;
+}
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
@@ -1140,7 +1609,9 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
   list.push_back(mem_->NewIterator());
   mem_->Ref();
   if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
+    for (size_t i = imm_->mems.size(); i > 0; i--) {
+      list.push_back(imm_->mems[i - 1]->NewIterator());
+    }
     imm_->Ref();
   }
   versions_->current()->AddIterators(options, &list);
@@ -1148,7 +1619,8 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
+  IterState* cleanup = new IterState(this, mem_, imm_, versions_->current());
+  live_iterators_.insert(cleanup);
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
@@ -1169,57 +1641,60 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->Get(key);
+  }
+
   Status s;
-  MutexLock l(&mutex_);
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
         static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
   } else {
+    // Read before the SuperVersion is, so that the SuperVersion holds
+    // everything written up to it.
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
-
-  bool have_stat_update = false;
+  SuperVersion* sv = GetSuperVersion();
+  Version* current = sv->current;
   Version::GetStats stats;
-
-  // Unlock while reading from files and memtables
+  stats.seek_file = nullptr;
   {
-    mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    IOCategoryScope io_category(kIOUserRead);
+    // First look in the memtable, then in the immutable memtables (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
+    if (sv->mem->Get(lkey, value, &s)) {
       // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
+    } else if (sv->imm != nullptr && sv->imm->Get(lkey, value, &s)) {
       // Done
     } else {
       s = current->Get(options, lkey, value, &stats);
-      have_stat_update = true;
     }
-    mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  // Only reads that had to look in more than one file are charged, so
+  // most reads never lock mutex_.
+  if (stats.seek_file != nullptr) {
+    MutexLock l(&mutex_);
+    if (current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
+  ReturnSuperVersion(sv);
   return s;
 }
 
-// TODO
-// MVLevelDB version of Get
-Status DBImpl::GetMV(const ReadOptions& options, const Slice& key, ValidTime vt,
-                     ValidTimePeriod* period, std::string* value) {
+Status DBImpl::GetPinned(const ReadOptions& options, const Slice& key,
+                         PinnedValue* value) {
+  value->Reset();
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->Get(key);
+  }
+
   Status s;
-  MutexLock l(&mutex_);
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
@@ -1228,49 +1703,72 @@ Status DBImpl::GetMV(const ReadOptions& options, const Slice& key, ValidTime vt,
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
-
-  bool have_stat_update = false;
+  SuperVersion* sv = GetSuperVersion();
+  Version* current = sv->current;
   Version::GetStats stats;
-
-  // Unlock while reading from files and memtables
+  stats.seek_file = nullptr;
   {
-    mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
-    MVLookupKey lkey(key, snapshot, vt);
-    if (mem->GetMV(lkey, value, period, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->GetMV(lkey, value, period, &s)) {
-      // Done
+    IOCategoryScope io_category(kIOUserRead);
+    // First look in the memtable, then in the immutable memtables (if any).
+    LookupKey lkey(key, snapshot);
+    Slice v;
+    if (sv->mem->Get(lkey, &v, &s) ||
+        (sv->imm != nullptr && sv->imm->Get(lkey, &v, &s))) {
+      if (s.ok()) {
+        // Keep the memtables alive for as long as *value is.
+        sv->refs.fetch_add(1, std::memory_order_relaxed);
+        value->PinSlice(v);
+        value->RegisterCleanup(&UnrefPinnedSuperVersion, this, sv);
+      }
     } else {
-      //      s = Status::NotFound("NOT_FOUND_IN_CACHE");
-      s = current->GetMV(options, lkey, value, period, &stats);
-      // TODO: DEBUG
-      period->hi = 2021;
-      have_stat_update = true;
+      // A value found in a table pins its block and table by itself.
+      s = current->Get(options, lkey, value, &stats);
     }
-    mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  if (stats.seek_file != nullptr) {
+    MutexLock l(&mutex_);
+    if (current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
+  }
+  ReturnSuperVersion(sv);
+  if (!s.ok()) {
+    value->Reset();
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
-
   return s;
 }
 
-Status DBImpl::GetMVRange(const ReadOptions& options, const KeyList& key_list,
-                          const TimeRange& time_range, ResultSet* result_set) {
-  Status s;
-  MutexLock l(&mutex_);
+void DBImpl::MultiGet(const ReadOptions& options,
+                      const std::vector<Slice>& keys,
+                      std::vector<std::string>* values,
+                      std::vector<Status>* statuses) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) {
+      for (const Slice& key : keys) {
+        tracer_->Get(key);
+      }
+    }
+  }
+
+  const size_t n = keys.size();
+  values->clear();
+  values->resize(n);
+  statuses->clear();
+  statuses->resize(n);
+
+  // Look the keys up in order, so that those in the same table or block
+  // are next to each other.
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) {
+    order[i] = i;
+  }
+  const Comparator* ucmp = user_comparator();
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return ucmp->Compare(keys[a], keys[b]) < 0;
+  });
+
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
@@ -1279,56 +1777,268 @@ Status DBImpl::GetMVRange(const ReadOptions& options, const KeyList& key_list,
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
-
-  bool have_stat_update = false;
-  Version::GetStats stats;
-
+  SuperVersion* sv = GetSuperVersion();
+  Version* current = sv->current;
+  std::deque<LookupKey> lkeys;  // Must not move while in use
+  std::vector<Version::KeyLookup> lookups;
   {
-    mutex_.Unlock();
-    if (TimeOverLapping(
-            TimeRange(mem->GetStartValidTime(), mem->GetEndValidTime()),
-            time_range)) {
-      mem->GetMVRange(key_list, time_range, snapshot, result_set, &s);
+    IOCategoryScope io_category(kIOUserRead);
+    // First look in the memtable, then in the immutable memtables (if
+    // any), and finally look the remaining keys up in the tables together.
+    for (size_t i : order) {
+      lkeys.emplace_back(keys[i], snapshot);
+      const LookupKey& lkey = lkeys.back();
+      std::string* value = &(*values)[i];
+      Status* s = &(*statuses)[i];
+      if (sv->mem->Get(lkey, value, s)) {
+        // Done
+      } else if (sv->imm != nullptr && sv->imm->Get(lkey, value, s)) {
+        // Done
+      } else {
+        Version::KeyLookup lookup;
+        lookup.key = &lkey;
+        lookup.value = value;
+        lookup.status = s;
+        lookups.push_back(lookup);
+      }
     }
-    if (imm != nullptr && TimeOverLapping(TimeRange(imm->GetStartValidTime(),
-                                                    imm->GetEndValidTime()),
-                                          time_range)) {
-      imm->GetMVRange(key_list, time_range, snapshot, result_set, &s);
+    if (!lookups.empty()) {
+      current->MultiGet(options, &lookups);
     }
-    // if (imm != nullptr && imm->GetStartValidTime() > time_range.lo) {
-
-    // Need to search more files
-    s = current->GetMVRange(options, snapshot, key_list, time_range, result_set,
-                            &stats);
-    mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  bool have_stat_update = false;
+  for (const Version::KeyLookup& lookup : lookups) {
+    if (lookup.stats.seek_file != nullptr) {
+      have_stat_update = true;
+      break;
+    }
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
-
-  return s;
-}
-
-Iterator* DBImpl::NewIterator(const ReadOptions& options) {
-  SequenceNumber latest_snapshot;
+  if (have_stat_update) {
+    MutexLock l(&mutex_);
+    bool schedule_compaction = false;
+    for (const Version::KeyLookup& lookup : lookups) {
+      if (current->UpdateStats(lookup.stats)) {
+        schedule_compaction = true;
+      }
+    }
+    if (schedule_compaction) {
+      MaybeScheduleCompaction();
+    }
+  }
+  ReturnSuperVersion(sv);
+}
+
+// TODO
+// MVLevelDB version of Get
+Status DBImpl::GetMV(const ReadOptions& options, const Slice& key, ValidTime vt,
+                     ValidTimePeriod* period, std::string* value) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->GetMV(key, vt);
+  }
+
+  Status s;
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  SuperVersion* sv = GetSuperVersion();
+  Version* current = sv->current;
+  Version::GetStats stats;
+  stats.seek_file = nullptr;
+  {
+    IOCategoryScope io_category(kIOUserRead);
+    // First look in the memtable, then in the immutable memtables (if any).
+    MVLookupKey lkey(key, snapshot, vt);
+    if (sv->mem->GetMV(lkey, value, period, &s)) {
+      // Done
+    } else if (sv->imm != nullptr && sv->imm->GetMV(lkey, value, period, &s)) {
+      // Done
+    } else {
+      //      s = Status::NotFound("NOT_FOUND_IN_CACHE");
+      s = current->GetMV(options, lkey, value, period, &stats);
+      // TODO: DEBUG
+      period->hi = 2021;
+    }
+  }
+
+  if (stats.seek_file != nullptr) {
+    MutexLock l(&mutex_);
+    if (current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
+  }
+  ReturnSuperVersion(sv);
+
+  return s;
+}
+
+Status DBImpl::GetMVPinned(const ReadOptions& options, const Slice& key,
+                           ValidTime vt, ValidTimePeriod* period,
+                           PinnedValue* value) {
+  value->Reset();
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->GetMV(key, vt);
+  }
+
+  Status s;
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  SuperVersion* sv = GetSuperVersion();
+  Version* current = sv->current;
+  Version::GetStats stats;
+  stats.seek_file = nullptr;
+  {
+    IOCategoryScope io_category(kIOUserRead);
+    // First look in the memtable, then in the immutable memtables (if any).
+    MVLookupKey lkey(key, snapshot, vt);
+    Slice v;
+    if (sv->mem->GetMV(lkey, &v, period, &s) ||
+        (sv->imm != nullptr && sv->imm->GetMV(lkey, &v, period, &s))) {
+      if (s.ok()) {
+        sv->refs.fetch_add(1, std::memory_order_relaxed);
+        value->PinSlice(v);
+        value->RegisterCleanup(&UnrefPinnedSuperVersion, this, sv);
+      }
+    } else {
+      s = current->GetMV(options, lkey, value, period, &stats);
+      // Same as GetMV()
+      period->hi = 2021;
+    }
+  }
+
+  if (stats.seek_file != nullptr) {
+    MutexLock l(&mutex_);
+    if (current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
+  }
+  ReturnSuperVersion(sv);
+  if (!s.ok()) {
+    value->Reset();
+  }
+  return s;
+}
+
+Status DBImpl::GetMVRange(const ReadOptions& options, const KeyList& key_list,
+                          const TimeRange& time_range, ResultSet* result_set) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->GetMVRange(key_list, time_range);
+  }
+
+  Status s;
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  SuperVersion* sv = GetSuperVersion();
+  MemTable* mem = sv->mem;
+  MemTableList* imm = sv->imm;
+  Version::GetStats stats;
+  {
+    IOCategoryScope io_category(kIOUserRead);
+    if (TimeOverLapping(
+            TimeRange(mem->GetStartValidTime(), mem->GetEndValidTime()),
+            time_range)) {
+      mem->GetMVRange(key_list, time_range, snapshot, result_set, &s);
+    }
+    for (size_t i = (imm != nullptr) ? imm->mems.size() : 0; i > 0; i--) {
+      MemTable* m = imm->mems[i - 1];
+      if (TimeOverLapping(
+              TimeRange(m->GetStartValidTime(), m->GetEndValidTime()),
+              time_range)) {
+        m->GetMVRange(key_list, time_range, snapshot, result_set, &s);
+      }
+    }
+    // if (imm != nullptr && imm->GetStartValidTime() > time_range.lo) {
+
+    // Need to search more files
+    s = sv->current->GetMVRange(options, snapshot, key_list, time_range,
+                                result_set, &stats);
+  }
+  ReturnSuperVersion(sv);
+
+  return s;
+}
+
+namespace {
+
+// Forwards to a DB iterator, recording its positioning calls in the trace.
+class TracingIterator : public Iterator {
+ public:
+  TracingIterator(DBImpl* db, Iterator* iter) : db_(db), iter_(iter) {}
+
+  TracingIterator(const TracingIterator&) = delete;
+  TracingIterator& operator=(const TracingIterator&) = delete;
+
+  ~TracingIterator() override { delete iter_; }
+
+  bool Valid() const override { return iter_->Valid(); }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+
+  void Seek(const Slice& target) override {
+    db_->RecordIteratorTrace(kTraceIteratorSeek, target);
+    iter_->Seek(target);
+  }
+  void SeekToFirst() override {
+    db_->RecordIteratorTrace(kTraceIteratorSeekToFirst, Slice());
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    db_->RecordIteratorTrace(kTraceIteratorSeekToLast, Slice());
+    iter_->SeekToLast();
+  }
+
+ private:
+  DBImpl* const db_;
+  Iterator* const iter_;
+};
+
+}  // anonymous namespace
+
+Iterator* DBImpl::NewIterator(const ReadOptions& options) {
+  SequenceNumber latest_snapshot;
   uint32_t seed;
   Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
-                       (options.snapshot != nullptr
-                            ? static_cast<const SnapshotImpl*>(options.snapshot)
-                                  ->sequence_number()
-                            : latest_snapshot),
-                       seed);
+  Iterator* db_iter = NewDBIterator(
+      this, user_comparator(), iter,
+      (options.snapshot != nullptr
+           ? static_cast<const SnapshotImpl*>(options.snapshot)
+                 ->sequence_number()
+           : latest_snapshot),
+      seed, options.prefix_seek ? options_.prefix_extractor : nullptr);
+  if (tracing_.load(std::memory_order_relaxed)) {
+    db_iter = new TracingIterator(this, db_iter);
+  }
+  return db_iter;
+}
+
+void DBImpl::RecordIteratorTrace(TraceType type, const Slice& target) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->IteratorOp(type, target);
+  }
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1338,6 +2048,11 @@ void DBImpl::RecordReadSample(Slice key) {
   }
 }
 
+Status DBImpl::GetValueFromLog(const Slice& value_index,
+                               std::string* value) {
+  return table_cache_->GetValue(value_index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
@@ -1350,29 +2065,62 @@ void DBImpl::ReleaseSnapshot(const Snapshot* snapshot) {
 
 // Convenience methods
 Status DBImpl::Put(const WriteOptions& o, const Slice& key, const Slice& val) {
-  return DB::Put(o, key, val);
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->Put(key, val);
+  }
+  WriteBatch batch;
+  batch.PutRef(key, val);
+  return WriteImpl(o, &batch);
 }
 
 Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
-  return DB::Delete(options, key);
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->Delete(key);
+  }
+  WriteBatch batch;
+  batch.Delete(key);
+  return WriteImpl(options, &batch);
 }
 
 // MVLevelDB version of Put/Delete
 Status DBImpl::PutMV(const WriteOptions& opt, const Slice& key, ValidTime vt,
                      const Slice& val) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->PutMV(key, vt, val);
+  }
   WriteBatchMV batch_mv;
-  batch_mv.Put(key, vt, val);
-  return WriteMV(opt, &batch_mv);
+  batch_mv.PutRef(key, vt, val);
+  return WriteMVImpl(opt, &batch_mv);
 }
 
 Status DBImpl::DeleteMV(const WriteOptions& opt, const Slice& key,
                         const ValidTime vt) {
+  if (tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->DeleteMV(key, vt);
+  }
   WriteBatchMV batch_mv;
   batch_mv.Delete(key, vt);
-  return WriteMV(opt, &batch_mv);
+  return WriteMVImpl(opt, &batch_mv);
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  if (updates != nullptr && tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->Write(updates);
+  }
+  return WriteImpl(options, updates);
+}
+
+Status DBImpl::WriteImpl(const WriteOptions& options, WriteBatch* updates) {
+  if (options_.enable_pipelined_write && !options_.multi_version &&
+      updates != nullptr) {
+    return PipelinedWriteImpl(options, updates);
+  }
+
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
@@ -1391,8 +2139,12 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Status status = MakeRoomForWrite(updates == nullptr);
   uint64_t last_sequence = versions_->LastSequence();
   Writer* last_writer = &w;
-  if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
-    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+  const bool grouped = status.ok() && updates != nullptr;
+  if (grouped) {  // nullptr batch is for compactions
+    if (options.sync) {
+      MaybeDelaySyncCommit(writers_.size());
+    }
+    WriteBatch* write_batch = BuildBatchGroup(&last_writer, tmp_batch_);
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(write_batch);
 
@@ -1401,11 +2153,16 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     // and protects against concurrent loggers and concurrent writes
     // into mem_.
     {
+      IOCategoryScope io_category(kIOWAL);
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      std::vector<Slice> parts;
+      WriteBatchInternal::GetParts(write_batch, &parts);
+      status = log_->AddRecord(parts.data(), parts.size());
+      bool synced = false;
       bool sync_error = false;
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
+        synced = true;
         if (!status.ok()) {
           sync_error = true;
         }
@@ -1414,6 +2171,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
+      if (synced) {
+        write_stats_.log_syncs++;
+      }
       if (sync_error) {
         // The state of the log file is indeterminate: the log record we
         // just added may or may not show up when the DB is re-opened.
@@ -1426,9 +2186,11 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     versions_->SetLastSequence(last_sequence);
   }
 
+  size_t group_size = 0;
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
+    group_size++;
     if (ready != &w) {
       ready->status = status;
       ready->done = true;
@@ -1436,6 +2198,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     }
     if (ready == last_writer) break;
   }
+  if (grouped) {
+    RecordWriteGroup(group_size, options.sync);
+  }
 
   // Notify new head of write queue
   if (!writers_.empty()) {
@@ -1445,8 +2210,160 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+// The write queue is split into two stages.  As in WriteImpl(), the writer
+// at the front of writers_ builds a group and appends it to the log.  It
+// then moves the group to memtable_writers_ and hands writers_ over to the
+// next leader, which can log its own group while this one is being
+// inserted into the memtable.  Groups are inserted (unless
+// allow_concurrent_memtable_write is set), and LastSequence() advanced past
+// them, one at a time in the order in which they were logged, so readers
+// never see a write before the ones logged ahead of it.
+//
+// A sync group whose successor at the front of writers_ is a sync write
+// too leaves the log sync to it, so that one sync covers both.  The group
+// waits in deferred_log_syncs_ before it becomes visible and returns.
+Status DBImpl::PipelinedWriteImpl(const WriteOptions& options,
+                                  WriteBatch* updates) {
+  Writer w(&mutex_);
+  w.batch = updates;
+  w.sync = options.sync;
+  w.done = false;
+
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  // Followers leave writers_ before they are done (see below).
+  while (!w.done && (writers_.empty() || &w != writers_.front())) {
+    w.cv.Wait();
+  }
+  if (w.done) {
+    return w.status;
+  }
+
+  // May temporarily unlock and wait.
+  Status status = MakeRoomForWrite(false);
+
+  MemTableWriteGroup group;
+  group.leader = &w;
+  group.batch = nullptr;
+  group.log_sync_pending = false;
+  // Sequence numbers handed out to earlier groups are published once they
+  // have been inserted, which may not have happened yet.
+  group.last_sequence = memtable_writers_.empty()
+                            ? versions_->LastSequence()
+                            : memtable_writers_.back()->last_sequence;
+  Writer* last_writer = &w;
+  WriteBatch scratch;  // Must outlive the memtable insert below
+  const bool grouped = status.ok();
+  if (grouped) {
+    if (options.sync) {
+      MaybeDelaySyncCommit(writers_.size());
+    }
+    group.batch = BuildBatchGroup(&last_writer, &scratch);
+    WriteBatchInternal::SetSequence(group.batch, group.last_sequence + 1);
+    group.last_sequence += WriteBatchInternal::Count(group.batch);
+
+    // We can release the lock while logging since &w is the only logger.
+    IOCategoryScope io_category(kIOWAL);
+    mutex_.Unlock();
+    std::vector<Slice> parts;
+    WriteBatchInternal::GetParts(group.batch, &parts);
+    status = log_->AddRecord(parts.data(), parts.size());
+    mutex_.Lock();
+  }
+
+  // Sync the log, or leave it to the next leader.  Either way the deferred
+  // syncs of earlier groups must be resolved before the log is handed over.
+  if (status.ok() && options.sync) {
+    std::deque<Writer*>::iterator next =
+        ++std::find(writers_.begin(), writers_.end(), last_writer);
+    if (next != writers_.end() && (*next)->sync && (*next)->batch != nullptr) {
+      group.log_sync_pending = true;
+      deferred_log_syncs_.push_back(&group);
+    } else {
+      status = SyncLog();
+    }
+  } else if (!deferred_log_syncs_.empty()) {
+    SyncLog();
+  }
+  group.status = status;
+
+  // Hand the log over to the next group.  Our followers leave writers_ but
+  // are not done until the group has been inserted.
+  size_t group_size = 0;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group_size++;
+    if (ready != &w) {
+      group.followers.push_back(ready);
+    }
+    if (ready == last_writer) break;
+  }
+  if (grouped) {
+    RecordWriteGroup(group_size, options.sync);
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  // mem_ cannot be switched while memtable_writers_ is non-empty.
+  memtable_writers_.push_back(&group);
+  MemTable* mem = mem_;
+  const bool concurrent = options_.allow_concurrent_memtable_write;
+  if (status.ok() && concurrent) {
+    // Entries carry their sequence numbers, so they can be inserted ahead
+    // of the groups logged before us: nothing reads past LastSequence().
+    mutex_.Unlock();
+    status = WriteBatchInternal::InsertConcurrentlyInto(group.batch, mem);
+    mutex_.Lock();
+  }
+
+  // Wait for the groups logged before us to be inserted.  A group that
+  // never reached the log still waits so that it does not publish a
+  // sequence number ahead of them.
+  while (memtable_writers_.front() != &group) {
+    w.cv.Wait();
+  }
+  if (status.ok() && !concurrent) {
+    mutex_.Unlock();
+    status = WriteBatchInternal::InsertInto(group.batch, mem);
+    mutex_.Lock();
+  }
+  while (group.log_sync_pending) {
+    w.cv.Wait();
+  }
+  if (status.ok()) {
+    status = group.log_sync_status;
+  }
+  if (group.batch != nullptr) {
+    versions_->SetLastSequence(group.last_sequence);
+  }
+  memtable_writers_.pop_front();
+
+  for (Writer* follower : group.followers) {
+    follower->status = status;
+    follower->done = true;
+    follower->cv.Signal();
+  }
+  if (!memtable_writers_.empty()) {
+    memtable_writers_.front()->leader->cv.Signal();
+  } else {
+    memtable_writers_drained_.SignalAll();
+  }
+  return status;
+}
+
 // MVLevelDB version of Write
 Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
+  if (updates != nullptr && tracing_.load(std::memory_order_relaxed)) {
+    MutexLock l(&trace_mutex_);
+    if (tracer_ != nullptr) tracer_->WriteMV(updates);
+  }
+  return WriteMVImpl(options, updates);
+}
+
+Status DBImpl::WriteMVImpl(const WriteOptions& options,
+                           WriteBatchMV* updates) {
   WriterMV w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
@@ -1455,6 +2372,22 @@ Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
   MutexLock l(&mutex_);
   writers_mv_.push_back(&w);
   while (!w.done && &w != writers_mv_.front()) {
+    if (w.insert_group != nullptr) {
+      // Our group has been logged; insert our part of it.
+      MemTableInsertGroupMV* group = w.insert_group;
+      w.insert_group = nullptr;
+      mutex_.Unlock();
+      Status s = WriteBatchMVInternal::InsertConcurrentlyInto(w.batch,
+                                                              group->mem);
+      mutex_.Lock();
+      if (!s.ok() && group->status.ok()) {
+        group->status = s;
+      }
+      if (--group->pending == 0) {
+        group->leader->cv.Signal();
+      }
+      continue;
+    }
     w.cv.Wait();
   }
   if (w.done) {
@@ -1465,29 +2398,46 @@ Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
   Status status = MakeRoomForWriteMV(updates == nullptr);
   uint64_t last_sequence = versions_->LastSequence();
   WriterMV* last_writer = &w;
-  if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
+  const bool grouped = status.ok() && updates != nullptr;
+  if (grouped) {  // nullptr batch is for compactions
+    if (options.sync) {
+      MaybeDelaySyncCommit(writers_mv_.size());
+    }
     WriteBatchMV* write_batch_mv = BuildBatchGroupMV(&last_writer);
-    WriteBatchMVInternal::SetSequence(write_batch_mv, last_sequence + 1);
+    const SequenceNumber first_sequence = last_sequence + 1;
+    WriteBatchMVInternal::SetSequence(write_batch_mv, first_sequence);
     last_sequence += WriteBatchMVInternal::Count(write_batch_mv);
+    // With allow_concurrent_memtable_write, the writers of a group insert
+    // their own batches into mem_ in parallel once it has been logged.
+    const bool concurrent =
+        options_.allow_concurrent_memtable_write && last_writer != &w;
 
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
     // into mem_.
     {
+      IOCategoryScope io_category(kIOWAL);
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchMVInternal::Contents(write_batch_mv));
+      std::vector<Slice> parts;
+      WriteBatchMVInternal::GetParts(write_batch_mv, &parts);
+      status = log_->AddRecord(parts.data(), parts.size());
+      bool synced = false;
       bool sync_error = false;
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
+        synced = true;
         if (!status.ok()) {
           sync_error = true;
         }
       }
-      if (status.ok()) {
+      if (status.ok() && !concurrent) {
         status = WriteBatchMVInternal::InsertInto(write_batch_mv, mem_);
       }
       mutex_.Lock();
+      if (synced) {
+        write_stats_.log_syncs++;
+      }
       if (sync_error) {
         // The state of the log file is indeterminate: the log record we
         // just added may or may not show up when the DB is re-opened.
@@ -1495,14 +2445,19 @@ Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
         RecordBackgroundError(status);
       }
     }
+    if (status.ok() && concurrent) {
+      status = InsertBatchGroupMV(last_writer, first_sequence);
+    }
     if (write_batch_mv == tmp_batch_mv_) tmp_batch_mv_->Clear();
 
     versions_->SetLastSequence(last_sequence);
   }
 
+  size_t group_size = 0;
   while (true) {
     WriterMV* ready = writers_mv_.front();
     writers_mv_.pop_front();
+    group_size++;
     if (ready != &w) {
       ready->status = status;
       ready->done = true;
@@ -1510,6 +2465,9 @@ Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
     }
     if (ready == last_writer) break;
   }
+  if (grouped) {
+    RecordWriteGroup(group_size, options.sync);
+  }
 
   // Notify new head of write queue
   if (!writers_mv_.empty()) {
@@ -1521,7 +2479,9 @@ Status DBImpl::WriteMV(const WriteOptions& options, WriteBatchMV* updates) {
 
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+// REQUIRES: "scratch" is empty; it holds the group if it has several writers
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer,
+                                    WriteBatch* scratch) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   Writer* first = writers_.front();
@@ -1555,20 +2515,106 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
         break;
       }
 
-      // Append to *result
+      // Append to *result.  The writers' batches stay unchanged until
+      // the group has been written, so large ones are referred to rather
+      // than copied.
       if (result == first->batch) {
         // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
+        result = scratch;
         assert(WriteBatchInternal::Count(result) == 0);
-        WriteBatchInternal::Append(result, first->batch);
+        WriteBatchInternal::AppendRef(result, first->batch);
       }
-      WriteBatchInternal::Append(result, w->batch);
+      WriteBatchInternal::AppendRef(result, w->batch);
     }
     *last_writer = w;
   }
   return result;
 }
 
+void DBImpl::MaybeDelaySyncCommit(size_t queued) {
+  mutex_.AssertHeld();
+  if (options_.sync_commit_delay_micros <= 0 ||
+      queued >= static_cast<size_t>(options_.sync_commit_min_writers)) {
+    return;
+  }
+  write_stats_.commit_delays++;
+  mutex_.Unlock();
+  env_->SleepForMicroseconds(options_.sync_commit_delay_micros);
+  mutex_.Lock();
+}
+
+Status DBImpl::SyncLog() {
+  mutex_.AssertHeld();
+  std::vector<MemTableWriteGroup*> groups;
+  groups.swap(deferred_log_syncs_);
+  Status s;
+  {
+    IOCategoryScope io_category(kIOWAL);
+    mutex_.Unlock();
+    s = logfile_->Sync();
+    mutex_.Lock();
+  }
+  write_stats_.log_syncs++;
+  if (!s.ok()) {
+    // See WriteImpl().
+    RecordBackgroundError(s);
+  }
+  for (MemTableWriteGroup* group : groups) {
+    group->log_sync_pending = false;
+    group->log_sync_status = s;
+    group->leader->cv.Signal();
+  }
+  return s;
+}
+
+void DBImpl::RecordWriteGroup(size_t writers, bool sync) {
+  mutex_.AssertHeld();
+  write_stats_.groups++;
+  write_stats_.writers += writers;
+  write_stats_.max_group_writers =
+      std::max<uint64_t>(write_stats_.max_group_writers, writers);
+  if (sync) {
+    write_stats_.synced_writers += writers;
+  }
+}
+
+// MVLevelDB: followers signaled here insert their batch from their wait
+// loop in WriteMVImpl().
+Status DBImpl::InsertBatchGroupMV(WriterMV* last_writer,
+                                  SequenceNumber sequence) {
+  mutex_.AssertHeld();
+  MemTableInsertGroupMV group;
+  group.leader = writers_mv_.front();
+  group.mem = mem_;
+  group.pending = 0;
+  for (WriterMV* writer : writers_mv_) {
+    if (writer->batch != nullptr) {
+      // Each batch gets the sequence numbers it was logged with.
+      WriteBatchMVInternal::SetSequence(writer->batch, sequence);
+      sequence += WriteBatchMVInternal::Count(writer->batch);
+      if (writer != group.leader) {
+        writer->insert_group = &group;
+        group.pending++;
+        writer->cv.Signal();
+      }
+    }
+    if (writer == last_writer) break;
+  }
+
+  // mem_ cannot be switched while we are at the front of writers_mv_.
+  mutex_.Unlock();
+  Status status = WriteBatchMVInternal::InsertConcurrentlyInto(
+      group.leader->batch, group.mem);
+  mutex_.Lock();
+  while (group.pending > 0) {
+    group.leader->cv.Wait();
+  }
+  if (status.ok()) {
+    status = group.status;
+  }
+  return status;
+}
+
 // MVLevelDB version of BuildBatchGroup
 WriteBatchMV* DBImpl::BuildBatchGroupMV(WriterMV** last_writer) {
   mutex_.AssertHeld();
@@ -1606,15 +2652,52 @@ WriteBatchMV* DBImpl::BuildBatchGroupMV(WriterMV** last_writer) {
         // Switch to temporary batch instead of disturbing caller's batch
         result = tmp_batch_mv_;
         assert(WriteBatchMVInternal::Count(result) == 0);
-        WriteBatchMVInternal::Append(result, first->batch);
+        WriteBatchMVInternal::AppendRef(result, first->batch);
       }
-      WriteBatchMVInternal::Append(result, w->batch);
+      WriteBatchMVInternal::AppendRef(result, w->batch);
     }
     *last_writer = w;
   }
   return result;
 }
 
+// Return the bytes of the batches queued in "writers", which the writer at
+// the front is likely to combine into its group, up to the largest group
+// BuildBatchGroup() builds.
+template <typename W>
+static uint64_t QueuedWriteBytes(const std::deque<W*>& writers) {
+  const uint64_t kMaxGroupBytes = 1 << 20;
+  uint64_t bytes = 0;
+  for (const W* w : writers) {
+    if (w->batch == nullptr || bytes >= kMaxGroupBytes) {
+      break;
+    }
+    bytes += w->batch->ApproximateSize();
+  }
+  return bytes;
+}
+
+void DBImpl::UpdateWriteController() {
+  mutex_.AssertHeld();
+  // A multi-version DB is never compacted, so only its level-0 file count
+  // can be brought down by waiting.
+  write_controller_.Update(
+      versions_->NumLevelFiles(0),
+      options_.multi_version ? 0 : versions_->EstimatedCompactionDebt());
+}
+
+void DBImpl::DelayWrite(uint64_t bytes) {
+  mutex_.AssertHeld();
+  const uint64_t delay = write_controller_.GetDelay(env_->NowMicros(), bytes);
+  if (delay > 0) {
+    write_stats_.write_delays++;
+    write_stats_.write_delay_micros += delay;
+    mutex_.Unlock();
+    env_->SleepForMicroseconds(static_cast<int>(delay));
+    mutex_.Lock();
+  }
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
@@ -1622,42 +2705,50 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   assert(!writers_.empty());
   bool allow_delay = !force;
   Status s;
+  UpdateWriteController();
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+    } else if (allow_delay && write_controller_.IsDelayed()) {
+      // Compactions are falling behind.  Rather than delaying a single
+      // write by several seconds when we hit the hard limit on the number
+      // of L0 files, slow writes down to a rate that gives compactions
+      // time to catch up, to reduce latency variance.  Also, this delay
+      // hands over some CPU to the compaction thread in case it is
+      // sharing the same core as the writer.
+      DelayWrite(QueuedWriteBytes(writers_));
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
-      // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+    } else if (imm_ != nullptr && static_cast<int>(imm_->mems.size()) >=
+                                      options_.max_write_buffer_number - 1) {
+      // We have filled up the current memtable, but all the previous
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
       background_work_finished_signal_.Wait();
+    } else if (!deferred_log_syncs_.empty()) {
+      // The groups that left their log sync to this writer cannot finish,
+      // and so memtable_writers_ cannot drain, until the log is synced.
+      SyncLog();
+    } else if (!memtable_writers_.empty()) {
+      // Logged writes are still being inserted into mem_; wait for them
+      // before it becomes immutable.
+      memtable_writers_drained_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      log::Writer* new_log = nullptr;
+      s = NewLogFile(new_log_number, &lfile, &new_log);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
@@ -1667,7 +2758,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       delete logfile_;
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      log_ = new_log;
       // TODO MVLevelDB copy MemTable
       if (options_.multi_version) {
         //        auto current =
@@ -1676,10 +2767,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
         //        std::chrono::duration_cast<std::chrono::milliseconds>(current).count();
         CreateImmutableMemTable(current_time_);
       } else {
-        imm_ = mem_;
-        has_imm_.store(true, std::memory_order_release);
-        mem_ = new MemTable(internal_comparator_);
-        mem_->Ref();
+        SwitchMemTable();
       }
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1693,30 +2781,24 @@ Status DBImpl::MakeRoomForWriteMV(bool force) {
   assert(!writers_mv_.empty());
   bool allow_delay = !force;
   Status s;
+  UpdateWriteController();
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+    } else if (allow_delay && write_controller_.IsDelayed()) {
+      // Too many L0 files: slow writes down, as in MakeRoomForWrite().
+      DelayWrite(QueuedWriteBytes(writers_mv_));
       allow_delay = false;
-      mutex_.Lock();
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
-      // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+    } else if (imm_ != nullptr && static_cast<int>(imm_->mems.size()) >=
+                                      options_.max_write_buffer_number - 1) {
+      // We have filled up the current memtable, but all the previous
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
@@ -1728,7 +2810,8 @@ Status DBImpl::MakeRoomForWriteMV(bool force) {
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      log::Writer* new_log = nullptr;
+      s = NewLogFile(new_log_number, &lfile, &new_log);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
@@ -1738,7 +2821,7 @@ Status DBImpl::MakeRoomForWriteMV(bool force) {
       delete logfile_;
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      log_ = new_log;
       // TODO: preserve latest data entries in MemTable
       if (options_.multi_version) {
         //        auto current = std::chrono::system_clock::now();
@@ -1746,10 +2829,7 @@ Status DBImpl::MakeRoomForWriteMV(bool force) {
         //        std::chrono::system_clock::to_time_t(current);
         CreateImmutableMemTable(current_time_);
       } else {
-        imm_ = mem_;
-        has_imm_.store(true, std::memory_order_release);
-        mem_ = new MemTable(internal_comparator_);
-        mem_->Ref();
+        SwitchMemTable();
       }
       force = false;
       MaybeScheduleCompaction();
@@ -1763,13 +2843,9 @@ Status DBImpl::CreateImmutableMemTable(ValidTime vt) {
   Status s;
   //  MutexLock l(&mutex_);
   mutex_.AssertHeld();
-  assert(imm_ == nullptr);
 
-  imm_ = mem_;
-  has_imm_.store(true, std::memory_order_release);
-  imm_->SetEndValidTime(vt);
-  mem_ = new MemTable(internal_comparator_);
-  mem_->Ref();
+  mem_->SetEndValidTime(vt);
+  SwitchMemTable();
   mem_->SetStartValidTime(vt);
 
   return s;
@@ -1779,10 +2855,10 @@ Status DBImpl::DuplicateFromImmutableMemTable() {
   Status s;
 
   MutexLock l(&mutex_);
-  MemTable* imm = imm_;
+  MemTable* imm = imm_->mems.back();
   imm->Ref();
 
-  ValidTime vt = imm_->GetEndValidTime();
+  ValidTime vt = imm->GetEndValidTime();
 
   WriteBatchMV* batch = new WriteBatchMV();
 
@@ -1813,7 +2889,10 @@ Status DBImpl::DuplicateFromImmutableMemTable() {
   last_sequence += WriteBatchMVInternal::Count(batch);
 
   // Add to log and apply to memtable.
-  s = log_->AddRecord(WriteBatchMVInternal::Contents(batch));
+  {
+    IOCategoryScope io_category(kIOWAL);
+    s = log_->AddRecord(WriteBatchMVInternal::Contents(batch));
+  }
   s = WriteBatchMVInternal::InsertInto(batch, mem_);
 
   versions_->SetLastSequence(last_sequence);
@@ -1878,6 +2957,106 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
                   static_cast<unsigned long long>(total_usage));
     value->append(buf);
     return true;
+  } else if (in == "memory-usage") {
+    // Memtables and versions that are no longer current but are kept
+    // alive by iterators, reads in progress or values DB::GetPinned()
+    // left in them.
+    std::set<MemTable*> live_mems = {mem_};
+    if (imm_ != nullptr) {
+      live_mems.insert(imm_->mems.begin(), imm_->mems.end());
+    }
+    std::set<MemTable*> pinned_mems;
+    std::set<Version*> pinned_versions;
+    auto pin = [&](MemTable* mem, MemTableList* imm, Version* version) {
+      std::vector<MemTable*> mems = {mem};
+      if (imm != nullptr) {
+        mems.insert(mems.end(), imm->mems.begin(), imm->mems.end());
+      }
+      for (MemTable* m : mems) {
+        if (live_mems.count(m) == 0) pinned_mems.insert(m);
+      }
+      if (version != versions_->current()) {
+        pinned_versions.insert(version);
+      }
+    };
+    for (IterState* state : live_iterators_) {
+      pin(state->mem, state->imm, state->version);
+    }
+    for (SuperVersion* sv : old_super_versions_) {
+      pin(sv->mem, sv->imm, sv->current);
+    }
+    size_t pinned_mem_usage = 0;
+    for (MemTable* m : pinned_mems) {
+      pinned_mem_usage += m->ApproximateMemoryUsage();
+    }
+
+    const struct {
+      const char* name;
+      size_t value;
+    } kUsage[] = {
+        {"mem-table", mem_ != nullptr ? mem_->ApproximateMemoryUsage() : 0},
+        {"immutable-mem-table",
+         imm_ != nullptr ? imm_->ApproximateMemoryUsage() : 0},
+        {"immutable-mem-table-count", imm_ != nullptr ? imm_->mems.size() : 0},
+        {"block-cache", options_.block_cache->TotalCharge()},
+        {"block-cache-pinned", options_.block_cache->PinnedCharge()},
+        {"open-table-count", table_cache_->NumOpenTables()},
+        {"open-table-index-and-filter", table_cache_->OpenTablesMemoryUsage()},
+        {"live-iterator-count", live_iterators_.size()},
+        {"iterator-pinned-mem-tables", pinned_mem_usage},
+        {"iterator-pinned-mem-table-count", pinned_mems.size()},
+        {"iterator-pinned-version-count", pinned_versions.size()},
+        {"write-batch-scratch",
+         tmp_batch_->ApproximateSize() + tmp_batch_mv_->ApproximateSize()},
+    };
+    char buf[100];
+    for (const auto& usage : kUsage) {
+      std::snprintf(buf, sizeof(buf), "%-32s %llu\n", usage.name,
+                    static_cast<unsigned long long>(usage.value));
+      value->append(buf);
+    }
+    return true;
+  } else if (in == "write-stats") {
+    const WriteStats& w = write_stats_;
+    const struct {
+      const char* name;
+      uint64_t value;
+    } kStats[] = {
+        {"write-groups", w.groups},
+        {"writers", w.writers},
+        {"max-writers-per-group", w.max_group_writers},
+        {"log-syncs", w.log_syncs},
+        {"synced-writers", w.synced_writers},
+        {"commit-delays", w.commit_delays},
+        {"write-delays", w.write_delays},
+        {"write-delay-micros", w.write_delay_micros},
+    };
+    char buf[100];
+    for (const auto& stat : kStats) {
+      std::snprintf(buf, sizeof(buf), "%-32s %llu\n", stat.name,
+                    static_cast<unsigned long long>(stat.value));
+      value->append(buf);
+    }
+    std::snprintf(
+        buf, sizeof(buf), "%-32s %.2f\n", "writers-per-group",
+        w.groups == 0 ? 0.0 : static_cast<double>(w.writers) / w.groups);
+    value->append(buf);
+    std::snprintf(buf, sizeof(buf), "%-32s %.2f\n", "synced-writers-per-sync",
+                  w.log_syncs == 0
+                      ? 0.0
+                      : static_cast<double>(w.synced_writers) / w.log_syncs);
+    value->append(buf);
+    return true;
+  } else if (in == "delayed-write-rate") {
+    UpdateWriteController();
+    *value = std::to_string(write_controller_.delayed_write_rate());
+    return true;
+  } else if (in == "io-stats") {
+    if (io_stats_env_ == nullptr) {
+      return false;
+    }
+    io_stats_env_->AppendReport(value);
+    return true;
   }
 
   return false;
@@ -1901,14 +3080,514 @@ void DBImpl::GetApproximateSizes(const Range* range, int n, uint64_t* sizes) {
   v->Unref();
 }
 
+Status DBImpl::StartTrace(const std::string& trace_file) {
+  MutexLock l(&trace_mutex_);
+  if (tracer_ != nullptr) {
+    return Status::InvalidArgument("a trace is already in progress");
+  }
+  WritableFile* file;
+  Status s = env_->NewWritableFile(trace_file, &file);
+  if (s.ok()) {
+    tracer_ = new Tracer(env_, file);
+    tracing_.store(true, std::memory_order_relaxed);
+  }
+  return s;
+}
+
+Status DBImpl::EndTrace() {
+  MutexLock l(&trace_mutex_);
+  if (tracer_ == nullptr) {
+    return Status::InvalidArgument("no trace in progress");
+  }
+  tracing_.store(false, std::memory_order_relaxed);
+  Status s = tracer_->Close();
+  delete tracer_;
+  tracer_ = nullptr;
+  return s;
+}
+
+namespace {
+
+// Returns true iff "mem" holds an entry for a user key in
+// [smallest, largest].
+bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+                      bool multi_version, const Slice& smallest,
+                      const Slice& largest) {
+  std::string seek_key;
+  if (multi_version) {
+    AppendMVInternalKey(&seek_key,
+                        ParsedMVInternalKey(smallest, kMaxSequenceNumber,
+                                            kValueTypeForSeek, kMaxValidTime));
+  } else {
+    AppendInternalKey(&seek_key, ParsedInternalKey(smallest, kMaxSequenceNumber,
+                                                   kValueTypeForSeek));
+  }
+  Iterator* iter = mem->NewIterator();
+  iter->Seek(seek_key);
+  bool overlap = false;
+  if (iter->Valid()) {
+    const Slice user_key = multi_version ? MVExtractUserKey(iter->key())
+                                         : ExtractUserKey(iter->key());
+    overlap = ucmp->Compare(user_key, largest) <= 0;
+  }
+  delete iter;
+  return overlap;
+}
+
+Status CopyFile(Env* env, const std::string& src, const std::string& dst) {
+  SequentialFile* in;
+  Status s = env->NewSequentialFile(src, &in);
+  if (!s.ok()) {
+    return s;
+  }
+  WritableFile* out;
+  s = env->NewWritableFile(dst, &out);
+  if (!s.ok()) {
+    delete in;
+    return s;
+  }
+  const size_t kBufferSize = 1 << 20;
+  char* buffer = new char[kBufferSize];
+  while (s.ok()) {
+    Slice chunk;
+    s = in->Read(kBufferSize, &chunk, buffer);
+    if (!s.ok() || chunk.empty()) {
+      break;
+    }
+    s = out->Append(chunk);
+  }
+  delete[] buffer;
+  if (s.ok()) {
+    s = out->Sync();
+  }
+  if (s.ok()) {
+    s = out->Close();
+  }
+  delete out;
+  delete in;
+  if (!s.ok()) {
+    env->RemoveFile(dst);
+  }
+  return s;
+}
+
+}  // namespace
+
+// A table file being added by IngestExternalFiles().
+struct DBImpl::ExternalFile {
+  std::string path;     // Where the caller left the file
+  uint64_t number = 0;  // Number of the file's copy in the DB, if any
+  bool moved = false;   // The copy was made by renaming "path"
+  uint64_t file_size = 0;
+  InternalKey smallest;
+  InternalKey largest;
+  MVInternalKey smallest_mv;  // Multi-version only
+  MVInternalKey largest_mv;   // Multi-version only
+  // The earliest valid time in the file.  The newest version of each key
+  // stays valid indefinitely, so the file's valid period is open-ended.
+  ValidTime start_time = kMaxValidTime;
+  ValidTime end_time = kMaxValidTime;
+  SequenceNumber max_sequence = 0;
+};
+
+Status DBImpl::ScanExternalFile(const std::string& fname, SequenceNumber base,
+                                TableBuilder* builder, ExternalFile* f) {
+  uint64_t file_size;
+  RandomAccessFile* file = nullptr;
+  Table* table = nullptr;
+  Status s = env_->GetFileSize(fname, &file_size);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  if (s.ok()) {
+    s = Table::Open(options_, file, file_size, &table);
+  }
+  if (!s.ok()) {
+    delete file;
+    return s;
+  }
+
+  ReadOptions read_options;
+  read_options.verify_checksums = true;
+  read_options.fill_cache = false;
+  Iterator* iter = table->NewIterator(read_options);
+  const bool mv = options_.multi_version;
+  std::string prev_key, key;
+  f->file_size = file_size;
+  f->start_time = kMaxValidTime;
+  f->max_sequence = 0;
+  bool first = true;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    const Slice input_key = iter->key();
+    if (!first && internal_comparator_.Compare(prev_key, input_key) >= 0) {
+      s = Status::Corruption(fname, "keys out of order");
+      break;
+    }
+    prev_key.assign(input_key.data(), input_key.size());
+    if (ExtractValueType(input_key, mv) == kTypeValueIndex) {
+      // The value log it refers to belongs to some other database.
+      s = Status::Corruption(fname, "refers to a value log");
+      break;
+    }
+
+    // Re-encode the key with its sequence number offset by "base".
+    key.clear();
+    SequenceNumber sequence;
+    if (mv) {
+      ParsedMVInternalKey parsed;
+      if (!ParseMVInternalKey(input_key, &parsed)) {
+        s = Status::Corruption(fname, "bad multi-version key");
+        break;
+      }
+      parsed.sequence += base;
+      sequence = parsed.sequence;
+      f->start_time = std::min(f->start_time, parsed.valid_time);
+      AppendMVInternalKey(&key, parsed);
+      if (first) {
+        f->smallest.DecodeFromMV(key);
+        f->smallest_mv.DecodeFrom(key);
+      }
+    } else {
+      ParsedInternalKey parsed;
+      if (!ParseInternalKey(input_key, &parsed)) {
+        s = Status::Corruption(fname, "bad internal key");
+        break;
+      }
+      parsed.sequence += base;
+      sequence = parsed.sequence;
+      AppendInternalKey(&key, parsed);
+      if (first) {
+        f->smallest.DecodeFrom(key);
+      }
+    }
+    first = false;
+    f->max_sequence = std::max(f->max_sequence, sequence);
+    if (builder != nullptr) {
+      builder->Add(key, iter->value());
+    }
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  if (s.ok() && first) {
+    s = Status::Corruption(fname, "empty table");
+  }
+  if (s.ok()) {
+    if (mv) {
+      f->largest.DecodeFromMV(key);
+      f->largest_mv.DecodeFrom(key);
+    } else {
+      f->largest.DecodeFrom(key);
+    }
+  }
+  delete iter;
+  delete table;
+  delete file;
+  return s;
+}
+
+Status DBImpl::CopyExternalFile(const std::string& src, SequenceNumber base,
+                                bool move, ExternalFile* f) {
+  const std::string fname = TableFileName(dbname_, f->number);
+  if (base == 0) {
+    // The file can be used as is.
+    if (move) {
+      Status s = env_->RenameFile(src, fname);
+      f->moved = s.ok();
+      return s;
+    }
+    return CopyFile(env_, src, fname);
+  }
+
+  WritableFile* file;
+  Status s = env_->NewWritableFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  TableBuilder builder(options_, file);
+  s = ScanExternalFile(src, base, &builder, f);
+  if (s.ok()) {
+    s = builder.Finish();
+  } else {
+    builder.Abandon();
+  }
+  if (s.ok()) {
+    f->file_size = builder.FileSize();
+    s = file->Sync();
+  }
+  if (s.ok()) {
+    s = file->Close();
+  }
+  delete file;
+  if (!s.ok()) {
+    env_->RemoveFile(fname);
+  }
+  return s;
+}
+
+// Ingestion holds the front of the write queue throughout, so that no
+// write reaches the memtable or takes a sequence number until the files
+// are installed.  Data in the memtables would shadow the files on reads,
+// so the memtables are flushed if they overlap the files.
+//
+// A file copied as is keeps the sequence numbers SstFileWriter gave it,
+// which sort before those of any other data.  That is only correct if
+// nothing else in the DB has keys in its range and no snapshot could
+// tell that the data is new; otherwise the copy is rewritten with
+// sequence numbers past LastSequence().
+Status DBImpl::IngestExternalFiles(const IngestExternalFileOptions& options,
+                                   const std::vector<std::string>& files) {
+  if (files.empty()) {
+    return Status::OK();
+  }
+
+  std::vector<ExternalFile> external(files.size());
+  Status s;
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    external[i].path = files[i];
+    s = ScanExternalFile(files[i], 0, nullptr, &external[i]);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  const Comparator* ucmp = user_comparator();
+  std::sort(external.begin(), external.end(),
+            [ucmp](const ExternalFile& a, const ExternalFile& b) {
+              return ucmp->Compare(a.smallest.user_key(),
+                                   b.smallest.user_key()) < 0;
+            });
+  for (size_t i = 1; i < external.size(); i++) {
+    if (ucmp->Compare(external[i - 1].largest.user_key(),
+                      external[i].smallest.user_key()) >= 0) {
+      return Status::InvalidArgument("external files overlap",
+                                     external[i].path);
+    }
+  }
+
+  MutexLock l(&mutex_);
+  // A writer with a null batch can be swept into the group of the writer
+  // ahead of it, so queue up again until this one leads.
+  Writer w(&mutex_);
+  WriterMV w_mv(&mutex_);
+  if (options_.multi_version) {
+    do {
+      w_mv.done = false;
+      writers_mv_.push_back(&w_mv);
+      while (!w_mv.done && &w_mv != writers_mv_.front()) {
+        w_mv.cv.Wait();
+      }
+    } while (w_mv.done);
+  } else {
+    do {
+      w.done = false;
+      writers_.push_back(&w);
+      while (!w.done && &w != writers_.front()) {
+        w.cv.Wait();
+      }
+    } while (w.done);
+    while (!memtable_writers_.empty()) {
+      memtable_writers_drained_.Wait();
+    }
+  }
+
+  bool memtable_overlap = false;
+  for (const ExternalFile& f : external) {
+    const Slice smallest = f.smallest.user_key();
+    const Slice largest = f.largest.user_key();
+    std::vector<MemTable*> mems = {mem_};
+    if (imm_ != nullptr) {
+      mems.insert(mems.end(), imm_->mems.begin(), imm_->mems.end());
+    }
+    for (MemTable* m : mems) {
+      if (MemTableOverlaps(m, ucmp, options_.multi_version, smallest,
+                           largest)) {
+        memtable_overlap = true;
+      }
+    }
+  }
+  if (memtable_overlap) {
+    s = options_.multi_version ? MakeRoomForWriteMV(true)
+                               : MakeRoomForWrite(true);
+  }
+
+  // Copy the files, after any flush and running compaction have finished
+  // so that the levels picked below stay valid.  If a snapshot is taken
+  // while files are copied as is, they are copied again.
+  bool copied = false;
+  bool rewritten = false;
+  while (s.ok()) {
+    while (bg_error_.ok() &&
+           (imm_ != nullptr || background_compaction_scheduled_)) {
+      background_work_finished_signal_.Wait();
+    }
+    s = bg_error_;
+    if (!s.ok()) {
+      break;
+    }
+    Version* current = versions_->current();
+    bool version_overlap = false;
+    for (const ExternalFile& f : external) {
+      const Slice smallest = f.smallest.user_key();
+      const Slice largest = f.largest.user_key();
+      for (int level = 0; level < config::kNumLevels; level++) {
+        if (current->OverlapInLevel(level, &smallest, &largest)) {
+          version_overlap = true;
+        }
+      }
+    }
+    const bool rewrite = version_overlap || !snapshots_.empty();
+    if (copied && (rewritten || !rewrite)) {
+      break;
+    }
+
+    const SequenceNumber base = rewrite ? versions_->LastSequence() + 1 : 0;
+    std::vector<uint64_t> old_numbers;
+    for (ExternalFile& f : external) {
+      old_numbers.push_back(f.number);
+      f.number = versions_->NewFileNumber();
+      pending_outputs_.insert(f.number);
+    }
+    mutex_.Unlock();
+    for (size_t i = 0; i < external.size() && s.ok(); i++) {
+      ExternalFile* f = &external[i];
+      if (old_numbers[i] == 0) {
+        s = CopyExternalFile(f->path, base, options.move_files, f);
+      } else {
+        // Rewrite the earlier copy, then give back or drop it.
+        const std::string old_fname = TableFileName(dbname_, old_numbers[i]);
+        s = CopyExternalFile(old_fname, base, false, f);
+        if (s.ok()) {
+          if (f->moved) {
+            s = env_->RenameFile(old_fname, f->path);
+            f->moved = false;
+          } else {
+            env_->RemoveFile(old_fname);
+          }
+        }
+      }
+    }
+    mutex_.Lock();
+    for (uint64_t number : old_numbers) {
+      pending_outputs_.erase(number);
+    }
+    copied = true;
+    rewritten = rewrite;
+  }
+
+  if (s.ok()) {
+    VersionEdit edit;
+    Version* current = versions_->current();
+    SequenceNumber last_sequence = versions_->LastSequence();
+    for (const ExternalFile& f : external) {
+      if (options_.multi_version) {
+        // MVLevelDB: we only have 1 on-disk level.
+        edit.AddMVFile(0, f.number, f.file_size, f.smallest, f.largest,
+                       f.smallest_mv, f.largest_mv, f.start_time, f.end_time);
+      } else {
+        // The deepest level such that no level above it, nor the level
+        // itself, has data in the file's range.
+        const Slice smallest = f.smallest.user_key();
+        const Slice largest = f.largest.user_key();
+        int level = 0;
+        while (level < config::kNumLevels &&
+               !current->OverlapInLevel(level, &smallest, &largest)) {
+          level++;
+        }
+        level = std::max(level - 1, 0);
+        edit.AddFile(level, f.number, f.file_size, f.smallest, f.largest);
+      }
+      Log(options_.info_log, "Ingested table #%llu from %s: %lld bytes",
+          static_cast<unsigned long long>(f.number), f.path.c_str(),
+          static_cast<unsigned long long>(f.file_size));
+      last_sequence = std::max(last_sequence, f.max_sequence);
+    }
+    versions_->SetLastSequence(last_sequence);
+    IOCategoryScope io_category(kIOManifest);
+    s = versions_->LogAndApply(&edit, &mutex_);
+    if (s.ok()) {
+      InstallSuperVersion();
+    }
+  }
+
+  for (ExternalFile& f : external) {
+    if (f.number == 0) {
+      continue;
+    }
+    pending_outputs_.erase(f.number);
+    if (!s.ok()) {
+      const std::string fname = TableFileName(dbname_, f.number);
+      if (f.moved) {
+        env_->RenameFile(fname, f.path);
+      } else {
+        env_->RemoveFile(fname);
+      }
+    } else if (options.move_files && !f.moved) {
+      env_->RemoveFile(f.path);
+    }
+  }
+  if (s.ok()) {
+    MaybeScheduleCompaction();
+  }
+
+  if (options_.multi_version) {
+    writers_mv_.pop_front();
+    if (!writers_mv_.empty()) {
+      writers_mv_.front()->cv.Signal();
+    }
+  } else {
+    writers_.pop_front();
+    if (!writers_.empty()) {
+      writers_.front()->cv.Signal();
+    }
+  }
+  return s;
+}
+
 // Default implementations of convenience methods that subclasses of DB
 // can call if they wish
 Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
   WriteBatch batch;
-  batch.Put(key, value);
+  batch.PutRef(key, value);
   return Write(opt, &batch);
 }
 
+void DB::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                  std::vector<std::string>* values,
+                  std::vector<Status>* statuses) {
+  values->clear();
+  values->resize(keys.size());
+  statuses->clear();
+  statuses->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    (*statuses)[i] = Get(options, keys[i], &(*values)[i]);
+  }
+}
+
+Status DB::GetPinned(const ReadOptions& options, const Slice& key,
+                     PinnedValue* value) {
+  value->Reset();
+  Status s = Get(options, key, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  } else {
+    value->Reset();
+  }
+  return s;
+}
+
+Status DB::GetMVPinned(const ReadOptions& options, const Slice& key,
+                       ValidTime vt, ValidTimePeriod* period,
+                       PinnedValue* value) {
+  value->Reset();
+  Status s = GetMV(options, key, vt, period, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  } else {
+    value->Reset();
+  }
+  return s;
+}
+
 Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   WriteBatch batch;
   batch.Delete(key);
@@ -1930,13 +3609,13 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    log::Writer* log;
+    s = impl->NewLogFile(new_log_number, &lfile, &log);
     if (s.ok()) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
+      impl->log_ = log;
       impl->mem_ = new MemTable(impl->internal_comparator_);
       impl->mem_->Ref();
     }
@@ -1944,9 +3623,11 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   if (s.ok() && save_manifest) {
     edit.SetPrevLogNumber(0);  // No older logs needed after recovery.
     edit.SetLogNumber(impl->logfile_number_);
+    IOCategoryScope io_category(kIOManifest);
     s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
   }
   if (s.ok()) {
+    impl->InstallSuperVersion();
     impl->RemoveObsoleteFiles();
     impl->MaybeScheduleCompaction();
   }
@@ -9,11 +9,14 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 // MVLevelDB
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/trace.h"
+#include "db/write_controller.h"
 #include <chrono>
 #include <ctime>
 
@@ -22,10 +25,13 @@
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/thread_local.h"
 
 namespace leveldb {
 
+class IOStatsEnv;
 class MemTable;
+class TableBuilder;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -47,12 +53,21 @@ class DBImpl : public DB {
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                std::vector<std::string>* values,
+                std::vector<Status>* statuses) override;
+  Status GetPinned(const ReadOptions& options, const Slice& key,
+                   PinnedValue* value) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
+  Status StartTrace(const std::string& trace_file) override;
+  Status EndTrace() override;
+  Status IngestExternalFiles(const IngestExternalFileOptions& options,
+                             const std::vector<std::string>& files) override;
 
   // Extra methods (for testing) that are not in the public DB interface
   void SetDBCurrentTime(ValidTime vt) { current_time_ = vt; }
@@ -66,6 +81,9 @@ class DBImpl : public DB {
   Status WriteMV(const WriteOptions& options, WriteBatchMV* updates) override;
   Status GetMV(const ReadOptions& options, const Slice& key, ValidTime vt,
                ValidTimePeriod* period, std::string* value) override;
+  Status GetMVPinned(const ReadOptions& options, const Slice& key,
+                     ValidTime vt, ValidTimePeriod* period,
+                     PinnedValue* value) override;
   Status GetMVRange(const ReadOptions& options, const KeyList& key_list,
                     const TimeRange& time_range,
                     ResultSet* result_set) override;
@@ -92,11 +110,22 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Read the value a kTypeValueIndex entry with value "value_index" refers
+  // to into *value.  The caller must hold a version the entry belongs to.
+  Status GetValueFromLog(const Slice& value_index, std::string* value);
+
+  // Record an iterator positioning call in the active trace, if any.
+  // "target" is only used for kTraceIteratorSeek.
+  void RecordIteratorTrace(TraceType type, const Slice& target);
+
  private:
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct MemTableWriteGroup;
   struct WriterMV;
+  struct MemTableInsertGroupMV;
+  struct ExternalFile;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -123,6 +152,51 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // Write group statistics, reported by the "leveldb.write-stats" property.
+  struct WriteStats {
+    uint64_t groups = 0;
+    uint64_t writers = 0;
+    uint64_t max_group_writers = 0;
+    uint64_t log_syncs = 0;
+    uint64_t synced_writers = 0;  // Sync writes, and writes grouped with them
+    uint64_t commit_delays = 0;
+    uint64_t write_delays = 0;
+    uint64_t write_delay_micros = 0;
+  };
+
+  // An immutable list of the memtables waiting to be flushed, oldest
+  // first.  Readers reference the list rather than each memtable.
+  struct MemTableList;
+
+  // State pinned by an iterator returned from NewInternalIterator().
+  struct IterState;
+
+  static void CleanupIteratorState(void* arg1, void* arg2);
+
+  // The memtables and Version a read looks in, published together so that
+  // point lookups can take references to them without locking mutex_.
+  struct SuperVersion;
+
+  // Make super_version_ refer to the current mem_, imm_ and Version, if
+  // it does not already.
+  void InstallSuperVersion() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Return a reference to the current SuperVersion, usually by borrowing
+  // the one the calling thread caches in local_super_version_.  Each call
+  // must be paired with a call to ReturnSuperVersion().
+  SuperVersion* GetSuperVersion() LOCKS_EXCLUDED(mutex_);
+  void ReturnSuperVersion(SuperVersion* sv) LOCKS_EXCLUDED(mutex_);
+
+  // Drop a reference to "sv", deleting it if that was the last one.
+  void UnrefSuperVersion(SuperVersion* sv) LOCKS_EXCLUDED(mutex_);
+  void DeleteSuperVersion(SuperVersion* sv) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Cleanup function for a SuperVersion pinned by a PinnedValue.
+  static void UnrefPinnedSuperVersion(void* arg1, void* arg2);
+
+  // Unref handler of local_super_version_.
+  static void UnrefLocalSuperVersion(void* ptr);
+
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
                                 uint32_t* seed);
@@ -137,7 +211,14 @@ class DBImpl : public DB {
 
   void MaybeIgnoreError(Status* s) const;
 
-  // Delete any unneeded files and stale in-memory entries.
+  // Create log file "number", overwriting a file from recycled_logs_ if
+  // there is one, and a writer for it.
+  Status NewLogFile(uint64_t number, WritableFile** file, log::Writer** log)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Delete any unneeded files and stale in-memory entries.  Obsolete log
+  // files are kept in recycled_logs_ instead, up to
+  // options_.recycle_log_file_num of them.
   void RemoveObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Compact the in-memory write buffer to disk.  Switches to a new
@@ -149,18 +230,72 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Write the contents of "mems", merged, to a new level-0 table.
+  Status WriteLevel0Table(const std::vector<MemTable*>& mems,
+                          VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Replace imm_ with a list of "mems", or with nullptr if it is empty.
+  void InstallImmutableMemTables(const std::vector<MemTable*>& mems)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Make mem_ immutable and start a new memtable.
+  void SwitchMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Check that "fname" is a table for this DB and record its key range,
+  // earliest valid time and largest sequence number in *f.  The sequence
+  // numbers of its keys are offset by "base".  If "builder" is non-null,
+  // also add the re-encoded entries to it.
+  Status ScanExternalFile(const std::string& fname, SequenceNumber base,
+                          TableBuilder* builder, ExternalFile* f);
+
+  // Copy "src" to the table file numbered f->number, renaming it instead
+  // if "move" is set.  A non-zero "base" rewrites the file through
+  // ScanExternalFile() rather than copying its bytes.
+  Status CopyExternalFile(const std::string& src, SequenceNumber base,
+                          bool move, ExternalFile* f);
+
+  // Write() and WriteMV() without tracing, so that Put() and Delete() are
+  // traced as themselves rather than as the batch they build.
+  Status WriteImpl(const WriteOptions& options, WriteBatch* updates);
+
+  // WriteImpl() for options_.enable_pipelined_write.
+  Status PipelinedWriteImpl(const WriteOptions& options, WriteBatch* updates);
+  Status WriteMVImpl(const WriteOptions& options, WriteBatchMV* updates);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-  WriteBatch* BuildBatchGroup(Writer** last_writer)
+
+  // Recompute the delayed write rate from the current version.
+  void UpdateWriteController() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Sleep, with mutex_ released, for as long as write_controller_ asks a
+  // write of "bytes" to be delayed.
+  void DelayWrite(uint64_t bytes) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  WriteBatch* BuildBatchGroup(Writer** last_writer, WriteBatch* scratch)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Sleep for options_.sync_commit_delay_micros, with mutex_ released, if
+  // fewer than options_.sync_commit_min_writers writers are "queued".
+  void MaybeDelaySyncCommit(size_t queued) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Sync the log for the caller and for the groups in deferred_log_syncs_,
+  // and wake the latter.  A failure is recorded in bg_error_.
+  // REQUIRES: the caller is at the front of writers_.
+  Status SyncLog() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  void RecordWriteGroup(size_t writers, bool sync)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // MVLevelDB Extra private methods
   Status MakeRoomForWriteMV(bool force) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatchMV* BuildBatchGroupMV(WriterMV** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Insert the batches of the logged group that ends at last_writer into
+  // mem_, each by its own writer, numbering them from "sequence" on.
+  // REQUIRES: the caller leads the group at the front of writers_mv_.
+  Status InsertBatchGroupMV(WriterMV* last_writer, SequenceNumber sequence)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status CreateImmutableMemTable(ValidTime vt);
 
   Status DuplicateFromImmutableMemTable();
@@ -176,6 +311,14 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Move the value of a compaction input entry into or out of the value
+  // logs as needed, and account for the value log records it no longer
+  // refers to.  *key and *value are updated to the entry to write, which
+  // may point into *key_buf and *value_buf.
+  Status SeparateCompactionValue(CompactionState* compact, ValueType type,
+                                 bool drop, Slice* key, Slice* value,
+                                 std::string* key_buf, std::string* value_buf);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
@@ -186,6 +329,7 @@ class DBImpl : public DB {
   }
 
   // Constant after construction
+  IOStatsEnv* const io_stats_env_;  // Non-null iff options.collect_io_stats
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
@@ -205,17 +349,45 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  MemTableList* imm_ GUARDED_BY(mutex_);  // Memtables being compacted
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-null imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
+  // Obsolete log files kept to be overwritten by new logs, oldest first.
+  // Only logs numbered first_recyclable_log_ or later, which this instance
+  // wrote in the recyclable format, are kept; 0 means none were.
+  std::deque<uint64_t> recycled_logs_ GUARDED_BY(mutex_);
+  uint64_t first_recyclable_log_ GUARDED_BY(mutex_);
+
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // Groups of writes that have been logged and are waiting for, or busy
+  // with, their turn to be inserted into mem_, in sequence order.  Only
+  // used with options_.enable_pipelined_write.
+  std::deque<MemTableWriteGroup*> memtable_writers_ GUARDED_BY(mutex_);
+  port::CondVar memtable_writers_drained_ GUARDED_BY(mutex_);
+
+  // Groups in memtable_writers_ that have been logged with sync set but
+  // left the sync to the next leader, so that one sync covers them all.
+  std::vector<MemTableWriteGroup*> deferred_log_syncs_ GUARDED_BY(mutex_);
+
+  // Iterators that have not been deleted yet.
+  std::set<IterState*> live_iterators_ GUARDED_BY(mutex_);
+
+  // The SuperVersion of mem_, imm_ and versions_->current(), and ones
+  // that have been replaced but are still referenced by a read.
+  SuperVersion* super_version_ GUARDED_BY(mutex_);
+  std::set<SuperVersion*> old_super_versions_ GUARDED_BY(mutex_);
+
+  // Each thread's reference to super_version_, or nullptr.  Replaced by
+  // nullptr in all threads whenever a new SuperVersion is installed.
+  ThreadLocalPtr local_super_version_;
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
   // Set of table files to protect from deletion because they are
@@ -234,11 +406,20 @@ class DBImpl : public DB {
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
 
+  WriteStats write_stats_ GUARDED_BY(mutex_);
+
+  WriteController write_controller_ GUARDED_BY(mutex_);
+
   // MVLevelDB extra private members
   std::deque<WriterMV*> writers_mv_ GUARDED_BY(mutex_);
   WriteBatchMV* tmp_batch_mv_ GUARDED_BY(mutex_);
 
   ValidTime current_time_ = 0;
+
+  // Workload tracing.  trace_mutex_ is never held while acquiring mutex_.
+  port::Mutex trace_mutex_;
+  Tracer* tracer_ GUARDED_BY(trace_mutex_);
+  std::atomic<bool> tracing_;  // So operations can skip trace_mutex_
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
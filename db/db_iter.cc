@@ -9,7 +9,9 @@
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/prefix_extractor.h"
 #include "port/port.h"
+#include "util/io_stats.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
@@ -46,13 +48,17 @@ class DBIter : public Iterator {
   enum Direction { kForward, kReverse };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         uint32_t seed, const PrefixExtractor* prefix_extractor)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        prefix_extractor_(prefix_extractor),
         direction_(kForward),
         valid_(false),
+        prefix_bounded_(false),
+        is_value_index_(false),
+        value_resolved_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
@@ -67,7 +73,20 @@ class DBIter : public Iterator {
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw_value = (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (!is_value_index_) {
+      return raw_value;
+    }
+    // Only read values kept in a value log once they are asked for.
+    if (!value_resolved_) {
+      Status s = db_->GetValueFromLog(raw_value, &resolved_value_);
+      if (!s.ok()) {
+        status_ = s;
+        resolved_value_.clear();
+      }
+      value_resolved_ = true;
+    }
+    return resolved_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -86,6 +105,7 @@ class DBIter : public Iterator {
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
+  void StopBackwardIteration();
   bool ParseKey(ParsedInternalKey* key);
 
   inline void SaveKey(const Slice& k, std::string* dst) {
@@ -110,11 +130,18 @@ class DBIter : public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
-  Status status_;
+  // Non-null in prefix-seek mode
+  const PrefixExtractor* const prefix_extractor_;
+  mutable Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool prefix_bounded_;  // Only yield keys that start with prefix_?
+  std::string prefix_;
+  bool is_value_index_;  // The raw value is the location of the value
+  mutable bool value_resolved_;
+  mutable std::string resolved_value_;  // Valid iff value_resolved_
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -140,6 +167,7 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
 
 void DBIter::Next() {
   assert(valid_);
+  IOCategoryScope io_category(kIOUserRead);
 
   if (direction_ == kReverse) {  // Switch directions?
     direction_ = kForward;
@@ -180,7 +208,13 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    if (!ParseKey(&ikey)) {
+      // Skip corrupted entries
+    } else if (prefix_bounded_ && !ikey.user_key.starts_with(prefix_)) {
+      // Past the keys with the prefix sought.  The tables that have none
+      // of them may have been skipped, so do not look any further.
+      break;
+    } else if (ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -189,11 +223,14 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeValueIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
           } else {
             valid_ = true;
+            is_value_index_ = (ikey.type == kTypeValueIndex);
+            value_resolved_ = false;
             saved_key_.clear();
             return;
           }
@@ -208,6 +245,11 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
 
 void DBIter::Prev() {
   assert(valid_);
+  if (prefix_extractor_ != nullptr) {
+    StopBackwardIteration();
+    return;
+  }
+  IOCategoryScope io_category(kIOUserRead);
 
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
@@ -272,10 +314,29 @@ void DBIter::FindPrevUserEntry() {
     direction_ = kForward;
   } else {
     valid_ = true;
+    is_value_index_ = (value_type == kTypeValueIndex);
+    value_resolved_ = false;
   }
 }
 
+void DBIter::StopBackwardIteration() {
+  // A seek in prefix-seek mode may have skipped tables that hold keys
+  // before its target, and moving backwards would miss them.
+  valid_ = false;
+  saved_key_.clear();
+  ClearSavedValue();
+  direction_ = kForward;
+  status_ = Status::NotSupported("backward iteration in prefix-seek mode");
+}
+
 void DBIter::Seek(const Slice& target) {
+  IOCategoryScope io_category(kIOUserRead);
+  prefix_bounded_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (prefix_bounded_) {
+    Slice prefix = prefix_extractor_->Prefix(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
@@ -290,6 +351,8 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  IOCategoryScope io_category(kIOUserRead);
+  prefix_bounded_ = false;
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -301,6 +364,11 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  if (prefix_extractor_ != nullptr) {
+    StopBackwardIteration();
+    return;
+  }
+  IOCategoryScope io_category(kIOUserRead);
   direction_ = kReverse;
   ClearSavedValue();
   iter_->SeekToLast();
@@ -311,8 +379,10 @@ void DBIter::SeekToLast() {
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed,
+                        const PrefixExtractor* prefix_extractor) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                    prefix_extractor);
 }
 
 }  // namespace leveldb
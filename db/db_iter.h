@@ -13,13 +13,18 @@
 namespace leveldb {
 
 class DBImpl;
+class PrefixExtractor;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
 // into appropriate user keys.
+//
+// A non-null "prefix_extractor" puts the iterator in prefix-seek mode
+// (see ReadOptions::prefix_seek).
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed,
+                        const PrefixExtractor* prefix_extractor = nullptr);
 
 }  // namespace leveldb
 
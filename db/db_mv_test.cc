@@ -412,6 +412,8 @@ class DBTest : public testing::Test {
               break;
             case kTypeDeletion:result += "DEL";
               break;
+            case kTypeValueIndex:result += "VINDEX";
+              break;
           }
         }
         iter->Next();
@@ -678,6 +680,38 @@ TEST_F(DBTest, GetFromImmutableLayer) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetFromSeveralImmutableLayers) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.multi_version = true;
+  options.write_buffer_size = 100000;
+  options.max_write_buffer_number = 3;
+  Reopen(&options);
+  ValidTimePeriod period(0, 0);
+
+  // Block sync calls, and so the flush of the first immutable memtable.
+  // The second switch does not wait for it.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  ASSERT_LEVELDB_OK(PutMV("k1", 100, std::string(100000, 'x')));
+  dbfull()->SetDBCurrentTime(150);
+  ASSERT_LEVELDB_OK(PutMV("k1", 150, "v150"));  // Switch memtables
+  ASSERT_LEVELDB_OK(PutMV("k2", 160, std::string(100000, 'y')));
+  dbfull()->SetDBCurrentTime(200);
+  ASSERT_LEVELDB_OK(PutMV("k1", 200, "v200"));  // Switch again
+
+  ASSERT_EQ(std::string(100000, 'x'), GetMV("k1", 120, &period));
+  ASSERT_EQ("v150", GetMV("k1", 170, &period));
+  ASSERT_EQ("v200", GetMV("k1", 250, &period));
+  ASSERT_EQ(std::string(100000, 'y'), GetMV("k2", 250, &period));
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  dbfull()->SetDBCurrentTime(300);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(std::string(100000, 'x'), GetMV("k1", 120, &period));
+  ASSERT_EQ("v150", GetMV("k1", 170, &period));
+  ASSERT_EQ(std::string(100000, 'y'), GetMV("k2", 170, &period));
+}
+
 TEST_F(DBTest, GetFromVersions) {
   do {
     Options options = CurrentOptions();
@@ -696,6 +730,37 @@ TEST_F(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetMVPinned) {
+  do {
+    Options options = CurrentOptions();
+    options.multi_version = true;
+    Reopen(&options);
+    ValidTimePeriod period(0, 0);
+    PinnedValue value;
+
+    ASSERT_TRUE(
+        db_->GetMVPinned(ReadOptions(), "foo", 100, &period, &value)
+            .IsNotFound());
+    ASSERT_LEVELDB_OK(PutMV("foo", 100, "v1"));
+    ASSERT_LEVELDB_OK(PutMV("foo", 200, "v2"));
+    ASSERT_LEVELDB_OK(
+        db_->GetMVPinned(ReadOptions(), "foo", 150, &period, &value));
+    ASSERT_EQ("v1", value.ToString());
+    ASSERT_EQ(100, period.lo);
+
+    // The value stays pinned in the memtable while it is compacted.
+    dbfull()->SetDBCurrentTime(300);
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ("v1", value.ToString());
+
+    PinnedValue in_table;
+    ASSERT_LEVELDB_OK(
+        db_->GetMVPinned(ReadOptions(), "foo", 250, &period, &in_table));
+    ASSERT_EQ("v2", in_table.ToString());
+    ASSERT_EQ(GetMV("foo", 250, &period), in_table.ToString());
+  } while (ChangeOptions());
+}
+
 TEST_F(DBTest, GetRangeFromMemTable) {
   do {
     Options options = CurrentOptions();
@@ -796,6 +861,88 @@ TEST_F(DBTest, GetRangeFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, ValueLogIgnored) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.multi_version = true;
+  options.value_log_threshold = 1000;
+  Reopen(&options);
+  ValidTimePeriod period(0, 0);
+
+  ASSERT_LEVELDB_OK(PutMV("k1", 100, std::string(2000, 'x')));
+  ASSERT_LEVELDB_OK(PutMV("k1", 150, "v150"));
+  dbfull()->SetDBCurrentTime(200);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(std::string(2000, 'x'), GetMV("k1", 120, &period));
+  ASSERT_EQ("v150", GetMV("k1", 170, &period));
+
+  // Large values stay in the tables.
+  std::vector<std::string> files;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &files));
+  uint64_t number;
+  FileType type;
+  for (const std::string& file : files) {
+    ASSERT_TRUE(!ParseFileName(file, &number, &type) ||
+                type != kValueLogFile);
+  }
+}
+
+namespace {
+
+struct MVWriterState {
+  DB* db;
+  int id;
+  int num_writes;
+  std::atomic<bool> done;
+};
+
+void MVWriterBody(void* arg) {
+  MVWriterState* state = reinterpret_cast<MVWriterState*>(arg);
+  WriteOptions options;
+  options.sync = true;
+  for (int i = 0; i < state->num_writes; i++) {
+    WriteBatchMV batch;
+    const int key = state->id * state->num_writes + i;
+    batch.Put(MakeKey(key), 100, "v100");
+    batch.Put(MakeKey(key + 1000), 200, "v200");
+    ASSERT_LEVELDB_OK(state->db->WriteMV(options, &batch));
+  }
+  state->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, ConcurrentMemTableWrite) {
+  // The writers of each group insert their own batches into the memtable.
+  static const int kWriters = 4;
+  static const int kWritesPerWriter = 100;
+  Options options = CurrentOptions();
+  options.multi_version = true;
+  options.allow_concurrent_memtable_write = true;
+  options.sync_commit_delay_micros = 100;
+  Reopen(&options);
+
+  MVWriterState states[kWriters];
+  for (int id = 0; id < kWriters; id++) {
+    states[id].db = db_;
+    states[id].id = id;
+    states[id].num_writes = kWritesPerWriter;
+    states[id].done.store(false, std::memory_order_release);
+    env_->StartThread(MVWriterBody, &states[id]);
+  }
+  for (int id = 0; id < kWriters; id++) {
+    while (!states[id].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+  }
+
+  ValidTimePeriod period(0, 0);
+  for (int i = 0; i < kWriters * kWritesPerWriter; i++) {
+    ASSERT_EQ("v100", GetMV(MakeKey(i), 150, &period));
+    ASSERT_EQ("v200", GetMV(MakeKey(i + 1000), 250, &period));
+  }
+}
+
 }  // namesapce leveldb
 
 int main(int argc, char** argv) {
@@ -4,9 +4,12 @@
 
 #include "leveldb/db.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cinttypes>
+#include <map>
 #include <string>
+#include <thread>
 
 #include "gtest/gtest.h"
 #include "benchmark/benchmark.h"
@@ -15,8 +18,10 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/dumpfile.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/prefix_extractor.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -277,6 +282,13 @@ class DBTest : public testing::Test {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kConcurrentMemTableWrite:
+        options.enable_pipelined_write = true;
+        options.allow_concurrent_memtable_write = true;
+        break;
       default:
         break;
     }
@@ -335,6 +347,34 @@ class DBTest : public testing::Test {
     return result;
   }
 
+  // Return the results of looking "keys" up with MultiGet(), formatted
+  // like the results of Get() and separated by commas.
+  std::string MultiGet(const std::vector<std::string>& keys,
+                       const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::vector<Slice> key_slices(keys.begin(), keys.end());
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    db_->MultiGet(options, key_slices, &values, &statuses);
+    EXPECT_EQ(keys.size(), values.size());
+    EXPECT_EQ(keys.size(), statuses.size());
+    std::string result;
+    for (size_t i = 0; i < statuses.size(); i++) {
+      if (i > 0) {
+        result += ",";
+      }
+      if (statuses[i].IsNotFound()) {
+        result += "NOT_FOUND";
+      } else if (!statuses[i].ok()) {
+        result += statuses[i].ToString();
+      } else {
+        result += values[i];
+      }
+    }
+    return result;
+  }
+
   // Return a string that contains all key,value pairs in order,
   // formatted like "(k1->v1)(k2->v2)".
   std::string Contents() {
@@ -391,6 +431,9 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeValueIndex:
+              result += "VINDEX";
+              break;
           }
         }
         iter->Next();
@@ -533,7 +576,15 @@ class DBTest : public testing::Test {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kPipelinedWrite,
+    kConcurrentMemTableWrite,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
   int option_config_;
@@ -627,6 +678,120 @@ TEST_F(DBTest, GetMemUsage) {
   } while (ChangeOptions());
 }
 
+// Returns the value of the "name" line of a report such as the
+// leveldb.memory-usage property, or -1 if there is no such line.
+static long long MemoryUsageEntry(const std::string& report,
+                                  const std::string& name) {
+  const std::string prefix = name + " ";
+  size_t pos = 0;
+  while (pos < report.size()) {
+    if (report.compare(pos, prefix.size(), prefix) == 0) {
+      return std::stoll(report.substr(pos + prefix.size()));
+    }
+    pos = report.find('\n', pos);
+    if (pos == std::string::npos) break;
+    pos++;
+  }
+  return -1;
+}
+
+TEST_F(DBTest, GetMemUsageBreakdown) {
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_GT(MemoryUsageEntry(val, "mem-table"), 0);
+  ASSERT_EQ(0, MemoryUsageEntry(val, "immutable-mem-table"));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "live-iterator-count"));
+
+  // An iterator keeps the memtable it was created over alive after the
+  // memtable has been flushed.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_EQ(1, MemoryUsageEntry(val, "live-iterator-count"));
+  ASSERT_EQ(1, MemoryUsageEntry(val, "iterator-pinned-mem-table-count"));
+  ASSERT_GT(MemoryUsageEntry(val, "iterator-pinned-mem-tables"), 0);
+  ASSERT_EQ(1, MemoryUsageEntry(val, "iterator-pinned-version-count"));
+  ASSERT_EQ(1, MemoryUsageEntry(val, "open-table-count"));
+  ASSERT_GT(MemoryUsageEntry(val, "open-table-index-and-filter"), 0);
+  ASSERT_EQ(0, MemoryUsageEntry(val, "block-cache-pinned"));
+
+  delete iter;
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "live-iterator-count"));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "iterator-pinned-mem-tables"));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "iterator-pinned-version-count"));
+
+  // So does a value DB::GetPinned() left in it.
+  ASSERT_LEVELDB_OK(Put("bar", "v2"));
+  PinnedValue pinned;
+  ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), "bar", &pinned));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_EQ(1, MemoryUsageEntry(val, "iterator-pinned-mem-table-count"));
+  pinned.Reset();
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "iterator-pinned-mem-table-count"));
+}
+
+TEST_F(DBTest, GetFromSeveralImmutableLayers) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;
+  options.max_write_buffer_number = 4;
+  Reopen(&options);
+
+  auto imm_count = [this]() {
+    std::string val;
+    EXPECT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+    return MemoryUsageEntry(val, "immutable-mem-table-count");
+  };
+
+  // Block sync calls, and so the flush of the first immutable memtable.
+  // Writes go on into new memtables until three are waiting.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  for (int i = 0; i < 3; i++) {
+    const std::string key = "k" + std::to_string(i);
+    ASSERT_LEVELDB_OK(Put(key, std::string(100000, 'a' + i)));
+    ASSERT_LEVELDB_OK(Put("foo", "v" + std::to_string(i + 2)));
+  }
+  ASSERT_EQ(3, imm_count());
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  ASSERT_LEVELDB_OK(Put("foo", "v5"));
+
+  // Reads see every layer, newest first.
+  ASSERT_EQ("v5", Get("foo"));
+  for (int i = 0; i < 3; i++) {
+    const std::string key = "k" + std::to_string(i);
+    ASSERT_EQ(std::string(100000, 'a' + i), Get(key));
+  }
+  iter->Seek("foo");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("v4", iter->value().ToString());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(4, count);
+  delete iter;
+
+  // Once released, the waiting memtables are flushed.  All but the first,
+  // which was being flushed already, are merged into one table.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(0, imm_count());
+  ASSERT_LE(TotalTableFiles(), 3);
+  ASSERT_EQ("v5", Get("foo"));
+  Reopen(&options);
+  ASSERT_EQ("v5", Get("foo"));
+  for (int i = 0; i < 3; i++) {
+    const std::string key = "k" + std::to_string(i);
+    ASSERT_EQ(std::string(100000, 'a' + i), Get(key));
+  }
+}
+
 TEST_F(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -736,6 +901,73 @@ TEST_F(DBTest, GetPicksCorrectFile) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, MultiGet) {
+  do {
+    ASSERT_EQ("", MultiGet({}));
+    ASSERT_EQ("NOT_FOUND", MultiGet({"a"}));
+
+    // Spread the keys over several levels and the memtable.
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    Compact("a", "c");
+    ASSERT_LEVELDB_OK(Put("x", "vx"));
+    Compact("x", "y");
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+    ASSERT_LEVELDB_OK(Put("e", "ve"));
+    ASSERT_LEVELDB_OK(Delete("x"));
+    dbfull()->TEST_CompactMemTable();
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(Put("a", "va2"));
+    ASSERT_LEVELDB_OK(Put("g", "vg"));
+
+    ASSERT_EQ("vg,va2,vc2,NOT_FOUND,va2,ve,NOT_FOUND,NOT_FOUND",
+              MultiGet({"g", "a", "c", "x", "a", "e", "b", "z"}));
+    ASSERT_EQ("NOT_FOUND,va,vc2,NOT_FOUND,va,ve,NOT_FOUND,NOT_FOUND",
+              MultiGet({"g", "a", "c", "x", "a", "e", "b", "z"}, snapshot));
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, GetPinned) {
+  do {
+    PinnedValue value;
+    ASSERT_TRUE(db_->GetPinned(ReadOptions(), "a", &value).IsNotFound());
+    ASSERT_TRUE(value.empty());
+
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), "a", &value));
+    ASSERT_EQ("va", value.ToString());
+
+    // A value pinned in the memtable outlives its compaction.
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("va", value.ToString());
+
+    // So does a value pinned in a table.
+    PinnedValue in_table;
+    ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), "b", &in_table));
+    ASSERT_EQ("vb", in_table.ToString());
+    ASSERT_LEVELDB_OK(Put("a", "va2"));
+    ASSERT_LEVELDB_OK(Delete("b"));
+    Compact("a", "b");
+    ASSERT_EQ("va", value.ToString());
+    ASSERT_EQ("vb", in_table.ToString());
+
+    ASSERT_TRUE(db_->GetPinned(ReadOptions(), "b", &in_table).IsNotFound());
+    ASSERT_TRUE(in_table.empty());
+    ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), "a", &value));
+    ASSERT_EQ("va2", value.ToString());
+
+    const std::string big(100000, 'x');
+    ASSERT_LEVELDB_OK(Put("c", big));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), "c", &value));
+    ASSERT_EQ(big, value.ToString());
+    value.Reset();
+    ASSERT_TRUE(value.empty());
+  } while (ChangeOptions());
+}
+
 TEST_F(DBTest, GetEncountersEmptyLevel) {
   do {
     // Arrange for the following to happen:
@@ -1099,6 +1331,261 @@ TEST_F(DBTest, RecoverWithLargeLog) {
   ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST_F(DBTest, RecycleLogFiles) {
+  Options options = CurrentOptions();
+  options.env = Env::Default();  // The test env cannot reuse files
+  options.write_buffer_size = 64 * 1024;
+  options.recycle_log_file_num = 1;
+  options.paranoid_checks = true;
+  Reopen(&options);
+
+  // Returns the number of log files and the number and size of the newest
+  // one.
+  auto logs = [this](uint64_t* newest_number, uint64_t* newest_size) {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int count = 0;
+    uint64_t newest = 0;
+    uint64_t number;
+    FileType type;
+    for (const std::string& file : files) {
+      if (ParseFileName(file, &number, &type) && type == kLogFile) {
+        count++;
+        newest = std::max(newest, number);
+      }
+    }
+    *newest_number = newest;
+    env_->GetFileSize(LogFileName(dbname_, newest), newest_size);
+    return count;
+  };
+
+  uint64_t log_number, size;
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 300; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::string(1000, 'a' + round)));
+    }
+    // The new log overwrites an obsolete one, which still holds the
+    // records of its previous use.  The live log and the obsolete one
+    // kept for the next switch are left.
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ(2, logs(&log_number, &size));
+    ASSERT_GT(size, 1000);
+
+    // Dumping the new log must stop at the end of its records, even
+    // where they line up with those left over from its previous use.
+    ASSERT_LEVELDB_OK(Put(Key(0), Key(0) + std::string(1000, 'z')));
+    const std::string dump_name = dbname_ + ".dump";
+    WritableFile* dump_file;
+    ASSERT_LEVELDB_OK(env_->NewWritableFile(dump_name, &dump_file));
+    ASSERT_LEVELDB_OK(
+        DumpFile(env_, LogFileName(dbname_, log_number), dump_file));
+    ASSERT_LEVELDB_OK(dump_file->Close());
+    delete dump_file;
+    std::string dump;
+    ASSERT_LEVELDB_OK(ReadFileToString(env_, dump_name, &dump));
+    ASSERT_LEVELDB_OK(env_->RemoveFile(dump_name));
+    ASSERT_EQ(0u, dump.find("--- offset 0; "));
+    ASSERT_EQ(std::string::npos, dump.find("--- offset", 1));
+
+    // And so must recovery.
+    ASSERT_LEVELDB_OK(Put(Key(0), "small"));
+    Reopen(&options);
+    ASSERT_EQ("small", Get(Key(0)));
+    ASSERT_EQ(Key(1) + std::string(1000, 'a' + round), Get(Key(1)));
+    ASSERT_EQ(Key(299) + std::string(1000, 'a' + round), Get(Key(299)));
+  }
+
+  // Without recycling the kept logs are removed.
+  options.recycle_log_file_num = 0;
+  Reopen(&options);
+  ASSERT_EQ("small", Get(Key(0)));
+  ASSERT_EQ(1, logs(&log_number, &size));
+}
+
+TEST_F(DBTest, MultiGetMatchesGet) {
+  Random rnd(301);
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.filter_policy = NewBloomFilterPolicy(10);
+  Reopen(&options);
+
+  // Build up several levels of overlapping tables.
+  for (int i = 0; i < 4000; i++) {
+    const int k = rnd.Uniform(2000);
+    if (rnd.OneIn(10)) {
+      ASSERT_LEVELDB_OK(Delete(Key(k)));
+    } else {
+      ASSERT_LEVELDB_OK(Put(Key(k), RandomString(&rnd, 100)));
+    }
+  }
+
+  for (int round = 0; round < 10; round++) {
+    std::vector<std::string> keys;
+    std::string expected;
+    for (int i = 0; i < 200; i++) {
+      keys.push_back(Key(rnd.Uniform(2200)));
+      if (i > 0) {
+        expected += ",";
+      }
+      expected += Get(keys.back());
+    }
+    ASSERT_EQ(expected, MultiGet(keys));
+  }
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, DataBlockHashIndex) {
+  Random rnd(301);
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.data_block_hash_index = true;
+  Reopen(&options);
+
+  // Several versions of each key, some of them only visible to a snapshot.
+  std::map<std::string, std::string> model, snapshot_model;
+  const Snapshot* snapshot = nullptr;
+  for (int i = 0; i < 6000; i++) {
+    if (i == 3000) {
+      snapshot = db_->GetSnapshot();
+      snapshot_model = model;
+    }
+    const std::string k = Key(2 * rnd.Uniform(1000));
+    if (rnd.OneIn(10)) {
+      ASSERT_LEVELDB_OK(Delete(k));
+      model.erase(k);
+    } else {
+      const std::string v = RandomString(&rnd, 50);
+      ASSERT_LEVELDB_OK(Put(k, v));
+      model[k] = v;
+    }
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  for (int pass = 0; pass < 2; pass++) {
+    // Odd keys were never written.
+    for (int i = 0; i < 2000; i++) {
+      const std::string k = Key(i);
+      auto it = model.find(k);
+      ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(k));
+      it = snapshot_model.find(k);
+      ASSERT_EQ(it == snapshot_model.end() ? "NOT_FOUND" : it->second,
+                Get(k, snapshot));
+    }
+    if (pass == 0) {
+      // The hash index is found without the option, too.
+      db_->ReleaseSnapshot(snapshot);
+      snapshot = nullptr;
+      snapshot_model = model;
+      options.data_block_hash_index = false;
+      Reopen(&options);
+    }
+  }
+}
+
+TEST_F(DBTest, WalCompression) {
+  Options options = CurrentOptions();
+  options.wal_compression = kSnappyCompression;
+  Reopen(&options);
+
+  // Recovery reads back compressed and uncompressed records alike.
+  Random rnd(301);
+  const std::string incompressible = RandomString(&rnd, 1000);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(10000, 'a' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(Put(Key(100), incompressible));
+  ASSERT_LEVELDB_OK(Put(Key(101), "small"));
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(std::string(10000, 'a' + i % 26), Get(Key(i)));
+  }
+  ASSERT_EQ(incompressible, Get(Key(100)));
+  ASSERT_EQ("small", Get(Key(101)));
+
+  // Logs written with compression are still read without it.
+  options.wal_compression = kNoCompression;
+  ASSERT_LEVELDB_OK(Put(Key(102), std::string(10000, 'z')));
+  Reopen(&options);
+  ASSERT_EQ(std::string(10000, 'z'), Get(Key(102)));
+}
+
+TEST_F(DBTest, ValueLog) {
+  Options options = CurrentOptions();
+  options.value_log_threshold = 1000;
+  options.value_log_gc_age_cutoff = 1.0;
+  Reopen(&options);
+
+  // Returns the number of value log files.
+  auto value_logs = [this]() {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int count = 0;
+    uint64_t number;
+    FileType type;
+    for (const std::string& file : files) {
+      if (ParseFileName(file, &number, &type) && type == kValueLogFile) {
+        count++;
+      }
+    }
+    return count;
+  };
+  auto large = [](int i, char c) { return Key(i) + std::string(2000, c); };
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), (i % 2 == 0) ? large(i, 'a') : "small"));
+  }
+  ASSERT_EQ(0, value_logs());
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, value_logs());
+  ASSERT_EQ(large(0, 'a'), Get(Key(0)));
+  ASSERT_EQ("small", Get(Key(1)));
+  PinnedValue pinned;
+  ASSERT_LEVELDB_OK(db_->GetPinned(ReadOptions(), Key(2), &pinned));
+  ASSERT_EQ(large(2, 'a'), pinned.ToString());
+
+  // Iterators read separated values in both directions.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek(Key(10));
+  ASSERT_EQ(Key(10) + "->" + large(10, 'a'), IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ(Key(11) + "->small", IterStatus(iter));
+  iter->Prev();
+  iter->Prev();
+  ASSERT_EQ(Key(9) + "->small", IterStatus(iter));
+  iter->SeekToLast();
+  ASSERT_EQ(Key(99) + "->small", IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ(Key(98) + "->" + large(98, 'a'), IterStatus(iter));
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+
+  Reopen(&options);
+  ASSERT_EQ(large(98, 'a'), Get(Key(98)));
+
+  // Overwritten values leave nothing behind in the value log they were
+  // in, and values still in use are moved out of old value logs.
+  for (int i = 0; i < 100; i += 2) {
+    ASSERT_LEVELDB_OK(Put(Key(i), large(i, 'b')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(2, value_logs());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(1, value_logs());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ((i % 2 == 0) ? large(i, 'b') : "small", Get(Key(i)));
+  }
+
+  // Values below the threshold move back into the tables once the tables
+  // referring to them are compacted.
+  options.value_log_threshold = 0;
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put(Key(1), "small"));
+  ASSERT_LEVELDB_OK(Put(Key(99), "small"));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, value_logs());
+  ASSERT_EQ(large(50, 'b'), Get(Key(50)));
+}
+
 TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
   Options options = CurrentOptions();
   options.write_buffer_size = 100000000;  // Large write buffer
@@ -1942,6 +2429,392 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, BloomFilterPolicies) {
+  // The other filter policies spare about as many reads as BloomFilter
+  // does.  Ribbon filters are meant to cover whole tables.
+  env_->count_random_reads_ = true;
+  for (int kind = 0; kind < 2; kind++) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.block_cache = NewLRUCache(0);  // Prevent cache hits
+    if (kind == 0) {
+      options.filter_policy = NewBlockedBloomFilterPolicy(10);
+    } else {
+      options.filter_policy = NewRibbonFilterPolicy(10);
+      options.whole_table_filter = true;
+    }
+    DestroyAndReopen(&options);
+
+    const int N = 10000;
+    for (int i = 0; i < N; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    }
+    Compact("a", "z");
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+    int reads = env_->random_read_counter_.Read();
+    ASSERT_GE(reads, N);
+    ASSERT_LE(reads, N + 2 * N / 100);
+
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%s: %d missing => %d reads\n",
+                 options.filter_policy->Name(), N, reads);
+    ASSERT_LE(reads, 3 * N / 100);
+
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+    Close();
+    delete options.block_cache;
+    delete options.filter_policy;
+  }
+}
+
+TEST_F(DBTest, WholeTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  Reopen(&options);
+
+  // A table with a filter per 2KB under one with a single filter.
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  options.whole_table_filter = true;
+  Reopen(&options);
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + "new"));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  for (int pass = 0; pass < 2; pass++) {
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(i % 100 == 0 ? Key(i) + "new" : Key(i), Get(Key(i)));
+    }
+    int reads = env_->random_read_counter_.Read();
+    ASSERT_GE(reads, N);
+    ASSERT_LE(reads, N + 2 * N / 100);
+
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3 * N / 100);
+
+    if (pass == 0) {
+      // Either kind of filter is read whatever the option says.
+      env_->delay_data_sync_.store(false, std::memory_order_release);
+      options.whole_table_filter = false;
+      Reopen(&options);
+      env_->delay_data_sync_.store(true, std::memory_order_release);
+    }
+  }
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+static std::string UserKey(int user, int i) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "user%04d:%02d", user, i);
+  return std::string(buf);
+}
+
+// Returns the number of reads it takes to seek the prefix of each of the
+// odd users below "n", which have no keys, with a new iterator each.
+static int MissingPrefixReads(DB* db, SpecialEnv* env,
+                              const ReadOptions& options, int n) {
+  env->random_read_counter_.Reset();
+  for (int u = 1; u < n; u += 2) {
+    Iterator* iter = db->NewIterator(options);
+    iter->Seek(UserKey(u, 0).substr(0, 9));
+    delete iter;
+  }
+  return env->random_read_counter_.Read();
+}
+
+TEST_F(DBTest, PrefixSeek) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewDelimitedPrefixExtractor(':');
+  Reopen(&options);
+
+  // Even users have ten keys each, spread over two layers, and odd users
+  // have none.
+  const int N = 1000;
+  for (int u = 0; u < N; u += 2) {
+    for (int i = 0; i < 10; i += 2) {
+      ASSERT_LEVELDB_OK(Put(UserKey(u, i), UserKey(u, i)));
+    }
+  }
+  ASSERT_LEVELDB_OK(Put("nodelimiter", "v"));
+  Compact("a", "z");
+  for (int u = 0; u < N; u += 2) {
+    for (int i = 1; i < 10; i += 2) {
+      ASSERT_LEVELDB_OK(Put(UserKey(u, i), UserKey(u, i)));
+    }
+    ASSERT_LEVELDB_OK(Delete(UserKey(u, 9)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  ReadOptions ro;
+  ro.prefix_seek = true;
+  Iterator* iter = db_->NewIterator(ro);
+  for (int u = 0; u < N; u += 2) {
+    iter->Seek(UserKey(u, 0).substr(0, 9));
+    for (int i = 0; i < 9; i++) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(UserKey(u, i), iter->key().ToString());
+      iter->Next();
+    }
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_LEVELDB_OK(iter->status());
+  }
+  iter->Seek(UserKey(10, 5));
+  ASSERT_EQ(UserKey(10, 5), iter->key().ToString());
+
+  // Seeking a prefix no key has rarely reads a block.
+  int reads = MissingPrefixReads(db_, env_, ro, N);
+  std::fprintf(stderr, "%d missing prefixes => %d reads\n", N / 2, reads);
+  ASSERT_LE(reads, 3 * (N / 2) / 100);
+  ASSERT_GE(MissingPrefixReads(db_, env_, ReadOptions(), N), N / 2);
+
+  // Keys without a prefix are iterated over as usual.
+  iter->Seek("nodelimiter");
+  ASSERT_EQ("nodelimiter", iter->key().ToString());
+  iter->Next();
+  ASSERT_EQ(UserKey(0, 0), iter->key().ToString());
+  iter->SeekToFirst();
+  ASSERT_EQ("nodelimiter", iter->key().ToString());
+
+  // Only forward iteration is supported.
+  iter->Prev();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  iter->SeekToLast();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  delete iter;
+
+  // Tables whose filters hold other prefixes are not skipped.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  delete options.prefix_extractor;
+  options.prefix_extractor = NewFixedPrefixExtractor(9);
+  Reopen(&options);
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  iter = db_->NewIterator(ro);
+  iter->Seek(UserKey(10, 0).substr(0, 9));
+  ASSERT_EQ(UserKey(10, 0), iter->key().ToString());
+  delete iter;
+  ASSERT_GE(MissingPrefixReads(db_, env_, ro, N), N / 2);
+
+  // Rewritten with whole-table filters holding the new prefixes, tables
+  // are skipped again.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  options.whole_table_filter = true;
+  Reopen(&options);
+  Compact("a", "z");
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  iter = db_->NewIterator(ro);
+  iter->Seek(UserKey(10, 0).substr(0, 9));
+  ASSERT_EQ(UserKey(10, 0), iter->key().ToString());
+  delete iter;
+  ASSERT_LE(MissingPrefixReads(db_, env_, ro, N), 3 * (N / 2) / 100);
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST_F(DBTest, PartitionedIndex) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewDelimitedPrefixExtractor(':');
+  options.index_partition_size = 1024;
+  Reopen(&options);
+
+  // Even users have ten keys each, and odd users have none.
+  const int N = 1000;
+  for (int u = 0; u < N; u += 2) {
+    for (int i = 0; i < 10; i++) {
+      ASSERT_LEVELDB_OK(Put(UserKey(u, i), UserKey(u, i)));
+    }
+  }
+  Compact("a", "z");
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  // A lookup reads a filter partition, an index partition and a block.
+  env_->random_read_counter_.Reset();
+  for (int u = 0; u < N; u += 2) {
+    ASSERT_EQ(UserKey(u, 5), Get(UserKey(u, 5)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  ASSERT_GE(reads, N / 2);
+  ASSERT_LE(reads, 3 * (N / 2));
+
+  // Missing keys rarely get past the filter partition.
+  env_->random_read_counter_.Reset();
+  for (int u = 1; u < N; u += 2) {
+    ASSERT_EQ("NOT_FOUND", Get(UserKey(u, 5)));
+  }
+  reads = env_->random_read_counter_.Read();
+  std::fprintf(stderr, "%d missing => %d reads\n", N / 2, reads);
+  ASSERT_LE(reads, N / 2 + 2 * 3 * (N / 2) / 100);
+
+  std::vector<std::string> keys;
+  std::string expected;
+  for (int u = 0; u < 200; u++) {
+    keys.push_back(UserKey(u, u % 10));
+    if (u > 0) {
+      expected += ",";
+    }
+    expected += (u % 2 == 0) ? keys.back() : "NOT_FOUND";
+  }
+  ASSERT_EQ(expected, MultiGet(keys));
+
+  // Prefix seeks skip whole partitions, forward scans see every key.
+  ReadOptions ro;
+  ro.prefix_seek = true;
+  Iterator* iter = db_->NewIterator(ro);
+  iter->Seek(UserKey(10, 0).substr(0, 9));
+  ASSERT_EQ(UserKey(10, 0), iter->key().ToString());
+  delete iter;
+  reads = MissingPrefixReads(db_, env_, ro, N);
+  std::fprintf(stderr, "%d missing prefixes => %d reads\n", N / 2, reads);
+  ASSERT_LE(reads, N / 2 + 2 * 3 * (N / 2) / 100);
+  iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(UserKey(count / 10 * 2, count % 10), iter->key().ToString());
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(10 * (N / 2), count);
+  delete iter;
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST_F(DBTest, WriteStats) {
+  do {
+    WriteOptions sync;
+    sync.sync = true;
+    ASSERT_LEVELDB_OK(db_->Put(sync, "a", "v1"));
+    ASSERT_LEVELDB_OK(db_->Put(sync, "b", "v2"));
+    ASSERT_LEVELDB_OK(Put("c", "v3"));
+    std::string val;
+    ASSERT_TRUE(db_->GetProperty("leveldb.write-stats", &val));
+    ASSERT_EQ(3, MemoryUsageEntry(val, "write-groups"));
+    ASSERT_EQ(3, MemoryUsageEntry(val, "writers"));
+    ASSERT_EQ(1, MemoryUsageEntry(val, "max-writers-per-group"));
+    ASSERT_EQ(2, MemoryUsageEntry(val, "log-syncs"));
+    ASSERT_EQ(2, MemoryUsageEntry(val, "synced-writers"));
+    ASSERT_EQ(0, MemoryUsageEntry(val, "commit-delays"));
+    ASSERT_EQ(0, MemoryUsageEntry(val, "write-delays"));
+    ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &val));
+    ASSERT_EQ("0", val);
+  } while (ChangeOptions());
+}
+
+namespace {
+
+struct SyncWriterState {
+  DB* db;
+  int id;
+  int num_writes;
+  std::atomic<bool> done;
+};
+
+void SyncWriterBody(void* arg) {
+  SyncWriterState* state = reinterpret_cast<SyncWriterState*>(arg);
+  WriteOptions options;
+  options.sync = true;
+  for (int i = 0; i < state->num_writes; i++) {
+    ASSERT_LEVELDB_OK(state->db->Put(
+        options, Key(state->id * state->num_writes + i), "v"));
+  }
+  state->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, ConcurrentSyncWrites) {
+  static const int kWriters = 4;
+  static const int kWritesPerWriter = 50;
+  for (bool pipelined : {false, true}) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.enable_pipelined_write = pipelined;
+    options.sync_commit_delay_micros = 100;
+    DestroyAndReopen(&options);
+
+    SyncWriterState states[kWriters];
+    for (int id = 0; id < kWriters; id++) {
+      states[id].db = db_;
+      states[id].id = id;
+      states[id].num_writes = kWritesPerWriter;
+      states[id].done.store(false, std::memory_order_release);
+      env_->StartThread(SyncWriterBody, &states[id]);
+    }
+    for (int id = 0; id < kWriters; id++) {
+      while (!states[id].done.load(std::memory_order_acquire)) {
+        DelayMilliseconds(10);
+      }
+    }
+
+    for (int i = 0; i < kWriters * kWritesPerWriter; i++) {
+      ASSERT_EQ("v", Get(Key(i)));
+    }
+    // Every write was covered by a sync, and some of them shared one.
+    std::string val;
+    ASSERT_TRUE(db_->GetProperty("leveldb.write-stats", &val));
+    ASSERT_EQ(kWriters * kWritesPerWriter,
+              MemoryUsageEntry(val, "synced-writers"));
+    ASSERT_GE(MemoryUsageEntry(val, "write-groups"),
+              MemoryUsageEntry(val, "log-syncs"));
+    ASSERT_GT(MemoryUsageEntry(val, "commit-delays"), 0);
+    ASSERT_LE(MemoryUsageEntry(val, "log-syncs"), kWriters * kWritesPerWriter);
+  }
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -2039,6 +2912,65 @@ TEST_F(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, ReadsDuringFlushes) {
+  // Point lookups run without the DB mutex, through whichever memtables
+  // and Version were current when they started.  Memtables are switched
+  // and flushed under readers here, which must still never see a value
+  // older than one they saw before.
+  const int kNumKeys = 10;
+  const int kNumReaders = 3;
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_LEVELDB_OK(Put(Key(k), "0"));
+  }
+  std::atomic<bool> stop(false);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> readers;
+  for (int id = 0; id < kNumReaders; id++) {
+    readers.emplace_back([&, id]() {
+      Random rnd(id);
+      std::vector<int> last(kNumKeys, 0);
+      while (!stop.load(std::memory_order_acquire)) {
+        const int k = rnd.Uniform(kNumKeys);
+        std::string value;
+        Status s;
+        if (id == 0) {
+          PinnedValue pinned;
+          s = db_->GetPinned(ReadOptions(), Key(k), &pinned);
+          value = pinned.ToString();
+        } else {
+          s = db_->Get(ReadOptions(), Key(k), &value);
+        }
+        const int v = s.ok() ? std::atoi(value.c_str()) : -1;
+        if (v < last[k]) {
+          errors.fetch_add(1);
+        } else {
+          last[k] = v;
+        }
+      }
+    });
+  }
+
+  for (int i = 1; i <= 100; i++) {
+    for (int k = 0; k < kNumKeys; k++) {
+      ASSERT_LEVELDB_OK(Put(Key(k), std::to_string(i)));
+    }
+    if (i % 10 == 0) {
+      ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    }
+  }
+  stop.store(true, std::memory_order_release);
+  for (std::thread& t : readers) {
+    t.join();
+  }
+  ASSERT_EQ(0, errors.load());
+
+  // Nothing is kept alive once the readers are gone.
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &val));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "iterator-pinned-mem-table-count"));
+  ASSERT_EQ(0, MemoryUsageEntry(val, "iterator-pinned-version-count"));
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -181,6 +181,12 @@ bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
   return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
 }
 
+void SetPrefixFilterKey(const Slice& prefix, std::string* dst) {
+  dst->clear();
+  AppendInternalKey(
+      dst, ParsedInternalKey(prefix, kMaxSequenceNumber, kValueTypeForSeek));
+}
+
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) {
   size_t usize = user_key.size();
   size_t needed = usize + 13;  // A conservative estimate
@@ -215,7 +221,7 @@ MVLookupKey::MVLookupKey(const Slice& user_key, SequenceNumber s,
   kstart_ = dst;
   std::memcpy(dst, user_key.data(), usize);
   dst += usize;
-  EncodeFixed64(dst, PackSequenceAndType(s, kValueTypeForSeek));
+  EncodeFixed64(dst, PackSequenceAndType(s, kMVValueTypeForSeek));
   dst += 8;
   EncodeFixed64(dst, t);
   dst += 8;
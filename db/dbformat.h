@@ -56,14 +56,25 @@ class MVInternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  // A value whose location in a value log file (see value_log.h) is
+  // stored instead of the value itself.  Only found in the tables of
+  // databases that are not multi-version.
+  kTypeValueIndex = 0x2
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeValueIndex;
+// Multi-version keys never hold kTypeValueIndex, and their lookups rely on
+// the lookup key's tag being equal to that of an entry written at the
+// snapshot's sequence number, so they keep seeking with kTypeValue.
+static const ValueType kMVValueTypeForSeek = kTypeValue;
 
 typedef uint64_t SequenceNumber;
 
@@ -138,6 +149,24 @@ inline ValidTime ExtractValidTime(const Slice& mv_internal_key) {
   return DecodeFixed64(mv_internal_key.data() + mv_internal_key.size() - 8);
 }
 
+// Returns the type of an internal key, or of a multi-version internal key
+// if "multi_version" is set.
+inline ValueType ExtractValueType(const Slice& internal_key,
+                                  bool multi_version) {
+  assert(internal_key.size() >= (multi_version ? 16 : 8));
+  const size_t tag_offset = internal_key.size() - (multi_version ? 16 : 8);
+  return static_cast<ValueType>(
+      static_cast<uint8_t>(internal_key[tag_offset]));
+}
+
+// Changes the type of the internal key in *key, or of the multi-version
+// internal key if "multi_version" is set, to "type".
+inline void SetValueType(std::string* key, ValueType type,
+                         bool multi_version) {
+  assert(key->size() >= (multi_version ? 16 : 8));
+  (*key)[key->size() - (multi_version ? 16 : 8)] = static_cast<char>(type);
+}
+
 // A comparator for internal keys that uses a specified comparator for
 // the user key portion and breaks ties by decreasing sequence number.
 class InternalKeyComparator : public Comparator {
@@ -192,6 +221,11 @@ class InternalFilterPolicy : public FilterPolicy {
   bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
 };
 
+// Sets *dst to the key the filters of a table hold for "prefix", the
+// prefix of some of its user keys (see Options::prefix_extractor).  It is
+// an internal key, so that an InternalFilterPolicy sees "prefix" itself.
+void SetPrefixFilterKey(const Slice& prefix, std::string* dst);
+
 // Modules in this directory should keep internal keys wrapped inside
 // the following class instead of plain strings so that we do not
 // incorrectly use string comparisons instead of an InternalKeyComparator.
@@ -266,6 +300,8 @@ class MVInternalKey {
 
   ValidTime valid_time() const { return ExtractValidTime(rep_); }
 
+  bool empty() const { return rep_.empty(); }
+
   void SetFrom(const ParsedMVInternalKey& p) {
     rep_.clear();
     AppendMVInternalKey(&rep_, p);
@@ -300,7 +336,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeValueIndex));
 }
 
 inline bool ParseMVInternalKey(const Slice& mv_internal_key,
@@ -23,7 +23,7 @@ namespace leveldb {
 
 namespace {
 
-bool GuessType(const std::string& fname, FileType* type) {
+bool GuessType(const std::string& fname, uint64_t* number, FileType* type) {
   size_t pos = fname.rfind('/');
   std::string basename;
   if (pos == std::string::npos) {
@@ -31,8 +31,7 @@ bool GuessType(const std::string& fname, FileType* type) {
   } else {
     basename = std::string(fname.data() + pos + 1, fname.size() - pos - 1);
   }
-  uint64_t ignored;
-  return ParseFileName(basename, &ignored, type);
+  return ParseFileName(basename, number, type);
 }
 
 // Notified when log reader encounters corruption.
@@ -50,8 +49,10 @@ class CorruptionReporter : public log::Reader::Reporter {
   WritableFile* dst_;
 };
 
-// Print contents of a log file. (*func)() is called on every record.
-Status PrintLogContents(Env* env, const std::string& fname,
+// Print contents of log file "number". (*func)() is called on every
+// record.  Records left over from a previous use of a recycled file are
+// not printed.
+Status PrintLogContents(Env* env, const std::string& fname, uint64_t number,
                         void (*func)(uint64_t, Slice, WritableFile*),
                         WritableFile* dst) {
   SequentialFile* file;
@@ -61,7 +62,7 @@ Status PrintLogContents(Env* env, const std::string& fname,
   }
   CorruptionReporter reporter;
   reporter.dst_ = dst;
-  log::Reader reader(file, &reporter, true, 0);
+  log::Reader reader(file, &reporter, true, 0, number);
   Slice record;
   std::string scratch;
   while (reader.ReadRecord(&record, &scratch)) {
@@ -119,8 +120,9 @@ static void WriteBatchPrinter(uint64_t pos, Slice record, WritableFile* dst) {
   }
 }
 
-Status DumpLog(Env* env, const std::string& fname, WritableFile* dst) {
-  return PrintLogContents(env, fname, WriteBatchPrinter, dst);
+Status DumpLog(Env* env, const std::string& fname, uint64_t number,
+               WritableFile* dst) {
+  return PrintLogContents(env, fname, number, WriteBatchPrinter, dst);
 }
 
 // Called on every log record (each one of which is a WriteBatch)
@@ -140,8 +142,9 @@ static void VersionEditPrinter(uint64_t pos, Slice record, WritableFile* dst) {
   dst->Append(r);
 }
 
-Status DumpDescriptor(Env* env, const std::string& fname, WritableFile* dst) {
-  return PrintLogContents(env, fname, VersionEditPrinter, dst);
+Status DumpDescriptor(Env* env, const std::string& fname, uint64_t number,
+                      WritableFile* dst) {
+  return PrintLogContents(env, fname, number, VersionEditPrinter, dst);
 }
 
 Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
@@ -189,6 +192,8 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
         r += "del";
       } else if (key.type == kTypeValue) {
         r += "val";
+      } else if (key.type == kTypeValueIndex) {
+        r += "vidx";
       } else {
         AppendNumberTo(&r, key.type);
       }
@@ -212,15 +217,16 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
 }  // namespace
 
 Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
+  uint64_t number;
   FileType ftype;
-  if (!GuessType(fname, &ftype)) {
+  if (!GuessType(fname, &number, &ftype)) {
     return Status::InvalidArgument(fname + ": unknown file type");
   }
   switch (ftype) {
     case kLogFile:
-      return DumpLog(env, fname, dst);
+      return DumpLog(env, fname, number, dst);
     case kDescriptorFile:
-      return DumpDescriptor(env, fname, dst);
+      return DumpDescriptor(env, fname, number, dst);
     case kTableFile:
       return DumpTable(env, fname, dst);
     default:
@@ -22,6 +22,7 @@ enum FileType {
   kLogFile,
   kDBLockFile,
   kTableFile,
+  kValueLogFile,
   kDescriptorFile,
   kCurrentFile,
   kTempFile,
@@ -43,6 +44,11 @@ std::string TableFileName(const std::string& dbname, uint64_t number);
 // "dbname".
 std::string SSTTableFileName(const std::string& dbname, uint64_t number);
 
+// Return the name of the value log file with the specified number
+// in the db named by "dbname".  The result will be prefixed with
+// "dbname".
+std::string ValueLogFileName(const std::string& dbname, uint64_t number);
+
 // Return the name of the descriptor file for the db named by
 // "dbname" and the specified incarnation number.  The result will be
 // prefixed with "dbname".
@@ -26,6 +26,7 @@ TEST(FileNameTest, Parse) {
       {"0.log", 0, kLogFile},
       {"0.sst", 0, kTableFile},
       {"0.ldb", 0, kTableFile},
+      {"7.vlog", 7, kValueLogFile},
       {"CURRENT", 0, kCurrentFile},
       {"LOCK", 0, kDBLockFile},
       {"MANIFEST-2", 2, kDescriptorFile},
@@ -99,6 +100,12 @@ TEST(FileNameTest, Construction) {
   ASSERT_EQ(200, number);
   ASSERT_EQ(kTableFile, type);
 
+  fname = ValueLogFileName("bar", 300);
+  ASSERT_EQ("bar/", std::string(fname.data(), 4));
+  ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+  ASSERT_EQ(300, number);
+  ASSERT_EQ(kValueLogFile, type);
+
   fname = DescriptorFileName("bar", 100);
   ASSERT_EQ("bar/", std::string(fname.data(), 4));
   ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
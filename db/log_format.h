@@ -20,15 +20,35 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // The same types in the recyclable format, whose header also holds the
+  // number of the log the record was written to.  A recycled log file
+  // still holds the records of its previous use past the new ones; they
+  // are told apart by their log number.
+  kRecyclableFullType = 5,
+  kRecyclableFirstType = 6,
+  kRecyclableMiddleType = 7,
+  kRecyclableLastType = 8,
+
+  // The start of a record whose data is compressed; the record's other
+  // fragments keep the MIDDLE and LAST types.
+  kCompressedFullType = 9,
+  kCompressedFirstType = 10,
+  kRecyclableCompressedFullType = 11,
+  kRecyclableCompressedFirstType = 12
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableCompressedFirstType;
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Recyclable header is checksum (4 bytes), length (2 bytes), type (1 byte),
+// log number (4 bytes, the low 32 bits of the number).
+static const int kRecyclableHeaderSize = kHeaderSize + 4;
+
 }  // namespace log
 }  // namespace leveldb
 
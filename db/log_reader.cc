@@ -7,6 +7,7 @@
 #include <cstdio>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -26,10 +27,41 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       initial_offset_(initial_offset),
-      resyncing_(initial_offset > 0) {}
+      resyncing_(initial_offset > 0),
+      check_log_number_(false),
+      log_number_(0),
+      recyclable_(false) {}
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t initial_offset, uint64_t log_number)
+    : file_(file),
+      reporter_(reporter),
+      checksum_(checksum),
+      backing_store_(new char[kBlockSize]),
+      buffer_(),
+      eof_(false),
+      last_record_offset_(0),
+      end_of_buffer_offset_(0),
+      initial_offset_(initial_offset),
+      resyncing_(initial_offset > 0),
+      check_log_number_(true),
+      log_number_(static_cast<uint32_t>(log_number)),
+      recyclable_(false) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
+// Store the uncompressed contents of the data of a compressed record in
+// *output.  Returns false if the data is corrupted.
+static bool UncompressRecord(const Slice& input, std::string* output) {
+  size_t length;
+  if (!port::Snappy_GetUncompressedLength(input.data(), input.size(),
+                                          &length)) {
+    return false;
+  }
+  output->resize(length);
+  return port::Snappy_Uncompress(input.data(), input.size(), &(*output)[0]);
+}
+
 bool Reader::SkipToInitialBlock() {
   const size_t offset_in_block = initial_offset_ % kBlockSize;
   uint64_t block_start_location = initial_offset_ - offset_in_block;
@@ -63,19 +95,22 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
   scratch->clear();
   record->clear();
   bool in_fragmented_record = false;
+  bool compressed_record = false;
   // Record offset of the logical record that we're reading
   // 0 is a dummy value to make compilers happy
   uint64_t prospective_record_offset = 0;
 
   Slice fragment;
   while (true) {
-    const unsigned int record_type = ReadPhysicalRecord(&fragment);
+    int header_size;
+    const unsigned int record_type =
+        ReadPhysicalRecord(&fragment, &header_size);
 
     // ReadPhysicalRecord may have only had an empty trailer remaining in its
     // internal buffer. Calculate the offset of the next physical record now
     // that it has returned, properly accounting for its header size.
     uint64_t physical_record_offset =
-        end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+        end_of_buffer_offset_ - buffer_.size() - header_size - fragment.size();
 
     if (resyncing_) {
       if (record_type == kMiddleType) {
@@ -105,7 +140,22 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         last_record_offset_ = prospective_record_offset;
         return true;
 
+      case kCompressedFullType:
+        if (in_fragmented_record && !scratch->empty()) {
+          ReportCorruption(scratch->size(), "partial record without end(1)");
+        }
+        in_fragmented_record = false;
+        if (!UncompressRecord(fragment, scratch)) {
+          ReportCorruption(fragment.size(), "corrupted compressed record");
+          scratch->clear();
+          break;
+        }
+        *record = Slice(*scratch);
+        last_record_offset_ = physical_record_offset;
+        return true;
+
       case kFirstType:
+      case kCompressedFirstType:
         if (in_fragmented_record) {
           // Handle bug in earlier versions of log::Writer where
           // it could emit an empty kFirstType record at the tail end
@@ -118,6 +168,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         prospective_record_offset = physical_record_offset;
         scratch->assign(fragment.data(), fragment.size());
         in_fragmented_record = true;
+        compressed_record = (record_type == kCompressedFirstType);
         break;
 
       case kMiddleType:
@@ -135,6 +186,16 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
                            "missing start of fragmented record(2)");
         } else {
           scratch->append(fragment.data(), fragment.size());
+          if (compressed_record) {
+            std::string uncompressed;
+            if (!UncompressRecord(*scratch, &uncompressed)) {
+              ReportCorruption(scratch->size(), "corrupted compressed record");
+              in_fragmented_record = false;
+              scratch->clear();
+              break;
+            }
+            scratch->swap(uncompressed);
+          }
           *record = Slice(*scratch);
           last_record_offset_ = prospective_record_offset;
           return true;
@@ -186,7 +247,14 @@ void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
   }
 }
 
-unsigned int Reader::ReadPhysicalRecord(Slice* result) {
+unsigned int Reader::EndRecyclableLog() {
+  buffer_.clear();
+  eof_ = true;
+  return kEof;
+}
+
+unsigned int Reader::ReadPhysicalRecord(Slice* result, int* header_size) {
+  *header_size = kHeaderSize;
   while (true) {
     if (buffer_.size() < kHeaderSize) {
       if (!eof_) {
@@ -217,11 +285,23 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const char* header = buffer_.data();
     const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
-    const unsigned int type = header[6];
+    unsigned int type = header[6];
     const uint32_t length = a | (b << 8);
-    if (kHeaderSize + length > buffer_.size()) {
+    const bool recyclable_type =
+        (type >= kRecyclableFullType && type <= kRecyclableLastType) ||
+        type == kRecyclableCompressedFullType ||
+        type == kRecyclableCompressedFirstType;
+    if (recyclable_ && !recyclable_type && type != kZeroType) {
+      // A recyclable log never switches back to the legacy format.
+      return EndRecyclableLog();
+    }
+    *header_size = recyclable_type ? kRecyclableHeaderSize : kHeaderSize;
+    if (*header_size + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
       buffer_.clear();
+      if (recyclable_) {
+        return EndRecyclableLog();
+      }
       if (!eof_) {
         ReportCorruption(drop_size, "bad record length");
         return kBadRecord;
@@ -243,8 +323,14 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     // Check crc
     if (checksum_) {
       uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+      uint32_t actual_crc =
+          crc32c::Value(header + 6, *header_size - 6 + length);
       if (actual_crc != expected_crc) {
+        if (recyclable_ || recyclable_type) {
+          // The writer died while overwriting a recycled file, or this is
+          // a leftover that the new records happen not to line up with.
+          return EndRecyclableLog();
+        }
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
         // fragment of a real log record that just happens to look
@@ -256,16 +342,30 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
       }
     }
 
-    buffer_.remove_prefix(kHeaderSize + length);
+    if (recyclable_type) {
+      if (check_log_number_ &&
+          DecodeFixed32(header + kHeaderSize) != log_number_) {
+        // Left over from the previous use of the file.
+        return EndRecyclableLog();
+      }
+      recyclable_ = true;
+      if (type >= kRecyclableCompressedFullType) {
+        type = type - kRecyclableCompressedFullType + kCompressedFullType;
+      } else {
+        type = type - kRecyclableFullType + kFullType;
+      }
+    }
+
+    buffer_.remove_prefix(*header_size + length);
 
     // Skip physical record that started before initial_offset_
-    if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+    if (end_of_buffer_offset_ - buffer_.size() - *header_size - length <
         initial_offset_) {
       result->clear();
       return kBadRecord;
     }
 
-    *result = Slice(header + kHeaderSize, length);
+    *result = Slice(header + *header_size, length);
     return type;
   }
 }
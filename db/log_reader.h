@@ -43,6 +43,12 @@ class Reader {
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
          uint64_t initial_offset);
 
+  // Like the above, for a log that may be a recycled file: records in the
+  // recyclable format that were not written to log "log_number" are left
+  // over from the file's previous use and end the log.
+  Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+         uint64_t initial_offset, uint64_t log_number);
+
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
 
@@ -60,11 +66,17 @@ class Reader {
   // Undefined before the first call to ReadRecord.
   uint64_t LastRecordOffset();
 
+  // Returns true if a record in the recyclable format has been read, in
+  // which case the file may hold leftovers of a previous use past the end
+  // of the log and must not be appended to.
+  bool recyclable() const { return recyclable_; }
+
  private:
   // Extend record types with the following special values
   enum {
     kEof = kMaxRecordType + 1,
-    // Returned whenever we find an invalid physical record.
+    // Returned whenever we find an invalid physical record.  In a recyclable
+    // log, kEof is returned instead since that is where the log ends.
     // Currently there are three situations in which this happens:
     // * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
     // * The record is a 0-length record (No drop is reported)
@@ -77,8 +89,13 @@ class Reader {
   // Returns true on success. Handles reporting.
   bool SkipToInitialBlock();
 
-  // Return type, or one of the preceding special values
-  unsigned int ReadPhysicalRecord(Slice* result);
+  // Return type, or one of the preceding special values.  Recyclable types
+  // are returned as the corresponding legacy types.  Sets *header_size to
+  // the size of the record's header.
+  unsigned int ReadPhysicalRecord(Slice* result, int* header_size);
+
+  // Ends the log: the rest of the file is left over from a previous use.
+  unsigned int EndRecyclableLog();
 
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
@@ -104,6 +121,13 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  // If check_log_number_, recyclable records must carry log_number_.
+  bool const check_log_number_;
+  uint32_t const log_number_;
+
+  // True once a recyclable record has been read.
+  bool recyclable_;
 };
 
 }  // namespace log
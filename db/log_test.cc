@@ -6,6 +6,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 #include "util/random.h"
@@ -54,13 +55,64 @@ class LogTest : public testing::Test {
     writer_ = new Writer(&dest_, dest_.contents_.size());
   }
 
+  // Write and read log "log_number" in the recyclable format.
+  void UseRecyclableFormat(uint64_t log_number) {
+    delete writer_;
+    delete reader_;
+    writer_ = new Writer(&dest_, 0, log_number);
+    reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                         0 /*initial_offset*/, log_number);
+  }
+
+  // Start overwriting what has been written so far with log "log_number",
+  // as if the file were recycled.
+  void RecycleAs(uint64_t log_number) {
+    recycled_contents_ = dest_.contents_;
+    dest_.contents_.clear();
+    UseRecyclableFormat(log_number);
+  }
+
+  // Leave the part of the recycled file that has not been overwritten
+  // after the records written since RecycleAs().
+  void EndRecycledWrites() {
+    if (recycled_contents_.size() > dest_.contents_.size()) {
+      dest_.contents_.append(recycled_contents_, dest_.contents_.size(),
+                             std::string::npos);
+    }
+  }
+
   void Write(const std::string& msg) {
     ASSERT_TRUE(!reading_) << "Write() after starting to read";
     writer_->AddRecord(Slice(msg));
   }
 
+  // Writes the concatenation of "parts" as one record.
+  void WriteParts(const std::vector<std::string>& parts) {
+    ASSERT_TRUE(!reading_) << "Write() after starting to read";
+    std::vector<Slice> slices(parts.begin(), parts.end());
+    writer_->AddRecord(slices.data(), slices.size());
+  }
+
   size_t WrittenBytes() const { return dest_.contents_.size(); }
 
+  void SetCompression(CompressionType compression) {
+    writer_->SetCompression(compression);
+  }
+
+  // Returns the type of the physical record whose header starts at
+  // "header_offset".
+  int RecordTypeAt(size_t header_offset) const {
+    return dest_.contents_[header_offset + 6];
+  }
+
+  // Returns the length of the physical record whose header starts at
+  // "header_offset".
+  int RecordLengthAt(size_t header_offset) const {
+    return static_cast<unsigned char>(dest_.contents_[header_offset + 4]) |
+           (static_cast<unsigned char>(dest_.contents_[header_offset + 5])
+            << 8);
+  }
+
   std::string Read() {
     if (!reading_) {
       reading_ = true;
@@ -228,6 +280,7 @@ class LogTest : public testing::Test {
   static int num_initial_offset_records_;
 
   StringDest dest_;
+  std::string recycled_contents_;
   StringSource source_;
   ReportCollector report_;
   bool reading_;
@@ -293,6 +346,19 @@ TEST_F(LogTest, Fragmentation) {
   ASSERT_EQ("EOF", Read());
 }
 
+TEST_F(LogTest, GatheredRecord) {
+  WriteParts({});
+  WriteParts({"foo", "", "bar"});
+  WriteParts({BigString("a", 20000), "", BigString("b", 50000), "c"});
+  const size_t n = kBlockSize - 2 * kHeaderSize;
+  WriteParts({BigString("foo", n - 1), "x", BigString("bar", 1000)});
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("foobar", Read());
+  ASSERT_EQ(BigString("a", 20000) + BigString("b", 50000) + "c", Read());
+  ASSERT_EQ(BigString("foo", n - 1) + "x" + BigString("bar", 1000), Read());
+  ASSERT_EQ("EOF", Read());
+}
+
 TEST_F(LogTest, MarginalTrailer) {
   // Make a trailer that is exactly the same length as an empty record.
   const int n = kBlockSize - 2 * kHeaderSize;
@@ -554,6 +620,163 @@ TEST_F(LogTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(LogTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
 
+TEST_F(LogTest, RecyclableReadWrite) {
+  UseRecyclableFormat(7);
+  Write("foo");
+  ASSERT_EQ(kRecyclableHeaderSize + 3, WrittenBytes());
+  Write("");
+  Write(BigString("large", 100000));
+  Write("bar");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ(BigString("large", 100000), Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableMarginalTrailer) {
+  // Leave a trailer that a legacy header would fit in.
+  const int n =
+      kBlockSize - kRecyclableHeaderSize - (kRecyclableHeaderSize - 1);
+  UseRecyclableFormat(7);
+  Write(BigString("foo", n));
+  ASSERT_EQ(kBlockSize - (kRecyclableHeaderSize - 1), WrittenBytes());
+  Write("bar");
+  ASSERT_EQ(kBlockSize + kRecyclableHeaderSize + 3, WrittenBytes());
+  ASSERT_EQ(BigString("foo", n), Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtOldRecords) {
+  UseRecyclableFormat(7);
+  for (int i = 0; i < 10000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleAs(8);
+  Write("foo");
+  Write(BigString("bar", 40000));
+  EndRecycledWrites();
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("bar", 40000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+  ASSERT_EQ("", ReportMessage());
+}
+
+TEST_F(LogTest, RecycledLogWithNoNewRecords) {
+  UseRecyclableFormat(7);
+  Write("foo");
+  RecycleAs(8);
+  EndRecycledWrites();
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtLegacyRecords) {
+  for (int i = 0; i < 100; i++) {
+    Write(NumberString(i));
+  }
+  RecycleAs(8);
+  Write("foo");
+  EndRecycledWrites();
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableBadChecksumEndsLog) {
+  UseRecyclableFormat(7);
+  Write("foo");
+  Write("bar");
+  Write("baz");
+  // Corrupt the payload of "bar", as a torn write would.
+  IncrementByte(2 * kRecyclableHeaderSize + 3, 1);
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+static bool SnappyCompressionSupported() {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaa";
+  return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
+TEST_F(LogTest, CompressedReadWrite) {
+  if (!SnappyCompressionSupported()) {
+    GTEST_SKIP() << "skipping compression tests";
+  }
+  SetCompression(kSnappyCompression);
+  Write("small");
+  ASSERT_EQ(kHeaderSize + 5, WrittenBytes());
+  const std::string compressible = BigString("compressible", 1000);
+  Write(compressible);
+  ASSERT_EQ(kCompressedFullType, RecordTypeAt(kHeaderSize + 5));
+  ASSERT_LT(WrittenBytes(), 2 * kHeaderSize + 5 + compressible.size() / 2);
+
+  // Incompressible data is written as is.
+  Random rnd(301);
+  std::string incompressible;
+  for (int i = 0; i < 1000; i++) {
+    incompressible.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  const size_t offset = WrittenBytes();
+  Write(incompressible);
+  ASSERT_EQ(kFullType, RecordTypeAt(offset));
+  ASSERT_EQ(offset + kHeaderSize + incompressible.size(), WrittenBytes());
+
+  // Compressed records may still span blocks.
+  const std::string large = BigString("large", 1000000);
+  Write(large);
+  Write("bar");
+
+  ASSERT_EQ("small", Read());
+  ASSERT_EQ(compressible, Read());
+  ASSERT_EQ(incompressible, Read());
+  ASSERT_EQ(large, Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableCompressedReadWrite) {
+  if (!SnappyCompressionSupported()) {
+    GTEST_SKIP() << "skipping compression tests";
+  }
+  UseRecyclableFormat(7);
+  SetCompression(kSnappyCompression);
+  const std::string compressible = BigString("compressible", 1000);
+  Write(compressible);
+  ASSERT_EQ(kRecyclableCompressedFullType, RecordTypeAt(0));
+  Write(BigString("large", 100000));
+  ASSERT_EQ(compressible, Read());
+  ASSERT_EQ(BigString("large", 100000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CorruptedCompressedRecord) {
+  if (!SnappyCompressionSupported()) {
+    GTEST_SKIP() << "skipping compression tests";
+  }
+  SetCompression(kSnappyCompression);
+  const std::string compressible = BigString("compressible", 1000);
+  Write(compressible);
+  Write("foo");
+  // Make the uncompressed length stored with the data too small, without
+  // breaking the checksum.
+  const int length = RecordLengthAt(0);
+  SetByte(kHeaderSize, 5);
+  FixChecksum(0, length);
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(length, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("corrupted compressed record"));
+}
+
 }  // namespace log
 }  // namespace leveldb
 
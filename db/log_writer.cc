@@ -4,9 +4,11 @@
 
 #include "db/log_writer.h"
 
+#include <algorithm>
 #include <cstdint>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -20,91 +22,186 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+// The crc of a recyclable record covers the log number after the type.
+static void InitRecyclableTypeCrc(uint32_t log_number, uint32_t* type_crc) {
+  char buf[5];
+  EncodeFixed32(buf + 1, log_number);
+  for (int i = 0; i <= kMaxRecordType; i++) {
+    buf[0] = static_cast<char>(i);
+    type_crc[i] = crc32c::Value(buf, sizeof(buf));
+  }
+}
+
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      recyclable_(false),
+      log_number_(0),
+      header_size_(kHeaderSize),
+      compression_(kNoCompression) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      recyclable_(false),
+      log_number_(0),
+      header_size_(kHeaderSize),
+      compression_(kNoCompression) {
   InitTypeCrc(type_crc_);
 }
 
+Writer::Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number)
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      recyclable_(true),
+      log_number_(static_cast<uint32_t>(log_number)),
+      header_size_(kRecyclableHeaderSize),
+      compression_(kNoCompression) {
+  InitRecyclableTypeCrc(log_number_, type_crc_);
+}
+
 Writer::~Writer() = default;
 
-Status Writer::AddRecord(const Slice& slice) {
-  const char* ptr = slice.data();
-  size_t left = slice.size();
+// Records smaller than this are not worth compressing.
+static const size_t kMinCompressedRecordSize = 256;
+
+// The type of the same record in the recyclable format.
+static RecordType RecyclableType(RecordType type) {
+  if (type >= kCompressedFullType) {
+    return static_cast<RecordType>(type + kRecyclableCompressedFullType -
+                                   kCompressedFullType);
+  }
+  return static_cast<RecordType>(type + kRecyclableFullType - kFullType);
+}
+
+Status Writer::AddRecord(const Slice& slice) { return AddRecord(&slice, 1); }
+
+Status Writer::AddRecord(const Slice* parts, size_t n) {
+  size_t left = 0;
+  for (size_t i = 0; i < n; i++) {
+    left += parts[i].size();
+  }
+
+  bool compressed = false;
+  Slice compressed_record;
+  if (compression_ == kSnappyCompression &&
+      left >= kMinCompressedRecordSize) {
+    std::string flattened;
+    const char* input = parts[0].data();
+    if (n > 1) {
+      flattened.reserve(left);
+      for (size_t i = 0; i < n; i++) {
+        flattened.append(parts[i].data(), parts[i].size());
+      }
+      input = flattened.data();
+    }
+    // Only store the compressed data if it saves at least 12.5%, like
+    // table blocks do.
+    if (port::Snappy_Compress(input, left, &compressed_) &&
+        compressed_.size() < left - (left / 8u)) {
+      compressed_record = Slice(compressed_);
+      parts = &compressed_record;
+      n = 1;
+      left = compressed_.size();
+      compressed = true;
+    }
+  }
 
-  // Fragment the record if necessary and emit it.  Note that if slice
-  // is empty, we still want to iterate once to emit a single
+  // Fragment the record if necessary, and gather the fragments and their
+  // headers so that they can be appended to the file at once.  Note that if
+  // the record is empty, we still want to iterate once to emit a single
   // zero-length record
-  Status s;
+  iov_.clear();
+  headers_.resize((left / (kBlockSize - header_size_) + 2) * header_size_);
+  char* header = &headers_[0];
+  size_t part = 0;         // The part holding the next bytes of the record
+  size_t part_offset = 0;  // Offset of those bytes in parts[part]
   bool begin = true;
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size_) {
       // Switch to a new block
       if (leftover > 0) {
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // Fill the trailer (literal below relies on kRecyclableHeaderSize
+        // being 11)
+        static_assert(kRecyclableHeaderSize == 11, "");
+        iov_.emplace_back("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+                          leftover);
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block.
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size_ bytes in a block.
+    assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size_;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     RecordType type;
     const bool end = (left == fragment_length);
     if (begin && end) {
-      type = kFullType;
+      type = compressed ? kCompressedFullType : kFullType;
     } else if (begin) {
-      type = kFirstType;
+      type = compressed ? kCompressedFirstType : kFirstType;
     } else if (end) {
       type = kLastType;
     } else {
       type = kMiddleType;
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length);
-    ptr += fragment_length;
+    if (recyclable_) {
+      type = RecyclableType(type);
+    }
+
+    // Compute the crc of the record type and the payload.
+    assert(header + header_size_ <= &headers_[0] + headers_.size());
+    iov_.emplace_back(header, header_size_);
+    uint32_t crc = type_crc_[type];
+    size_t remaining = fragment_length;
+    while (remaining > 0) {
+      const size_t available = parts[part].size() - part_offset;
+      if (available == 0) {
+        part++;
+        part_offset = 0;
+        continue;
+      }
+      const size_t length = std::min(available, remaining);
+      const char* data = parts[part].data() + part_offset;
+      crc = crc32c::Extend(crc, data, length);
+      iov_.emplace_back(data, length);
+      part_offset += length;
+      remaining -= length;
+    }
+    FormatHeader(type, fragment_length, crc, header);
+
+    header += header_size_;
+    block_offset_ += header_size_ + fragment_length;
     left -= fragment_length;
     begin = false;
-  } while (s.ok() && left > 0);
+  } while (left > 0);
+
+  Status s = dest_->AppendParts(iov_.data(), iov_.size());
+  if (s.ok()) {
+    s = dest_->Flush();
+  }
   return s;
 }
 
-Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
-                                  size_t length) {
+void Writer::FormatHeader(RecordType t, size_t length, uint32_t crc,
+                          char* buf) {
   assert(length <= 0xffff);  // Must fit in two bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+  assert(block_offset_ + header_size_ + length <= kBlockSize);
 
-  // Format the header
-  char buf[kHeaderSize];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
   buf[6] = static_cast<char>(t);
-
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
-  crc = crc32c::Mask(crc);  // Adjust for storage
-  EncodeFixed32(buf, crc);
-
-  // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
-  if (s.ok()) {
-    s = dest_->Append(Slice(ptr, length));
-    if (s.ok()) {
-      s = dest_->Flush();
-    }
+  if (recyclable_) {
+    EncodeFixed32(buf + kHeaderSize, log_number_);
   }
-  block_offset_ += kHeaderSize + length;
-  return s;
+  EncodeFixed32(buf, crc32c::Mask(crc));  // Adjust for storage
 }
 
 }  // namespace log
@@ -7,7 +7,11 @@
 
 #include <cstdint>
 
+#include <string>
+#include <vector>
+
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -29,22 +33,49 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   Writer(WritableFile* dest, uint64_t dest_length);
 
+  // Create a writer that will write data to "*dest" in the recyclable
+  // record format, tagging every record with "log_number" so that readers
+  // can tell it apart from the contents of a recycled file.
+  // "*dest" must have initial length "dest_length", or be a recycled file
+  // that is being overwritten from the start ("dest_length" == 0).
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number);
+
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
 
   ~Writer();
 
+  // Compress the data of records added from now on with "compression",
+  // if they are large enough and that makes them enough smaller.
+  void SetCompression(CompressionType compression) {
+    compression_ = compression;
+  }
+
   Status AddRecord(const Slice& slice);
 
+  // Add a record holding the concatenation of parts[0..n-1], without
+  // copying them into one buffer first.
+  Status AddRecord(const Slice* parts, size_t n);
+
  private:
-  Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
+  // Store the header of a physical record of type "t" with "length" bytes
+  // of data, whose crc including the header's type is "crc", in "buf".
+  void FormatHeader(RecordType t, size_t length, uint32_t crc, char* buf);
 
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
+  const bool recyclable_;
+  const uint32_t log_number_;  // Only used if recyclable_
+  const int header_size_;
+  CompressionType compression_;
+  std::string compressed_;  // Compressed data of the record being added
+  std::string headers_;     // Headers of the record being added
+  std::vector<Slice> iov_;  // Headers and data of the record being added
 
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
-  // record type stored in the header.
+  // record type (and log number) stored in the header.
   uint32_t type_crc_[kMaxRecordType + 1];
 };
 
@@ -78,6 +78,17 @@ Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
+  table_.Insert(EncodeEntry(s, type, key, value, false));
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const Slice& value) {
+  table_.InsertConcurrently(EncodeEntry(s, type, key, value, true));
+}
+
+const char* MemTable::EncodeEntry(SequenceNumber s, ValueType type,
+                                  const Slice& key, const Slice& value,
+                                  bool concurrent) {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
   //  key bytes    : char[internal_key.size()]
@@ -89,7 +100,8 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   const size_t encoded_len = VarintLength(internal_key_size) +
                              internal_key_size + VarintLength(val_size) +
                              val_size;
-  char* buf = arena_.Allocate(encoded_len);
+  char* buf = concurrent ? arena_.AllocateConcurrently(encoded_len)
+                         : arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
   p += key_size;
@@ -98,12 +110,25 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  return buf;
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  Slice v;
+  Status found;
+  if (!Get(key, &v, &found)) {
+    return false;
+  }
+  if (found.ok()) {
+    value->assign(v.data(), v.size());
+  } else {
+    *s = found;
+  }
+  return true;
+}
+
+bool MemTable::Get(const LookupKey& key, Slice* value, Status* s) {
   Slice memkey = key.memtable_key();
-  Slice* a = new Slice();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
   if (iter.Valid()) {
@@ -125,13 +150,17 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
+          *value = GetLengthPrefixedSlice(key_ptr + key_length);
           return true;
         }
         case kTypeDeletion:
           *s = Status::NotFound(Slice());
           return true;
+        case kTypeValueIndex:
+          // Values are only moved to value logs as tables are written.
+          assert(false);
+          *s = Status::Corruption("value index in memtable");
+          return true;
       }
     }
   }
@@ -141,13 +170,26 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
 // Add multi-version entries to MemTable
 void MemTable::AddMV(SequenceNumber s, ValueType type, const Slice& key,
                      ValidTime vt, const Slice& value) {
+  table_.Insert(EncodeEntryMV(s, type, key, vt, value, false));
+}
+
+void MemTable::AddMVConcurrently(SequenceNumber s, ValueType type,
+                                 const Slice& key, ValidTime vt,
+                                 const Slice& value) {
+  table_.InsertConcurrently(EncodeEntryMV(s, type, key, vt, value, true));
+}
+
+const char* MemTable::EncodeEntryMV(SequenceNumber s, ValueType type,
+                                    const Slice& key, ValidTime vt,
+                                    const Slice& value, bool concurrent) {
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 16;
   const size_t encoded_len = VarintLength(internal_key_size) +
                              internal_key_size + VarintLength(val_size) +
                              val_size;
-  char* buf = arena_.Allocate(encoded_len);
+  char* buf = concurrent ? arena_.AllocateConcurrently(encoded_len)
+                         : arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
   p += key_size;
@@ -158,12 +200,27 @@ void MemTable::AddMV(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  return buf;
 }
 
 // TODO
 bool MemTable::GetMV(const MVLookupKey& key, std::string* value,
                      ValidTimePeriod* period, Status* s) {
+  Slice v;
+  Status found;
+  if (!GetMV(key, &v, period, &found)) {
+    return false;
+  }
+  if (found.ok()) {
+    value->assign(v.data(), v.size());
+  } else {
+    *s = found;
+  }
+  return true;
+}
+
+bool MemTable::GetMV(const MVLookupKey& key, Slice* value,
+                     ValidTimePeriod* period, Status* s) {
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   // Advances to the latest data version of the required key
@@ -191,8 +248,7 @@ bool MemTable::GetMV(const MVLookupKey& key, std::string* value,
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 16);
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
+          *value = GetLengthPrefixedSlice(key_ptr + key_length);
           period->lo = lo_;
           period->hi = hi_;
           return true;
@@ -202,6 +258,11 @@ bool MemTable::GetMV(const MVLookupKey& key, std::string* value,
           period->lo = lo_;
           period->hi = hi_;
           return true;
+        case kTypeValueIndex:
+          // Multi-version entries never hold value indexes.
+          assert(false);
+          *s = Status::Corruption("value index in memtable");
+          return true;
       }
     }
   }
@@ -243,6 +304,11 @@ bool MemTable::GetMVRange(const KeyList& key_list, const TimeRange& time_range,
               result_set->push_back(
                   ResultVersion(key.user_key(), Slice(), lo_, hi_));
               break;
+            case kTypeValueIndex:
+              // Multi-version entries never hold value indexes.
+              assert(false);
+              *s = Status::Corruption("value index in memtable");
+              break;
           }
 
           // Advance to next (earlier) version
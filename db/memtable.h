@@ -64,11 +64,24 @@ class MemTable {
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
+  // Like Get(), but leaves *value pointing at the value in the memtable,
+  // which stays valid for as long as the memtable is referenced.
+  bool Get(const LookupKey& key, Slice* value, Status* s);
+
+  // Like Add(), but may be called by several threads at once.  Must not
+  // race with Add() or AddMV().
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                       const Slice& value);
+
   // MVLevelDB extra methods
   void AddMV(SequenceNumber seq, ValueType type, const Slice& key, ValidTime vt,
              const Slice& value);
+  void AddMVConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                         ValidTime vt, const Slice& value);
   bool GetMV(const MVLookupKey& key, std::string* value,
              ValidTimePeriod* period, Status* s);
+  bool GetMV(const MVLookupKey& key, Slice* value, ValidTimePeriod* period,
+             Status* s);
   bool GetMVRange(const KeyList& key_list, const TimeRange& time_range,
                   SequenceNumber snapshot, ResultSet* result_set, Status* s);
 
@@ -94,6 +107,13 @@ class MemTable {
 
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Encode an entry into memory allocated from arena_ and return it.
+  const char* EncodeEntry(SequenceNumber s, ValueType type, const Slice& key,
+                          const Slice& value, bool concurrent);
+  const char* EncodeEntryMV(SequenceNumber s, ValueType type,
+                            const Slice& key, ValidTime vt,
+                            const Slice& value, bool concurrent);
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
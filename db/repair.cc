@@ -14,6 +14,8 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every value log file is kept, with none of its bytes counted
+//        as garbage
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -119,6 +121,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kValueLogFile) {
+            value_logs_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -171,7 +175,7 @@ class Repairer {
     // propagating bad information (like overly large sequence
     // numbers).
     log::Reader reader(lfile, &reporter, false /*do not checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, log);
 
     // Read all the records and add to a memtable
     std::string scratch;
@@ -203,7 +207,8 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta,
+                        nullptr);
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -372,6 +377,16 @@ class Repairer {
                     t.meta.largest);
     }
 
+    // Keep every value log, since the tables may refer to any of them.
+    // Space held by values nothing refers to any more is not reclaimed.
+    for (size_t i = 0; i < value_logs_.size(); i++) {
+      std::string fname = ValueLogFileName(dbname_, value_logs_[i]);
+      uint64_t file_size;
+      if (env_->GetFileSize(fname, &file_size).ok() && file_size > 0) {
+        edit_.AddValueLog(value_logs_[i], file_size);
+      }
+    }
+
     // std::fprintf(stderr,
     //              "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
     {
@@ -438,6 +453,7 @@ class Repairer {
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
   std::vector<uint64_t> logs_;
+  std::vector<uint64_t> value_logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
 };
@@ -8,7 +8,9 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex.  The
+// exception is InsertConcurrently(), which may be called by several threads
+// at once as long as no thread calls Insert() at the same time.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -21,14 +23,15 @@
 //
 // (2) The contents of a Node except for the next/prev pointers are
 // immutable after the Node has been linked into the SkipList.
-// Only Insert() modifies the list, and it is careful to initialize
-// a node and use release-stores to publish the nodes in one or
-// more lists.
+// Only Insert() and InsertConcurrently() modify the list, and they are
+// careful to initialize a node and use release-stores (or
+// compare-and-swaps) to publish the nodes in one or more lists.
 //
 // ... prev vs. next pointer ordering ...
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 
 #include "util/arena.h"
@@ -56,6 +59,14 @@ class SkipList {
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
+  // Like Insert(), but safe to call from several threads at once.  Each
+  // level is linked with a compare-and-swap on the predecessor's next
+  // pointer, retrying from the predecessor if another insert won the race.
+  // Node memory comes from Arena::AllocateAlignedConcurrently().
+  // REQUIRES: nothing that compares equal to key is currently in the list,
+  // and no thread is calling Insert().
+  void InsertConcurrently(const Key& key);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -105,8 +116,9 @@ class SkipList {
     return max_height_.load(std::memory_order_relaxed);
   }
 
-  Node* NewNode(const Key& key, int height);
+  Node* NewNode(const Key& key, int height, bool concurrent = false);
   int RandomHeight();
+  static int RandomHeight(Random* rnd);
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -127,14 +139,19 @@ class SkipList {
   // Return head_ if list is empty.
   Node* FindLast() const;
 
+  // Starting at "before", which must sort before key, find the nodes
+  // between which key belongs at "level".
+  void FindSpliceForLevel(const Key& key, Node* before, int level,
+                          Node** out_prev, Node** out_next) const;
+
   // Immutable after construction
   Comparator const compare_;
   Arena* const arena_;  // Arena used for allocations of nodes
 
   Node* const head_;
 
-  // Modified only by Insert().  Read racily by readers, but stale
-  // values are ok.
+  // Modified only by Insert() and InsertConcurrently().  Read racily by
+  // readers, but stale values are ok.
   std::atomic<int> max_height_;  // Height of the entire list
 
   // Read/written only by Insert().
@@ -173,6 +190,15 @@ struct SkipList<Key, Comparator>::Node {
     next_[n].store(x, std::memory_order_relaxed);
   }
 
+  // Set the link to x if it is still "expected".  Has release semantics
+  // on success, like SetNext().
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed);
+  }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
   std::atomic<Node*> next_[1];
@@ -180,9 +206,11 @@ struct SkipList<Key, Comparator>::Node {
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
-    const Key& key, int height) {
-  char* const node_memory = arena_->AllocateAligned(
-      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+    const Key& key, int height, bool concurrent) {
+  const size_t bytes = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+  char* const node_memory = concurrent
+                                ? arena_->AllocateAlignedConcurrently(bytes)
+                                : arena_->AllocateAligned(bytes);
   return new (node_memory) Node(key);
 }
 
@@ -240,10 +268,15 @@ inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
 
 template <typename Key, class Comparator>
 int SkipList<Key, Comparator>::RandomHeight() {
+  return RandomHeight(&rnd_);
+}
+
+template <typename Key, class Comparator>
+int SkipList<Key, Comparator>::RandomHeight(Random* rnd) {
   // Increase height with probability 1 in kBranching
   static const unsigned int kBranching = 4;
   int height = 1;
-  while (height < kMaxHeight && ((rnd_.Next() % kBranching) == 0)) {
+  while (height < kMaxHeight && ((rnd->Next() % kBranching) == 0)) {
     height++;
   }
   assert(height > 0);
@@ -321,6 +354,22 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::FindLast()
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key,
+                                                   Node* before, int level,
+                                                   Node** out_prev,
+                                                   Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (!KeyIsAfterNode(key, next)) {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+    before = next;
+  }
+}
+
 template <typename Key, class Comparator>
 SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
@@ -367,6 +416,53 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  // rnd_ belongs to Insert(); every inserting thread draws heights from
+  // its own generator instead.
+  static std::atomic<uint32_t> next_seed(0xdeadbeef);
+  thread_local Random rnd(next_seed.fetch_add(1, std::memory_order_relaxed));
+  const int height = RandomHeight(&rnd);
+
+  // Raise max_height_ first.  As in Insert(), readers that observe the new
+  // height before the new node is linked at the new levels just find
+  // nullptr links from head_ there.
+  int max_height = GetMaxHeight();
+  while (height > max_height) {
+    if (max_height_.compare_exchange_weak(max_height, height,
+                                          std::memory_order_relaxed)) {
+      max_height = height;
+      break;
+    }
+  }
+
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = head_;
+  for (int i = max_height - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+  // Link bottom-up, like Insert(), so that a node reachable at some level
+  // is reachable at every level below it.  A failed CAS means another
+  // node was linked after prev[i]; it sorts before "next[i]", so the
+  // splice can be recomputed starting from prev[i].
+  Node* x = NewNode(key, height, true /* concurrent */);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr);
@@ -6,6 +6,8 @@
 
 #include <atomic>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "leveldb/env.h"
@@ -365,6 +367,99 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads call InsertConcurrently() on the same list while a
+// reader checks that every scan it makes is in order.
+class ConcurrentInsertState {
+ public:
+  static const int kWriters = 4;
+  static const int kPerWriter = 20000;
+
+  ConcurrentInsertState()
+      : list_(Comparator(), &arena_),
+        done_(0),
+        quit_(false),
+        out_of_order_(false) {}
+
+  static void Writer(void* arg) {
+    auto* w = reinterpret_cast<std::pair<ConcurrentInsertState*, int>*>(arg);
+    ConcurrentInsertState* state = w->first;
+    // Writer "id" inserts every key equal to id modulo kWriters, in an
+    // order that interleaves with the other writers.
+    Random rnd(w->second + 301);
+    std::vector<Key> keys;
+    for (Key k = w->second; k < kWriters * kPerWriter; k += kWriters) {
+      keys.push_back(k);
+    }
+    for (size_t i = keys.size() - 1; i > 0; i--) {
+      std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+    }
+    for (Key k : keys) {
+      state->list_.InsertConcurrently(k);
+    }
+    state->done_.fetch_add(1, std::memory_order_release);
+  }
+
+  static void Reader(void* arg) {
+    ConcurrentInsertState* state =
+        reinterpret_cast<ConcurrentInsertState*>(arg);
+    while (!state->quit_.load(std::memory_order_acquire)) {
+      SkipList<Key, Comparator>::Iterator iter(&state->list_);
+      bool first = true;
+      Key last = 0;
+      for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+        if (!first && iter.key() <= last) {
+          state->out_of_order_.store(true, std::memory_order_relaxed);
+        }
+        first = false;
+        last = iter.key();
+      }
+    }
+    state->done_.fetch_add(1, std::memory_order_release);
+  }
+
+  Arena arena_;
+  SkipList<Key, Comparator> list_;
+  std::atomic<int> done_;
+  std::atomic<bool> quit_;
+  std::atomic<bool> out_of_order_;
+};
+
+TEST(SkipTest, ConcurrentInsert) {
+  ConcurrentInsertState state;
+  Env* env = Env::Default();
+  const int kWriters = ConcurrentInsertState::kWriters;
+  std::pair<ConcurrentInsertState*, int> writers[kWriters];
+  env->StartThread(&ConcurrentInsertState::Reader, &state);
+  for (int i = 0; i < kWriters; i++) {
+    writers[i] = std::make_pair(&state, i);
+    env->StartThread(&ConcurrentInsertState::Writer, &writers[i]);
+  }
+  while (state.done_.load(std::memory_order_acquire) < kWriters) {
+    env->SleepForMicroseconds(1000);
+  }
+  state.quit_.store(true, std::memory_order_release);
+  while (state.done_.load(std::memory_order_acquire) < kWriters + 1) {
+    env->SleepForMicroseconds(1000);
+  }
+  ASSERT_TRUE(!state.out_of_order_.load());
+
+  const Key kTotal = kWriters * ConcurrentInsertState::kPerWriter;
+  SkipList<Key, Comparator>::Iterator iter(&state.list_);
+  iter.SeekToFirst();
+  for (Key k = 0; k < kTotal; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  for (Key k = 0; k < kTotal; k += 97) {
+    ASSERT_TRUE(state.list_.Contains(k));
+    iter.Seek(k);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -0,0 +1,178 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Every entry of a plain file is stored with sequence number 0.  In a
+// multi-version file the versions of a key are numbered 0 (oldest) to n-1
+// (newest), since the multi-version key order only tells versions of a key
+// apart by sequence number.  DBImpl::IngestExternalFiles() offsets these
+// numbers when the data has to be ordered after existing data.
+
+#include "leveldb/sst_file_writer.h"
+
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+struct SstFileWriter::Rep {
+  explicit Rep(const Options& o)
+      : internal_comparator(o.comparator, o.multi_version),
+        internal_filter_policy(o.filter_policy),
+        options(o),
+        file(nullptr),
+        builder(nullptr),
+        file_size(0),
+        num_entries(0) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (o.filter_policy != nullptr) ? &internal_filter_policy : nullptr;
+  }
+
+  // Write the buffered versions of last_key, newest first.
+  void FlushVersions() {
+    for (size_t i = versions.size(); i > 0; i--) {
+      const PendingVersion& v = versions[i - 1];
+      builder->Add(MVInternalKey(last_key, i - 1, v.type, v.vt).Encode(),
+                   v.value);
+    }
+    versions.clear();
+  }
+
+  struct PendingVersion {
+    ValidTime vt;
+    ValueType type;
+    std::string value;
+  };
+
+  const InternalKeyComparator internal_comparator;
+  const InternalFilterPolicy internal_filter_policy;
+  Options options;  // options.comparator == &internal_comparator
+  WritableFile* file;
+  TableBuilder* builder;
+  uint64_t file_size;
+  uint64_t num_entries;
+  std::string last_key;  // User key of the last entry added
+
+  // Multi-version only: the versions of last_key, oldest first.  They are
+  // numbered once all of them are known.
+  std::vector<PendingVersion> versions;
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != nullptr) {
+    rep_->builder->Abandon();
+    delete rep_->builder;
+    delete rep_->file;
+  }
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  if (r->builder != nullptr) {
+    return Status::InvalidArgument("SstFileWriter is already open");
+  }
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (!s.ok()) {
+    return s;
+  }
+  r->builder = new TableBuilder(r->options, r->file);
+  r->file_size = 0;
+  r->num_entries = 0;
+  r->last_key.clear();
+  r->versions.clear();
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  return Add(key, 0, false, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return Add(key, 0, true, Slice(), false);
+}
+
+Status SstFileWriter::PutMV(const Slice& key, ValidTime vt,
+                            const Slice& value) {
+  return Add(key, vt, false, value, true);
+}
+
+Status SstFileWriter::DeleteMV(const Slice& key, ValidTime vt) {
+  return Add(key, vt, true, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, ValidTime vt, bool is_deletion,
+                          const Slice& value, bool multi_version) {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  if (multi_version != r->options.multi_version) {
+    return Status::InvalidArgument(
+        multi_version ? "PutMV/DeleteMV require options.multi_version"
+                      : "Put/Delete cannot be used with options.multi_version");
+  }
+  if (r->num_entries > 0) {
+    const int c =
+        r->internal_comparator.user_comparator()->Compare(key, r->last_key);
+    if (c < 0 || (c == 0 && (!multi_version || vt <= r->versions.back().vt))) {
+      return Status::InvalidArgument("keys must be added in sorted order",
+                                     key);
+    }
+    if (c > 0 && multi_version) {
+      r->FlushVersions();
+    }
+  }
+
+  const ValueType type = is_deletion ? kTypeDeletion : kTypeValue;
+  r->num_entries++;
+  r->last_key.assign(key.data(), key.size());
+  if (multi_version) {
+    Rep::PendingVersion v;
+    v.vt = vt;
+    v.type = type;
+    v.value.assign(value.data(), value.size());
+    r->versions.push_back(v);
+  } else {
+    r->builder->Add(InternalKey(key, 0, type).Encode(), value);
+  }
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  Status s;
+  if (r->num_entries == 0) {
+    r->builder->Abandon();
+    s = Status::InvalidArgument("cannot create a table with no entries");
+  } else {
+    r->FlushVersions();
+    s = r->builder->Finish();
+    if (s.ok()) {
+      r->file_size = r->builder->FileSize();
+      s = r->file->Sync();
+    }
+    if (s.ok()) {
+      s = r->file->Close();
+    }
+  }
+  delete r->builder;
+  delete r->file;
+  r->builder = nullptr;
+  r->file = nullptr;
+  return s;
+}
+
+uint64_t SstFileWriter::FileSize() const { return rep_->file_size; }
+
+}  // namespace leveldb
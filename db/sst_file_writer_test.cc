@@ -0,0 +1,230 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/db_impl.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+class SstFileWriterTest : public testing::Test {
+ public:
+  SstFileWriterTest() : env_(Env::Default()), db_(nullptr) {
+    dbname_ = testing::TempDir() + "sst_file_writer_test";
+    external_dir_ = testing::TempDir() + "sst_file_writer_test_external";
+    env_->CreateDir(external_dir_);
+  }
+
+  ~SstFileWriterTest() {
+    delete db_;
+    DestroyDB(dbname_, Options());
+    std::vector<std::string> children;
+    env_->GetChildren(external_dir_, &children);
+    for (const std::string& child : children) {
+      env_->RemoveFile(external_dir_ + "/" + child);
+    }
+    env_->RemoveDir(external_dir_);
+  }
+
+  void Open(bool multi_version) {
+    delete db_;
+    db_ = nullptr;
+    options_ = Options(multi_version);
+    options_.create_if_missing = true;
+    DestroyDB(dbname_, options_);
+    ASSERT_LEVELDB_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  void Reopen() {
+    delete db_;
+    db_ = nullptr;
+    ASSERT_LEVELDB_OK(DB::Open(options_, dbname_, &db_));
+  }
+
+  std::string ExternalFile(const std::string& name) {
+    return external_dir_ + "/" + name;
+  }
+
+  // Write "keys" (each mapped to "prefix" + key) to a new external file.
+  std::string WriteFile(const std::string& name,
+                        const std::vector<std::string>& keys,
+                        const std::string& prefix) {
+    std::string fname = ExternalFile(name);
+    SstFileWriter writer(options_);
+    EXPECT_LEVELDB_OK(writer.Open(fname));
+    for (const std::string& key : keys) {
+      EXPECT_LEVELDB_OK(writer.Put(key, prefix + key));
+    }
+    EXPECT_LEVELDB_OK(writer.Finish());
+    EXPECT_LT(0, writer.FileSize());
+    return fname;
+  }
+
+  Status Ingest(const std::vector<std::string>& files, bool move = false) {
+    IngestExternalFileOptions options;
+    options.move_files = move;
+    return db_->IngestExternalFiles(options, files);
+  }
+
+  std::string Get(const std::string& k, const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string result;
+    Status s = db_->Get(options, k, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
+  std::string GetMV(const std::string& k, ValidTime vt) {
+    ValidTimePeriod period(0, 0);
+    std::string result;
+    Status s = db_->GetMV(ReadOptions(), k, vt, &period, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
+  int NumTableFilesAtLevel(int level) {
+    std::string property;
+    EXPECT_TRUE(db_->GetProperty(
+        "leveldb.num-files-at-level" + std::to_string(level), &property));
+    return std::stoi(property);
+  }
+
+  Env* env_;
+  std::string dbname_;
+  std::string external_dir_;
+  Options options_;
+  DB* db_;
+};
+
+TEST_F(SstFileWriterTest, RejectsUnsortedKeys) {
+  Open(false);
+  SstFileWriter writer(options_);
+  ASSERT_LEVELDB_OK(writer.Open(ExternalFile("unsorted.ldb")));
+  ASSERT_LEVELDB_OK(writer.Put("b", "v"));
+  ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+  ASSERT_TRUE(writer.Put("b", "v").IsInvalidArgument());
+  ASSERT_TRUE(writer.PutMV("c", 1, "v").IsInvalidArgument());
+  ASSERT_LEVELDB_OK(writer.Delete("c"));
+  ASSERT_LEVELDB_OK(writer.Finish());
+
+  SstFileWriter empty(options_);
+  ASSERT_LEVELDB_OK(empty.Open(ExternalFile("empty.ldb")));
+  ASSERT_TRUE(empty.Finish().IsInvalidArgument());
+}
+
+TEST_F(SstFileWriterTest, IngestIntoEmptyDB) {
+  Open(false);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; i++) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    keys.push_back(buf);
+  }
+  std::string fname = WriteFile("1.ldb", keys, "v-");
+  ASSERT_LEVELDB_OK(Ingest({fname}));
+
+  // Nothing else overlaps, so the file goes to the bottom level as is.
+  ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+  ASSERT_TRUE(env_->FileExists(fname));
+  for (int i = 0; i < 1000; i += 37) {
+    ASSERT_EQ("v-" + keys[i], Get(keys[i]));
+  }
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+
+  // Later writes are ordered after the ingested data.
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), keys[5], "new"));
+  ASSERT_EQ("new", Get(keys[5]));
+  Reopen();
+  ASSERT_EQ("new", Get(keys[5]));
+  ASSERT_EQ("v-" + keys[6], Get(keys[6]));
+}
+
+TEST_F(SstFileWriterTest, IngestOverExistingData) {
+  Open(false);
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "a", "old-a"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "c", "old-c"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "z", "old-z"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+
+  // Overlaps the memtable, so it is flushed, and then the flushed table.
+  std::string fname = WriteFile("1.ldb", {"a", "b", "c"}, "new-");
+  ASSERT_LEVELDB_OK(Ingest({fname}));
+  ASSERT_EQ("new-a", Get("a"));
+  ASSERT_EQ("new-b", Get("b"));
+  ASSERT_EQ("new-c", Get("c"));
+  ASSERT_EQ("old-z", Get("z"));
+  ASSERT_EQ("old-a", Get("a", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get("b", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  ASSERT_LEVELDB_OK(db_->Delete(WriteOptions(), "b"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  Reopen();
+  ASSERT_EQ("new-a", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("new-c", Get("c"));
+  ASSERT_EQ("old-z", Get("z"));
+}
+
+TEST_F(SstFileWriterTest, IngestSeveralFiles) {
+  Open(false);
+  std::string f1 = WriteFile("1.ldb", {"a", "b"}, "1-");
+  std::string f2 = WriteFile("2.ldb", {"c", "d"}, "2-");
+  std::string f3 = WriteFile("3.ldb", {"b", "e"}, "3-");
+  ASSERT_TRUE(Ingest({f1, f3}).IsInvalidArgument());
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+
+  ASSERT_LEVELDB_OK(Ingest({f2, f1}, true /* move */));
+  ASSERT_TRUE(!env_->FileExists(f1));
+  ASSERT_TRUE(!env_->FileExists(f2));
+  ASSERT_EQ("1-a", Get("a"));
+  ASSERT_EQ("2-d", Get("d"));
+  ASSERT_EQ(2, NumTableFilesAtLevel(config::kNumLevels - 1));
+
+  ASSERT_TRUE(!Ingest({ExternalFile("missing.ldb")}).ok());
+}
+
+TEST_F(SstFileWriterTest, IngestMultiVersion) {
+  Open(true);
+  SstFileWriter writer(options_);
+  std::string fname = ExternalFile("mv.ldb");
+  ASSERT_LEVELDB_OK(writer.Open(fname));
+  ASSERT_TRUE(writer.Put("bar", "v").IsInvalidArgument());
+  ASSERT_LEVELDB_OK(writer.PutMV("bar", 100, "bar100"));
+  ASSERT_LEVELDB_OK(writer.PutMV("foo", 100, "foo100"));
+  ASSERT_LEVELDB_OK(writer.PutMV("foo", 200, "foo200"));
+  ASSERT_TRUE(writer.PutMV("foo", 150, "x").IsInvalidArgument());
+  ASSERT_LEVELDB_OK(writer.Finish());
+  ASSERT_LEVELDB_OK(Ingest({fname}));
+
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_EQ("bar100", GetMV("bar", 100));
+  ASSERT_EQ("foo100", GetMV("foo", 150));
+  ASSERT_EQ("foo200", GetMV("foo", 250));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -5,7 +5,9 @@
 #include "db/table_cache.h"
 
 #include "db/filename.h"
+#include "db/value_log.h"
 #include "leveldb/env.h"
+#include "leveldb/pinned_value.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
 
@@ -14,15 +16,32 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  size_t memory_usage;  // table->ApproximateMemoryUsage()
+  std::atomic<size_t>* open_tables;
+  std::atomic<size_t>* open_tables_memory;
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  tf->open_tables->fetch_sub(1, std::memory_order_relaxed);
+  tf->open_tables_memory->fetch_sub(tf->memory_usage,
+                                    std::memory_order_relaxed);
   delete tf->table;
   delete tf->file;
   delete tf;
 }
 
+static void DeleteValueLogEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+// Value log files are cached under their number prefixed with 'v', which
+// cannot collide with the 8-byte keys of the tables.
+static void EncodeValueLogKey(char* buf, uint64_t file_number) {
+  buf[0] = 'v';
+  EncodeFixed64(buf + 1, file_number);
+}
+
 static void UnrefEntry(void* arg1, void* arg2) {
   Cache* cache = reinterpret_cast<Cache*>(arg1);
   Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
@@ -34,6 +53,8 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
     : env_(options.env),
       dbname_(dbname),
       options_(options),
+      open_tables_(0),
+      open_tables_memory_(0),
       cache_(NewLRUCache(entries)) {}
 
 TableCache::~TableCache() { delete cache_; }
@@ -69,6 +90,12 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->memory_usage = table->ApproximateMemoryUsage();
+      tf->open_tables = &open_tables_;
+      tf->open_tables_memory = &open_tables_memory_;
+      open_tables_.fetch_add(1, std::memory_order_relaxed);
+      open_tables_memory_.fetch_add(tf->memory_usage,
+                                    std::memory_order_relaxed);
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
@@ -97,30 +124,71 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+void TableCache::ReleaseTable(Cache::Handle* handle, PinnedValue* pinned) {
+  if (pinned != nullptr) {
+    pinned->RegisterCleanup(&UnrefEntry, cache_, handle);
+  } else {
+    cache_->Release(handle);
+  }
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
-                                             const Slice&)) {
+                                             const Slice&),
+                       PinnedValue* pinned) {
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
-    cache_->Release(handle);
+    s = t->InternalGet(options, k, arg, handle_result, pinned);
+    ReleaseTable(handle, pinned);
   }
   return s;
 }
 
+void TableCache::MultiGet(const ReadOptions& options, uint64_t file_number,
+                          uint64_t file_size, const Slice* keys,
+                          void* const* args, size_t n,
+                          void (*handle_result)(void*, const Slice&,
+                                                const Slice&),
+                          Status* statuses) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    t->InternalMultiGet(options, keys, args, n, handle_result, statuses);
+    cache_->Release(handle);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      statuses[i] = s;
+    }
+  }
+}
+
+bool TableCache::PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                                const Slice& k) {
+  Cache::Handle* handle = nullptr;
+  if (!FindTable(file_number, file_size, &handle).ok()) {
+    return true;  // Let reading the table report the error
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  const bool may_match = t->PrefixMayMatch(k);
+  cache_->Release(handle);
+  return may_match;
+}
+
 Status TableCache::GetMV(const ReadOptions& options, uint64_t file_number,
                uint64_t file_size, const Slice& k, void* arg,
-               void (*handle_result)(void*, const Slice&, const ValidTimePeriod&, const Slice&)) {
+               void (*handle_result)(void*, const Slice&, const ValidTimePeriod&, const Slice&),
+               PinnedValue* pinned) {
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   // TODO
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGetMV(options, k, arg, handle_result);
-    cache_->Release(handle);
+    s = t->InternalGetMV(options, k, arg, handle_result, pinned);
+    ReleaseTable(handle, pinned);
   }
   return s;
 }
@@ -150,4 +218,44 @@ void TableCache::Evict(uint64_t file_number) {
   cache_->Erase(Slice(buf, sizeof(buf)));
 }
 
+Status TableCache::FindValueLog(uint64_t file_number, Cache::Handle** handle) {
+  Status s;
+  char buf[1 + sizeof(file_number)];
+  EncodeValueLogKey(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle == nullptr) {
+    RandomAccessFile* file = nullptr;
+    s = env_->NewRandomAccessFile(ValueLogFileName(dbname_, file_number),
+                                  &file);
+    if (s.ok()) {
+      *handle = cache_->Insert(key, file, 1, &DeleteValueLogEntry);
+    }
+  }
+  return s;
+}
+
+Status TableCache::GetValue(const Slice& value_index, std::string* value) {
+  ValueIndex index;
+  Status s = index.DecodeFrom(value_index);
+  if (!s.ok()) {
+    return s;
+  }
+  Cache::Handle* handle = nullptr;
+  s = FindValueLog(index.file_number, &handle);
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+    s = ReadValueLogRecord(file, index, value);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+void TableCache::EvictValueLog(uint64_t file_number) {
+  char buf[1 + sizeof(file_number)];
+  EncodeValueLogKey(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
 }  // namespace leveldb
@@ -7,6 +7,7 @@
 #ifndef STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 #define STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 
@@ -36,27 +37,74 @@ class TableCache {
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
+  //
+  // If "pinned" is non-null, the table and the block searched stay alive
+  // until *pinned is released, so found_value may be pinned in it.
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             PinnedValue* pinned = nullptr);
+
+  // Like Get() for each of the internal keys keys[0..n-1], which must be
+  // sorted, calling (*handle_result)(args[i], ...) for keys[i] and storing
+  // what Get() would return in statuses[i].
+  void MultiGet(const ReadOptions& options, uint64_t file_number,
+                uint64_t file_size, const Slice* keys, void* const* args,
+                size_t n,
+                void (*handle_result)(void*, const Slice&, const Slice&),
+                Status* statuses);
+
+  // Returns false if the filters of the specified file rule out any key
+  // at or after internal key "k" with the same prefix (see
+  // Table::PrefixMayMatch()).
+  bool PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                      const Slice& k);
+
   // MVLevelDB version
   Status GetMV(const ReadOptions& options, uint64_t file_number,
                uint64_t file_size, const Slice& k, void* arg,
-               void (*handle_result)(void*, const Slice&, const ValidTimePeriod&, const Slice&));
+               void (*handle_result)(void*, const Slice&, const ValidTimePeriod&, const Slice&),
+               PinnedValue* pinned = nullptr);
   // TODO
   Status GetMVRange(const ReadOptions& options, uint64_t file_number, SequenceNumber snapshot,
                     uint64_t file_size, const KeyList& key_list, const TimeRange& time_range,
                     ResultSet* result_set);
 
+  // Read the value in a value log file "value_index" (an encoded
+  // ValueIndex) refers to into *value.  Value log files share the cache
+  // with the tables.
+  Status GetValue(const Slice& value_index, std::string* value);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
+  // Evict any entry for the specified value log file number
+  void EvictValueLog(uint64_t file_number);
+
+  // Number of tables currently open, including tables that have been
+  // evicted but are still in use by iterators.
+  size_t NumOpenTables() const {
+    return open_tables_.load(std::memory_order_relaxed);
+  }
+
+  // Heap memory held by the open tables (see Table::ApproximateMemoryUsage).
+  size_t OpenTablesMemoryUsage() const {
+    return open_tables_memory_.load(std::memory_order_relaxed);
+  }
+
  private:
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindValueLog(uint64_t file_number, Cache::Handle**);
+
+  // Release "handle", or hand it to "pinned" to release once the value it
+  // holds has been released.
+  void ReleaseTable(Cache::Handle* handle, PinnedValue* pinned);
 
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
+  std::atomic<size_t> open_tables_;
+  std::atomic<size_t> open_tables_memory_;
   Cache* cache_;
 };
 
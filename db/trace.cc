@@ -0,0 +1,327 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Payload encodings, by record type:
+//    kTraceGet, kTraceDelete, kTraceIteratorSeek:
+//        key: length-prefixed
+//    kTracePut:
+//        key: length-prefixed, value: length-prefixed
+//    kTraceWrite, kTraceWriteMV:
+//        the batch contents, as stored in the log
+//    kTraceGetMV, kTraceDeleteMV:
+//        key: length-prefixed, valid_time: fixed64
+//    kTracePutMV:
+//        key: length-prefixed, valid_time: fixed64, value: length-prefixed
+//    kTraceGetMVRange:
+//        lo: fixed64, hi: fixed64, count: varint32, count length-prefixed keys
+//    kTraceIteratorSeekToFirst, kTraceIteratorSeekToLast:
+//        empty
+
+#include "db/trace.h"
+
+#include "db/log_reader.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/write_batch.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+namespace {
+
+const char kTraceMagic[] = "leveldb.trace.1";
+
+struct TraceCorruptionReporter : public log::Reader::Reporter {
+  void Corruption(size_t bytes, const Status& s) override {
+    if (status->ok()) *status = s;
+  }
+  Status* status;
+};
+
+// Return the concatenation of "parts", gathering them in *scratch if there
+// is more than one.
+Slice Flatten(const std::vector<Slice>& parts, std::string* scratch) {
+  if (parts.size() == 1) {
+    return parts[0];
+  }
+  for (const Slice& part : parts) {
+    scratch->append(part.data(), part.size());
+  }
+  return *scratch;
+}
+
+}  // namespace
+
+Tracer::Tracer(Env* env, WritableFile* file)
+    : env_(env),
+      file_(file),
+      writer_(file),
+      start_micros_(env->NowMicros()) {
+  writer_.AddRecord(Slice(kTraceMagic, sizeof(kTraceMagic) - 1));
+}
+
+Tracer::~Tracer() { Close(); }
+
+Status Tracer::Close() {
+  Status s;
+  if (file_ != nullptr) {
+    s = file_->Close();
+    delete file_;
+    file_ = nullptr;
+  }
+  return s;
+}
+
+Status Tracer::AddRecord(TraceType type, const Slice& payload) {
+  if (file_ == nullptr) {
+    return Status::IOError("trace file is closed");
+  }
+  record_.clear();
+  PutVarint64(&record_, env_->NowMicros() - start_micros_);
+  record_.push_back(static_cast<char>(type));
+  record_.append(payload.data(), payload.size());
+  return writer_.AddRecord(record_);
+}
+
+Status Tracer::Get(const Slice& key) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  return AddRecord(kTraceGet, payload);
+}
+
+Status Tracer::Put(const Slice& key, const Slice& value) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  PutLengthPrefixedSlice(&payload, value);
+  return AddRecord(kTracePut, payload);
+}
+
+Status Tracer::Delete(const Slice& key) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  return AddRecord(kTraceDelete, payload);
+}
+
+Status Tracer::Write(const WriteBatch* batch) {
+  std::vector<Slice> parts;
+  WriteBatchInternal::GetParts(batch, &parts);
+  std::string scratch;
+  return AddRecord(kTraceWrite, Flatten(parts, &scratch));
+}
+
+Status Tracer::GetMV(const Slice& key, ValidTime vt) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  PutFixed64(&payload, vt);
+  return AddRecord(kTraceGetMV, payload);
+}
+
+Status Tracer::PutMV(const Slice& key, ValidTime vt, const Slice& value) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  PutFixed64(&payload, vt);
+  PutLengthPrefixedSlice(&payload, value);
+  return AddRecord(kTracePutMV, payload);
+}
+
+Status Tracer::DeleteMV(const Slice& key, ValidTime vt) {
+  std::string payload;
+  PutLengthPrefixedSlice(&payload, key);
+  PutFixed64(&payload, vt);
+  return AddRecord(kTraceDeleteMV, payload);
+}
+
+Status Tracer::WriteMV(const WriteBatchMV* batch) {
+  std::vector<Slice> parts;
+  WriteBatchMVInternal::GetParts(batch, &parts);
+  std::string scratch;
+  return AddRecord(kTraceWriteMV, Flatten(parts, &scratch));
+}
+
+Status Tracer::GetMVRange(const KeyList& key_list,
+                          const TimeRange& time_range) {
+  std::string payload;
+  PutFixed64(&payload, time_range.lo);
+  PutFixed64(&payload, time_range.hi);
+  PutVarint32(&payload, static_cast<uint32_t>(key_list.size()));
+  for (const Slice& key : key_list) {
+    PutLengthPrefixedSlice(&payload, key);
+  }
+  return AddRecord(kTraceGetMVRange, payload);
+}
+
+Status Tracer::IteratorOp(TraceType type, const Slice& target) {
+  assert(type == kTraceIteratorSeek || type == kTraceIteratorSeekToFirst ||
+         type == kTraceIteratorSeekToLast);
+  std::string payload;
+  if (type == kTraceIteratorSeek) {
+    PutLengthPrefixedSlice(&payload, target);
+  }
+  return AddRecord(type, payload);
+}
+
+Status ReadTrace(Env* env, const std::string& fname,
+                 std::vector<TraceRecord>* records) {
+  records->clear();
+  SequentialFile* file;
+  Status s = env->NewSequentialFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+
+  TraceCorruptionReporter reporter;
+  reporter.status = &s;
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+  Slice record;
+  std::string scratch;
+  if (!reader.ReadRecord(&record, &scratch) ||
+      record != Slice(kTraceMagic, sizeof(kTraceMagic) - 1)) {
+    delete file;
+    return Status::Corruption(fname, "not a trace file");
+  }
+  while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+    TraceRecord r;
+    if (!GetVarint64(&record, &r.timestamp) || record.empty() ||
+        record[0] < kTraceGet || record[0] > kMaxTraceType) {
+      s = Status::Corruption(fname, "bad trace record");
+      break;
+    }
+    r.type = static_cast<TraceType>(record[0]);
+    r.payload.assign(record.data() + 1, record.size() - 1);
+    records->push_back(r);
+  }
+  delete file;
+  return s;
+}
+
+Status ReplayTraceRecord(DB* db, const TraceRecord& record) {
+  Slice input(record.payload);
+  Slice key, value;
+  uint64_t vt;
+  std::string result;
+  Status s;
+  switch (record.type) {
+    case kTraceGet:
+      if (!GetLengthPrefixedSlice(&input, &key)) break;
+      s = db->Get(ReadOptions(), key, &result);
+      return s.IsNotFound() ? Status::OK() : s;
+    case kTracePut:
+      if (!GetLengthPrefixedSlice(&input, &key) ||
+          !GetLengthPrefixedSlice(&input, &value)) {
+        break;
+      }
+      return db->Put(WriteOptions(), key, value);
+    case kTraceDelete:
+      if (!GetLengthPrefixedSlice(&input, &key)) break;
+      return db->Delete(WriteOptions(), key);
+    case kTraceWrite: {
+      if (input.size() < 12) break;
+      WriteBatch batch;
+      WriteBatchInternal::SetContents(&batch, input);
+      return db->Write(WriteOptions(), &batch);
+    }
+    case kTraceGetMV: {
+      if (!GetLengthPrefixedSlice(&input, &key) || !GetFixed64(&input, &vt)) {
+        break;
+      }
+      ValidTimePeriod period(0, 0);
+      s = db->GetMV(ReadOptions(), key, vt, &period, &result);
+      return s.IsNotFound() ? Status::OK() : s;
+    }
+    case kTracePutMV:
+      if (!GetLengthPrefixedSlice(&input, &key) || !GetFixed64(&input, &vt) ||
+          !GetLengthPrefixedSlice(&input, &value)) {
+        break;
+      }
+      return db->PutMV(WriteOptions(), key, vt, value);
+    case kTraceDeleteMV:
+      if (!GetLengthPrefixedSlice(&input, &key) || !GetFixed64(&input, &vt)) {
+        break;
+      }
+      return db->DeleteMV(WriteOptions(), key, vt);
+    case kTraceWriteMV: {
+      if (input.size() < 12) break;
+      WriteBatchMV batch;
+      WriteBatchMVInternal::SetContents(&batch, input);
+      return db->WriteMV(WriteOptions(), &batch);
+    }
+    case kTraceGetMVRange: {
+      uint64_t hi;
+      uint32_t count;
+      if (!GetFixed64(&input, &vt) || !GetFixed64(&input, &hi) ||
+          !GetVarint32(&input, &count)) {
+        break;
+      }
+      KeyList key_list;
+      while (key_list.size() < count && GetLengthPrefixedSlice(&input, &key)) {
+        key_list.push_back(key);
+      }
+      if (key_list.size() != count) break;
+      ResultSet result_set;
+      s = db->GetMVRange(ReadOptions(), key_list, TimeRange(vt, hi),
+                         &result_set);
+      return s.IsNotFound() ? Status::OK() : s;
+    }
+    case kTraceIteratorSeek:
+    case kTraceIteratorSeekToFirst:
+    case kTraceIteratorSeekToLast: {
+      if (record.type == kTraceIteratorSeek &&
+          !GetLengthPrefixedSlice(&input, &key)) {
+        break;
+      }
+      Iterator* iter = db->NewIterator(ReadOptions());
+      if (record.type == kTraceIteratorSeek) {
+        iter->Seek(key);
+      } else if (record.type == kTraceIteratorSeekToFirst) {
+        iter->SeekToFirst();
+      } else {
+        iter->SeekToLast();
+      }
+      if (iter->Valid()) {
+        // Touch the value so that the block holding it is read.
+        iter->value();
+      }
+      s = iter->status();
+      delete iter;
+      return s;
+    }
+  }
+  return Status::Corruption("bad trace record payload",
+                            TraceTypeName(record.type));
+}
+
+const char* TraceTypeName(TraceType type) {
+  switch (type) {
+    case kTraceGet:
+      return "get";
+    case kTracePut:
+      return "put";
+    case kTraceDelete:
+      return "delete";
+    case kTraceWrite:
+      return "write";
+    case kTraceGetMV:
+      return "get(mv)";
+    case kTracePutMV:
+      return "put(mv)";
+    case kTraceDeleteMV:
+      return "delete(mv)";
+    case kTraceWriteMV:
+      return "write(mv)";
+    case kTraceGetMVRange:
+      return "getrange(mv)";
+    case kTraceIteratorSeek:
+      return "seek";
+    case kTraceIteratorSeekToFirst:
+      return "seektofirst";
+    case kTraceIteratorSeekToLast:
+      return "seektolast";
+  }
+  return "unknown";
+}
+
+}  // namespace leveldb
@@ -0,0 +1,111 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Workload traces.  A Tracer records the operations issued against a DB
+// (with the time at which each one was issued) into a file, and the trace
+// can later be read back and re-issued against another DB to reproduce the
+// workload.  See ../doc/index.md for how to capture a trace.
+//
+// A trace file uses the log format (see log_format.h).  The first record is
+// a header holding kTraceMagic; every following record is
+//    timestamp: varint64   (microseconds since the trace was started)
+//    type:      uint8      (TraceType)
+//    payload:   type-specific, see trace.cc
+
+#ifndef STORAGE_LEVELDB_DB_TRACE_H_
+#define STORAGE_LEVELDB_DB_TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "db/log_writer.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class DB;
+class Env;
+class WritableFile;
+class WriteBatch;
+class WriteBatchMV;
+
+enum TraceType {
+  kTraceGet = 1,
+  kTracePut = 2,
+  kTraceDelete = 3,
+  kTraceWrite = 4,
+  kTraceGetMV = 5,
+  kTracePutMV = 6,
+  kTraceDeleteMV = 7,
+  kTraceWriteMV = 8,
+  kTraceGetMVRange = 9,
+  kTraceIteratorSeek = 10,
+  kTraceIteratorSeekToFirst = 11,
+  kTraceIteratorSeekToLast = 12
+};
+static const int kMaxTraceType = kTraceIteratorSeekToLast;
+
+// A single traced operation.
+struct TraceRecord {
+  uint64_t timestamp;  // Microseconds since the start of the trace
+  TraceType type;
+  std::string payload;
+};
+
+// Appends operations to a trace file.
+//
+// Not thread-safe: callers must provide external synchronization.
+class Tracer {
+ public:
+  // Takes ownership of "file", which must be empty.
+  Tracer(Env* env, WritableFile* file);
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  ~Tracer();
+
+  Status Get(const Slice& key);
+  Status Put(const Slice& key, const Slice& value);
+  Status Delete(const Slice& key);
+  Status Write(const WriteBatch* batch);
+  Status GetMV(const Slice& key, ValidTime vt);
+  Status PutMV(const Slice& key, ValidTime vt, const Slice& value);
+  Status DeleteMV(const Slice& key, ValidTime vt);
+  Status WriteMV(const WriteBatchMV* batch);
+  Status GetMVRange(const KeyList& key_list, const TimeRange& time_range);
+
+  // "target" is only used for kTraceIteratorSeek.
+  Status IteratorOp(TraceType type, const Slice& target);
+
+  // Flush and close the trace file.  Later calls to the methods above
+  // return an error.
+  Status Close();
+
+ private:
+  Status AddRecord(TraceType type, const Slice& payload);
+
+  Env* const env_;
+  WritableFile* file_;
+  log::Writer writer_;
+  const uint64_t start_micros_;
+  std::string record_;  // Scratch buffer reused across records
+};
+
+// Read every record of the trace stored in "fname" into *records.
+Status ReadTrace(Env* env, const std::string& fname,
+                 std::vector<TraceRecord>* records);
+
+// Re-issue the operation described by "record" against "db".  Lookups of
+// absent keys are not treated as errors.
+Status ReplayTraceRecord(DB* db, const TraceRecord& record);
+
+// Returns a short human readable name for "type", e.g. "get".
+const char* TraceTypeName(TraceType type);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_TRACE_H_
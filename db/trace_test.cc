@@ -0,0 +1,171 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/trace.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/write_batch.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+class TraceTest : public testing::Test {
+ public:
+  TraceTest() : env_(Env::Default()), db_(nullptr), replay_db_(nullptr) {
+    dbname_ = testing::TempDir() + "trace_test";
+    replay_dbname_ = testing::TempDir() + "trace_test_replay";
+    trace_file_ = testing::TempDir() + "trace_test.trace";
+  }
+
+  ~TraceTest() {
+    delete db_;
+    delete replay_db_;
+    DestroyDB(dbname_, Options());
+    DestroyDB(replay_dbname_, Options());
+    env_->RemoveFile(trace_file_);
+  }
+
+  void Open(bool multi_version) {
+    Options options(multi_version);
+    options.create_if_missing = true;
+    DestroyDB(dbname_, options);
+    DestroyDB(replay_dbname_, options);
+    ASSERT_LEVELDB_OK(DB::Open(options, dbname_, &db_));
+    ASSERT_LEVELDB_OK(DB::Open(options, replay_dbname_, &replay_db_));
+  }
+
+  // Replay every record of the trace against replay_db_.
+  void Replay(const std::vector<TraceRecord>& records) {
+    for (const TraceRecord& record : records) {
+      ASSERT_LEVELDB_OK(ReplayTraceRecord(replay_db_, record));
+    }
+  }
+
+  std::string Get(DB* db, const std::string& k) {
+    std::string result;
+    Status s = db->Get(ReadOptions(), k, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
+  Env* env_;
+  std::string dbname_;
+  std::string replay_dbname_;
+  std::string trace_file_;
+  DB* db_;
+  DB* replay_db_;
+};
+
+TEST_F(TraceTest, RecordAndReplay) {
+  Open(false);
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "untraced", "v0"));
+  ASSERT_LEVELDB_OK(db_->StartTrace(trace_file_));
+  ASSERT_TRUE(db_->StartTrace(trace_file_).IsInvalidArgument());
+
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "a", "v1"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "b", "v2"));
+  ASSERT_EQ("v1", Get(db_, "a"));
+  ASSERT_LEVELDB_OK(db_->Delete(WriteOptions(), "b"));
+  WriteBatch batch;
+  batch.Put("c", "v3");
+  batch.Put("d", "v4");
+  batch.Delete("a");
+  ASSERT_LEVELDB_OK(db_->Write(WriteOptions(), &batch));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek("c");
+  iter->SeekToFirst();
+  iter->SeekToLast();
+  iter->Next();
+  delete iter;
+
+  ASSERT_LEVELDB_OK(db_->EndTrace());
+  ASSERT_TRUE(db_->EndTrace().IsInvalidArgument());
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "e", "untraced"));
+
+  std::vector<TraceRecord> records;
+  ASSERT_LEVELDB_OK(ReadTrace(env_, trace_file_, &records));
+  const TraceType kExpected[] = {kTracePut,
+                                 kTracePut,
+                                 kTraceGet,
+                                 kTraceDelete,
+                                 kTraceWrite,
+                                 kTraceIteratorSeek,
+                                 kTraceIteratorSeekToFirst,
+                                 kTraceIteratorSeekToLast};
+  ASSERT_EQ(sizeof(kExpected) / sizeof(kExpected[0]), records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    ASSERT_EQ(kExpected[i], records[i].type) << i;
+    if (i > 0) {
+      ASSERT_LE(records[i - 1].timestamp, records[i].timestamp);
+    }
+  }
+
+  Replay(records);
+  ASSERT_EQ("NOT_FOUND", Get(replay_db_, "untraced"));
+  ASSERT_EQ("NOT_FOUND", Get(replay_db_, "a"));
+  ASSERT_EQ("NOT_FOUND", Get(replay_db_, "b"));
+  ASSERT_EQ("v3", Get(replay_db_, "c"));
+  ASSERT_EQ("v4", Get(replay_db_, "d"));
+  ASSERT_EQ("NOT_FOUND", Get(replay_db_, "e"));
+}
+
+TEST_F(TraceTest, RecordAndReplayMV) {
+  Open(true);
+  ASSERT_LEVELDB_OK(db_->StartTrace(trace_file_));
+  ASSERT_LEVELDB_OK(db_->PutMV(WriteOptions(), "k1", 10, "v10"));
+  ASSERT_LEVELDB_OK(db_->PutMV(WriteOptions(), "k1", 20, "v20"));
+  WriteBatchMV batch;
+  batch.Put("k2", 15, "w15");
+  ASSERT_LEVELDB_OK(db_->WriteMV(WriteOptions(), &batch));
+  ASSERT_LEVELDB_OK(db_->DeleteMV(WriteOptions(), "k2", 30));
+  ValidTimePeriod period(0, 0);
+  std::string value;
+  ASSERT_LEVELDB_OK(db_->GetMV(ReadOptions(), "k1", 15, &period, &value));
+  KeyList keys;
+  keys.push_back("k1");
+  keys.push_back("k2");
+  ResultSet result_set;
+  db_->GetMVRange(ReadOptions(), keys, TimeRange(0, 25), &result_set);
+  ASSERT_LEVELDB_OK(db_->EndTrace());
+
+  std::vector<TraceRecord> records;
+  ASSERT_LEVELDB_OK(ReadTrace(env_, trace_file_, &records));
+  const TraceType kExpected[] = {kTracePutMV,    kTracePutMV, kTraceWriteMV,
+                                 kTraceDeleteMV, kTraceGetMV, kTraceGetMVRange};
+  ASSERT_EQ(sizeof(kExpected) / sizeof(kExpected[0]), records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    ASSERT_EQ(kExpected[i], records[i].type) << i;
+  }
+
+  Replay(records);
+  ReadOptions options;
+  ASSERT_LEVELDB_OK(replay_db_->GetMV(options, "k1", 15, &period, &value));
+  ASSERT_EQ("v10", value);
+  ASSERT_LEVELDB_OK(replay_db_->GetMV(options, "k1", 25, &period, &value));
+  ASSERT_EQ("v20", value);
+  ASSERT_LEVELDB_OK(replay_db_->GetMV(options, "k2", 20, &period, &value));
+  ASSERT_EQ("w15", value);
+}
+
+TEST_F(TraceTest, NotATrace) {
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, "not a trace", trace_file_));
+  std::vector<TraceRecord> records;
+  ASSERT_TRUE(ReadTrace(env_, trace_file_, &records).IsCorruption());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/value_log.h"
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void ValueIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+Status ValueIndex::DecodeFrom(const Slice& input) {
+  Slice in = input;
+  if (GetVarint64(&in, &file_number) && GetVarint64(&in, &offset) &&
+      GetVarint64(&in, &size) && in.empty()) {
+    return Status::OK();
+  }
+  return Status::Corruption("bad value log index");
+}
+
+Status ReadValueLogRecord(RandomAccessFile* file, const ValueIndex& index,
+                          std::string* value) {
+  const size_t n = static_cast<size_t>(index.record_size());
+  value->resize(n);
+  Slice contents;
+  Status s = file->Read(index.offset, n, &contents, &(*value)[0]);
+  if (!s.ok()) {
+    return s;
+  }
+  if (contents.size() != n) {
+    return Status::Corruption("truncated value log record");
+  }
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data()));
+  const char* data = contents.data() + kValueLogHeaderSize;
+  if (crc32c::Value(data, index.size) != crc) {
+    return Status::Corruption("value log checksum mismatch");
+  }
+  if (contents.data() == value->data()) {
+    value->erase(0, kValueLogHeaderSize);
+  } else {
+    value->assign(data, index.size);
+  }
+  return s;
+}
+
+ValueLogBuilder::ValueLogBuilder(const std::string& dbname,
+                                 const Options& options, uint64_t number)
+    : env_(options.env),
+      fname_(ValueLogFileName(dbname, number)),
+      number_(number),
+      threshold_(options.value_log_threshold),
+      file_(nullptr),
+      num_entries_(0),
+      file_size_(0),
+      closed_(false) {}
+
+ValueLogBuilder::~ValueLogBuilder() {
+  if (!closed_) {
+    Abandon();
+  }
+}
+
+Status ValueLogBuilder::Add(const Slice& value, std::string* index) {
+  assert(!closed_);
+  if (!status_.ok()) {
+    return status_;
+  }
+  if (file_ == nullptr) {
+    status_ = env_->NewWritableFile(fname_, &file_);
+    if (!status_.ok()) {
+      return status_;
+    }
+  }
+
+  char header[kValueLogHeaderSize];
+  const uint32_t crc = crc32c::Value(value.data(), value.size());
+  EncodeFixed32(header, crc32c::Mask(crc));
+  status_ = file_->Append(Slice(header, sizeof(header)));
+  if (status_.ok()) {
+    status_ = file_->Append(value);
+  }
+  if (status_.ok()) {
+    ValueIndex vi;
+    vi.file_number = number_;
+    vi.offset = file_size_;
+    vi.size = value.size();
+    index->clear();
+    vi.EncodeTo(index);
+    num_entries_++;
+    file_size_ += vi.record_size();
+  }
+  return status_;
+}
+
+Status ValueLogBuilder::Finish() {
+  assert(!closed_);
+  closed_ = true;
+  if (file_ == nullptr) {
+    return status_;
+  }
+  if (status_.ok()) {
+    status_ = file_->Sync();
+  }
+  if (status_.ok()) {
+    status_ = file_->Close();
+  }
+  delete file_;
+  file_ = nullptr;
+  if (!status_.ok()) {
+    env_->RemoveFile(fname_);
+  }
+  return status_;
+}
+
+void ValueLogBuilder::Abandon() {
+  closed_ = true;
+  if (file_ != nullptr) {
+    file_->Close();
+    delete file_;
+    file_ = nullptr;
+    env_->RemoveFile(fname_);
+  }
+}
+
+}  // namespace leveldb
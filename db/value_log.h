@@ -0,0 +1,105 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Value log files hold large values outside of the tables (see
+// Options::value_log_threshold), so that compactions only have to move
+// their locations around instead of rewriting them.  A table refers to
+// such a value with a kTypeValueIndex entry whose value is an encoded
+// ValueIndex.
+//
+// A value log file is written by a single memtable flush or compaction
+// and never modified afterwards.  It is a sequence of records:
+//    checksum: uint32     // masked crc32c of value; little-endian
+//    value:    uint8[size]
+// The manifest records the size of each value log file and how many of its
+// bytes belong to records no table refers to any more.  Once that is all
+// of them, the file is deleted.
+
+#ifndef STORAGE_LEVELDB_DB_VALUE_LOG_H_
+#define STORAGE_LEVELDB_DB_VALUE_LOG_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class RandomAccessFile;
+class WritableFile;
+
+// Size of the header preceding each value in a value log file.
+static const int kValueLogHeaderSize = 4;
+
+// Location of a value in a value log file.
+struct ValueIndex {
+  uint64_t file_number;
+  uint64_t offset;  // Offset of the record holding the value
+  uint64_t size;    // Size of the value
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(const Slice& input);
+
+  // Bytes of the value log file taken up by the value's record.
+  uint64_t record_size() const { return kValueLogHeaderSize + size; }
+};
+
+// Read the value "index" refers to from "file", the value log file
+// index.file_number, into *value.
+Status ReadValueLogRecord(RandomAccessFile* file, const ValueIndex& index,
+                          std::string* value);
+
+// Appends values to a new value log file.  The file is only created once
+// the first value is added.
+class ValueLogBuilder {
+ public:
+  ValueLogBuilder(const std::string& dbname, const Options& options,
+                  uint64_t number);
+
+  ValueLogBuilder(const ValueLogBuilder&) = delete;
+  ValueLogBuilder& operator=(const ValueLogBuilder&) = delete;
+
+  // Abandons the file unless Finish() has been called.
+  ~ValueLogBuilder();
+
+  // Return true iff values of "size" bytes belong in the value log.
+  bool ShouldStore(size_t size) const {
+    return threshold_ > 0 && size >= threshold_;
+  }
+
+  // Append "value" and store the encoding of its ValueIndex in *index.
+  Status Add(const Slice& value, std::string* index);
+
+  // Sync and close the file, if it was created.
+  Status Finish();
+
+  // Close and delete the file, if it was created.
+  void Abandon();
+
+  uint64_t number() const { return number_; }
+
+  // Number of values added.
+  uint64_t NumEntries() const { return num_entries_; }
+
+  // Size of the file.
+  uint64_t FileSize() const { return file_size_; }
+
+ private:
+  Env* const env_;
+  const std::string fname_;
+  const uint64_t number_;
+  const size_t threshold_;
+  WritableFile* file_;
+  Status status_;
+  uint64_t num_entries_;
+  uint64_t file_size_;
+  bool closed_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_VALUE_LOG_H_
@@ -0,0 +1,141 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/value_log.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+class ValueLogTest : public testing::Test {
+ public:
+  ValueLogTest() : env_(Env::Default()) {
+    dbname_ = testing::TempDir() + "value_log_test";
+    env_->CreateDir(dbname_);
+    options_.env = env_;
+    options_.value_log_threshold = 100;
+  }
+
+  ~ValueLogTest() {
+    env_->RemoveFile(ValueLogFileName(dbname_, 1));
+    env_->RemoveDir(dbname_);
+  }
+
+  // Read the value "index" refers to, or the error reading it.
+  std::string Read(const std::string& index) {
+    ValueIndex vi;
+    Status s = vi.DecodeFrom(index);
+    RandomAccessFile* file = nullptr;
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(ValueLogFileName(dbname_, vi.file_number),
+                                    &file);
+    }
+    std::string value;
+    if (s.ok()) {
+      s = ReadValueLogRecord(file, vi, &value);
+    }
+    delete file;
+    return s.ok() ? value : s.ToString();
+  }
+
+  Env* const env_;
+  std::string dbname_;
+  Options options_;
+};
+
+TEST_F(ValueLogTest, ShouldStore) {
+  ValueLogBuilder builder(dbname_, options_, 1);
+  ASSERT_TRUE(!builder.ShouldStore(99));
+  ASSERT_TRUE(builder.ShouldStore(100));
+
+  options_.value_log_threshold = 0;
+  ValueLogBuilder disabled(dbname_, options_, 1);
+  ASSERT_TRUE(!disabled.ShouldStore(1 << 20));
+}
+
+TEST_F(ValueLogTest, AddAndRead) {
+  std::vector<std::string> values, indexes;
+  ValueLogBuilder builder(dbname_, options_, 1);
+  for (int i = 0; i < 10; i++) {
+    values.push_back(std::string(100 + i * 50, 'a' + i));
+    std::string index;
+    ASSERT_LEVELDB_OK(builder.Add(values.back(), &index));
+    indexes.push_back(index);
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+  ASSERT_EQ(10, builder.NumEntries());
+
+  uint64_t file_size;
+  ASSERT_LEVELDB_OK(
+      env_->GetFileSize(ValueLogFileName(dbname_, 1), &file_size));
+  ASSERT_EQ(builder.FileSize(), file_size);
+
+  uint64_t record_bytes = 0;
+  for (size_t i = 0; i < values.size(); i++) {
+    ValueIndex vi;
+    ASSERT_LEVELDB_OK(vi.DecodeFrom(indexes[i]));
+    ASSERT_EQ(1, vi.file_number);
+    ASSERT_EQ(record_bytes, vi.offset);
+    record_bytes += vi.record_size();
+    ASSERT_EQ(values[i], Read(indexes[i]));
+  }
+  ASSERT_EQ(file_size, record_bytes);
+}
+
+TEST_F(ValueLogTest, NoFileWithoutValues) {
+  ValueLogBuilder builder(dbname_, options_, 1);
+  ASSERT_LEVELDB_OK(builder.Finish());
+  ASSERT_EQ(0, builder.NumEntries());
+  ASSERT_TRUE(!env_->FileExists(ValueLogFileName(dbname_, 1)));
+}
+
+TEST_F(ValueLogTest, AbandonRemovesFile) {
+  {
+    ValueLogBuilder builder(dbname_, options_, 1);
+    std::string index;
+    ASSERT_LEVELDB_OK(builder.Add(std::string(200, 'x'), &index));
+    ASSERT_TRUE(env_->FileExists(ValueLogFileName(dbname_, 1)));
+    // Destroyed without being finished
+  }
+  ASSERT_TRUE(!env_->FileExists(ValueLogFileName(dbname_, 1)));
+}
+
+TEST_F(ValueLogTest, DetectsCorruption) {
+  std::string index;
+  {
+    ValueLogBuilder builder(dbname_, options_, 1);
+    ASSERT_LEVELDB_OK(builder.Add(std::string(200, 'x'), &index));
+    ASSERT_LEVELDB_OK(builder.Finish());
+  }
+
+  // Flip a byte of the value.
+  const std::string fname = ValueLogFileName(dbname_, 1);
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, fname, &contents));
+  contents[kValueLogHeaderSize + 10] ^= 0x1;
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, contents, fname));
+  ASSERT_NE(std::string::npos, Read(index).find("checksum mismatch"));
+
+  // Truncate the file.
+  contents[kValueLogHeaderSize + 10] ^= 0x1;
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, contents.substr(0, 100), fname));
+  ASSERT_NE(std::string(200, 'x'), Read(index));
+
+  ValueIndex vi;
+  ASSERT_TRUE(vi.DecodeFrom(index + "x").IsCorruption());
+  ASSERT_TRUE(vi.DecodeFrom(Slice(index.data(), 1)).IsCorruption());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
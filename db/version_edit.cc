@@ -20,7 +20,9 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewValueLog = 10,
+  kValueLogGarbage = 11
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +38,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_value_logs_.clear();
+  value_log_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -81,6 +85,18 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
   }
+
+  for (const auto& value_log : new_value_logs_) {
+    PutVarint32(dst, kNewValueLog);
+    PutVarint64(dst, value_log.first);   // file number
+    PutVarint64(dst, value_log.second);  // file size
+  }
+
+  for (const auto& garbage : value_log_garbage_) {
+    PutVarint32(dst, kValueLogGarbage);
+    PutVarint64(dst, garbage.first);   // file number
+    PutVarint64(dst, garbage.second);  // bytes
+  }
 }
 
 static bool GetInternalKey(Slice* input, InternalKey* dst) {
@@ -111,6 +127,7 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   // Temporary storage for parsing
   int level;
   uint64_t number;
+  uint64_t bytes;
   FileMetaData f;
   Slice str;
   InternalKey key;
@@ -185,6 +202,22 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewValueLog:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          new_value_logs_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "new value log entry";
+        }
+        break;
+
+      case kValueLogGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          value_log_garbage_[number] += bytes;
+        } else {
+          msg = "value log garbage";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -250,6 +283,18 @@ std::string VersionEdit::DebugString() const {
     r.append(" .. ");
     r.append(f.largest.DebugString());
   }
+  for (const auto& value_log : new_value_logs_) {
+    r.append("\n  AddValueLog: ");
+    AppendNumberTo(&r, value_log.first);
+    r.append(" ");
+    AppendNumberTo(&r, value_log.second);
+  }
+  for (const auto& garbage : value_log_garbage_) {
+    r.append("\n  ValueLogGarbage: ");
+    AppendNumberTo(&r, garbage.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage.second);
+  }
   r.append("\n}\n");
   return r;
 }
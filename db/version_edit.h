@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -31,6 +32,14 @@ struct FileMetaData {
   ValidTime end_time;
 };
 
+// A value log file (see value_log.h).
+struct ValueLogMetaData {
+  ValueLogMetaData() : file_size(0), garbage_bytes(0) {}
+
+  uint64_t file_size;      // File size in bytes
+  uint64_t garbage_bytes;  // Bytes of records no table refers to
+};
+
 class VersionEdit {
  public:
   VersionEdit() { Clear(); }
@@ -97,6 +106,17 @@ class VersionEdit {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the specified value log file.
+  void AddValueLog(uint64_t file, uint64_t file_size) {
+    new_value_logs_.push_back(std::make_pair(file, file_size));
+  }
+
+  // Record that tables no longer refer to "bytes" more bytes of records
+  // in the specified value log file.
+  void AddValueLogGarbage(uint64_t file, uint64_t bytes) {
+    value_log_garbage_[file] += bytes;
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -121,6 +141,8 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<std::pair<uint64_t, uint64_t>> new_value_logs_;
+  std::map<uint64_t, uint64_t> value_log_garbage_;
 };
 
 }  // namespace leveldb
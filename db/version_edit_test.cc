@@ -38,6 +38,19 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeValueLogs) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    edit.AddValueLog(kBig + 100 + i, kBig + 200 + i);
+    edit.AddValueLogGarbage(kBig + 300 + i, kBig + 400 + i);
+    TestEncodeDecode(edit);
+  }
+  edit.AddValueLogGarbage(kBig + 300, 1);
+  TestEncodeDecode(edit);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <iterator>
 
 #include "db/filename.h"
 #include "db/log_reader.h"
@@ -13,6 +14,7 @@
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/pinned_value.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
@@ -219,11 +221,27 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
   }
 }
 
+static bool FilePrefixMayMatch(void* arg, const ReadOptions& options,
+                               const Slice& file_value, const Slice& target) {
+  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  if (file_value.size() != 16) {
+    return true;  // GetFileIterator() reports the corruption
+  }
+  return cache->PrefixMayMatch(DecodeFixed64(file_value.data()),
+                               DecodeFixed64(file_value.data() + 8), target);
+}
+
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
+  // In prefix-seek mode, a seek skips the file its target falls into if
+  // the filters rule out the prefix of the target, and with it the rest
+  // of the level.
+  const bool prefix_seek =
+      options.prefix_seek && vset_->options_->prefix_extractor != nullptr;
   return NewTwoLevelIterator(
       new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      vset_->table_cache_, options,
+      prefix_seek ? &FilePrefixMayMatch : nullptr);
 }
 
 void Version::AddIterators(const ReadOptions& options,
@@ -258,6 +276,8 @@ struct Saver {
   Slice user_key;
   ValidTimePeriod* period;
   std::string* value;
+  PinnedValue* pinned;  // If non-null, used instead of value
+  bool value_index;  // The value is the location of the value in a value log
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -267,9 +287,14 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeDeletion) ? kDeleted : kFound;
       if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+        s->value_index = (parsed_key.type == kTypeValueIndex);
+        if (s->pinned != nullptr) {
+          s->pinned->PinSlice(v);
+        } else {
+          s->value->assign(v.data(), v.size());
+        }
       }
     }
   }
@@ -286,7 +311,11 @@ static void SaveValueMV(void* arg, const Slice& ikey, const ValidTimePeriod& per
       if (s->state == kFound) {
         s->period->lo = period.lo;
         s->period->hi = period.hi;
-        s->value->assign(v.data(), v.size());
+        if (s->pinned != nullptr) {
+          s->pinned->PinSlice(v);
+        } else {
+          s->value->assign(v.data(), v.size());
+        }
       }
     }
   }
@@ -386,6 +415,17 @@ void Version::ForEachOverlappingMVRange(const KeyList& key_list, const TimeRange
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
                     std::string* value, GetStats* stats) {
+  return GetImpl(options, k, value, nullptr, stats);
+}
+
+Status Version::Get(const ReadOptions& options, const LookupKey& k,
+                    PinnedValue* value, GetStats* stats) {
+  return GetImpl(options, k, nullptr, value, stats);
+}
+
+Status Version::GetImpl(const ReadOptions& options, const LookupKey& k,
+                        std::string* value, PinnedValue* pinned,
+                        GetStats* stats) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
 
@@ -414,9 +454,15 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
+      PinnedValue* pinned = state->saver.pinned;
       state->s = state->vset->table_cache_->Get(*state->options, f->number,
                                                 f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+                                                &state->saver, SaveValue,
+                                                pinned);
+      if (pinned != nullptr &&
+          (!state->s.ok() || state->saver.state != kFound)) {
+        pinned->Reset();  // Do not keep the block pinned
+      }
       if (!state->s.ok()) {
         state->found = true;
         return false;
@@ -456,10 +502,177 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.pinned = pinned;
+  state.saver.value_index = false;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
-  return state.found ? state.s : Status::NotFound(Slice());
+  if (!state.found) {
+    return Status::NotFound(Slice());
+  }
+  if (state.s.ok() && state.saver.value_index) {
+    std::string index;
+    if (pinned != nullptr) {
+      index = pinned->ToString();
+      pinned->Reset();
+      state.s = vset_->table_cache_->GetValue(index, pinned->GetSelf());
+      pinned->PinSelf();
+    } else {
+      index.swap(*value);
+      state.s = vset_->table_cache_->GetValue(index, value);
+    }
+  }
+  return state.s;
+}
+
+void Version::MultiGet(const ReadOptions& options,
+                       std::vector<KeyLookup>* lookups) {
+  struct State {
+    const ReadOptions* options;
+    VersionSet* vset;
+    std::vector<KeyLookup>* lookups;
+    std::vector<Saver> savers;
+    std::vector<FileMetaData*> last_file_read;
+    std::vector<int> last_file_read_level;
+    std::vector<bool> done;
+
+    // Look up the keys of lookups[batch[0..]] in "f".
+    void Search(int level, FileMetaData* f, const std::vector<size_t>& batch) {
+      std::vector<Slice> ikeys;
+      std::vector<void*> args;
+      for (size_t i : batch) {
+        GetStats* stats = &(*lookups)[i].stats;
+        if (stats->seek_file == nullptr && last_file_read[i] != nullptr) {
+          // We have had more than one seek for this read.  Charge the 1st
+          // file.
+          stats->seek_file = last_file_read[i];
+          stats->seek_file_level = last_file_read_level[i];
+        }
+        last_file_read[i] = f;
+        last_file_read_level[i] = level;
+        ikeys.push_back((*lookups)[i].key->internal_key());
+        args.push_back(&savers[i]);
+      }
+
+      std::vector<Status> statuses(batch.size());
+      vset->table_cache_->MultiGet(*options, f->number, f->file_size,
+                                   ikeys.data(), args.data(), batch.size(),
+                                   SaveValue, statuses.data());
+      for (size_t j = 0; j < batch.size(); j++) {
+        const size_t i = batch[j];
+        Status* status = (*lookups)[i].status;
+        if (!statuses[j].ok()) {
+          *status = statuses[j];
+          done[i] = true;
+          continue;
+        }
+        switch (savers[i].state) {
+          case kNotFound:
+            break;  // Keep searching in other files
+          case kFound:
+            *status = Status::OK();
+            done[i] = true;
+            break;
+          case kDeleted:
+            *status = Status::NotFound(Slice());
+            done[i] = true;
+            break;
+          case kCorrupt:
+            *status = Status::Corruption("corrupted key for ",
+                                         savers[i].user_key);
+            done[i] = true;
+            break;
+        }
+      }
+    }
+  };
+
+  const size_t n = lookups->size();
+  State state;
+  state.options = &options;
+  state.vset = vset_;
+  state.lookups = lookups;
+  state.savers.resize(n);
+  state.last_file_read.assign(n, nullptr);
+  state.last_file_read_level.assign(n, -1);
+  state.done.assign(n, false);
+  for (size_t i = 0; i < n; i++) {
+    KeyLookup* lookup = &(*lookups)[i];
+    lookup->stats.seek_file = nullptr;
+    lookup->stats.seek_file_level = -1;
+    Saver* saver = &state.savers[i];
+    saver->state = kNotFound;
+    saver->ucmp = vset_->icmp_.user_comparator();
+    saver->user_key = lookup->key->user_key();
+    saver->value = lookup->value;
+    saver->pinned = nullptr;
+    saver->value_index = false;
+  }
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  // Search level-0 in order from newest to oldest, looking each file up
+  // for the keys in its range.
+  std::vector<FileMetaData*> tmp(files_[0]);
+  std::sort(tmp.begin(), tmp.end(), NewestFirst);
+  std::vector<size_t> batch;
+  for (FileMetaData* f : tmp) {
+    batch.clear();
+    for (size_t i = 0; i < n; i++) {
+      const Slice user_key = state.savers[i].user_key;
+      if (!state.done[i] &&
+          ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+          ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        batch.push_back(i);
+      }
+    }
+    if (!batch.empty()) {
+      state.Search(0, f, batch);
+    }
+  }
+
+  // Search other levels.  The keys are sorted, so those in the same file
+  // are next to each other.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    size_t num_files = files_[level].size();
+    if (num_files == 0) continue;
+
+    batch.clear();
+    FileMetaData* batch_file = nullptr;
+    for (size_t i = 0; i < n; i++) {
+      if (state.done[i]) continue;
+      // Binary search to find earliest index whose largest key >= the key.
+      uint32_t index = FindFile(vset_->icmp_, files_[level],
+                                (*lookups)[i].key->internal_key());
+      if (index >= num_files) {
+        break;  // The remaining keys are past the end of the level
+      }
+      FileMetaData* f = files_[level][index];
+      if (ucmp->Compare(state.savers[i].user_key, f->smallest.user_key()) <
+          0) {
+        continue;  // All of "f" is past any data for the key
+      }
+      if (f != batch_file && !batch.empty()) {
+        state.Search(level, batch_file, batch);
+        batch.clear();
+      }
+      batch_file = f;
+      batch.push_back(i);
+    }
+    if (!batch.empty()) {
+      state.Search(level, batch_file, batch);
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    KeyLookup* lookup = &(*lookups)[i];
+    if (!state.done[i]) {
+      *lookup->status = Status::NotFound(Slice());
+    } else if (lookup->status->ok() && state.savers[i].value_index) {
+      std::string index;
+      index.swap(*lookup->value);
+      *lookup->status = vset_->table_cache_->GetValue(index, lookup->value);
+    }
+  }
 }
 
 Status Version::GetMV(const ReadOptions& options,
@@ -467,6 +680,18 @@ Status Version::GetMV(const ReadOptions& options,
                       std::string* value,
                       ValidTimePeriod* period,
                       GetStats* stats) {
+  return GetMVImpl(options, k, value, nullptr, period, stats);
+}
+
+Status Version::GetMV(const ReadOptions& options, const MVLookupKey& k,
+                      PinnedValue* value, ValidTimePeriod* period,
+                      GetStats* stats) {
+  return GetMVImpl(options, k, nullptr, value, period, stats);
+}
+
+Status Version::GetMVImpl(const ReadOptions& options, const MVLookupKey& k,
+                          std::string* value, PinnedValue* pinned,
+                          ValidTimePeriod* period, GetStats* stats) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
 
@@ -495,9 +720,15 @@ Status Version::GetMV(const ReadOptions& options,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
+      PinnedValue* pinned = state->saver.pinned;
       state->s = state->vset->table_cache_->GetMV(*state->options, f->number,
                                                 f->file_size, state->ikey,
-                                                &state->saver, SaveValueMV);
+                                                &state->saver, SaveValueMV,
+                                                pinned);
+      if (pinned != nullptr &&
+          (!state->s.ok() || state->saver.state != kFound)) {
+        pinned->Reset();  // Do not keep the block pinned
+      }
       if (!state->s.ok()) {
         state->found = true;
         return false;
@@ -539,6 +770,7 @@ Status Version::GetMV(const ReadOptions& options,
   state.saver.user_key = k.user_key();
   state.saver.period = period;
   state.saver.value = value;
+  state.saver.pinned = pinned;
 
   ForEachOverlappingMV(state.saver.user_key, k.valid_time(), state.ikey, &state, &State::Match);
 
@@ -774,6 +1006,21 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!value_logs_.empty()) {
+    // E.g.,
+    //   --- value logs ---
+    //   18:4096[1024 garbage]
+    r.append("--- value logs ---\n");
+    for (const auto& value_log : value_logs_) {
+      r.push_back(' ');
+      AppendNumberTo(&r, value_log.first);
+      r.push_back(':');
+      AppendNumberTo(&r, value_log.second.file_size);
+      r.append("[");
+      AppendNumberTo(&r, value_log.second.garbage_bytes);
+      r.append(" garbage]\n");
+    }
+  }
   return r;
 }
 
@@ -789,7 +1036,8 @@ class VersionSet::Builder {
     bool operator()(FileMetaData* f1, FileMetaData* f2) const {
       // MVLevelDB
       int r = 0;
-      if (!f1->smallest_mv.user_key().empty()) {
+      // Only files written in multi-version mode carry smallest_mv.
+      if (!f1->smallest_mv.empty() && !f2->smallest_mv.empty()) {
         r = internal_comparator->Compare(f1->smallest_mv, f2->smallest_mv);
       } else {
         r = internal_comparator->Compare(f1->smallest, f2->smallest);
@@ -812,10 +1060,12 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, ValueLogMetaData> value_logs_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), value_logs_(base->value_logs_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -886,10 +1136,28 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new value logs and account for their garbage
+    for (const auto& value_log : edit->new_value_logs_) {
+      value_logs_[value_log.first].file_size = value_log.second;
+    }
+    for (const auto& garbage : edit->value_log_garbage_) {
+      auto it = value_logs_.find(garbage.first);
+      if (it != value_logs_.end()) {
+        it->second.garbage_bytes += garbage.second;
+      }
+    }
   }
 
   // Save the current state in *v.
   void SaveTo(Version* v) {
+    // Drop value logs no table refers to any more
+    for (const auto& value_log : value_logs_) {
+      if (value_log.second.garbage_bytes < value_log.second.file_size) {
+        v->value_logs_.insert(value_log);
+      }
+    }
+
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
     for (int level = 0; level < config::kNumLevels; level++) {
@@ -1007,7 +1275,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   }
 
   edit->SetNextFile(next_file_number_);
-  edit->SetLastSequence(last_sequence_);
+  edit->SetLastSequence(LastSequence());
 
   Version* v = new Version(this);
   {
@@ -1193,7 +1461,7 @@ Status VersionSet::Recover(bool* save_manifest) {
     AppendVersion(v);
     manifest_file_number_ = next_file;
     next_file_number_ = next_file + 1;
-    last_sequence_ = last_sequence;
+    last_sequence_.store(last_sequence, std::memory_order_release);
     log_number_ = log_number;
     prev_log_number_ = prev_log_number;
 
@@ -1285,6 +1553,23 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Level-0 files past the compaction trigger are merged with all of
+  // level-1.  Every other level is compacted into the next one until it
+  // fits its limit, rewriting about ten times its excess there as well.
+  uint64_t debt = 0;
+  if (v->files_[0].size() >= config::kL0_CompactionTrigger) {
+    debt += TotalFileSize(v->files_[0]) + TotalFileSize(v->files_[1]);
+  }
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files_[level]);
+    const uint64_t max_bytes =
+        static_cast<uint64_t>(MaxBytesForLevel(options_, level));
+    if (level_bytes > max_bytes) {
+      debt += (level_bytes - max_bytes) * 11;
+    }
+  }
+  v->compaction_debt_ = debt;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1312,6 +1597,15 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     }
   }
 
+  // Save value logs
+  for (const auto& value_log : current_->value_logs_) {
+    edit.AddValueLog(value_log.first, value_log.second.file_size);
+    if (value_log.second.garbage_bytes > 0) {
+      edit.AddValueLogGarbage(value_log.first,
+                              value_log.second.garbage_bytes);
+    }
+  }
+
   std::string record;
   edit.EncodeTo(&record);
   return log->AddRecord(record);
@@ -1376,7 +1670,22 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& value_log : v->value_logs_) {
+      live->insert(value_log.first);
+    }
+  }
+}
+
+uint64_t VersionSet::ValueLogGCCutoff(double fraction) const {
+  const std::map<uint64_t, ValueLogMetaData>& value_logs =
+      current_->value_logs_;
+  const size_t count = static_cast<size_t>(value_logs.size() * fraction);
+  if (count == 0) {
+    return 0;
   }
+  auto it = value_logs.begin();
+  std::advance(it, count - 1);
+  return it->first;
 }
 
 int64_t VersionSet::NumLevelBytes(int level) const {
@@ -15,6 +15,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
@@ -33,6 +34,7 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class PinnedValue;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -74,9 +76,31 @@ class Version {
 
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
+
+  // Like Get(), but leaves the value in the table block it was found in,
+  // pinned by *val.
+  Status Get(const ReadOptions&, const LookupKey& key, PinnedValue* val,
+             GetStats* stats);
+
+  // One of the keys looked up by MultiGet().
+  struct KeyLookup {
+    const LookupKey* key;
+    std::string* value;
+    Status* status;
+    GetStats stats;
+  };
+
+  // Do what Get() does for each element of *lookups, which must be sorted
+  // by user key, storing its result in *status.  The keys are looked up
+  // level by level, and those that fall into the same table are looked up
+  // in one pass over it.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, std::vector<KeyLookup>* lookups);
   // MVLevelDB version
   Status GetMV(const ReadOptions&, const MVLookupKey& key, std::string* value,
                ValidTimePeriod* period, GetStats* stats);
+  Status GetMV(const ReadOptions&, const MVLookupKey& key, PinnedValue* value,
+               ValidTimePeriod* period, GetStats* stats);
   Status GetMVRange(const ReadOptions&, SequenceNumber snapshot, const KeyList& key_list,
                     const TimeRange& time_range, ResultSet* result_set,
                     GetStats* stats);
@@ -134,7 +158,8 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        compaction_debt_(0) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -143,6 +168,14 @@ class Version {
 
   Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
+  // Implement Get() and GetMV(), storing the value in whichever of *value
+  // and *pinned is non-null.
+  Status GetImpl(const ReadOptions&, const LookupKey& key, std::string* value,
+                 PinnedValue* pinned, GetStats* stats);
+  Status GetMVImpl(const ReadOptions&, const MVLookupKey& key,
+                   std::string* value, PinnedValue* pinned,
+                   ValidTimePeriod* period, GetStats* stats);
+
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
   // false, makes no more calls.
@@ -175,6 +208,13 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Estimated number of bytes compactions have to write before no level
+  // needs compacting.  Initialized by Finalize().
+  uint64_t compaction_debt_;
+
+  // Value log files still referred to by some table, by file number.
+  std::map<uint64_t, ValueLogMetaData> value_logs_;
 };
 
 class VersionSet {
@@ -221,13 +261,16 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
-  // Return the last sequence number.
-  uint64_t LastSequence() const { return last_sequence_; }
+  // Return the last sequence number.  May be called without holding the
+  // lock; the writes up to the returned number are then visible.
+  uint64_t LastSequence() const {
+    return last_sequence_.load(std::memory_order_acquire);
+  }
 
   // Set the last sequence number to s.
   void SetLastSequence(uint64_t s) {
-    assert(s >= last_sequence_);
-    last_sequence_ = s;
+    assert(s >= LastSequence());
+    last_sequence_.store(s, std::memory_order_release);
   }
 
   // Mark the specified file number as used.
@@ -261,6 +304,18 @@ class VersionSet {
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
 
+  // Return an estimate of the bytes compactions have to write to bring
+  // every level of the current version within its size limit.
+  uint64_t EstimatedCompactionDebt() const {
+    return current_->compaction_debt_;
+  }
+
+  // Return the number of the newest value log file among the oldest
+  // "fraction" of the current version's value log files, or zero if there
+  // is no such file.  Compactions move the values in use from these files
+  // to new ones.
+  uint64_t ValueLogGCCutoff(double fraction) const;
+
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
@@ -313,7 +368,7 @@ class VersionSet {
   const InternalKeyComparator icmp_;
   uint64_t next_file_number_;
   uint64_t manifest_file_number_;
-  uint64_t last_sequence_;
+  std::atomic<uint64_t> last_sequence_;
   uint64_t log_number_;
   uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
@@ -12,6 +12,12 @@
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
+//
+// A batch need not hold all of these bytes itself.  Values added with
+// PutRef() and batches appended with AppendRef() stay where they are, and
+// refs_ records where in rep_ they belong, so that the batch's contents
+// are a list of slices (see WriteBatchInternal::GetParts()).  A reference
+// is only ever placed between two fields, so no field spans two slices.
 
 #include "leveldb/write_batch.h"
 
@@ -28,6 +34,128 @@ namespace leveldb {
 // WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
 static const size_t kHeader = 12;
 
+// Values and batches smaller than this are copied rather than referred to,
+// since copying them costs about as much as keeping track of a reference.
+static const size_t kMinRefSize = 512;
+
+namespace {
+
+typedef std::vector<std::pair<size_t, Slice>> Refs;
+
+size_t RefBytes(const Refs& refs) {
+  size_t bytes = 0;
+  for (const auto& ref : refs) {
+    bytes += ref.second.size();
+  }
+  return bytes;
+}
+
+// Append the non-empty slices that make up the contents of a batch from
+// offset "start" of "rep" onwards to *parts.
+void AddParts(const std::string& rep, const Refs& refs, size_t start,
+              std::vector<Slice>* parts) {
+  for (const auto& ref : refs) {
+    if (ref.first > start) {
+      parts->emplace_back(rep.data() + start, ref.first - start);
+    }
+    if (!ref.second.empty()) {
+      parts->push_back(ref.second);
+    }
+    start = ref.first;
+  }
+  if (rep.size() > start) {
+    parts->emplace_back(rep.data() + start, rep.size() - start);
+  }
+}
+
+// Refer to the records of "src_rep" and "src_refs" from *dst_refs, placing
+// them at offset "offset" of the destination's rep.
+void AddRefs(const std::string& src_rep, const Refs& src_refs, size_t offset,
+             Refs* dst_refs) {
+  std::vector<Slice> parts;
+  AddParts(src_rep, src_refs, kHeader, &parts);
+  for (const Slice& part : parts) {
+    dst_refs->emplace_back(offset, part);
+  }
+}
+
+// Reads the fields of the records of a batch, skipping over the boundaries
+// between its slices.
+class RecordReader {
+ public:
+  RecordReader(const std::string& rep, const Refs& refs)
+      : rep_(rep),
+        refs_(refs),
+        next_ref_(0),
+        in_rep_(true),
+        input_(rep.data() + kHeader,
+               (refs.empty() ? rep.size() : refs[0].first) - kHeader) {}
+
+  bool empty() {
+    NextPart();
+    return input_.empty();
+  }
+
+  char GetTag() {
+    NextPart();
+    char tag = input_[0];
+    input_.remove_prefix(1);
+    return tag;
+  }
+
+  bool GetLengthPrefixedSlice(Slice* result) {
+    NextPart();
+    uint32_t len;
+    if (!GetVarint32(&input_, &len)) {
+      return false;
+    }
+    if (len > 0) {
+      NextPart();
+    }
+    if (input_.size() < len) {
+      return false;
+    }
+    *result = Slice(input_.data(), len);
+    input_.remove_prefix(len);
+    return true;
+  }
+
+  bool GetFixed64(uint64_t* value) {
+    NextPart();
+    return leveldb::GetFixed64(&input_, value);
+  }
+
+ private:
+  // Move on to the next non-empty slice once the current one is used up.
+  void NextPart() {
+    while (input_.empty()) {
+      if (in_rep_) {
+        if (next_ref_ == refs_.size()) {
+          return;
+        }
+        input_ = refs_[next_ref_].second;
+        in_rep_ = false;
+      } else {
+        const size_t start = refs_[next_ref_].first;
+        next_ref_++;
+        const size_t limit = next_ref_ < refs_.size()
+                                 ? refs_[next_ref_].first
+                                 : rep_.size();
+        input_ = Slice(rep_.data() + start, limit - start);
+        in_rep_ = true;
+      }
+    }
+  }
+
+  const std::string& rep_;
+  const Refs& refs_;
+  size_t next_ref_;  // The reference following the current rep_ bytes
+  bool in_rep_;      // Whether input_ holds rep_ bytes
+  Slice input_;
+};
+
+}  // namespace
+
 WriteBatch::WriteBatch() { Clear(); }
 
 WriteBatch::~WriteBatch() = default;
@@ -37,34 +165,35 @@ WriteBatch::Handler::~Handler() = default;
 void WriteBatch::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
+  refs_.clear();
 }
 
-size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+size_t WriteBatch::ApproximateSize() const {
+  return WriteBatchInternal::ByteSize(this);
+}
 
 Status WriteBatch::Iterate(Handler* handler) const {
-  Slice input(rep_);
-  if (input.size() < kHeader) {
+  if (rep_.size() < kHeader) {
     return Status::Corruption("malformed WriteBatch (too small)");
   }
 
-  input.remove_prefix(kHeader);
+  RecordReader input(rep_, refs_);
   Slice key, value;
   int found = 0;
   while (!input.empty()) {
     found++;
-    char tag = input[0];
-    input.remove_prefix(1);
+    char tag = input.GetTag();
     switch (tag) {
       case kTypeValue:
-        if (GetLengthPrefixedSlice(&input, &key) &&
-            GetLengthPrefixedSlice(&input, &value)) {
+        if (input.GetLengthPrefixedSlice(&key) &&
+            input.GetLengthPrefixedSlice(&value)) {
           handler->Put(key, value);
         } else {
           return Status::Corruption("bad WriteBatch Put");
         }
         break;
       case kTypeDeletion:
-        if (GetLengthPrefixedSlice(&input, &key)) {
+        if (input.GetLengthPrefixedSlice(&key)) {
           handler->Delete(key);
         } else {
           return Status::Corruption("bad WriteBatch Delete");
@@ -104,6 +233,18 @@ void WriteBatch::Put(const Slice& key, const Slice& value) {
   PutLengthPrefixedSlice(&rep_, value);
 }
 
+void WriteBatch::PutRef(const Slice& key, const Slice& value) {
+  if (value.size() < kMinRefSize) {
+    Put(key, value);
+    return;
+  }
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeValue));
+  PutLengthPrefixedSlice(&rep_, key);
+  PutVarint32(&rep_, value.size());
+  refs_.emplace_back(rep_.size(), value);
+}
+
 void WriteBatch::Delete(const Slice& key) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
   rep_.push_back(static_cast<char>(kTypeDeletion));
@@ -119,13 +260,22 @@ class MemTableInserter : public WriteBatch::Handler {
  public:
   SequenceNumber sequence_;
   MemTable* mem_;
+  bool concurrent_ = false;
 
   void Put(const Slice& key, const Slice& value) override {
-    mem_->Add(sequence_, kTypeValue, key, value);
-    sequence_++;
+    Add(kTypeValue, key, value);
   }
   void Delete(const Slice& key) override {
-    mem_->Add(sequence_, kTypeDeletion, key, Slice());
+    Add(kTypeDeletion, key, Slice());
+  }
+
+ private:
+  void Add(ValueType type, const Slice& key, const Slice& value) {
+    if (concurrent_) {
+      mem_->AddConcurrently(sequence_, type, key, value);
+    } else {
+      mem_->Add(sequence_, type, key, value);
+    }
     sequence_++;
   }
 };
@@ -134,13 +284,23 @@ class MemTableInserter : public WriteBatch::Handler {
   public:
    SequenceNumber sequence_;
    MemTable* mem_;
+   bool concurrent_ = false;
 
    void Put(const Slice& key, ValidTime vt, const Slice& value) override {
-     mem_->AddMV(sequence_, kTypeValue, key, vt, value);
-     sequence_++;
+     Add(kTypeValue, key, vt, value);
    }
    void Delete(const Slice& key, ValidTime vt) override {
-     mem_->AddMV(sequence_, kTypeDeletion, key, vt, Slice());
+     Add(kTypeDeletion, key, vt, Slice());
+   }
+
+  private:
+   void Add(ValueType type, const Slice& key, ValidTime vt,
+            const Slice& value) {
+     if (concurrent_) {
+       mem_->AddMVConcurrently(sequence_, type, key, vt, value);
+     } else {
+       mem_->AddMV(sequence_, type, key, vt, value);
+     }
      sequence_++;
    }
  };
@@ -153,17 +313,49 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable) {
   return b->Iterate(&inserter);
 }
 
+Status WriteBatchInternal::InsertConcurrentlyInto(const WriteBatch* b,
+                                                  MemTable* memtable) {
+  MemTableInserter inserter;
+  inserter.sequence_ = WriteBatchInternal::Sequence(b);
+  inserter.mem_ = memtable;
+  inserter.concurrent_ = true;
+  return b->Iterate(&inserter);
+}
+
+void WriteBatchInternal::GetParts(const WriteBatch* b,
+                                  std::vector<Slice>* parts) {
+  AddParts(b->rep_, b->refs_, 0, parts);
+}
+
+size_t WriteBatchInternal::ByteSize(const WriteBatch* b) {
+  return b->rep_.size() + RefBytes(b->refs_);
+}
+
 void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
   assert(contents.size() >= kHeader);
   b->rep_.assign(contents.data(), contents.size());
+  b->refs_.clear();
 }
 
 void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
   SetCount(dst, Count(dst) + Count(src));
   assert(src->rep_.size() >= kHeader);
+  const size_t offset = dst->rep_.size() - kHeader;
+  for (const auto& ref : src->refs_) {
+    dst->refs_.emplace_back(offset + ref.first, ref.second);
+  }
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
+void WriteBatchInternal::AppendRef(WriteBatch* dst, const WriteBatch* src) {
+  if (src->rep_.size() < kMinRefSize) {
+    Append(dst, src);
+    return;
+  }
+  SetCount(dst, Count(dst) + Count(src));
+  AddRefs(src->rep_, src->refs_, dst->rep_.size(), &dst->refs_);
+}
+
 // MVLevelDB implementations of internal functions to setup WriteBatch
 Status WriteBatchMVInternal::InsertInto(const WriteBatchMV* b, MemTable* memtable) {
   MemTableMVInsertor inserter;
@@ -172,17 +364,50 @@ Status WriteBatchMVInternal::InsertInto(const WriteBatchMV* b, MemTable* memtabl
   return b->Iterate(&inserter);
 }
 
+Status WriteBatchMVInternal::InsertConcurrentlyInto(const WriteBatchMV* b,
+                                                    MemTable* memtable) {
+  MemTableMVInsertor inserter;
+  inserter.sequence_ = WriteBatchMVInternal::Sequence(b);
+  inserter.mem_ = memtable;
+  inserter.concurrent_ = true;
+  return b->Iterate(&inserter);
+}
+
+void WriteBatchMVInternal::GetParts(const WriteBatchMV* b,
+                                    std::vector<Slice>* parts) {
+  AddParts(b->rep_, b->refs_, 0, parts);
+}
+
+size_t WriteBatchMVInternal::ByteSize(const WriteBatchMV* b) {
+  return b->rep_.size() + RefBytes(b->refs_);
+}
+
 void WriteBatchMVInternal::SetContents(WriteBatchMV* b, const Slice& contents) {
   assert(contents.size() >= kHeader);
   b->rep_.assign(contents.data(), contents.size());
+  b->refs_.clear();
 }
 
 void WriteBatchMVInternal::Append(WriteBatchMV* dst, const WriteBatchMV* src) {
   SetCount(dst, Count(dst) + Count(src));
   assert(src->rep_.size() >= kHeader);
+  const size_t offset = dst->rep_.size() - kHeader;
+  for (const auto& ref : src->refs_) {
+    dst->refs_.emplace_back(offset + ref.first, ref.second);
+  }
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
+void WriteBatchMVInternal::AppendRef(WriteBatchMV* dst,
+                                     const WriteBatchMV* src) {
+  if (src->rep_.size() < kMinRefSize) {
+    Append(dst, src);
+    return;
+  }
+  SetCount(dst, Count(dst) + Count(src));
+  AddRefs(src->rep_, src->refs_, dst->rep_.size(), &dst->refs_);
+}
+
 
 // MVLevelDB
 // WriteBatchMV::rep_ :=
@@ -202,37 +427,36 @@ WriteBatchMV::Handler::~Handler() = default;
 void WriteBatchMV::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
+  refs_.clear();
 }
 
-size_t WriteBatchMV::ApproximateSize() const { return rep_.size(); }
+size_t WriteBatchMV::ApproximateSize() const {
+  return WriteBatchMVInternal::ByteSize(this);
+}
 
 Status WriteBatchMV::Iterate(Handler* handler) const {
-  Slice input(rep_);
-  if (input.size() < kHeader) {
+  if (rep_.size() < kHeader) {
     return Status::Corruption("malformed WriteBatchMV (too small)");
   }
 
-  input.remove_prefix(kHeader);
+  RecordReader input(rep_, refs_);
   Slice key, value;
   ValidTime vt;
   int found = 0;
   while (!input.empty()) {
     found++;
-    char tag = input[0];
-    input.remove_prefix(1);
+    char tag = input.GetTag();
     switch (tag) {
       case kTypeValue:
-        if (GetLengthPrefixedSlice(&input, &key) &&
-            GetFixed64(&input, &vt) &&
-            GetLengthPrefixedSlice(&input, &value)) {
+        if (input.GetLengthPrefixedSlice(&key) && input.GetFixed64(&vt) &&
+            input.GetLengthPrefixedSlice(&value)) {
           handler->Put(key, vt, value);
         } else {
           return Status::Corruption("bad WriteBatchMV Put");
         }
         break;
       case kTypeDeletion:
-        if (GetLengthPrefixedSlice(&input, &key) &&
-            GetFixed64(&input, &vt)) {
+        if (input.GetLengthPrefixedSlice(&key) && input.GetFixed64(&vt)) {
           handler->Delete(key, vt);
         } else {
           return Status::Corruption("bad WriteBatchMV Delete");
@@ -274,6 +498,21 @@ void WriteBatchMV::Put(const Slice& key, const ValidTime vt, const Slice& value)
   PutLengthPrefixedSlice(&rep_, value);
 }
 
+void WriteBatchMV::PutRef(const Slice& key, const ValidTime vt,
+                          const Slice& value) {
+  if (value.size() < kMinRefSize) {
+    Put(key, vt, value);
+    return;
+  }
+  WriteBatchMVInternal::SetCount(this,
+                                 WriteBatchMVInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeValue));
+  PutLengthPrefixedSlice(&rep_, key);
+  PutFixed64(&rep_, vt);
+  PutVarint32(&rep_, value.size());
+  refs_.emplace_back(rep_.size(), value);
+}
+
 void WriteBatchMV::Delete(const Slice& key, const ValidTime vt) {
   WriteBatchMVInternal::SetCount(this,
                                  WriteBatchMVInternal::Count(this) + 1);
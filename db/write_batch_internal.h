@@ -5,6 +5,9 @@
 #ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
+#include <cassert>
+#include <vector>
+
 #include "db/dbformat.h"
 
 #include "leveldb/write_batch.h"
@@ -30,15 +33,35 @@ class WriteBatchInternal {
   // this batch.
   static void SetSequence(WriteBatch* batch, SequenceNumber seq);
 
-  static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
+  // REQUIRES: The batch does not refer to bytes it does not hold (see
+  // GetParts()).
+  static Slice Contents(const WriteBatch* batch) {
+    assert(batch->refs_.empty());
+    return Slice(batch->rep_);
+  }
+
+  // Append the slices that make up the contents of the batch to *parts, in
+  // order.  Unlike Contents(), this works for batches built with PutRef()
+  // or AppendRef().
+  static void GetParts(const WriteBatch* batch, std::vector<Slice>* parts);
 
-  static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
+  static size_t ByteSize(const WriteBatch* batch);
 
   static void SetContents(WriteBatch* batch, const Slice& contents);
 
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
+  // Like InsertInto(), but may run at the same time as other
+  // InsertConcurrentlyInto() calls on the same memtable.
+  static Status InsertConcurrentlyInto(const WriteBatch* batch,
+                                       MemTable* memtable);
+
   static void Append(WriteBatch* dst, const WriteBatch* src);
+
+  // Like Append(), but "dst" may refer to the contents of "src" instead of
+  // copying them, so "src" must stay unchanged until "dst" has been
+  // written, cleared or destroyed.
+  static void AppendRef(WriteBatch* dst, const WriteBatch* src);
 };
 
 class WriteBatchMVInternal {
@@ -49,14 +72,17 @@ class WriteBatchMVInternal {
   static void SetSequence(WriteBatchMV* batch, SequenceNumber seq);
 
   static Slice Contents(const WriteBatchMV* batch) {
+    assert(batch->refs_.empty());
     return Slice(batch->rep_);
   }
-  static size_t ByteSize(const WriteBatchMV* batch) {
-    return batch->rep_.size();
-  }
+  static void GetParts(const WriteBatchMV* batch, std::vector<Slice>* parts);
+  static size_t ByteSize(const WriteBatchMV* batch);
   static void SetContents(WriteBatchMV* batch, const Slice& contents);
   static Status InsertInto(const WriteBatchMV* batch, MemTable* memtable);
+  static Status InsertConcurrentlyInto(const WriteBatchMV* batch,
+                                       MemTable* memtable);
   static void Append(WriteBatchMV* dst, const WriteBatchMV* src);
+  static void AppendRef(WriteBatchMV* dst, const WriteBatchMV* src);
 };
 
 }  // namespace leveldb
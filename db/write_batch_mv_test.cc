@@ -44,6 +44,12 @@ static std::string PrintContents(WriteBatchMV* b) {
         state.append(")");
         count++;
         break;
+      case kTypeValueIndex:
+        // Not counted: batches never hold value indexes.
+        state.append("ValueIndex(");
+        state.append(ikey.user_key.ToString());
+        state.append(")");
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
@@ -141,6 +147,34 @@ TEST(WriteBatchMVTest, Append) {
       PrintContents(&b1));
 }
 
+TEST(WriteBatchMVTest, PutRef) {
+  std::string value(1000, 'x');
+  WriteBatchMV b1, b2, copied;
+  b1.PutRef("foo", 7, value);
+  b1.PutRef("bar", 8, "small");
+  WriteBatchMVInternal::AppendRef(&b2, &b1);
+  copied.Put("foo", 7, value);
+  copied.Put("bar", 8, "small");
+  ASSERT_EQ(copied.ApproximateSize(), b2.ApproximateSize());
+
+  std::vector<Slice> parts;
+  WriteBatchMVInternal::GetParts(&b2, &parts);
+  std::string contents;
+  for (const Slice& part : parts) {
+    contents.append(part.data(), part.size());
+  }
+  ASSERT_EQ(WriteBatchMVInternal::Contents(&copied).ToString(), contents);
+
+  // b2 refers to the large value through b1.
+  value[0] = 'y';
+  WriteBatchMVInternal::SetSequence(&b2, 100);
+  copied.Clear();
+  copied.Put("foo", 7, value);
+  copied.Put("bar", 8, "small");
+  WriteBatchMVInternal::SetSequence(&copied, 100);
+  ASSERT_EQ(PrintContents(&copied), PrintContents(&b2));
+}
+
 TEST(WriteBatchMVTest, ApproximateSize) {
   auto current = std::chrono::system_clock::now();
   std::time_t current_time = std::chrono::system_clock::to_time_t(current);
@@ -37,6 +37,12 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeValueIndex:
+        // Not counted: batches never hold value indexes.
+        state.append("ValueIndex(");
+        state.append(ikey.user_key.ToString());
+        state.append(")");
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
@@ -112,6 +118,75 @@ TEST(WriteBatchTest, Append) {
       PrintContents(&b1));
 }
 
+// Return the contents of "b" gathered from its parts.
+static std::string GatherContents(const WriteBatch* b) {
+  std::vector<Slice> parts;
+  WriteBatchInternal::GetParts(b, &parts);
+  std::string contents;
+  for (const Slice& part : parts) {
+    contents.append(part.data(), part.size());
+  }
+  return contents;
+}
+
+TEST(WriteBatchTest, PutRef) {
+  std::string value(1000, 'x');
+  WriteBatch batch, copied;
+  batch.PutRef("foo", value);
+  batch.PutRef("bar", "small");
+  batch.Delete("box");
+  copied.Put("foo", value);
+  copied.Put("bar", "small");
+  copied.Delete("box");
+  ASSERT_EQ(WriteBatchInternal::Contents(&copied).ToString(),
+            GatherContents(&batch));
+  ASSERT_EQ(copied.ApproximateSize(), batch.ApproximateSize());
+
+  // The batch refers to the large value instead of holding a copy.
+  value[0] = 'y';
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(
+      "Put(bar, small)@101"
+      "Delete(box)@102"
+      "Put(foo, y" + std::string(999, 'x') + ")@100",
+      PrintContents(&batch));
+
+  batch.Clear();
+  ASSERT_EQ("", PrintContents(&batch));
+  ASSERT_EQ(WriteBatch().ApproximateSize(), batch.ApproximateSize());
+}
+
+TEST(WriteBatchTest, AppendRef) {
+  const std::string large(1000, 'v');
+  WriteBatch b1, b2, b3, copied;
+  b2.Put("a", large);
+  b2.PutRef("b", large);
+  b3.Put("c", "vc");
+  for (const WriteBatch* b : {&b2, &b3, &b2}) {
+    WriteBatchInternal::AppendRef(&b1, b);
+    copied.Append(*b);
+  }
+  ASSERT_EQ(5, WriteBatchInternal::Count(&b1));
+  ASSERT_EQ(GatherContents(&copied), GatherContents(&b1));
+
+  // Small batches are copied.
+  b3.Clear();
+  ASSERT_EQ(GatherContents(&copied), GatherContents(&b1));
+
+  // Append() copies what b1 holds or refers to through AppendRef().
+  WriteBatch b4;
+  b4.Append(b1);
+  b1.Clear();
+  WriteBatchInternal::SetSequence(&b4, 200);
+  ASSERT_EQ(
+      "Put(a, " + large + ")@203"
+      "Put(a, " + large + ")@200"
+      "Put(b, " + large + ")@204"
+      "Put(b, " + large + ")@201"
+      "Put(c, vc)@202",
+      PrintContents(&b4));
+}
+
 TEST(WriteBatchTest, ApproximateSize) {
   WriteBatch batch;
   size_t empty_size = batch.ApproximateSize();
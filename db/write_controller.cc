@@ -0,0 +1,74 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+namespace {
+
+// Writes are never delayed to a lower rate than this, so that a writer
+// is not blocked for minutes when the debt estimate runs away.  The hard
+// stop on level-0 files still applies below it.
+constexpr uint64_t kMinDelayedWriteRate = 16 * 1024;
+
+// Writes within this many microseconds' worth of bytes of the rate are
+// admitted without a delay, which saves many tiny sleeps.
+constexpr uint64_t kMaxBurstMicros = 1000;
+
+}  // namespace
+
+WriteController::WriteController(uint64_t max_rate, uint64_t soft_debt_limit)
+    : max_rate_(std::max(max_rate, kMinDelayedWriteRate)),
+      soft_debt_limit_(soft_debt_limit),
+      delayed_write_rate_(0),
+      paid_until_micros_(0) {}
+
+void WriteController::Update(int level0_files, uint64_t compaction_debt) {
+  // The fraction of max_rate_ writes are admitted at; anything at or above
+  // one means writes are not delayed.
+  double fraction = 1.0;
+  bool delayed = false;
+  if (level0_files >= config::kL0_SlowdownWritesTrigger) {
+    // Fall linearly from the full rate at the slowdown trigger to nothing
+    // at the stop trigger.
+    delayed = true;
+    fraction = static_cast<double>(config::kL0_StopWritesTrigger -
+                                   level0_files) /
+               (config::kL0_StopWritesTrigger -
+                config::kL0_SlowdownWritesTrigger);
+  }
+  if (soft_debt_limit_ > 0 && compaction_debt >= soft_debt_limit_) {
+    // Fall in inverse proportion to the debt past the limit.
+    delayed = true;
+    fraction = std::min(fraction, static_cast<double>(soft_debt_limit_) /
+                                      compaction_debt);
+  }
+
+  if (!delayed) {
+    delayed_write_rate_ = 0;
+    paid_until_micros_ = 0;
+    return;
+  }
+  delayed_write_rate_ = std::max(
+      static_cast<uint64_t>(std::max(fraction, 0.0) * max_rate_),
+      kMinDelayedWriteRate);
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes) {
+  if (delayed_write_rate_ == 0) {
+    return 0;
+  }
+  const uint64_t earliest =
+      now_micros > kMaxBurstMicros ? now_micros - kMaxBurstMicros : 0;
+  paid_until_micros_ = std::max(paid_until_micros_, earliest) +
+                       bytes * 1000000 / delayed_write_rate_;
+  return paid_until_micros_ > now_micros ? paid_until_micros_ - now_micros : 0;
+}
+
+}  // namespace leveldb
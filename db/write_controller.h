@@ -0,0 +1,60 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The WriteController slows writes down while compactions are falling
+// behind, so that they catch up before writes have to stop altogether.
+// The more work compactions have left (the more level-0 files, and the more
+// bytes the levels hold beyond their limits), the lower the rate writes are
+// admitted at.  Writes are then spaced out evenly at that rate instead of
+// each being delayed by a fixed amount regardless of its size.
+//
+// Not thread-safe: DBImpl calls it with its mutex held.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+class WriteController {
+ public:
+  // Writes that have to be delayed are admitted at up to max_rate bytes
+  // per second.  Compaction debt beyond soft_debt_limit bytes lowers the
+  // rate in proportion; zero disables delays based on debt.
+  WriteController(uint64_t max_rate, uint64_t soft_debt_limit);
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Recompute the rate writes are admitted at from the number of level-0
+  // files and the estimated compaction debt, in bytes.
+  void Update(int level0_files, uint64_t compaction_debt);
+
+  // Return true iff writes are currently being delayed.
+  bool IsDelayed() const { return delayed_write_rate_ > 0; }
+
+  // Return the rate, in bytes per second, writes are admitted at, or zero
+  // if they are not being delayed.
+  uint64_t delayed_write_rate() const { return delayed_write_rate_; }
+
+  // Account for a write of "bytes" issued at "now_micros" and return the
+  // number of microseconds the writer has to wait for it to stay within
+  // the delayed write rate.  Returns zero if writes are not delayed.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t bytes);
+
+ private:
+  const uint64_t max_rate_;
+  const uint64_t soft_debt_limit_;
+  uint64_t delayed_write_rate_;  // Zero if writes are not delayed
+
+  // The time at which the writes admitted so far will have been paid for
+  // at the delayed write rate.  It never trails the current time by more
+  // than a short burst, so that time spent idle is not saved up.
+  uint64_t paid_until_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,91 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+static const uint64_t kRate = 1 << 20;         // 1MB/s
+static const uint64_t kDebtLimit = 100 << 20;  // 100MB
+
+TEST(WriteControllerTest, NotDelayedBelowTriggers) {
+  WriteController controller(kRate, kDebtLimit);
+  controller.Update(config::kL0_SlowdownWritesTrigger - 1, kDebtLimit - 1);
+  ASSERT_TRUE(!controller.IsDelayed());
+  ASSERT_EQ(0, controller.delayed_write_rate());
+  ASSERT_EQ(0, controller.GetDelay(1000000, 1 << 20));
+}
+
+TEST(WriteControllerTest, RateFallsWithLevel0Files) {
+  WriteController controller(kRate, kDebtLimit);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  ASSERT_TRUE(controller.IsDelayed());
+  ASSERT_EQ(kRate, controller.delayed_write_rate());
+
+  const int halfway = (config::kL0_SlowdownWritesTrigger +
+                       config::kL0_StopWritesTrigger) / 2;
+  controller.Update(halfway, 0);
+  ASSERT_EQ(kRate / 2, controller.delayed_write_rate());
+
+  // Never slowed down to nothing short of the stop trigger.
+  controller.Update(config::kL0_StopWritesTrigger - 1, 0);
+  ASSERT_LT(0, controller.delayed_write_rate());
+  ASSERT_GT(kRate / 10, controller.delayed_write_rate());
+
+  controller.Update(0, 0);
+  ASSERT_TRUE(!controller.IsDelayed());
+}
+
+TEST(WriteControllerTest, RateFallsWithCompactionDebt) {
+  WriteController controller(kRate, kDebtLimit);
+  controller.Update(0, kDebtLimit);
+  ASSERT_EQ(kRate, controller.delayed_write_rate());
+  controller.Update(0, 4 * kDebtLimit);
+  ASSERT_EQ(kRate / 4, controller.delayed_write_rate());
+
+  // The lower of the two rates applies.
+  const int halfway = (config::kL0_SlowdownWritesTrigger +
+                       config::kL0_StopWritesTrigger) / 2;
+  controller.Update(halfway, 4 * kDebtLimit);
+  ASSERT_EQ(kRate / 4, controller.delayed_write_rate());
+
+  WriteController no_limit(kRate, 0);
+  no_limit.Update(0, 4 * kDebtLimit);
+  ASSERT_TRUE(!no_limit.IsDelayed());
+}
+
+TEST(WriteControllerTest, DelaysSpaceWritesAtRate) {
+  WriteController controller(kRate, kDebtLimit);
+  controller.Update(0, kDebtLimit);
+
+  // A small write fits in the allowed burst.
+  uint64_t now = 10000000;
+  ASSERT_EQ(0, controller.GetDelay(now, 100));
+
+  // Writes issued together wait for the earlier ones to be paid for.
+  now += 1000;
+  const uint64_t first = controller.GetDelay(now, kRate / 8);
+  ASSERT_GT(first, 123000);
+  ASSERT_LT(first, 125000);
+  const uint64_t second = controller.GetDelay(now, kRate / 8);
+  ASSERT_EQ(first + 125000, second);
+
+  // Once those delays have passed, the next write waits for itself only.
+  now += second;
+  ASSERT_EQ(125000, controller.GetDelay(now, kRate / 8));
+
+  // Time spent idle is not saved up for later writes.
+  now += 10000000;
+  ASSERT_GT(controller.GetDelay(now, kRate / 8), 123000);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
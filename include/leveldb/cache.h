@@ -97,6 +97,11 @@ class LEVELDB_EXPORT Cache {
   // cache.
   virtual size_t TotalCharge() const = 0;
 
+  // Return an estimate of the combined charges of the elements stored in
+  // the cache that are currently referenced by clients, and so cannot be
+  // evicted.  Default implementation returns 0.
+  virtual size_t PinnedCharge() const { return 0; }
+
  private:
   void LRU_Remove(Handle* e);
   void LRU_Append(Handle* e);
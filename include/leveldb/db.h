@@ -7,10 +7,13 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinned_value.h"
 
 namespace leveldb {
 
@@ -89,6 +92,28 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Like Get(), but instead of copying the value into a string, leaves it
+  // in the memtable or cached table block it was found in and pins that
+  // memory in *value until *value is reset or destroyed.  Any value held
+  // by *value before the call is released.  On a non-OK status *value is
+  // left empty.
+  //
+  // The default implementation copies the value Get() returns into *value.
+  virtual Status GetPinned(const ReadOptions& options, const Slice& key,
+                           PinnedValue* value);
+
+  // Look up each of "keys" as Get() would, all against the same state of
+  // the DB, and store the result for keys[i] in (*values)[i] and
+  // (*statuses)[i].  Both vectors are resized to keys.size().
+  //
+  // This is cheaper than calling Get() for each key: keys that fall into
+  // the same table, or the same block of a table, are looked up together.
+  // The default implementation calls Get() for each key.
+  virtual void MultiGet(const ReadOptions& options,
+                        const std::vector<Slice>& keys,
+                        std::vector<std::string>* values,
+                        std::vector<Status>* statuses);
+
   // MVLevelDB methods
   // Implementations must override these methods to provide multi-version data access.
   virtual Status PutMV(const WriteOptions&, const Slice& key, ValidTime vt,
@@ -105,6 +130,11 @@ class LEVELDB_EXPORT DB {
                ValidTime vt, ValidTimePeriod* period, std::string* value) {
     return Status::NotSupported("Multi-Version is not supported in current DB.");
   }
+  // Like GetMV(), but pins the value as GetPinned() does.  The default
+  // implementation copies the value GetMV() returns into *value.
+  virtual Status GetMVPinned(const ReadOptions& options, const Slice& key,
+                             ValidTime vt, ValidTimePeriod* period,
+                             PinnedValue* value);
   virtual Status GetMVRange(const ReadOptions& options, const KeyList& key_list,
                      const TimeRange& time_range, ResultSet* result_set) {
     return Status::NotSupported("Multi-Version is not supported in current DB.");
@@ -144,6 +174,23 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.memory-usage" - returns a multi-line string breaking down
+  //     the memory held by the DB: memtables, block cache (total and pinned
+  //     by readers), open tables' index and filter blocks, memtables and
+  //     versions kept alive by iterators and pinned values, and write batch
+  //     scratch space.
+  //     Entries ending in "-count" are counts, all others are bytes.
+  //  "leveldb.io-stats" - returns a multi-line string with the number of
+  //     opens, reads, writes and syncs, their sizes and latencies, issued by
+  //     each subsystem of the DB.  Only available if
+  //     Options::collect_io_stats is set.
+  //  "leveldb.write-stats" - returns a multi-line string with the number of
+  //     write groups, the writes they combined, the log syncs issued and
+  //     the sync writes they covered, and the commit and write delays
+  //     taken.
+  //  "leveldb.delayed-write-rate" - returns the rate, in bytes per second,
+  //     writes are slowed down to while compactions catch up, or "0" if
+  //     writes are not being slowed down.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -168,6 +215,37 @@ class LEVELDB_EXPORT DB {
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+  // Start recording every Get/Put/Delete/Write (and their multi-version
+  // counterparts) and every iterator Seek/SeekToFirst/SeekToLast issued
+  // against this DB, along with the time each was issued, into the trace
+  // file "trace_file".  Any existing file with that name is replaced.
+  //
+  // The trace can be replayed with db_bench --benchmarks=replay.
+  virtual Status StartTrace(const std::string& trace_file) {
+    return Status::NotSupported("Tracing is not supported in current DB.");
+  }
+
+  // Stop the trace started by StartTrace() and close its file.
+  virtual Status EndTrace() {
+    return Status::NotSupported("Tracing is not supported in current DB.");
+  }
+
+  // Add the tables built with SstFileWriter listed in "files" to the DB
+  // without going through the log or the memtable.  The files must not
+  // overlap one another.  Their contents become visible atomically and
+  // take precedence over any data already in the DB for the same keys.
+  //
+  // Each file is placed at the deepest level holding no data in its key
+  // range; memtable data in that range is flushed first.  Data of files
+  // that overlap existing data, or that are ingested while snapshots are
+  // held, is given a new sequence number, which requires rewriting the
+  // file rather than copying it.
+  virtual Status IngestExternalFiles(const IngestExternalFileOptions& options,
+                                     const std::vector<std::string>& files) {
+    return Status::NotSupported(
+        "External file ingestion is not supported in current DB.");
+  }
 };
 
 // Destroy the contents of the specified database.
@@ -110,6 +110,22 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Rename the existing file "old_fname" to "fname" and create an object
+  // that overwrites it from the start.  Unlike NewWritableFile(), the file
+  // is not truncated, so writing to it need not allocate new blocks or
+  // change its size until it outgrows its old contents.  On success,
+  // stores a pointer to the file in *result and returns OK.  On failure
+  // stores nullptr in *result and returns non-OK.
+  //
+  // The returned file will only be accessed by one thread at a time.
+  //
+  // May return an IsNotSupportedError error if this Env does not allow
+  // reusing files; EnvWrapper does not forward this call, since a
+  // subclass may have overridden NewWritableFile().
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -284,9 +300,20 @@ class LEVELDB_EXPORT WritableFile {
   virtual ~WritableFile();
 
   virtual Status Append(const Slice& data) = 0;
+
+  // Append the concatenation of parts[0..n-1].  An implementation may write
+  // large parts straight from the caller's buffers, with a single system
+  // call.  The default implementation calls Append() for each part.
+  virtual Status AppendParts(const Slice* parts, size_t n);
+
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Hint that the file will grow by about "size" bytes at a time, so that
+  // an implementation may reserve space for it ahead of the writes.  The
+  // default implementation does nothing.
+  virtual void SetPreallocationBlockSize(size_t size);
 };
 
 // An interface for writing log messages.
@@ -67,6 +67,35 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a blocked bloom filter with
+// approximately the specified number of bits per key.  All the bits
+// tested for a key lie in a single 64-byte block, so that a check
+// touches about one cache line instead of one per probe, and on x86
+// CPUs with AVX2 tests all of them at once.  In exchange, the false
+// positive rate is slightly higher than NewBloomFilterPolicy()'s for
+// the same bits_per_key, though still about 1% for 10.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.  The same note about custom comparators as for
+// NewBloomFilterPolicy() applies.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses Ribbon filters with about the
+// false positive rate of NewBloomFilterPolicy(bits_per_key), e.g. 0.8%
+// for 10, in about 25% less memory.  Building a filter takes a few times
+// as long as building a bloom filter, and checking a key somewhat longer.
+//
+// A Ribbon filter for a few keys takes more room than a bloom filter,
+// so the filters of fewer than a few hundred keys are bloom filters
+// instead.  As a filter covers only 2KB of data blocks by default, this
+// policy saves memory mostly when used with Options::whole_table_filter.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.  The same note about custom comparators as for
+// NewBloomFilterPolicy() applies.
+LEVELDB_EXPORT const FilterPolicy* NewRibbonFilterPolicy(int bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
@@ -16,6 +17,7 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PrefixExtractor;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -85,13 +87,34 @@ struct LEVELDB_EXPORT Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
-  // Also, a larger write buffer will result in a longer recovery time
-  // the next time the database is opened.
+  // Up to max_write_buffer_number write buffers may be held in memory at
+  // the same time, so you may wish to adjust this parameter to control
+  // memory usage.  Also, a larger write buffer will result in a longer
+  // recovery time the next time the database is opened.
   // LevelDB default: 4 * 1024 * 1024
   size_t write_buffer_size = 2 * 1024 * 1024;
 
+  // Maximum number of write buffers held in memory: the one being written
+  // and those that are full and waiting to be flushed to disk.  Writes
+  // only stall on a full write buffer once all the others are waiting, so
+  // larger values absorb longer bursts of writes.  The write buffers
+  // waiting when a flush starts are merged into a single table.
+  int max_write_buffer_number = 2;
+
+  // When compactions fall behind, writes are slowed down to give them
+  // time to catch up before writes have to stop.  This is the rate, in
+  // bytes per second, writes are admitted at when that starts; it is
+  // lowered the further compactions fall behind.
+  uint64_t delayed_write_rate = 16 * 1024 * 1024;
+
+  // Writes are slowed down once compactions are estimated to have more
+  // than this many bytes to write before every level is within its size
+  // limit, as well as when there are many level-0 files.  Zero disables
+  // slowing down writes based on this estimate.
+  //
+  // Ignored when multi_version is set, since such a DB is not compacted.
+  uint64_t soft_pending_compaction_bytes_limit = 64ull << 30;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -117,6 +140,31 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, each data block ends in a hash index from the user keys it
+  // holds to the restart points their entries follow, so that most point
+  // lookups skip the binary search of the block.  Costs about one and a
+  // third bytes per user key.  Only correct if the comparator never
+  // treats different keys as equal.  Ignored by multi-version DBs.
+  //
+  // Tables written with this option cannot be read by versions of
+  // leveldb that do not know it.
+  bool data_block_hash_index = false;
+
+  // If non-zero, the index of each table is split into partitions of
+  // about this many bytes, and its filters (see filter_policy) into one
+  // filter per index partition.  Opening a table then only reads a small
+  // top-level index, and the partitions are read when a lookup needs
+  // them, through the block cache like data blocks, instead of being held
+  // in memory for as long as the table is open.  In exchange, a lookup
+  // in a table whose partitions are not cached costs up to two more
+  // reads.  Worth it for large tables (see max_file_size).
+  //
+  // whole_table_filter is ignored: each filter covers one partition.
+  //
+  // Tables written with this option cannot be read by versions of
+  // leveldb that do not know it.
+  size_t index_partition_size = 0;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -144,16 +192,104 @@ struct LEVELDB_EXPORT Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
 
+  // If positive, values of at least this many bytes are moved out of the
+  // tables into value log files when memtables are flushed and tables are
+  // compacted, leaving only their locations in the tables.  Compactions
+  // then do not have to rewrite large values, at the cost of an extra
+  // read for each such value read.
+  //
+  // Ignored if multi_version is set, since such databases never compact
+  // their tables.
+  //
+  // Default: 0, which keeps all values in the tables.
+  size_t value_log_threshold = 0;
+
+  // Compactions move the values still in use from the oldest
+  // value_log_gc_age_cutoff fraction of the value log files to new ones
+  // (or back into the tables, if they are now below value_log_threshold),
+  // so that the space taken by values that were overwritten or deleted is
+  // eventually reclaimed.  A value log file is deleted once none of its
+  // values are in use.
+  double value_log_gc_age_cutoff = 0.25;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // If positive, keep up to this many obsolete log files and overwrite
+  // them with new logs instead of creating new files, so that syncing a
+  // log does not also have to commit its allocation and size changes.
+  // Logs are then written in a format that tells their records apart
+  // from those left over from the file's previous use; reuse_logs does
+  // not apply to them.
+  int recycle_log_file_num = 0;
+
+  // Compress the write batches written to the log with this algorithm.
+  // Small batches, and batches that do not compress well, are still
+  // written uncompressed.  Logs written with compression cannot be read
+  // by versions of leveldb that do not support it.
+  //
+  // Default: kNoCompression
+  CompressionType wal_compression = kNoCompression;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If true (and filter_policy is non-null), each table has a single
+  // filter for all of its keys instead of one for every 2KB of data
+  // blocks.  Reads then check it before searching the table's index, so
+  // that a read of a key the table does not hold costs no index search.
+  // The keys of a table are kept in memory until the table is finished.
+  //
+  // Tables are read alike whichever way their filters were written, and
+  // tables with a single filter can be read by versions of leveldb that
+  // predate this option.
+  bool whole_table_filter = false;
+
+  // If non-null (and filter_policy is non-null too), the filters also
+  // hold the prefix "prefix_extractor" returns for each key, which lets
+  // iterators in prefix-seek mode (see ReadOptions::prefix_seek) skip
+  // the tables and blocks that hold no key with the prefix they seek.
+  //
+  // Tables written with a different extractor, or with none, are read
+  // as usual, but not skipped.
+  //
+  // Ignored when multi_version is set.
+  const PrefixExtractor* prefix_extractor = nullptr;
+
+  // If true, account the reads, writes, syncs and opens issued by the DB
+  // to the subsystem that issued them (log, flush, compaction, ...).  The
+  // counters are reported by the "leveldb.io-stats" property.
+  bool collect_io_stats = false;
+
+  // If true, a group of writes may be appended to the log while the
+  // previous group is still being inserted into the memtable, instead of
+  // waiting for it.  Writes still become visible in sequence order.
+  //
+  // Ignored when multi_version is set.
+  bool enable_pipelined_write = false;
+
+  // If true, groups of writes logged by the pipelined write path are
+  // inserted into the memtable concurrently with each other rather than
+  // one at a time.  They still become visible in sequence order.
+  //
+  // Only used together with enable_pipelined_write, or with multi_version,
+  // where the writes grouped into one log record are then inserted by
+  // their writers in parallel.
+  bool allow_concurrent_memtable_write = false;
+
+  // Commit delay for sync writes.  If positive, a sync write that leads a
+  // group while fewer than sync_commit_min_writers writes are queued
+  // sleeps this many microseconds before building the group, so that
+  // writes arriving in the meantime share its log sync.  This trades the
+  // latency of each sync write for fewer syncs under concurrency; a value
+  // somewhat below the device's sync latency is a good start.
+  int sync_commit_delay_micros = 0;
+  int sync_commit_min_writers = 4;
 };
 
 // Options that control read operations
@@ -173,6 +309,25 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // Number of bytes iterators read ahead of the table blocks they need.
+  // If zero, an iterator starts reading ahead once it has read a few
+  // adjacent blocks, 8KB at first and doubling up to 256KB as long as
+  // it keeps scanning.  A non-zero value reads that many bytes ahead
+  // right from the start, which suits callers that know they are about
+  // to scan a large range.
+  size_t readahead_size = 0;
+
+  // If true, an iterator only returns the keys that have the same prefix
+  // (see Options::prefix_extractor) as the target of its last Seek(),
+  // and becomes invalid at the first key that does not.  In return, the
+  // seek skips the tables and blocks whose filters rule the prefix out.
+  // A target without a prefix is sought and iterated over as usual.
+  //
+  // Such an iterator only moves forward: Prev() and SeekToLast() leave
+  // it invalid with a NotSupported status.  SeekToFirst() scans all keys
+  // as usual.
+  bool prefix_seek = false;
 };
 
 // Options that control write operations
@@ -196,6 +351,15 @@ struct LEVELDB_EXPORT WriteOptions {
   bool sync = false;
 };
 
+// Options that control DB::IngestExternalFiles()
+struct LEVELDB_EXPORT IngestExternalFileOptions {
+  IngestExternalFileOptions() = default;
+
+  // If true, the files are renamed into the DB directory instead of being
+  // copied.  They must then be on the same file system as the DB.
+  bool move_files = false;
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
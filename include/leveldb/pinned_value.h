@@ -0,0 +1,86 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnedValue holds a value looked up by DB::GetPinned() without copying
+// it.  It points into the memtable or the table block the value was found
+// in, and keeps that memory alive until the PinnedValue is Reset() or
+// destroyed.  Values that only exist in some other form (e.g. in a value
+// log) are copied into storage owned by the PinnedValue instead.
+//
+// Holding a PinnedValue keeps its memtable or block from being freed, much
+// like a live Iterator, so it should be released once the value has been
+// used.  All PinnedValues must be released before the DB is deleted.
+//
+// Multiple threads can invoke const methods on a PinnedValue without
+// external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same PinnedValue must use
+// external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNED_VALUE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNED_VALUE_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT PinnedValue {
+ public:
+  PinnedValue() = default;
+
+  PinnedValue(const PinnedValue&) = delete;
+  PinnedValue& operator=(const PinnedValue&) = delete;
+
+  ~PinnedValue() { Reset(); }
+
+  // The value.  Empty unless the last lookup into this PinnedValue found
+  // one.
+  const Slice& value() const { return value_; }
+  const char* data() const { return value_.data(); }
+  size_t size() const { return value_.size(); }
+  bool empty() const { return value_.empty(); }
+  std::string ToString() const { return value_.ToString(); }
+
+  // Release whatever the value is pinned in and make it empty.
+  void Reset();
+
+  // The methods below are for implementations of DB::GetPinned().
+
+  // Refer to "value", which the functions registered with RegisterCleanup()
+  // keep alive.
+  void PinSlice(const Slice& value) { value_ = value; }
+
+  // Refer to a copy of "value" owned by this PinnedValue.
+  void PinSelf(const Slice& value) {
+    self_.assign(value.data(), value.size());
+    value_ = self_;
+  }
+
+  // Storage owned by this PinnedValue.  Fill it, then call PinSelf().
+  std::string* GetSelf() { return &self_; }
+  void PinSelf() { value_ = self_; }
+
+  // Register function/arg1/arg2 triples to be invoked, in the reverse of
+  // the order they were registered in, when the value is released.
+  using CleanupFunction = void (*)(void* arg1, void* arg2);
+  void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
+
+ private:
+  struct Cleanup {
+    CleanupFunction function;
+    void* arg1;
+    void* arg2;
+  };
+
+  Slice value_;
+  std::string self_;
+  std::vector<Cleanup> cleanups_;  // Kept around to be reused
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNED_VALUE_H_
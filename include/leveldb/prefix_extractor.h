@@ -0,0 +1,63 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a PrefixExtractor that maps each key
+// to a prefix, e.g. "user123:" for "user123:orders:42".  The filters of
+// the tables then also hold the prefixes of the keys, so that a seek in
+// prefix-seek mode (see ReadOptions::prefix_seek) can skip the tables and
+// blocks that hold no key with the prefix of its target.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+#define STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT PrefixExtractor {
+ public:
+  virtual ~PrefixExtractor();
+
+  // Return the name of this extractor.  The name is recorded in the
+  // tables whose filters hold prefixes, and must change whenever the
+  // prefixes returned for some key change.  Otherwise, tables written
+  // with the old prefixes may be wrongly skipped.
+  virtual const char* Name() const = 0;
+
+  // Return true if "key" has a prefix.  Keys without one are not
+  // filtered by prefix.
+  virtual bool InDomain(const Slice& key) const = 0;
+
+  // Return the prefix of "key", which must be the first bytes of "key".
+  // REQUIRES: InDomain(key)
+  //
+  // All keys with the same prefix must be adjacent in the order of the
+  // comparator, and a key that starts with the prefix of another key
+  // must have that same prefix.
+  virtual Slice Prefix(const Slice& key) const = 0;
+};
+
+// Return a new extractor whose prefixes are the first "prefix_length"
+// bytes of the keys.  Shorter keys have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const PrefixExtractor* NewFixedPrefixExtractor(
+    size_t prefix_length);
+
+// Return a new extractor whose prefixes run up to and including the
+// first "delimiter" in the keys, e.g. "user123:" for "user123:orders:42"
+// with a ':' delimiter.  Keys without "delimiter" have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const PrefixExtractor* NewDelimitedPrefixExtractor(
+    char delimiter);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table file outside of any DB that can later be
+// added to a DB with DB::IngestExternalFiles(), bypassing the log, the
+// memtable and compaction.  Keys must be added in sorted order.
+//
+// The sequence numbers stored in the file are only placeholders; the DB
+// gives the data a sequence number of its own when the file is ingested.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SstFileWriter {
+ public:
+  // "options" must match the options of the DB the file will be ingested
+  // into: the comparator, filter policy and multi_version setting are
+  // recorded in the file.  options.env is used to create the file.
+  explicit SstFileWriter(const Options& options);
+
+  SstFileWriter(const SstFileWriter&) = delete;
+  SstFileWriter& operator=(const SstFileWriter&) = delete;
+
+  // Abandons the file if Finish() has not been called.
+  ~SstFileWriter();
+
+  // Create the file "fname", replacing any existing file.
+  Status Open(const std::string& fname);
+
+  // Add an entry to the file.
+  // REQUIRES: key is after any previously added key according to the
+  // comparator.  Only for options.multi_version == false.
+  Status Put(const Slice& key, const Slice& value);
+  Status Delete(const Slice& key);
+
+  // Add a version of key that became valid at "vt".
+  // REQUIRES: key is after any previously added key, or equal to it with
+  // an earlier "vt".  Only for options.multi_version == true.
+  Status PutMV(const Slice& key, ValidTime vt, const Slice& value);
+  Status DeleteMV(const Slice& key, ValidTime vt);
+
+  // Finish writing, then sync and close the file.  Fails if no entries
+  // have been added.
+  Status Finish();
+
+  // Size of the file once Finish() has succeeded.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+
+  Status Add(const Slice& key, ValidTime vt, bool is_deletion,
+             const Slice& value, bool multi_version);
+
+  Rep* rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
@@ -17,8 +17,10 @@ namespace leveldb {
 
 class Block;
 class BlockHandle;
-class Footer;
+struct BlockContents;
+class FilterBlockReader;
 struct Options;
+class PinnedValue;
 class RandomAccessFile;
 struct ReadOptions;
 class TableCache;
@@ -61,31 +63,105 @@ class LEVELDB_EXPORT Table {
   // be close to the file length.
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+  // Returns the number of bytes of heap memory held by the table for as
+  // long as it is open, i.e. its index and filter blocks.
+  size_t ApproximateMemoryUsage() const;
+
  private:
   friend class TableCache;
   struct Rep;
+  struct Partition;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+
+  // Returns an iterator over the block "index_value" refers to, reading
+  // it from "file" if it is not cached.  See Block::NewIterator() for
+  // "point_lookup".
+  Iterator* ReadBlockIterator(RandomAccessFile* file, const ReadOptions&,
+                              const Slice& index_value, bool point_lookup);
 
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Returns an iterator over the index whose values refer to data blocks.
+  // With a partitioned index, "may_match" (if non-null) is passed on to
+  // NewTwoLevelIterator() to skip partitions.
+  Iterator* NewIndexIterator(const ReadOptions&,
+                             bool (*may_match)(void*, const ReadOptions&,
+                                               const Slice&,
+                                               const Slice&)) const;
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+
+  // Sets *partition to the index and filter that cover internal key "k".
+  // Returns false, setting *status on errors, if k is past the end of
+  // the table.
+  bool FindPartition(const ReadOptions&, const Slice& k, Partition* partition,
+                     Status* status) const;
+
+  // Sets *partition to the one the top-level index entry "index_value"
+  // refers to.  REQUIRES: rep_->partitioned_index
+  void LoadPartition(const ReadOptions&, const Slice& index_value,
+                     Partition* partition) const;
+
+  // Returns an iterator over the index of *partition.
+  Iterator* NewPartitionIndexIterator(const ReadOptions&,
+                                      const Partition& partition) const;
+
+  // Returns false if the filters rule out any key at or after internal key
+  // "target" with the same prefix (see Options::prefix_extractor).  Keys
+  // without a prefix, and tables whose filters do not hold the prefixes
+  // of this extractor, always may match.
+  bool PrefixMayMatch(const Slice& target) const;
+
+  // Like PrefixMayMatch() for "filter" and the block "index_value"
+  // refers to, which must be the one "target" falls into (and is ignored
+  // if the filter covers a whole table or partition).
+  // REQUIRES: rep_->prefix_filter
+  bool BlockPrefixMayMatch(FilterBlockReader* filter,
+                           const Slice& index_value,
+                           const Slice& target) const;
+  static bool PrefixMayMatchBlock(void*, const ReadOptions&,
+                                  const Slice& index_value,
+                                  const Slice& target);
+  static bool PrefixMayMatchPartition(void*, const ReadOptions&,
+                                      const Slice& index_value,
+                                      const Slice& target);
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
+  //
+  // If "pinned" is non-null, the block searched is kept alive until
+  // *pinned is released, so that handle_result can leave the value in it.
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                      void (*handle_result)(void* arg, const Slice& k,
-                                           const Slice& v));
+                                           const Slice& v),
+                     PinnedValue* pinned = nullptr);
+
+  // Like InternalGet() for each of keys[0..n-1], which must be sorted,
+  // calling (*handle_result)(args[i], ...) for keys[i] and storing what
+  // InternalGet() would return in statuses[i].  Keys that fall into the
+  // same data block share a single read of the block.
+  void InternalMultiGet(const ReadOptions&, const Slice* keys,
+                        void* const* args, size_t n,
+                        void (*handle_result)(void* arg, const Slice& k,
+                                              const Slice& v),
+                        Status* statuses);
+
   // MVLevelDB version
   Status InternalGetMV(const ReadOptions&, const Slice& key, void* arg,
                        void (*handle_result)(void* arg, const Slice& k,
-                           const ValidTimePeriod&, const Slice& v));
+                           const ValidTimePeriod&, const Slice& v),
+                       PinnedValue* pinned = nullptr);
   Status InternalGetMVRange(const ReadOptions& options,
                                  SequenceNumber snapshot,
                                  const KeyList& key_list,
                                  const TimeRange& time_range,
                                  ResultSet* result_set);
 
-  void ReadMeta(const Footer& footer);
+  void ReadMeta(const BlockContents& contents);
   void ReadFilter(const Slice& filter_handle_value);
 
   Rep* const rep_;
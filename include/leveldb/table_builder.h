@@ -83,6 +83,9 @@ class LEVELDB_EXPORT TableBuilder {
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  // Writes the current index partition and its filter, and adds them to
+  // the top-level index.
+  void WriteIndexPartition();
 
   struct Rep;
   Rep* rep_;
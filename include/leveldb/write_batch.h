@@ -22,16 +22,17 @@
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 #include "db/dbformat.h"  // MVLevelDB: import type ValidTime
 
 namespace leveldb {
 
-class Slice;
-
 class LEVELDB_EXPORT WriteBatch {
  public:
   class LEVELDB_EXPORT Handler {
@@ -52,6 +53,11 @@ class LEVELDB_EXPORT WriteBatch {
   // Store the mapping "key->value" in the database.
   void Put(const Slice& key, const Slice& value);
 
+  // Like Put(), but the batch refers to the bytes of "value" instead of
+  // copying them, so they must stay unchanged until the batch has been
+  // written, cleared or destroyed.  Small values are copied anyway.
+  void PutRef(const Slice& key, const Slice& value);
+
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
@@ -78,6 +84,10 @@ class LEVELDB_EXPORT WriteBatch {
   friend class WriteBatchInternal;
 
   std::string rep_;  // See comment in write_batch.cc for the format of rep_
+
+  // Bytes of the batch held outside of rep_: each entry places its slice
+  // after the rep_ bytes before its offset.
+  std::vector<std::pair<size_t, Slice>> refs_;
 };
 
 class LEVELDB_EXPORT WriteBatchMV : public WriteBatch {
@@ -97,6 +107,7 @@ class LEVELDB_EXPORT WriteBatchMV : public WriteBatch {
   ~WriteBatchMV();
 
   void Put(const Slice& key, ValidTime vt, const Slice& value);
+  void PutRef(const Slice& key, ValidTime vt, const Slice& value);
   void Delete(const Slice& key, ValidTime vt);
   void Clear();
 
@@ -109,6 +120,7 @@ class LEVELDB_EXPORT WriteBatchMV : public WriteBatch {
   friend class WriteBatchMVInternal;
 
   std::string rep_;
+  std::vector<std::pair<size_t, Slice>> refs_;
 };
 
 }  // namespace leveldb
@@ -13,30 +13,44 @@
 #include "leveldb/comparator.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
 namespace leveldb {
 
-inline uint32_t Block::NumRestarts() const {
-  assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
-}
-
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      num_restarts_(0),
+      num_buckets_(0),
       owned_(contents.heap_allocated) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
+    return;
+  }
+  num_restarts_ = DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  // Bytes following the restart array
+  uint64_t trailer_size = sizeof(uint32_t);
+  if ((num_restarts_ & kBlockHashIndexFlag) != 0) {
+    num_restarts_ &= ~kBlockHashIndexFlag;
+    if (size_ < 2 * sizeof(uint32_t)) {
       size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      return;
+    }
+    num_buckets_ = DecodeFixed32(data_ + size_ - 2 * sizeof(uint32_t));
+    trailer_size += sizeof(uint32_t) + num_buckets_;
+    if (num_buckets_ == 0 || trailer_size > size_) {
+      size_ = 0;
+      return;
     }
   }
+  size_t max_restarts_allowed = (size_ - trailer_size) / sizeof(uint32_t);
+  if (num_restarts_ > max_restarts_allowed) {
+    // The size is too small for num_restarts_
+    size_ = 0;
+  } else {
+    restart_offset_ = size_ - trailer_size - num_restarts_ * sizeof(uint32_t);
+  }
 }
 
 Block::~Block() {
@@ -81,6 +95,10 @@ class Block::Iter : public Iterator {
   uint32_t const restarts_;      // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_;  // Number of uint32_t entries in restart array
 
+  // Hash index used by Seek(), or nullptr
+  const uint8_t* const buckets_;
+  uint32_t const num_buckets_;
+
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
   uint32_t restart_index_;  // Index of restart block in which current_ falls
@@ -114,11 +132,13 @@ class Block::Iter : public Iterator {
 
  public:
   Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-       uint32_t num_restarts)
+       uint32_t num_restarts, const uint8_t* buckets, uint32_t num_buckets)
       : comparator_(comparator),
         data_(data),
         restarts_(restarts),
         num_restarts_(num_restarts),
+        buckets_(buckets),
+        num_buckets_(num_buckets),
         current_(restarts_),
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -162,6 +182,31 @@ class Block::Iter : public Iterator {
   }
 
   void Seek(const Slice& target) override {
+    if (buckets_ != nullptr && target.size() >= 8) {
+      const uint32_t h = Hash(target.data(), target.size() - 8, kBlockHashSeed);
+      const uint8_t restart = buckets_[h % num_buckets_];
+      if (restart == kBlockHashNoEntry) {
+        // No entry has target's user key
+        current_ = restarts_;
+        restart_index_ = num_restarts_;
+        return;
+      } else if (restart < num_restarts_) {
+        // The entries for target's user key, if any, follow this restart
+        // point.  Finding an entry for another user key does not mean it
+        // is the first one after target, so it is not returned.
+        SeekToRestartPoint(restart);
+        SeekInRestartInterval(target);
+        if (Valid() && (key_.size() < 8 ||
+                        Slice(key_.data(), key_.size() - 8) !=
+                            Slice(target.data(), target.size() - 8))) {
+          current_ = restarts_;
+          restart_index_ = num_restarts_;
+        }
+        return;
+      }
+      // Otherwise fall back on the binary search.
+    }
+
     // Binary search in restart array to find the last restart point
     // with a key < target
     uint32_t left = 0;
@@ -215,15 +260,7 @@ class Block::Iter : public Iterator {
     if (!skip_seek) {
       SeekToRestartPoint(left);
     }
-    // Linear search (within restart block) for first key >= target
-    while (true) {
-      if (!ParseNextKey()) {
-        return;
-      }
-      if (Compare(key_, target) >= 0) {
-        return;
-      }
-    }
+    SeekInRestartInterval(target);
   }
 
   void SeekToFirst() override {
@@ -239,6 +276,18 @@ class Block::Iter : public Iterator {
   }
 
  private:
+  // Linear search (within restart block) for first key >= target
+  void SeekInRestartInterval(const Slice& target) {
+    while (true) {
+      if (!ParseNextKey()) {
+        return;
+      }
+      if (Compare(key_, target) >= 0) {
+        return;
+      }
+    }
+  }
+
   void CorruptionError() {
     current_ = restarts_;
     restart_index_ = num_restarts_;
@@ -277,16 +326,21 @@ class Block::Iter : public Iterator {
   }
 };
 
-Iterator* Block::NewIterator(const Comparator* comparator) {
+Iterator* Block::NewIterator(const Comparator* comparator,
+                             bool point_lookup) {
   if (size_ < sizeof(uint32_t)) {
     return NewErrorIterator(Status::Corruption("bad block contents"));
   }
-  const uint32_t num_restarts = NumRestarts();
-  if (num_restarts == 0) {
+  if (num_restarts_ == 0) {
     return NewEmptyIterator();
-  } else {
-    return new Iter(comparator, data_, restart_offset_, num_restarts);
   }
+  const uint8_t* buckets = nullptr;
+  if (point_lookup && num_buckets_ > 0) {
+    buckets = reinterpret_cast<const uint8_t*>(data_) + restart_offset_ +
+              num_restarts_ * sizeof(uint32_t);
+  }
+  return new Iter(comparator, data_, restart_offset_, num_restarts_, buckets,
+                  num_buckets_);
 }
 
 }  // namespace leveldb
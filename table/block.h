@@ -26,16 +26,21 @@ class Block {
   ~Block();
 
   size_t size() const { return size_; }
-  Iterator* NewIterator(const Comparator* comparator);
+
+  // An iterator for point lookups of internal keys may use the block's
+  // hash index, if it has one.  Its Seek(target) then leaves it invalid
+  // rather than at an entry for a user key other than target's.
+  Iterator* NewIterator(const Comparator* comparator,
+                        bool point_lookup = false);
 
  private:
   class Iter;
 
-  uint32_t NumRestarts() const;
-
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
+  uint32_t num_restarts_;
+  uint32_t num_buckets_;     // Size of the hash index, or 0 if none
   bool owned_;               // Block owns data_[]
 };
 
@@ -25,6 +25,20 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// A block built with a hash index (see Options::data_block_hash_index)
+// whose keys are internal keys instead has the trailer
+//     restarts: uint32[num_restarts]
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+//     num_restarts | kBlockHashIndexFlag: uint32
+// The user key of each entry hashes to bucket
+// Hash(user_key, kBlockHashSeed) % num_buckets, which holds the number of
+// the restart point the entries for that user key follow.  A bucket no
+// user key hashes to holds kBlockHashNoEntry, and one for user keys that
+// follow different restart points holds kBlockHashCollision.  Blocks
+// with more than kBlockHashIndexMaxRestarts restart points are built
+// without a hash index.
 
 #include "table/block_builder.h"
 
@@ -33,12 +47,18 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
-BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index)
+    : options_(options),
+      hash_index_(hash_index),
+      restarts_(),
+      counter_(0),
+      finished_(false) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -50,11 +70,22 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hash_entries_.clear();
+}
+
+size_t BlockBuilder::NumHashBuckets() const {
+  // Keep the buckets about three quarters full.
+  return std::max<size_t>(1, hash_entries_.size() * 4 / 3);
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
+  size_t hash_index_size = 0;
+  if (hash_index_) {
+    hash_index_size = NumHashBuckets() + sizeof(uint32_t);
+  }
   return (buffer_.size() +                       // Raw data buffer
           restarts_.size() * sizeof(uint32_t) +  // Restart array
+          hash_index_size +                      // Hash index
           sizeof(uint32_t));                     // Restart array length
 }
 
@@ -63,7 +94,23 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t num_restarts = restarts_.size();
+  if (hash_index_ && num_restarts <= kBlockHashIndexMaxRestarts) {
+    const size_t num_buckets = NumHashBuckets();
+    std::string buckets(num_buckets, static_cast<char>(kBlockHashNoEntry));
+    for (const auto& entry : hash_entries_) {
+      char* bucket = &buckets[entry.first % num_buckets];
+      if (*bucket == static_cast<char>(kBlockHashNoEntry)) {
+        *bucket = static_cast<char>(entry.second);
+      } else if (*bucket != static_cast<char>(entry.second)) {
+        *bucket = static_cast<char>(kBlockHashCollision);
+      }
+    }
+    buffer_.append(buckets);
+    PutFixed32(&buffer_, num_buckets);
+    num_restarts |= kBlockHashIndexFlag;
+  }
+  PutFixed32(&buffer_, num_restarts);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -97,6 +144,16 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   buffer_.append(key.data() + shared, non_shared);
   buffer_.append(value.data(), value.size());
 
+  if (hash_index_ && key.size() >= 8) {
+    // Record the restart point the entry follows under the hash of its
+    // user key, once for each run of entries with the same hash.
+    const uint32_t h = Hash(key.data(), key.size() - 8, kBlockHashSeed);
+    const std::pair<uint32_t, uint32_t> entry(h, restarts_.size() - 1);
+    if (hash_entries_.empty() || hash_entries_.back() != entry) {
+      hash_entries_.push_back(entry);
+    }
+  }
+
   // Update state
   last_key_.resize(shared);
   last_key_.append(key.data() + shared, non_shared);
@@ -6,6 +6,8 @@
 #define STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
 
 #include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "leveldb/slice.h"
@@ -16,7 +18,9 @@ struct Options;
 
 class BlockBuilder {
  public:
-  explicit BlockBuilder(const Options* options);
+  // If "hash_index" is set, the keys added must be internal keys, and the
+  // block ends in a hash index of their user keys.
+  explicit BlockBuilder(const Options* options, bool hash_index = false);
 
   BlockBuilder(const BlockBuilder&) = delete;
   BlockBuilder& operator=(const BlockBuilder&) = delete;
@@ -41,12 +45,18 @@ class BlockBuilder {
   bool empty() const { return buffer_.empty(); }
 
  private:
+  size_t NumHashBuckets() const;
+
   const Options* options_;
+  const bool hash_index_;
   std::string buffer_;              // Destination buffer
   std::vector<uint32_t> restarts_;  // Restart points
   int counter_;                     // Number of entries emitted since restart
   bool finished_;                   // Has Finish() been called?
   std::string last_key_;
+
+  // (Hash of user key, restart point) for the entries added so far.
+  std::vector<std::pair<uint32_t, uint32_t>> hash_entries_;
 };
 
 }  // namespace leveldb
@@ -15,10 +15,18 @@ namespace leveldb {
 static const size_t kFilterBaseLg = 11;
 static const size_t kFilterBase = 1 << kFilterBaseLg;
 
-FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {}
+// A whole-table filter is encoded as the only filter of a block with a
+// base so large that every block offset maps to it.
+static const size_t kWholeTableFilterBaseLg = 63;
+
+FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy,
+                                       bool whole_table)
+    : policy_(policy), whole_table_(whole_table), has_last_prefix_(false) {}
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
+  if (whole_table_) {
+    return;
+  }
   uint64_t filter_index = (block_offset / kFilterBase);
   assert(filter_index >= filter_offsets_.size());
   while (filter_index > filter_offsets_.size()) {
@@ -32,8 +40,17 @@ void FilterBlockBuilder::AddKey(const Slice& key) {
   keys_.append(k.data(), k.size());
 }
 
+void FilterBlockBuilder::AddPrefix(const Slice& prefix_key) {
+  if (has_last_prefix_ && Slice(last_prefix_) == prefix_key) {
+    return;
+  }
+  has_last_prefix_ = true;
+  last_prefix_.assign(prefix_key.data(), prefix_key.size());
+  AddKey(prefix_key);
+}
+
 Slice FilterBlockBuilder::Finish() {
-  if (!start_.empty()) {
+  if (!start_.empty() || whole_table_) {
     GenerateFilter();
   }
 
@@ -44,11 +61,13 @@ Slice FilterBlockBuilder::Finish() {
   }
 
   PutFixed32(&result_, array_offset);
-  result_.push_back(kFilterBaseLg);  // Save encoding parameter in result
+  // Save encoding parameter in result
+  result_.push_back(whole_table_ ? kWholeTableFilterBaseLg : kFilterBaseLg);
   return Slice(result_);
 }
 
 void FilterBlockBuilder::GenerateFilter() {
+  has_last_prefix_ = false;
   const size_t num_keys = start_.size();
   if (num_keys == 0) {
     // Fast path if there are no keys for this filter
@@ -76,15 +95,22 @@ void FilterBlockBuilder::GenerateFilter() {
 
 FilterBlockReader::FilterBlockReader(const FilterPolicy* policy,
                                      const Slice& contents)
-    : policy_(policy), data_(nullptr), offset_(nullptr), num_(0), base_lg_(0) {
+    : policy_(policy),
+      data_(nullptr),
+      offset_(nullptr),
+      num_(0),
+      base_lg_(0),
+      whole_table_(false) {
   size_t n = contents.size();
   if (n < 5) return;  // 1 byte for base_lg_ and 4 for start of offset array
   base_lg_ = contents[n - 1];
+  if (base_lg_ > kWholeTableFilterBaseLg) return;
   uint32_t last_word = DecodeFixed32(contents.data() + n - 5);
   if (last_word > n - 5) return;
   data_ = contents.data();
   offset_ = data_ + last_word;
   num_ = (n - 5 - last_word) / 4;
+  whole_table_ = (base_lg_ == kWholeTableFilterBaseLg && num_ == 1);
 }
 
 bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
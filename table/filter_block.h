@@ -26,24 +26,36 @@ class FilterPolicy;
 // a special block in the Table.
 //
 // The sequence of calls to FilterBlockBuilder must match the regexp:
-//      (StartBlock AddKey*)* Finish
+//      (StartBlock (AddKey | AddPrefix)*)* Finish
+//
+// If "whole_table" is set, a single filter covers the keys of all blocks.
 class FilterBlockBuilder {
  public:
-  explicit FilterBlockBuilder(const FilterPolicy*);
+  explicit FilterBlockBuilder(const FilterPolicy*, bool whole_table = false);
 
   FilterBlockBuilder(const FilterBlockBuilder&) = delete;
   FilterBlockBuilder& operator=(const FilterBlockBuilder&) = delete;
 
   void StartBlock(uint64_t block_offset);
   void AddKey(const Slice& key);
+
+  // Like AddKey(), for the key "prefix_key" that stands for the prefix of
+  // the keys added next.  The keys of one prefix are added in a row, so
+  // a prefix key equal to the last one added to the same filter is only
+  // added once.
+  void AddPrefix(const Slice& prefix_key);
+
   Slice Finish();
 
  private:
   void GenerateFilter();
 
   const FilterPolicy* policy_;
+  const bool whole_table_;
   std::string keys_;             // Flattened key contents
   std::vector<size_t> start_;    // Starting index in keys_ of each key
+  bool has_last_prefix_;         // Has a prefix key been added to keys_?
+  std::string last_prefix_;      // The last one, if so
   std::string result_;           // Filter data computed so far
   std::vector<Slice> tmp_keys_;  // policy_->CreateFilter() argument
   std::vector<uint32_t> filter_offsets_;
@@ -55,12 +67,17 @@ class FilterBlockReader {
   FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
 
+  // Does a single filter cover the whole table?  If so, KeyMayMatch()
+  // gives the same answer for every block_offset.
+  bool whole_table() const { return whole_table_; }
+
  private:
   const FilterPolicy* policy_;
   const char* data_;    // Pointer to filter data (at block-start)
   const char* offset_;  // Pointer to beginning of offset array (at block-end)
   size_t num_;          // Number of entries in offset array
   size_t base_lg_;      // Encoding parameter (see kFilterBaseLg in .cc file)
+  bool whole_table_;
 };
 
 }  // namespace leveldb
@@ -119,6 +119,78 @@ TEST_F(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST_F(FilterBlockTest, WholeTable) {
+  FilterBlockBuilder builder(&policy_, true);
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(3100);
+  builder.AddKey("bar");
+  builder.StartBlock(9000);
+  builder.AddKey("box");
+
+  // Three hashes, a single filter offset, the offset of that and the
+  // encoding parameter
+  Slice block = builder.Finish();
+  ASSERT_EQ(3 * 4 + 4 + 4 + 1, block.size());
+  FilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.whole_table());
+  for (uint64_t offset : {0, 3100, 9000, 1 << 30}) {
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "foo"));
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "bar"));
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "box"));
+    ASSERT_TRUE(!reader.KeyMayMatch(offset, "hello"));
+  }
+}
+
+TEST_F(FilterBlockTest, EmptyWholeTable) {
+  FilterBlockBuilder builder(&policy_, true);
+  Slice block = builder.Finish();
+  FilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.whole_table());
+  ASSERT_TRUE(!reader.KeyMayMatch(0, "foo"));
+  ASSERT_TRUE(!reader.KeyMayMatch(100000, "foo"));
+
+  // Blocks with a filter per 2KB are not mistaken for one.
+  FilterBlockBuilder per_block(&policy_);
+  per_block.StartBlock(0);
+  per_block.AddKey("foo");
+  FilterBlockReader per_block_reader(&policy_, per_block.Finish());
+  ASSERT_TRUE(!per_block_reader.whole_table());
+}
+
+TEST_F(FilterBlockTest, Prefixes) {
+  FilterBlockBuilder builder(&policy_);
+
+  // First filter
+  builder.StartBlock(0);
+  builder.AddPrefix("a:");
+  builder.AddKey("a:1");
+  builder.AddPrefix("a:");  // Dropped
+  builder.AddKey("a:2");
+  builder.AddPrefix("b:");
+  builder.AddKey("b:1");
+
+  // Second filter, which needs the prefix again
+  builder.StartBlock(3100);
+  builder.AddPrefix("b:");
+  builder.AddKey("b:2");
+
+  // Seven hashes, two filter offsets, the offset of those and the encoding
+  // parameter
+  Slice block = builder.Finish();
+  ASSERT_EQ(7 * 4 + 2 * 4 + 4 + 1, block.size());
+  FilterBlockReader reader(&policy_, block);
+
+  ASSERT_TRUE(reader.KeyMayMatch(0, "a:"));
+  ASSERT_TRUE(reader.KeyMayMatch(0, "a:2"));
+  ASSERT_TRUE(reader.KeyMayMatch(0, "b:"));
+  ASSERT_TRUE(!reader.KeyMayMatch(0, "c:"));
+
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "b:"));
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "b:2"));
+  ASSERT_TRUE(!reader.KeyMayMatch(3100, "a:"));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -62,12 +62,17 @@ class Footer {
   const BlockHandle& index_handle() const { return index_handle_; }
   void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
 
+  // Is the index block the top level of a partitioned index?
+  bool partitioned_index() const { return partitioned_index_; }
+  void set_partitioned_index(bool p) { partitioned_index_ = p; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  bool partitioned_index_ = false;
 };
 
 // kTableMagicNumber was picked by running
@@ -75,9 +80,27 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// Tables with a partitioned index end in kPartitionedTableMagicNumber
+// instead, so that versions of leveldb that cannot read them reject
+// them.  Picked like kTableMagicNumber, from
+//    echo -n http://code.google.com/p/leveldb/partitioned-index | sha1sum
+static const uint64_t kPartitionedTableMagicNumber = 0xdc61c290f7e9671aull;
+
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// A block's restart count has this bit set if a hash index of the user
+// keys in it follows its restart array (see block_builder.cc).
+static const uint32_t kBlockHashIndexFlag = 1u << 31;
+
+// Buckets of the hash index hold a restart point number below
+// kBlockHashIndexMaxRestarts, or one of the following.
+static const uint32_t kBlockHashIndexMaxRestarts = 254;
+static const uint8_t kBlockHashCollision = 254;
+static const uint8_t kBlockHashNoEntry = 255;
+
+static const uint32_t kBlockHashSeed = 0x9e3779b9;
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
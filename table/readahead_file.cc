@@ -0,0 +1,88 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "table/readahead_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace leveldb {
+
+const size_t ReadaheadFile::kInitialReadahead;
+const size_t ReadaheadFile::kMaxReadahead;
+
+ReadaheadFile::ReadaheadFile(RandomAccessFile* file, size_t readahead_size)
+    : file_(file),
+      fixed_(readahead_size > 0),
+      max_size_(fixed_ ? readahead_size : kMaxReadahead),
+      size_(fixed_ ? readahead_size : kInitialReadahead),
+      passthrough_(false),
+      sequential_reads_(0),
+      next_offset_(~static_cast<uint64_t>(0)),
+      buffer_(nullptr),
+      buffer_capacity_(0),
+      buffer_size_(0),
+      buffer_offset_(0) {}
+
+ReadaheadFile::~ReadaheadFile() { delete[] buffer_; }
+
+Status ReadaheadFile::Read(uint64_t offset, size_t n, Slice* result,
+                           char* scratch) const {
+  const bool sequential = (offset == next_offset_);
+  next_offset_ = offset + n;
+  if (offset >= buffer_offset_ &&
+      offset + n <= buffer_offset_ + buffer_size_) {
+    std::memcpy(scratch, buffer_ + (offset - buffer_offset_), n);
+    *result = Slice(scratch, n);
+    return Status::OK();
+  }
+
+  if (!fixed_) {
+    if (sequential) {
+      sequential_reads_++;
+    } else {
+      sequential_reads_ = 0;
+      size_ = kInitialReadahead;
+    }
+  }
+  if (passthrough_ || (!fixed_ && sequential_reads_ < 2)) {
+    Status s = file_->Read(offset, n, result, scratch);
+    if (s.ok() && !result->empty() && result->data() != scratch) {
+      passthrough_ = true;
+    }
+    return s;
+  }
+
+  const size_t len = std::max(n, size_);
+  if (len > buffer_capacity_) {
+    delete[] buffer_;
+    buffer_ = new char[len];
+    buffer_capacity_ = len;
+  }
+  buffer_size_ = 0;
+  Slice data;
+  Status s = file_->Read(offset, len, &data, buffer_);
+  if (!s.ok()) {
+    return s;
+  }
+  if (!data.empty() && data.data() != buffer_) {
+    // The file serves reads from its own memory; there is nothing to win.
+    passthrough_ = true;
+    *result = Slice(data.data(), std::min(n, data.size()));
+    return s;
+  }
+  buffer_size_ = data.size();
+  buffer_offset_ = offset;
+  if (!fixed_) {
+    size_ = std::min(2 * size_, max_size_);
+  }
+
+  // A short read means the end of the file.
+  const size_t size = std::min(n, buffer_size_);
+  std::memcpy(scratch, buffer_, size);
+  *result = Slice(scratch, size);
+  return s;
+}
+
+}  // namespace leveldb
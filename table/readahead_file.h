@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_TABLE_READAHEAD_FILE_H_
+#define STORAGE_LEVELDB_TABLE_READAHEAD_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+// A RandomAccessFile that turns a run of sequential reads of another file
+// into fewer, larger reads of it.  Each table iterator reads its data
+// blocks through its own ReadaheadFile, so that a scan does not issue one
+// small read per block.
+//
+// With a zero "readahead_size", reads are passed through until two of
+// them in a row have been sequential.  From then on each read of the
+// underlying file fetches kInitialReadahead bytes, doubling with every
+// further read up to kMaxReadahead; a read that is not sequential starts
+// over.  A non-zero "readahead_size" fetches that many bytes with every
+// read instead.
+//
+// Reads are always copied into "scratch".  Files that hand out pointers
+// into their own memory (e.g. mmap-ed ones) gain nothing from readahead,
+// so once a read of "file" returns such a pointer, all reads are passed
+// through.
+//
+// Unlike other RandomAccessFiles, a ReadaheadFile is not safe for
+// concurrent use.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  static const size_t kInitialReadahead = 8 * 1024;
+  static const size_t kMaxReadahead = 256 * 1024;
+
+  // Does not take ownership of "file", which must remain live while this
+  // ReadaheadFile is in use.
+  ReadaheadFile(RandomAccessFile* file, size_t readahead_size);
+
+  ReadaheadFile(const ReadaheadFile&) = delete;
+  ReadaheadFile& operator=(const ReadaheadFile&) = delete;
+
+  ~ReadaheadFile() override;
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override;
+
+ private:
+  RandomAccessFile* const file_;
+  const bool fixed_;        // Read ahead from the first read on?
+  const size_t max_size_;   // Largest readahead
+  mutable size_t size_;     // Bytes fetched by the next readahead
+  mutable bool passthrough_;
+  mutable int sequential_reads_;  // Sequential reads since the last seek
+  mutable uint64_t next_offset_;  // Offset a sequential read starts at
+
+  // Bytes [buffer_offset_, buffer_offset_ + buffer_size_) of file_.
+  mutable char* buffer_;
+  mutable size_t buffer_capacity_;
+  mutable size_t buffer_size_;
+  mutable uint64_t buffer_offset_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_TABLE_READAHEAD_FILE_H_
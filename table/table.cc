@@ -11,9 +11,12 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/pinned_value.h"
+#include "leveldb/prefix_extractor.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
+#include "table/readahead_file.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 
@@ -32,9 +35,13 @@ struct Table::Rep {
   uint64_t cache_id;
   FilterBlockReader* filter;
   const char* filter_data;
+  bool partitioned_filter;  // Does each index partition have a filter?
+  bool prefix_filter;  // Do filters hold options.prefix_extractor's prefixes?
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
-  Block* index_block;
+  Block* index_block;  // The top level of the index, if partitioned_index
+  bool partitioned_index;
+  size_t memory_usage;  // Heap bytes held by index_block and filter_data
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -54,13 +61,32 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
   s = footer.DecodeFrom(&footer_input);
   if (!s.ok()) return s;
 
-  // Read the index block
-  BlockContents index_block_contents;
+  // The metaindex block comes right before the index block, so both are
+  // read at once if the metaindex is needed.
+  const BlockHandle& metaindex_handle = footer.metaindex_handle();
+  const BlockHandle& index_handle = footer.index_handle();
+  size_t tail_size = 0;
+  if (options.filter_policy != nullptr &&
+      metaindex_handle.offset() < index_handle.offset()) {
+    tail_size = index_handle.offset() + index_handle.size() +
+                kBlockTrailerSize - metaindex_handle.offset();
+  }
+  ReadaheadFile tail(file, tail_size);
+  BlockContents metaindex_contents;
+  bool have_metaindex = false;
   ReadOptions opt;
   if (options.paranoid_checks) {
     opt.verify_checksums = true;
   }
-  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+  if (options.filter_policy != nullptr) {
+    // Do not propagate errors since meta info is not needed for operation
+    have_metaindex = ReadBlock(&tail, opt, metaindex_handle,
+                               &metaindex_contents).ok();
+  }
+
+  // Read the index block
+  BlockContents index_block_contents;
+  s = ReadBlock(&tail, opt, index_handle, &index_block_contents);
 
   if (s.ok()) {
     // We've successfully read the footer and the index block: we're
@@ -71,40 +97,50 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->file = file;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
+    rep->memory_usage =
+        index_block_contents.heap_allocated ? index_block->size() : 0;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->partitioned_filter = false;
+    rep->prefix_filter = false;
+    rep->partitioned_index = footer.partitioned_index();
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    if (have_metaindex) {
+      (*table)->ReadMeta(metaindex_contents);
+    }
+  } else if (have_metaindex && metaindex_contents.heap_allocated) {
+    delete[] metaindex_contents.data.data();
   }
 
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
-  ReadOptions opt;
-  if (rep_->options.paranoid_checks) {
-    opt.verify_checksums = true;
-  }
-  BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
-    return;
-  }
+void Table::ReadMeta(const BlockContents& contents) {
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  std::string key;
+  if (rep_->partitioned_index) {
+    // The filters of the partitions are found through the top-level index.
+    key = "partitionedfilter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    rep_->partitioned_filter = iter->Valid() && iter->key() == Slice(key);
+  } else {
+    key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  if ((rep_->filter != nullptr || rep_->partitioned_filter) &&
+      rep_->options.prefix_extractor != nullptr) {
+    key = "prefix.";
+    key.append(rep_->options.prefix_extractor->Name());
+    iter->Seek(key);
+    rep_->prefix_filter = iter->Valid() && iter->key() == Slice(key);
   }
   delete iter;
   delete meta;
@@ -129,12 +165,17 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   }
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();  // Will need to delete later
+    rep_->memory_usage += block.data.size();
   }
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
 Table::~Table() { delete rep_; }
 
+size_t Table::ApproximateMemoryUsage() const {
+  return sizeof(Table) + sizeof(Rep) + rep_->memory_usage;
+}
+
 static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
 }
@@ -150,12 +191,195 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+static void DeleteBlockIterator(void* arg, void* ignored) {
+  delete reinterpret_cast<Iterator*>(arg);
+}
+
+// Delete "block_iter", or hand it to "pinned" to delete once the value
+// it holds has been released.
+static void ReleaseBlockIterator(Iterator* block_iter, PinnedValue* pinned) {
+  if (pinned != nullptr) {
+    pinned->RegisterCleanup(&DeleteBlockIterator, block_iter, nullptr);
+  } else {
+    delete block_iter;
+  }
+}
+
+namespace {
+
+// The argument Table::NewIterator() passes to its block function: the
+// table, and the file its blocks are read through.
+struct ReadaheadArg {
+  ReadaheadArg(Table* t, RandomAccessFile* f, size_t readahead_size)
+      : table(t), file(f, readahead_size) {}
+
+  Table* const table;
+  ReadaheadFile file;
+};
+
+void DeleteReadaheadArg(void* arg, void* ignored) {
+  delete reinterpret_cast<ReadaheadArg*>(arg);
+}
+
+// A filter partition, as kept in the block cache.
+struct FilterPartition {
+  FilterPartition(const FilterPolicy* policy, const BlockContents& contents)
+      : data(contents.heap_allocated ? contents.data.data() : nullptr),
+        reader(policy, contents.data) {}
+  ~FilterPartition() { delete[] data; }
+
+  const char* const data;  // Owned, unless nullptr
+  FilterBlockReader reader;
+};
+
+void DeleteCachedFilterPartition(const Slice& key, void* value) {
+  delete reinterpret_cast<FilterPartition*>(value);
+}
+
+}  // namespace
+
+// The index and filter that cover the keys a lookup is after: those of
+// the whole table or, if the index is partitioned, those of a partition.
+struct Table::Partition {
+  Partition() : filter(nullptr), owned_filter(nullptr), cache(nullptr),
+                cache_handle(nullptr) {}
+  ~Partition() { ReleaseFilter(); }
+
+  void ReleaseFilter() {
+    if (cache_handle != nullptr) {
+      cache->Release(cache_handle);
+      cache_handle = nullptr;
+    }
+    delete owned_filter;
+    owned_filter = nullptr;
+    filter = nullptr;
+  }
+
+  // For a partitioned index, the top-level index entry of the partition.
+  std::string index_value;
+  FilterBlockReader* filter;  // May be nullptr
+
+  // Whichever of these holds *filter for a partition, if any.
+  FilterPartition* owned_filter;
+  Cache* cache;
+  Cache::Handle* cache_handle;
+};
+
+void Table::LoadPartition(const ReadOptions& options, const Slice& index_value,
+                          Partition* partition) const {
+  partition->ReleaseFilter();
+  partition->index_value.assign(index_value.data(), index_value.size());
+  if (!rep_->partitioned_filter) {
+    return;
+  }
+
+  // The handle of the filter follows that of the index partition.
+  // Filters that cannot be read are not used.
+  Slice input = index_value;
+  BlockHandle index_handle, filter_handle;
+  if (!index_handle.DecodeFrom(&input).ok() ||
+      !filter_handle.DecodeFrom(&input).ok()) {
+    return;
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  EncodeFixed64(cache_key_buffer + 8, filter_handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (block_cache != nullptr) {
+    Cache::Handle* cache_handle = block_cache->Lookup(key);
+    if (cache_handle != nullptr) {
+      partition->filter =
+          &reinterpret_cast<FilterPartition*>(block_cache->Value(cache_handle))
+               ->reader;
+      partition->cache = block_cache;
+      partition->cache_handle = cache_handle;
+      return;
+    }
+  }
+  BlockContents contents;
+  if (!ReadBlock(rep_->file, options, filter_handle, &contents).ok()) {
+    return;
+  }
+  FilterPartition* filter =
+      new FilterPartition(rep_->options.filter_policy, contents);
+  partition->filter = &filter->reader;
+  if (block_cache != nullptr && contents.cachable && options.fill_cache) {
+    partition->cache = block_cache;
+    partition->cache_handle =
+        block_cache->Insert(key, filter, contents.data.size(),
+                            &DeleteCachedFilterPartition);
+  } else {
+    partition->owned_filter = filter;
+  }
+}
+
+bool Table::FindPartition(const ReadOptions& options, const Slice& k,
+                          Partition* partition, Status* status) const {
+  if (!rep_->partitioned_index) {
+    partition->filter = rep_->filter;
+    return true;
+  }
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iter->Seek(k);
+  const bool found = iter->Valid();
+  if (found) {
+    LoadPartition(options, iter->value(), partition);
+  }
+  *status = iter->status();
+  delete iter;
+  return found;
+}
+
+Iterator* Table::NewPartitionIndexIterator(const ReadOptions& options,
+                                           const Partition& partition) const {
+  if (!rep_->partitioned_index) {
+    return rep_->index_block->NewIterator(rep_->options.comparator);
+  }
+  // Index partitions are read like data blocks.
+  return const_cast<Table*>(this)->ReadBlockIterator(
+      rep_->file, options, partition.index_value, false);
+}
+
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  return table->ReadBlockIterator(table->rep_->file, options, index_value,
+                                  false);
+}
+
+Iterator* Table::NewIndexIterator(
+    const ReadOptions& options,
+    bool (*may_match)(void*, const ReadOptions&, const Slice&,
+                      const Slice&)) const {
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->partitioned_index) {
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                               const_cast<Table*>(this), options, may_match);
+  }
+  return iter;
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->ReadBlockIterator(table->rep_->file, options, index_value,
+                                  false);
+}
+
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadArg* ra = reinterpret_cast<ReadaheadArg*>(arg);
+  return ra->table->ReadBlockIterator(&ra->file, options, index_value, false);
+}
+
+Iterator* Table::ReadBlockIterator(RandomAccessFile* file,
+                                   const ReadOptions& options,
+                                   const Slice& index_value,
+                                   bool point_lookup) {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
@@ -169,14 +393,14 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     BlockContents contents;
     if (block_cache != nullptr) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
       EncodeFixed64(cache_key_buffer + 8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(file, options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
@@ -186,7 +410,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -195,7 +419,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator, point_lookup);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -207,33 +431,124 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
   return iter;
 }
 
+bool Table::PrefixMayMatchBlock(void* arg, const ReadOptions& options,
+                                const Slice& index_value, const Slice& target) {
+  ReadaheadArg* ra = reinterpret_cast<ReadaheadArg*>(arg);
+  return ra->table->BlockPrefixMayMatch(ra->table->rep_->filter, index_value,
+                                        target);
+}
+
+bool Table::PrefixMayMatchPartition(void* arg, const ReadOptions& options,
+                                    const Slice& index_value,
+                                    const Slice& target) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  Partition partition;
+  table->LoadPartition(options, index_value, &partition);
+  return partition.filter == nullptr ||
+         table->BlockPrefixMayMatch(partition.filter, Slice(), target);
+}
+
+bool Table::BlockPrefixMayMatch(FilterBlockReader* filter,
+                                const Slice& index_value,
+                                const Slice& target) const {
+  const PrefixExtractor* extractor = rep_->options.prefix_extractor;
+  const Slice user_key = ExtractUserKey(target);
+  if (!extractor->InDomain(user_key)) {
+    return true;
+  }
+  uint64_t block_offset = 0;  // Any will do for a whole-table filter
+  if (!filter->whole_table()) {
+    BlockHandle handle;
+    Slice input = index_value;
+    if (!handle.DecodeFrom(&input).ok()) {
+      return true;
+    }
+    block_offset = handle.offset();
+  }
+  std::string prefix_key;
+  SetPrefixFilterKey(extractor->Prefix(user_key), &prefix_key);
+  return filter->KeyMayMatch(block_offset, prefix_key);
+}
+
+bool Table::PrefixMayMatch(const Slice& target) const {
+  if (!rep_->prefix_filter) {
+    return true;
+  }
+  Partition partition;
+  Status s;
+  if (!FindPartition(ReadOptions(), target, &partition, &s)) {
+    return true;  // Past the end of the table, or an error
+  }
+  FilterBlockReader* filter = partition.filter;
+  if (filter == nullptr) {
+    return true;
+  }
+  if (filter->whole_table()) {
+    return BlockPrefixMayMatch(filter, Slice(), target);
+  }
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iiter->Seek(target);
+  bool may_match = true;
+  if (iiter->Valid()) {
+    may_match = BlockPrefixMayMatch(filter, iiter->value(), target);
+  }
+  delete iiter;
+  return may_match;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  // Iterators tend to read runs of adjacent blocks, so each reads its
+  // blocks through its own ReadaheadFile.
+  ReadaheadArg* arg = new ReadaheadArg(const_cast<Table*>(this), rep_->file,
+                                       options.readahead_size);
+  // In prefix-seek mode, a seek does not read the block (or with a
+  // partitioned index, the index partition) its target falls into if it
+  // has no key with the prefix of the target.  As keys with the same
+  // prefix are adjacent, none follows in later blocks either.
+  const bool prefix_seek = options.prefix_seek && rep_->prefix_filter;
+  const bool partitioned = rep_->partitioned_index;
+  Iterator* iter = NewTwoLevelIterator(
+      NewIndexIterator(options, (prefix_seek && partitioned)
+                                    ? &Table::PrefixMayMatchPartition
+                                    : nullptr),
+      &Table::ReadaheadBlockReader, arg, options,
+      (prefix_seek && !partitioned) ? &Table::PrefixMayMatchBlock : nullptr);
+  iter->RegisterCleanup(&DeleteReadaheadArg, arg, nullptr);
+  return iter;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
-                                                const Slice&)) {
+                                                const Slice&),
+                          PinnedValue* pinned) {
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Partition partition;
+  if (!FindPartition(options, k, &partition, &s)) {
+    return s;  // Past the end of the table
+  }
+  FilterBlockReader* filter = partition.filter;
+  if (filter != nullptr && filter->whole_table() &&
+      !filter->KeyMayMatch(0, k)) {
+    return s;  // Not found, without searching the index
+  }
+  Iterator* iiter = NewPartitionIndexIterator(options, partition);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
+    if (filter != nullptr && !filter->whole_table() &&
+        handle.DecodeFrom(&handle_value).ok() &&
         !filter->KeyMayMatch(handle.offset(), k)) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
+      Iterator* block_iter =
+          ReadBlockIterator(rep_->file, options, iiter->value(), true);
       block_iter->Seek(k);
       if (block_iter->Valid()) {
         (*handle_result)(arg, block_iter->key(), block_iter->value());
       }
       s = block_iter->status();
-      delete block_iter;
+      ReleaseBlockIterator(block_iter, pinned);
     }
   }
   if (s.ok()) {
@@ -243,11 +558,100 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
   return s;
 }
 
+void Table::InternalMultiGet(const ReadOptions& options, const Slice* keys,
+                             void* const* args, size_t n,
+                             void (*handle_result)(void*, const Slice&,
+                                                   const Slice&),
+                             Status* statuses) {
+  for (size_t i = 0; i < n; i++) {
+    statuses[i] = Status::OK();
+  }
+  const Comparator* const cmp = rep_->options.comparator;
+  // With a partitioned index, titer goes through the top-level index and
+  // iiter through the partition of the current key.
+  Iterator* titer = nullptr;
+  Partition partition;
+  if (rep_->partitioned_index) {
+    titer = rep_->index_block->NewIterator(cmp);
+  } else {
+    partition.filter = rep_->filter;
+  }
+  Iterator* iiter = nullptr;  // Created once a key needs it
+  Iterator* block_iter = nullptr;
+  uint64_t block_offset = 0;  // Offset of the block block_iter reads
+  // An error only fails the keys whose lookup ran into it, as it would
+  // with InternalGet(); the other keys carry on with the next block.
+  for (size_t i = 0; i < n; i++) {
+    const Slice& k = keys[i];
+    // Like blocks below, a partition covers every key up to its entry.
+    if (titer != nullptr &&
+        (!titer->Valid() || cmp->Compare(k, titer->key()) > 0)) {
+      titer->Seek(k);
+      if (!titer->Valid()) {
+        // The remaining keys are past the end of the table
+        for (; i < n; i++) {
+          statuses[i] = titer->status();
+        }
+        break;
+      }
+      delete iiter;
+      iiter = nullptr;
+      LoadPartition(options, titer->value(), &partition);
+    }
+    FilterBlockReader* const filter = partition.filter;
+    if (filter != nullptr && filter->whole_table() &&
+        !filter->KeyMayMatch(0, k)) {
+      continue;  // Not found, without searching the index
+    }
+    if (iiter == nullptr) {
+      iiter = NewPartitionIndexIterator(options, partition);
+    }
+    // The block of the previous key covers every key up to its index
+    // entry, so the index is only searched again once the keys move past
+    // it.
+    if (!iiter->Valid() || cmp->Compare(k, iiter->key()) > 0) {
+      iiter->Seek(k);
+      if (!iiter->Valid()) {
+        statuses[i] = iiter->status();  // Or past the end of the table
+        continue;
+      }
+    }
+
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&handle_value).ok()) {
+      statuses[i] = Status::Corruption("bad block handle");
+      continue;
+    }
+    if (filter != nullptr && !filter->whole_table() &&
+        !filter->KeyMayMatch(handle.offset(), k)) {
+      continue;  // Not found
+    }
+    if (block_iter == nullptr || block_offset != handle.offset()) {
+      delete block_iter;
+      block_iter = ReadBlockIterator(rep_->file, options, iiter->value(), true);
+      block_offset = handle.offset();
+    }
+    block_iter->Seek(k);
+    if (block_iter->Valid()) {
+      (*handle_result)(args[i], block_iter->key(), block_iter->value());
+    }
+    statuses[i] = block_iter->status();
+    if (statuses[i].ok()) {
+      statuses[i] = iiter->status();
+    }
+  }
+  delete block_iter;
+  delete iiter;
+  delete titer;
+}
+
 Status Table::InternalGetMV(const ReadOptions& options,
                             const Slice& k,
                             void* arg,
                             void (* handle_result)(void*, const Slice&,
-                                const ValidTimePeriod&, const Slice&)) {
+                                const ValidTimePeriod&, const Slice&),
+                            PinnedValue* pinned) {
   Status s;
   // Parse Multi-Version Timestamp
   ParsedMVInternalKey parsed_key;
@@ -255,7 +659,7 @@ Status Table::InternalGetMV(const ReadOptions& options,
   ValidTime target_valid_time = parsed_key.valid_time;
 
   // TODO： Find versions not in the same block
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* iiter = NewIndexIterator(options, nullptr);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
@@ -285,7 +689,7 @@ Status Table::InternalGetMV(const ReadOptions& options,
         (*handle_result)(arg, block_iter->key(), period, block_iter->value());
       }
       s = block_iter->status();
-      delete block_iter;
+      ReleaseBlockIterator(block_iter, pinned);
     }
   }
   if (s.ok()) {
@@ -314,7 +718,7 @@ Status Table::InternalGetMVRange(const ReadOptions& options,
 
     bool end_search = false;
 
-    Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+    Iterator* iiter = NewIndexIterator(options, nullptr);
     iiter->Seek(ikey);
     if (iiter->Valid()) {
       while (!end_search) {
@@ -381,8 +785,7 @@ Status Table::InternalGetMVRange(const ReadOptions& options,
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions(), nullptr);
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
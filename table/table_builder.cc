@@ -6,10 +6,12 @@
 
 #include <cassert>
 
+#include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/prefix_extractor.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -24,28 +26,39 @@ struct TableBuilder::Rep {
         index_block_options(opt),
         file(f),
         offset(0),
-        data_block(&options),
+        data_block(&options, opt.data_block_hash_index),
         index_block(&index_block_options),
+        top_level_index_block(&index_block_options),
         num_entries(0),
         closed(false),
-        filter_block(opt.filter_policy == nullptr
-                         ? nullptr
-                         : new FilterBlockBuilder(opt.filter_policy)),
+        filter_block(opt.filter_policy == nullptr ? nullptr
+                                                  : NewFilterBlockBuilder()),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
   }
 
+  // With a partitioned index, each partition has a filter of its own.
+  FilterBlockBuilder* NewFilterBlockBuilder() const {
+    return new FilterBlockBuilder(options.filter_policy,
+                                  options.whole_table_filter ||
+                                      options.index_partition_size > 0);
+  }
+
   Options options;
   Options index_block_options;
   WritableFile* file;
   uint64_t offset;
   Status status;
   BlockBuilder data_block;
-  BlockBuilder index_block;
+  BlockBuilder index_block;  // The current partition, if partitioned
+  // With a partitioned index, maps the last key of each partition to the
+  // handle of its index block, followed by that of its filter block.
+  BlockBuilder top_level_index_block;
   std::string last_key;
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  std::string prefix_key;  // Scratch space for the filter's prefix keys
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -82,6 +95,22 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.data_block_hash_index != rep_->options.data_block_hash_index) {
+    return Status::InvalidArgument(
+        "changing data_block_hash_index while building table");
+  }
+  if (options.whole_table_filter != rep_->options.whole_table_filter) {
+    return Status::InvalidArgument(
+        "changing whole_table_filter while building table");
+  }
+  if (options.prefix_extractor != rep_->options.prefix_extractor) {
+    return Status::InvalidArgument(
+        "changing prefix_extractor while building table");
+  }
+  if (options.index_partition_size != rep_->options.index_partition_size) {
+    return Status::InvalidArgument(
+        "changing index_partition_size while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
@@ -106,9 +135,23 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     r->pending_handle.EncodeTo(&handle_encoding);
     r->index_block.Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
+    if (r->options.index_partition_size > 0 &&
+        r->index_block.CurrentSizeEstimate() >=
+            r->options.index_partition_size) {
+      WriteIndexPartition();
+    }
   }
 
   if (r->filter_block != nullptr) {
+    const PrefixExtractor* extractor = r->options.prefix_extractor;
+    if (extractor != nullptr) {
+      // Table keys are internal keys when there is an extractor.
+      const Slice user_key = ExtractUserKey(key);
+      if (extractor->InDomain(user_key)) {
+        SetPrefixFilterKey(extractor->Prefix(user_key), &r->prefix_key);
+        r->filter_block->AddPrefix(r->prefix_key);
+      }
+    }
     r->filter_block->AddKey(key);
   }
 
@@ -193,6 +236,32 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   }
 }
 
+void TableBuilder::WriteIndexPartition() {
+  Rep* r = rep_;
+  if (!ok()) return;
+  // The filter holds the keys of exactly the blocks of the partition:
+  // those of the next block are only added once its first key is.
+  BlockHandle filter_handle;
+  if (r->filter_block != nullptr) {
+    WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_handle);
+    delete r->filter_block;
+    r->filter_block = r->NewFilterBlockBuilder();
+  }
+  BlockHandle index_handle;
+  if (ok()) {
+    WriteBlock(&r->index_block, &index_handle);
+  }
+  if (ok()) {
+    // r->last_key is the key of the last entry of the partition.
+    std::string handle_encoding;
+    index_handle.EncodeTo(&handle_encoding);
+    if (r->filter_block != nullptr) {
+      filter_handle.EncodeTo(&handle_encoding);
+    }
+    r->top_level_index_block.Add(r->last_key, Slice(handle_encoding));
+  }
+}
+
 Status TableBuilder::status() const { return rep_->status; }
 
 Status TableBuilder::Finish() {
@@ -202,9 +271,22 @@ Status TableBuilder::Finish() {
   r->closed = true;
 
   BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  const bool partitioned = r->options.index_partition_size > 0;
 
-  // Write filter block
-  if (ok() && r->filter_block != nullptr) {
+  if (partitioned) {
+    // Write the last partition
+    if (ok() && r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->pending_index_entry = false;
+    }
+    if (!r->index_block.empty()) {
+      WriteIndexPartition();
+    }
+  } else if (ok() && r->filter_block != nullptr) {
+    // Write filter block
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
@@ -213,12 +295,30 @@ Status TableBuilder::Finish() {
   if (ok()) {
     BlockBuilder meta_index_block(&r->options);
     if (r->filter_block != nullptr) {
-      // Add mapping from "filter.Name" to location of filter data
-      std::string key = "filter.";
-      key.append(r->options.filter_policy->Name());
-      std::string handle_encoding;
-      filter_block_handle.EncodeTo(&handle_encoding);
-      meta_index_block.Add(key, handle_encoding);
+      std::string key;
+      if (partitioned) {
+        // Record that the partitions have filters, and of which policy.
+        // They are found through the top-level index.
+        key = "partitionedfilter.";
+        key.append(r->options.filter_policy->Name());
+        meta_index_block.Add(key, Slice());
+      } else {
+        // Add mapping from "filter.Name" to location of filter data
+        key = "filter.";
+        key.append(r->options.filter_policy->Name());
+        std::string handle_encoding;
+        filter_block_handle.EncodeTo(&handle_encoding);
+        meta_index_block.Add(key, handle_encoding);
+      }
+
+      if (r->options.prefix_extractor != nullptr) {
+        // Record that the filters hold the prefixes of the keys, and
+        // which ones.  "prefix." sorts after "filter." and
+        // "partitionedfilter.".
+        key = "prefix.";
+        key.append(r->options.prefix_extractor->Name());
+        meta_index_block.Add(key, Slice());
+      }
     }
 
     // TODO(postrelease): Add stats and other meta blocks
@@ -227,14 +327,18 @@ Status TableBuilder::Finish() {
 
   // Write index block
   if (ok()) {
-    if (r->pending_index_entry) {
-      r->options.comparator->FindShortSuccessor(&r->last_key);
-      std::string handle_encoding;
-      r->pending_handle.EncodeTo(&handle_encoding);
-      r->index_block.Add(r->last_key, Slice(handle_encoding));
-      r->pending_index_entry = false;
+    if (partitioned) {
+      WriteBlock(&r->top_level_index_block, &index_block_handle);
+    } else {
+      if (r->pending_index_entry) {
+        r->options.comparator->FindShortSuccessor(&r->last_key);
+        std::string handle_encoding;
+        r->pending_handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(r->last_key, Slice(handle_encoding));
+        r->pending_index_entry = false;
+      }
+      WriteBlock(&r->index_block, &index_block_handle);
     }
-    WriteBlock(&r->index_block, &index_block_handle);
   }
 
   // Write footer
@@ -242,6 +346,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_partitioned_index(partitioned);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -13,6 +13,7 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
@@ -109,14 +110,18 @@ class StringSink : public WritableFile {
 class StringSource : public RandomAccessFile {
  public:
   StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {}
+      : contents_(contents.data(), contents.size()), num_reads_(0) {}
 
   ~StringSource() override = default;
 
   uint64_t Size() const { return contents_.size(); }
 
+  // Number of Read() calls so far.
+  int num_reads() const { return num_reads_; }
+
   Status Read(uint64_t offset, size_t n, Slice* result,
               char* scratch) const override {
+    num_reads_++;
     if (offset >= contents_.size()) {
       return Status::InvalidArgument("invalid Read offset");
     }
@@ -130,6 +135,7 @@ class StringSource : public RandomAccessFile {
 
  private:
   std::string contents_;
+  mutable int num_reads_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -181,7 +187,7 @@ class BlockConstructor : public Constructor {
   Status FinishImpl(const Options& options, const KVMap& data) override {
     delete block_;
     block_ = nullptr;
-    BlockBuilder builder(&options);
+    BlockBuilder builder(&options, options.data_block_hash_index);
 
     for (const auto& kvp : data) {
       builder.Add(kvp.first, kvp.second);
@@ -230,6 +236,7 @@ class TableConstructor : public Constructor {
     source_ = new StringSource(sink.contents());
     Options table_options;
     table_options.comparator = options.comparator;
+    table_options.filter_policy = options.filter_policy;
     return Table::Open(table_options, source_, sink.contents().size(), &table_);
   }
 
@@ -237,10 +244,20 @@ class TableConstructor : public Constructor {
     return table_->NewIterator(ReadOptions());
   }
 
+  Iterator* NewIterator(const ReadOptions& options) const {
+    return table_->NewIterator(options);
+  }
+
+  int NumFileReads() const { return source_->num_reads(); }
+
   uint64_t ApproximateOffsetOf(const Slice& key) const {
     return table_->ApproximateOffsetOf(key);
   }
 
+  size_t ApproximateMemoryUsage() const {
+    return table_->ApproximateMemoryUsage();
+  }
+
  private:
   void Reset() {
     delete table_;
@@ -372,10 +389,14 @@ class DBConstructor : public Constructor {
 
 enum TestType { TABLE_TEST, BLOCK_TEST, MEMTABLE_TEST, DB_TEST };
 
+// Trailing fields left out of an initializer are false or 0, which are
+// the defaults of the options they set.
 struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool hash_index;  // Options::data_block_hash_index
+  size_t index_partition_size;
 };
 
 static const TestArgs kTestArgList[] = {
@@ -393,6 +414,15 @@ static const TestArgs kTestArgList[] = {
     {BLOCK_TEST, true, 1},
     {BLOCK_TEST, true, 1024},
 
+    // Iterators ignore the hash index, but must still find the restarts
+    {TABLE_TEST, false, 16, true},
+    {BLOCK_TEST, false, 16, true},
+    {BLOCK_TEST, true, 1, true},
+
+    // Index partitions of a few entries each
+    {TABLE_TEST, false, 16, false, 128},
+    {TABLE_TEST, true, 1, false, 128},
+
     // Restart interval does not matter for memtables
     {MEMTABLE_TEST, false, 16},
     {MEMTABLE_TEST, true, 16},
@@ -413,6 +443,8 @@ class Harness : public testing::Test {
     options_ = Options();
 
     options_.block_restart_interval = args.restart_interval;
+    options_.data_block_hash_index = args.hash_index;
+    options_.index_partition_size = args.index_partition_size;
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
@@ -745,6 +777,64 @@ TEST(MemTableTest, Simple) {
   memtable->Unref();
 }
 
+TEST(BlockTest, HashIndexPointLookups) {
+  InternalKeyComparator cmp(BytewiseComparator());
+  Options options;
+  options.comparator = &cmp;
+  options.block_restart_interval = 4;
+
+  for (bool hash_index : {false, true}) {
+    // Every other user key, some with enough versions to span restart
+    // points.
+    BlockBuilder builder(&options, hash_index);
+    for (int i = 0; i < 200; i += 2) {
+      const std::string user_key = "key" + std::to_string(1000 + i);
+      for (SequenceNumber seq = (i % 20 == 0) ? 6 : 1; seq > 0; seq--) {
+        builder.Add(InternalKey(user_key, seq, kTypeValue).Encode(),
+                    user_key + "@" + std::to_string(seq));
+      }
+    }
+    const std::string data = builder.Finish().ToString();
+    BlockContents contents;
+    contents.data = data;
+    contents.cachable = false;
+    contents.heap_allocated = false;
+    Block block(contents);
+
+    // Point lookups find what Seek() does, unless that is an entry for
+    // another user key.
+    Iterator* seek_iter = block.NewIterator(&cmp);
+    Iterator* get_iter = block.NewIterator(&cmp, true);
+    int ruled_out = 0;
+    for (int i = 0; i < 200; i++) {
+      const std::string user_key = "key" + std::to_string(1000 + i);
+      for (SequenceNumber seq : {kMaxSequenceNumber, SequenceNumber(3),
+                                 SequenceNumber(0)}) {
+        LookupKey lkey(user_key, seq);
+        seek_iter->Seek(lkey.internal_key());
+        get_iter->Seek(lkey.internal_key());
+        if (get_iter->Valid()) {
+          ASSERT_TRUE(seek_iter->Valid());
+          ASSERT_EQ(seek_iter->key().ToString(), get_iter->key().ToString());
+          ASSERT_EQ(seek_iter->value().ToString(),
+                    get_iter->value().ToString());
+        } else if (seek_iter->Valid()) {
+          ASSERT_NE(user_key, ExtractUserKey(seek_iter->key()).ToString());
+          if (i % 2 == 1) ruled_out++;
+        }
+      }
+      ASSERT_LEVELDB_OK(get_iter->status());
+    }
+    if (hash_index) {
+      ASSERT_GT(ruled_out, 3 * 25);
+    } else {
+      ASSERT_EQ(0, ruled_out);
+    }
+    delete seek_iter;
+    delete get_iter;
+  }
+}
+
 static bool Between(uint64_t val, uint64_t low, uint64_t high) {
   bool result = (val >= low) && (val <= high);
   if (!result) {
@@ -784,6 +874,119 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+// Scan the table "c" holds with "options", returning the number of reads
+// of its file the scan took.
+static int ScanFileReads(const TableConstructor& c,
+                         const ReadOptions& options, const KVMap& data) {
+  const int before = c.NumFileReads();
+  Iterator* iter = c.NewIterator(options);
+  KVMap::const_iterator model = data.begin();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++model) {
+    EXPECT_TRUE(model != data.end());
+    EXPECT_EQ(model->first, iter->key().ToString());
+    EXPECT_EQ(model->second, iter->value().ToString());
+  }
+  EXPECT_TRUE(model == data.end());
+  EXPECT_LEVELDB_OK(iter->status());
+  delete iter;
+  return c.NumFileReads() - before;
+}
+
+TEST(TableTest, ReadaheadScan) {
+  TableConstructor c(BytewiseComparator());
+  Random rnd(301);
+  for (int i = 0; i < 2000; i++) {
+    char key[20];
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    std::string value;
+    c.Add(key, test::RandomString(&rnd, 200, &value));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  c.Finish(options, &keys, &kvmap);
+
+  // The table has some 400 blocks of about 1KB, which a scan without
+  // readahead would read one by one.
+  const int adaptive = ScanFileReads(c, ReadOptions(), kvmap);
+  ASSERT_GT(adaptive, 2);
+  ASSERT_LT(adaptive, 20);
+
+  ReadOptions fixed;
+  fixed.readahead_size = 64 * 1024;
+  const int fixed_reads = ScanFileReads(c, fixed, kvmap);
+  ASSERT_GT(fixed_reads, 4);
+  ASSERT_LT(fixed_reads, 12);
+
+  // Seeks around the table do not read ahead.
+  Iterator* iter = c.NewIterator(ReadOptions());
+  const int before = c.NumFileReads();
+  for (int i = 0; i < 50; i++) {
+    iter->Seek(keys[rnd.Uniform(keys.size())]);
+    ASSERT_TRUE(iter->Valid());
+  }
+  ASSERT_LE(c.NumFileReads() - before, 50);
+  delete iter;
+}
+
+TEST(TableTest, PartitionedIndex) {
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  TableConstructor plain(BytewiseComparator());
+  TableConstructor partitioned(BytewiseComparator());
+  Random rnd(301);
+  for (int i = 0; i < 5000; i++) {
+    char key[20];
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    std::string value;
+    test::RandomString(&rnd, 100, &value);
+    plain.Add(key, value);
+    partitioned.Add(key, value);
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.filter_policy = policy;
+  plain.Finish(options, &keys, &kvmap);
+  options.index_partition_size = 1024;
+  partitioned.Finish(options, &keys, &kvmap);
+
+  // Opening the table reads its footer, and then its metaindex and
+  // top-level index at once.  Only the latter stays in memory.
+  ASSERT_EQ(2, partitioned.NumFileReads());
+  ASSERT_LT(partitioned.ApproximateMemoryUsage() * 10,
+            plain.ApproximateMemoryUsage());
+
+  // A seek reads one index partition and one data block.
+  Iterator* iter = partitioned.NewIterator(ReadOptions());
+  const int before = partitioned.NumFileReads();
+  iter->Seek("k002500");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k002500", iter->key().ToString());
+  ASSERT_EQ(2, partitioned.NumFileReads() - before);
+  iter->Seek("k002500a");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k002501", iter->key().ToString());
+  iter->Seek("k9");
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+
+  ScanFileReads(partitioned, ReadOptions(), kvmap);
+
+  // The index and filter partitions (tens of KB in all) take room between
+  // the data blocks.
+  for (int i = 0; i < 5000; i += 100) {
+    const uint64_t offset = plain.ApproximateOffsetOf(keys[i]);
+    ASSERT_TRUE(Between(partitioned.ApproximateOffsetOf(keys[i]), offset,
+                        offset + 64 * 1024));
+  }
+  delete policy;
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -14,11 +14,14 @@ namespace leveldb {
 namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
+typedef bool (*MayMatchFunction)(void*, const ReadOptions&, const Slice&,
+                                 const Slice&);
 
 class TwoLevelIterator : public Iterator {
  public:
   TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+                   void* arg, const ReadOptions& options,
+                   MayMatchFunction may_match);
 
   ~TwoLevelIterator() override;
 
@@ -58,6 +61,7 @@ class TwoLevelIterator : public Iterator {
   void InitDataBlock();
 
   BlockFunction block_function_;
+  MayMatchFunction may_match_;  // May be nullptr
   void* arg_;
   const ReadOptions options_;
   Status status_;
@@ -70,8 +74,10 @@ class TwoLevelIterator : public Iterator {
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   const ReadOptions& options,
+                                   MayMatchFunction may_match)
     : block_function_(block_function),
+      may_match_(may_match),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
@@ -81,6 +87,11 @@ TwoLevelIterator::~TwoLevelIterator() = default;
 
 void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
+  if (may_match_ != nullptr && index_iter_.Valid() &&
+      !(*may_match_)(arg_, options_, index_iter_.value(), target)) {
+    SetDataIterator(nullptr);
+    return;
+  }
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
   SkipEmptyDataBlocksForward();
@@ -164,8 +175,10 @@ void TwoLevelIterator::InitDataBlock() {
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
-                              const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+                              const ReadOptions& options,
+                              MayMatchFunction may_match) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              may_match);
 }
 
 }  // namespace leveldb
@@ -20,11 +20,20 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "may_match" is non-null, Seek(target) first passes it the index_iter
+// value of the block "target" falls into, and if it returns false, leaves
+// the iterator invalid without reading any block.  It is meant for
+// iterators that are only interested in the entries right after a target,
+// and returns false if the block has none of them.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(void* arg, const ReadOptions& options,
                                 const Slice& index_value),
-    void* arg, const ReadOptions& options);
+    void* arg, const ReadOptions& options,
+    bool (*may_match)(void* arg, const ReadOptions& options,
+                      const Slice& index_value,
+                      const Slice& target) = nullptr);
 
 }  // namespace leveldb
 
@@ -11,6 +11,9 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
 class Arena {
@@ -28,6 +31,11 @@ class Arena {
   // Allocate memory with the normal alignment guarantees provided by malloc.
   char* AllocateAligned(size_t bytes);
 
+  // Variants of Allocate() and AllocateAligned() that may be called by
+  // several threads at once.  They must not race with the plain variants.
+  char* AllocateConcurrently(size_t bytes) LOCKS_EXCLUDED(mu_);
+  char* AllocateAlignedConcurrently(size_t bytes) LOCKS_EXCLUDED(mu_);
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   size_t MemoryUsage() const {
@@ -50,6 +58,9 @@ class Arena {
   // TODO(costan): This member is accessed via atomics, but the others are
   //               accessed without any locking. Is this OK?
   std::atomic<size_t> memory_usage_;
+
+  // Serializes the *Concurrently() allocation methods.
+  port::Mutex mu_;
 };
 
 inline char* Arena::Allocate(size_t bytes) {
@@ -4,6 +4,11 @@
 
 #include "leveldb/filter_policy.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEVELDB_BLOOM_AVX2 1
+#include <immintrin.h>
+#endif
+
 #include "leveldb/slice.h"
 #include "util/hash.h"
 
@@ -83,10 +88,144 @@ class BloomFilterPolicy : public FilterPolicy {
   size_t bits_per_key_;
   size_t k_;
 };
+
+// A blocked bloom filter is an array of 64-byte blocks followed by the
+// number of probes and the format version, a byte each.  All the probes
+// for a key fall into the one block picked by its hash.
+static const size_t kBloomBlockBytes = 64;
+static const size_t kBloomBlockBits = kBloomBlockBytes * 8;
+static const char kBlockedBloomFormat = 1;
+
+// Each probe multiplies the hash by kProbeMultiplier and takes the top
+// nine bits of the result as the bit to probe in the block.
+static const uint32_t kProbeMultiplier = 0x9e3779b9;
+
+static uint32_t BlockedBloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0x5bd1e995);
+}
+
+// Returns the block of a filter with "num_blocks" blocks that hash "h"
+// falls into.
+static inline size_t BloomBlock(uint32_t h, size_t num_blocks) {
+  return static_cast<size_t>((static_cast<uint64_t>(h) * num_blocks) >> 32);
+}
+
+static bool BlockMayMatch(const char* block, uint32_t h, int num_probes) {
+  for (int i = 0; i < num_probes; i++) {
+    h *= kProbeMultiplier;
+    const uint32_t bitpos = h >> 23;
+    if ((block[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
+  }
+  return true;
+}
+
+#if defined(LEVELDB_BLOOM_AVX2)
+// Same as BlockMayMatch(), eight probes at a time.  Reading the block as
+// little-endian 32-bit words leaves the position of each bit unchanged.
+__attribute__((target("avx2"))) static bool BlockMayMatchAVX2(
+    const char* block, uint32_t h, int num_probes) {
+  // kProbeMultiplier to the powers 1 to 8, the multipliers of the next
+  // eight probes.
+  const __m256i multipliers =
+      _mm256_setr_epi32(0x9e3779b9, 0xe35e67b1, 0x734297e9, 0x35fbe861,
+                        0xdeb7c719, 0x0448b211, 0x3459b749, 0xab25f4c1);
+  const uint32_t kProbeMultiplier8 = 0xab25f4c1;
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const int* words = reinterpret_cast<const int*>(block);
+  for (int i = 0; i < num_probes; i += 8) {
+    const __m256i hashes =
+        _mm256_mullo_epi32(_mm256_set1_epi32(h), multipliers);
+    const __m256i bitpos = _mm256_srli_epi32(hashes, 23);
+    const __m256i probed =
+        _mm256_i32gather_epi32(words, _mm256_srli_epi32(bitpos, 5), 4);
+    __m256i bits = _mm256_sllv_epi32(
+        _mm256_set1_epi32(1), _mm256_and_si256(bitpos, _mm256_set1_epi32(31)));
+    // Lanes past the last probe test no bit.
+    bits = _mm256_and_si256(
+        bits, _mm256_cmpgt_epi32(_mm256_set1_epi32(num_probes - i), lanes));
+    if (!_mm256_testc_si256(probed, bits)) return false;
+    h *= kProbeMultiplier8;
+  }
+  return true;
+}
+
+static bool HaveAVX2() {
+  static const bool have_avx2 = __builtin_cpu_supports("avx2");
+  return have_avx2;
+}
+#endif  // defined(LEVELDB_BLOOM_AVX2)
+
+class BlockedBloomFilterPolicy : public FilterPolicy {
+ public:
+  explicit BlockedBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key) {
+    // Same number of probes as BloomFilterPolicy
+    k_ = static_cast<int>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > 30) k_ = 30;
+  }
+
+  // The format has a version of its own, so the name stays the same.
+  const char* Name() const override { return "leveldb.BlockedBloomFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    size_t num_blocks = (n * bits_per_key_ + kBloomBlockBits - 1) /
+                        kBloomBlockBits;
+    if (num_blocks == 0) num_blocks = 1;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + num_blocks * kBloomBlockBytes, 0);
+    dst->push_back(static_cast<char>(k_));
+    dst->push_back(kBlockedBloomFormat);
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      uint32_t h = BlockedBloomHash(keys[i]);
+      char* block = array + BloomBlock(h, num_blocks) * kBloomBlockBytes;
+      for (int j = 0; j < k_; j++) {
+        h *= kProbeMultiplier;
+        const uint32_t bitpos = h >> 23;
+        block[bitpos / 8] |= (1 << (bitpos % 8));
+      }
+    }
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+    const size_t len = bloom_filter.size();
+    if (len < 2) return false;
+
+    const char* array = bloom_filter.data();
+    const size_t bytes = len - 2;
+    if (array[len - 1] != kBlockedBloomFormat || bytes == 0 ||
+        bytes % kBloomBlockBytes != 0) {
+      // Consider filters in formats of the future, or corrupted ones, a
+      // match.
+      return true;
+    }
+    const int k = static_cast<unsigned char>(array[len - 2]);
+
+    const uint32_t h = BlockedBloomHash(key);
+    const char* block =
+        array + BloomBlock(h, bytes / kBloomBlockBytes) * kBloomBlockBytes;
+#if defined(LEVELDB_BLOOM_AVX2)
+    if (HaveAVX2()) {
+      return BlockMayMatchAVX2(block, h, k);
+    }
+#endif
+    return BlockMayMatch(block, h, k);
+  }
+
+ private:
+  size_t bits_per_key_;
+  int k_;
+};
 }  // namespace
 
 const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
   return new BloomFilterPolicy(bits_per_key);
 }
 
+const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+  return new BlockedBloomFilterPolicy(bits_per_key);
+}
+
 }  // namespace leveldb
@@ -19,7 +19,8 @@ static Slice Key(int i, char* buffer) {
 
 class BloomTest : public testing::Test {
  public:
-  BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+  explicit BloomTest(const FilterPolicy* policy = NewBloomFilterPolicy(10))
+      : policy_(policy) {}
 
   ~BloomTest() { delete policy_; }
 
@@ -43,6 +44,7 @@ class BloomTest : public testing::Test {
   }
 
   size_t FilterSize() const { return filter_.size(); }
+  std::string* filter() { return &filter_; }
 
   void DumpFilter() {
     std::fprintf(stderr, "F(");
@@ -149,6 +151,220 @@ TEST_F(BloomTest, VaryingLengths) {
   ASSERT_LE(mediocre_filters, good_filters / 5);
 }
 
+class BlockedBloomTest : public BloomTest {
+ public:
+  BlockedBloomTest() : BloomTest(NewBlockedBloomFilterPolicy(10)) {}
+};
+
+TEST_F(BlockedBloomTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(BlockedBloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(BlockedBloomTest, ProbesStayInOneBlock) {
+  char buffer[sizeof(int)];
+  for (int j = 0; j < 1000; j++) {
+    Add(Key(j, buffer));
+  }
+  Build();
+  const std::string saved = *filter();
+  const size_t bytes = saved.size() - 2;
+  ASSERT_EQ(0, bytes % 64);
+  for (int i = 0; i < 10; i++) {
+    // Keep one block at a time: exactly one of them holds all of key i.
+    int blocks_hit = 0;
+    for (size_t b = 0; b < bytes; b += 64) {
+      std::string* f = filter();
+      f->assign(bytes, '\0');
+      f->replace(b, 64, saved, b, 64);
+      f->append(saved, bytes, 2);
+      if (Matches(Key(i, buffer))) {
+        blocks_hit++;
+      }
+    }
+    ASSERT_EQ(1, blocks_hit) << i;
+  }
+}
+
+TEST_F(BlockedBloomTest, UnknownFormat) {
+  Add("hello");
+  Build();
+  ASSERT_TRUE(!Matches("foo"));
+
+  // Filters of a later format version are considered to match anything.
+  std::string* f = filter();
+  (*f)[f->size() - 1]++;
+  ASSERT_TRUE(Matches("foo"));
+
+  // As are filters that are not made of whole blocks.
+  (*f)[f->size() - 1]--;
+  f->insert(0, 1, '\0');
+  ASSERT_TRUE(Matches("foo"));
+}
+
+TEST_F(BlockedBloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Whole blocks, plus two bytes
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 66))
+        << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.015)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+class RibbonTest : public BloomTest {
+ public:
+  RibbonTest() : BloomTest(NewRibbonFilterPolicy(10)) {}
+
+  // Is the filter a Ribbon filter rather than a bloom filter?
+  bool IsRibbon() {
+    const std::string* f = filter();
+    return !f->empty() && static_cast<unsigned char>(f->back()) == 0xc1;
+  }
+};
+
+TEST_F(RibbonTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(RibbonTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+  // Too few keys for a Ribbon filter to pay off
+  ASSERT_TRUE(!IsRibbon());
+}
+
+TEST_F(RibbonTest, DuplicateKeys) {
+  char buffer[sizeof(int)];
+  for (int i = 0; i < 3000; i++) {
+    Add(Key(i % 1000, buffer));
+  }
+  Build();
+  ASSERT_TRUE(IsRibbon());
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(Matches(Key(i, buffer))) << i;
+  }
+}
+
+TEST_F(RibbonTest, Corrupted) {
+  char buffer[sizeof(int)];
+  for (int i = 0; i < 1000; i++) {
+    Add(Key(i, buffer));
+  }
+  Build();
+  ASSERT_TRUE(IsRibbon());
+  ASSERT_TRUE(!Matches("foo"));
+
+  // Filters that do not add up are considered to match anything.
+  std::string* f = filter();
+  f->insert(0, 1, '\0');
+  ASSERT_TRUE(Matches("foo"));
+  f->erase(0, 1);
+  (*f)[f->size() - 2] = 40;
+  ASSERT_TRUE(Matches("foo"));
+  // Including ones too short to hold a trailer.
+  f->assign(1, static_cast<char>(0xc1));
+  ASSERT_TRUE(Matches("foo"));
+}
+
+TEST_F(RibbonTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  // Past 10000 keys, step in larger increments to reach Ribbon sizes.
+  for (int length = 1; length <= 100000;
+       length = length < 10000 ? NextLength(length) : length + 10000) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Never larger than a bloom filter, and 20% smaller for many keys
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
+        << length;
+    if (length >= 10000) {
+      ASSERT_TRUE(IsRibbon()) << length;
+      ASSERT_LE(FilterSize(), static_cast<size_t>(length * 8 / 8)) << length;
+    }
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
 // Different bits-per-byte
 
 }  // namespace leveldb
@@ -168,6 +168,14 @@ class LRUCache {
     MutexLock l(&mutex_);
     return usage_;
   }
+  size_t PinnedCharge() const {
+    MutexLock l(&mutex_);
+    size_t pinned = 0;
+    for (const LRUHandle* e = in_use_.next; e != &in_use_; e = e->next) {
+      pinned += e->charge;
+    }
+    return pinned;
+  }
 
  private:
   void LRU_Remove(LRUHandle* e);
@@ -392,6 +400,13 @@ class ShardedLRUCache : public Cache {
     }
     return total;
   }
+  size_t PinnedCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].PinnedCharge();
+    }
+    return total;
+  }
 };
 
 }  // end anonymous namespace
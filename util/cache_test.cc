@@ -213,6 +213,24 @@ TEST_F(CacheTest, Prune) {
   ASSERT_EQ(-1, Lookup(2));
 }
 
+TEST_F(CacheTest, PinnedCharge) {
+  Insert(1, 100, 10);
+  Cache::Handle* h1 = InsertAndReturnHandle(2, 200, 20);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(1));
+  ASSERT_EQ(30, cache_->TotalCharge());
+  ASSERT_EQ(30, cache_->PinnedCharge());
+
+  cache_->Release(h2);
+  ASSERT_EQ(20, cache_->PinnedCharge());
+
+  // Erased entries no longer count against the cache.
+  Erase(2);
+  ASSERT_EQ(0, cache_->PinnedCharge());
+  cache_->Release(h1);
+  ASSERT_EQ(10, cache_->TotalCharge());
+  ASSERT_EQ(0, cache_->PinnedCharge());
+}
+
 TEST_F(CacheTest, ZeroSizeCache) {
   delete cache_;
   cache_ = NewLRUCache(0);
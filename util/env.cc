@@ -22,6 +22,13 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  *result = nullptr;
+  return Status::NotSupported("ReuseWritableFile", fname);
+}
+
 Status Env::RemoveDir(const std::string& dirname) { return DeleteDir(dirname); }
 Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 
@@ -34,6 +41,16 @@ RandomAccessFile::~RandomAccessFile() = default;
 
 WritableFile::~WritableFile() = default;
 
+Status WritableFile::AppendParts(const Slice* parts, size_t n) {
+  Status s;
+  for (size_t i = 0; s.ok() && i < n; i++) {
+    s = Append(parts[i]);
+  }
+  return s;
+}
+
+void WritableFile::SetPreallocationBlockSize(size_t size) {}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -10,10 +10,13 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -26,6 +29,7 @@
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
@@ -57,6 +61,13 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// The most buffers a single writev() call accepts.
+#if defined(IOV_MAX)
+constexpr const size_t kMaxIovecs = IOV_MAX;
+#else
+constexpr const size_t kMaxIovecs = 1024;
+#endif  // defined(IOV_MAX)
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) {
     return Status::NotFound(context, std::strerror(error_number));
@@ -250,6 +261,9 @@ class PosixWritableFile final : public WritableFile {
  public:
   PosixWritableFile(std::string filename, int fd)
       : pos_(0),
+        file_size_(0),
+        preallocation_block_size_(0),
+        preallocated_size_(0),
         fd_(fd),
         is_manifest_(IsManifest(filename)),
         filename_(std::move(filename)),
@@ -291,6 +305,35 @@ class PosixWritableFile final : public WritableFile {
     return WriteUnbuffered(write_data, write_size);
   }
 
+  Status AppendParts(const Slice* parts, size_t n) override {
+    size_t size = 0;
+    for (size_t i = 0; i < n; i++) {
+      size += parts[i].size();
+    }
+    if (size <= kWritableFileBufferSize - pos_) {
+      for (size_t i = 0; i < n; i++) {
+        std::memcpy(buf_ + pos_, parts[i].data(), parts[i].size());
+        pos_ += parts[i].size();
+      }
+      return Status::OK();
+    }
+
+    // Write the buffer and the parts together, without copying the parts.
+    std::vector<struct ::iovec> iov;
+    iov.reserve(n + 1);
+    if (pos_ > 0) {
+      iov.push_back({buf_, pos_});
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (!parts[i].empty()) {
+        iov.push_back({const_cast<char*>(parts[i].data()), parts[i].size()});
+      }
+    }
+    size += pos_;
+    pos_ = 0;
+    return WriteUnbuffered(iov.data(), iov.size(), size);
+  }
+
   Status Close() override {
     Status status = FlushBuffer();
     const int close_result = ::close(fd_);
@@ -303,6 +346,10 @@ class PosixWritableFile final : public WritableFile {
 
   Status Flush() override { return FlushBuffer(); }
 
+  void SetPreallocationBlockSize(size_t size) override {
+    preallocation_block_size_ = size;
+  }
+
   Status Sync() override {
     // Ensure new files referred to by the manifest are in the filesystem.
     //
@@ -330,6 +377,7 @@ class PosixWritableFile final : public WritableFile {
   }
 
   Status WriteUnbuffered(const char* data, size_t size) {
+    Preallocate(size);
     while (size > 0) {
       ssize_t write_result = ::write(fd_, data, size);
       if (write_result < 0) {
@@ -340,10 +388,60 @@ class PosixWritableFile final : public WritableFile {
       }
       data += write_result;
       size -= write_result;
+      file_size_ += write_result;
     }
     return Status::OK();
   }
 
+  // Like WriteUnbuffered() above, for the "size" bytes of "count" buffers.
+  Status WriteUnbuffered(struct ::iovec* iov, size_t count, size_t size) {
+    Preallocate(size);
+    while (count > 0) {
+      const int batch = static_cast<int>(std::min(count, kMaxIovecs));
+      ssize_t write_result = ::writev(fd_, iov, batch);
+      if (write_result < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      file_size_ += write_result;
+
+      // Skip what has been written, which may end inside a buffer.
+      size_t written = write_result;
+      while (count > 0 && written >= iov->iov_len) {
+        written -= iov->iov_len;
+        ++iov;
+        --count;
+      }
+      if (written > 0) {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+        iov->iov_len -= written;
+      }
+    }
+    return Status::OK();
+  }
+
+  // Reserves whole preallocation blocks for the next "size" bytes if they
+  // reach past the space reserved so far.  The file's size is left alone,
+  // so only the allocation, and not the size update, is done ahead of the
+  // writes.  Errors are ignored: the writes allocate what they need.
+  void Preallocate(size_t size) {
+#if HAVE_FALLOCATE
+    if (preallocation_block_size_ == 0 ||
+        file_size_ + size <= preallocated_size_) {
+      return;
+    }
+    const uint64_t block = preallocation_block_size_;
+    const uint64_t end = (file_size_ + size + block - 1) / block * block;
+    ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, preallocated_size_,
+                end - preallocated_size_);
+    preallocated_size_ = end;
+#else
+    (void)size;
+#endif  // HAVE_FALLOCATE
+  }
+
   Status SyncDirIfManifest() {
     Status status;
     if (!is_manifest_) {
@@ -429,6 +527,9 @@ class PosixWritableFile final : public WritableFile {
   // buf_[0, pos_ - 1] contains data to be written to fd_.
   char buf_[kWritableFileBufferSize];
   size_t pos_;
+  uint64_t file_size_;  // Bytes written through fd_
+  size_t preallocation_block_size_;
+  uint64_t preallocated_size_;
   int fd_;
 
   const bool is_manifest_;  // True if the file's name starts with MANIFEST.
@@ -568,6 +669,23 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    *result = nullptr;
+    if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      return PosixError(old_filename, errno);
+    }
+    int fd =
+        ::open(filename.c_str(), O_WRONLY | O_CREAT | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   bool FileExists(const std::string& filename) override {
     return ::access(filename.c_str(), F_OK) == 0;
   }
@@ -70,6 +70,37 @@ TEST_F(EnvTest, ReadWrite) {
   delete sequential_file;
 }
 
+TEST_F(EnvTest, AppendParts) {
+  Random rnd(test::RandomSeed());
+
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file_name = test_dir + "/append_parts.txt";
+  WritableFile* writable_file;
+  ASSERT_LEVELDB_OK(env_->NewWritableFile(test_file_name, &writable_file));
+
+  // Mix writes of a few parts, large parts and very many parts.
+  std::string data;
+  for (int i = 0; i < 100; i++) {
+    const int num_parts = rnd.OneIn(10) ? 3000 : 1 + rnd.Uniform(5);
+    std::vector<std::string> parts(num_parts);
+    std::vector<Slice> slices;
+    for (std::string& part : parts) {
+      test::RandomString(&rnd, rnd.Skewed(rnd.OneIn(10) ? 18 : 8), &part);
+      data += part;
+      slices.push_back(part);
+    }
+    ASSERT_LEVELDB_OK(writable_file->AppendParts(slices.data(), slices.size()));
+  }
+  ASSERT_LEVELDB_OK(writable_file->Close());
+  delete writable_file;
+
+  std::string read_result;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, test_file_name, &read_result));
+  ASSERT_EQ(data, read_result);
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file_name));
+}
+
 TEST_F(EnvTest, RunImmediately) {
   struct RunState {
     port::Mutex mu;
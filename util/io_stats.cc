@@ -0,0 +1,255 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/io_stats.h"
+
+#include <cstdio>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+namespace {
+
+thread_local IOCategory current_io_category = kIOOther;
+
+void Charge(std::atomic<uint64_t>* counter, uint64_t n) {
+  counter->fetch_add(n, std::memory_order_relaxed);
+}
+
+class StatsSequentialFile : public SequentialFile {
+ public:
+  StatsSequentialFile(Env* env, IOStatsEnv::Counters* counters,
+                      SequentialFile* target)
+      : env_(env), counters_(counters), target_(target) {}
+  ~StatsSequentialFile() override { delete target_; }
+
+  Status Read(size_t n, Slice* result, char* scratch) override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->Read(n, result, scratch);
+    Charge(&c->read_micros, env_->NowMicros() - start);
+    Charge(&c->reads, 1);
+    Charge(&c->read_bytes, result->size());
+    return s;
+  }
+
+  Status Skip(uint64_t n) override { return target_->Skip(n); }
+
+ private:
+  Env* const env_;
+  IOStatsEnv::Counters* const counters_;
+  SequentialFile* const target_;
+};
+
+class StatsRandomAccessFile : public RandomAccessFile {
+ public:
+  StatsRandomAccessFile(Env* env, IOStatsEnv::Counters* counters,
+                        RandomAccessFile* target)
+      : env_(env), counters_(counters), target_(target) {}
+  ~StatsRandomAccessFile() override { delete target_; }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->Read(offset, n, result, scratch);
+    Charge(&c->read_micros, env_->NowMicros() - start);
+    Charge(&c->reads, 1);
+    Charge(&c->read_bytes, result->size());
+    return s;
+  }
+
+ private:
+  Env* const env_;
+  IOStatsEnv::Counters* const counters_;
+  RandomAccessFile* const target_;
+};
+
+class StatsWritableFile : public WritableFile {
+ public:
+  StatsWritableFile(Env* env, IOStatsEnv::Counters* counters,
+                    WritableFile* target)
+      : env_(env), counters_(counters), target_(target) {}
+  ~StatsWritableFile() override { delete target_; }
+
+  Status Append(const Slice& data) override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->Append(data);
+    Charge(&c->write_micros, env_->NowMicros() - start);
+    Charge(&c->writes, 1);
+    Charge(&c->write_bytes, data.size());
+    return s;
+  }
+
+  Status AppendParts(const Slice* parts, size_t n) override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->AppendParts(parts, n);
+    Charge(&c->write_micros, env_->NowMicros() - start);
+    Charge(&c->writes, 1);
+    for (size_t i = 0; i < n; i++) {
+      Charge(&c->write_bytes, parts[i].size());
+    }
+    return s;
+  }
+
+  Status Close() override { return target_->Close(); }
+
+  Status Flush() override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->Flush();
+    Charge(&c->write_micros, env_->NowMicros() - start);
+    return s;
+  }
+
+  void SetPreallocationBlockSize(size_t size) override {
+    target_->SetPreallocationBlockSize(size);
+  }
+
+  Status Sync() override {
+    IOStatsEnv::Counters* c = &counters_[CurrentIOCategory()];
+    const uint64_t start = env_->NowMicros();
+    Status s = target_->Sync();
+    Charge(&c->sync_micros, env_->NowMicros() - start);
+    Charge(&c->syncs, 1);
+    return s;
+  }
+
+ private:
+  Env* const env_;
+  IOStatsEnv::Counters* const counters_;
+  WritableFile* const target_;
+};
+
+}  // namespace
+
+IOCategory CurrentIOCategory() { return current_io_category; }
+
+IOCategoryScope::IOCategoryScope(IOCategory category)
+    : saved_(current_io_category) {
+  current_io_category = category;
+}
+
+IOCategoryScope::~IOCategoryScope() { current_io_category = saved_; }
+
+IOStatsEnv::IOStatsEnv(Env* target) : EnvWrapper(target) {}
+
+IOStatsEnv::~IOStatsEnv() = default;
+
+Status IOStatsEnv::NewSequentialFile(const std::string& f,
+                                     SequentialFile** r) {
+  Status s = target()->NewSequentialFile(f, r);
+  if (s.ok()) {
+    Charge(&counters_[CurrentIOCategory()].opens, 1);
+    *r = new StatsSequentialFile(target(), counters_, *r);
+  }
+  return s;
+}
+
+Status IOStatsEnv::NewRandomAccessFile(const std::string& f,
+                                       RandomAccessFile** r) {
+  Status s = target()->NewRandomAccessFile(f, r);
+  if (s.ok()) {
+    Charge(&counters_[CurrentIOCategory()].opens, 1);
+    *r = new StatsRandomAccessFile(target(), counters_, *r);
+  }
+  return s;
+}
+
+Status IOStatsEnv::NewWritableFile(const std::string& f, WritableFile** r) {
+  Status s = target()->NewWritableFile(f, r);
+  if (s.ok()) {
+    Charge(&counters_[CurrentIOCategory()].opens, 1);
+    *r = new StatsWritableFile(target(), counters_, *r);
+  }
+  return s;
+}
+
+Status IOStatsEnv::NewAppendableFile(const std::string& f, WritableFile** r) {
+  Status s = target()->NewAppendableFile(f, r);
+  if (s.ok()) {
+    Charge(&counters_[CurrentIOCategory()].opens, 1);
+    *r = new StatsWritableFile(target(), counters_, *r);
+  }
+  return s;
+}
+
+Status IOStatsEnv::ReuseWritableFile(const std::string& f,
+                                     const std::string& old_f,
+                                     WritableFile** r) {
+  Status s = target()->ReuseWritableFile(f, old_f, r);
+  if (s.ok()) {
+    Charge(&counters_[CurrentIOCategory()].opens, 1);
+    *r = new StatsWritableFile(target(), counters_, *r);
+  }
+  return s;
+}
+
+void IOStatsEnv::AppendReport(std::string* value) const {
+  char buf[200];
+  value->append(
+      "                            Reads                    Writes"
+      "              Syncs\n"
+      "Category     Opens    Count  Size(MB) us/op    Count  Size(MB) us/op"
+      "    Count us/op\n"
+      "------------------------------------------------------------------"
+      "-----------------\n");
+  for (int i = 0; i < kNumIOCategories; i++) {
+    const Counters& c = counters_[i];
+    const uint64_t reads = c.reads.load(std::memory_order_relaxed);
+    const uint64_t writes = c.writes.load(std::memory_order_relaxed);
+    const uint64_t syncs = c.syncs.load(std::memory_order_relaxed);
+    std::snprintf(
+        buf, sizeof(buf),
+        "%-11s %6llu %8llu %9.1f %5.0f %8llu %9.1f %5.0f %8llu %5.0f\n",
+        IOCategoryName(static_cast<IOCategory>(i)),
+        static_cast<unsigned long long>(
+            c.opens.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(reads),
+        c.read_bytes.load(std::memory_order_relaxed) / 1048576.0,
+        reads == 0 ? 0.0
+                   : static_cast<double>(
+                         c.read_micros.load(std::memory_order_relaxed)) /
+                         reads,
+        static_cast<unsigned long long>(writes),
+        c.write_bytes.load(std::memory_order_relaxed) / 1048576.0,
+        writes == 0 ? 0.0
+                    : static_cast<double>(
+                          c.write_micros.load(std::memory_order_relaxed)) /
+                          writes,
+        static_cast<unsigned long long>(syncs),
+        syncs == 0 ? 0.0
+                   : static_cast<double>(
+                         c.sync_micros.load(std::memory_order_relaxed)) /
+                         syncs);
+    value->append(buf);
+  }
+}
+
+const char* IOCategoryName(IOCategory category) {
+  switch (category) {
+    case kIOOther:
+      return "other";
+    case kIOWAL:
+      return "wal";
+    case kIOFlush:
+      return "flush";
+    case kIOCompactionInput:
+      return "compact-in";
+    case kIOCompactionOutput:
+      return "compact-out";
+    case kIOUserRead:
+      return "user-read";
+    case kIOManifest:
+      return "manifest";
+    case kNumIOCategories:
+      break;
+  }
+  return "unknown";
+}
+
+}  // namespace leveldb
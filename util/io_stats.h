@@ -0,0 +1,94 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// I/O accounting.  IOStatsEnv forwards every call to another Env and
+// attributes the reads, writes, syncs and opens issued through it to the
+// IOCategory of the calling thread, which DBImpl sets with IOCategoryScope
+// around each subsystem's work.
+
+#ifndef STORAGE_LEVELDB_UTIL_IO_STATS_H_
+#define STORAGE_LEVELDB_UTIL_IO_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+enum IOCategory {
+  kIOOther = 0,  // Work outside of any IOCategoryScope
+  kIOWAL,
+  kIOFlush,
+  kIOCompactionInput,
+  kIOCompactionOutput,
+  kIOUserRead,
+  kIOManifest,
+  kNumIOCategories
+};
+
+// Returns the category that I/O issued by the calling thread is charged to.
+IOCategory CurrentIOCategory();
+
+// Charges the I/O issued by the calling thread to "category" for the
+// lifetime of the object.  Scopes may be nested; the previous category is
+// restored on destruction.
+class IOCategoryScope {
+ public:
+  explicit IOCategoryScope(IOCategory category);
+
+  IOCategoryScope(const IOCategoryScope&) = delete;
+  IOCategoryScope& operator=(const IOCategoryScope&) = delete;
+
+  ~IOCategoryScope();
+
+ private:
+  const IOCategory saved_;
+};
+
+class IOStatsEnv : public EnvWrapper {
+ public:
+  // Counters for a single category.  Latencies are in microseconds.
+  struct Counters {
+    std::atomic<uint64_t> opens{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> read_bytes{0};
+    std::atomic<uint64_t> read_micros{0};
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> write_bytes{0};
+    std::atomic<uint64_t> write_micros{0};  // Includes time spent in Flush()
+    std::atomic<uint64_t> syncs{0};
+    std::atomic<uint64_t> sync_micros{0};
+  };
+
+  // Does not take ownership of "target".
+  explicit IOStatsEnv(Env* target);
+  ~IOStatsEnv() override;
+
+  Status NewSequentialFile(const std::string& f, SequentialFile** r) override;
+  Status NewRandomAccessFile(const std::string& f,
+                             RandomAccessFile** r) override;
+  Status NewWritableFile(const std::string& f, WritableFile** r) override;
+  Status NewAppendableFile(const std::string& f, WritableFile** r) override;
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override;
+
+  const Counters& counters(IOCategory category) const {
+    return counters_[category];
+  }
+
+  // Append a human readable table of the counters to *value.
+  void AppendReport(std::string* value) const;
+
+ private:
+  Counters counters_[kNumIOCategories];
+};
+
+// Returns a short name for "category", e.g. "wal".
+const char* IOCategoryName(IOCategory category);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_IO_STATS_H_
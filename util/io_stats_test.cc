@@ -0,0 +1,172 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/io_stats.h"
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+TEST(IOStatsTest, CategoryScope) {
+  ASSERT_EQ(kIOOther, CurrentIOCategory());
+  {
+    IOCategoryScope outer(kIOFlush);
+    ASSERT_EQ(kIOFlush, CurrentIOCategory());
+    {
+      IOCategoryScope inner(kIOManifest);
+      ASSERT_EQ(kIOManifest, CurrentIOCategory());
+    }
+    ASSERT_EQ(kIOFlush, CurrentIOCategory());
+  }
+  ASSERT_EQ(kIOOther, CurrentIOCategory());
+}
+
+TEST(IOStatsTest, CountsByCategory) {
+  Env* mem_env = NewMemEnv(Env::Default());
+  IOStatsEnv env(mem_env);
+
+  WritableFile* writable;
+  {
+    IOCategoryScope scope(kIOWAL);
+    ASSERT_LEVELDB_OK(env.NewWritableFile("/f", &writable));
+    ASSERT_LEVELDB_OK(writable->Append("hello"));
+    ASSERT_LEVELDB_OK(writable->Append("world"));
+    ASSERT_LEVELDB_OK(writable->Sync());
+  }
+  ASSERT_LEVELDB_OK(writable->Close());
+  delete writable;
+
+  RandomAccessFile* random;
+  {
+    IOCategoryScope scope(kIOUserRead);
+    ASSERT_LEVELDB_OK(env.NewRandomAccessFile("/f", &random));
+    char scratch[10];
+    Slice result;
+    ASSERT_LEVELDB_OK(random->Read(2, 6, &result, scratch));
+    ASSERT_EQ("llowor", result.ToString());
+  }
+  delete random;
+
+  const IOStatsEnv::Counters& wal = env.counters(kIOWAL);
+  ASSERT_EQ(1, wal.opens.load());
+  ASSERT_EQ(2, wal.writes.load());
+  ASSERT_EQ(10, wal.write_bytes.load());
+  ASSERT_EQ(1, wal.syncs.load());
+  ASSERT_EQ(0, wal.reads.load());
+
+  const IOStatsEnv::Counters& user_read = env.counters(kIOUserRead);
+  ASSERT_EQ(1, user_read.opens.load());
+  ASSERT_EQ(1, user_read.reads.load());
+  ASSERT_EQ(6, user_read.read_bytes.load());
+  ASSERT_EQ(0, user_read.writes.load());
+
+  ASSERT_EQ(0, env.counters(kIOFlush).opens.load());
+
+  delete mem_env;
+}
+
+// Finds the line for "category" in the output of the "leveldb.io-stats"
+// property and stores its open and write counts.
+static bool ParseReport(const std::string& report, const char* category,
+                        unsigned long long* opens, unsigned long long* writes) {
+  size_t pos = 0;
+  while ((pos = report.find('\n', pos)) != std::string::npos) {
+    pos++;
+    char name[32];
+    unsigned long long reads;
+    double read_mb, read_micros;
+    if (std::sscanf(report.c_str() + pos, "%31s %llu %llu %lf %lf %llu", name,
+                    opens, &reads, &read_mb, &read_micros, writes) == 6 &&
+        std::string(name) == category) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the number of writes reported for "category", or -1 if the
+// category is missing.
+static int ReportedWrites(const std::string& report, const char* category) {
+  unsigned long long opens, writes;
+  if (!ParseReport(report, category, &opens, &writes)) return -1;
+  return static_cast<int>(writes);
+}
+
+// Returns the number of opens reported for "category", or -1 if the
+// category is missing.
+static int ReportedOpens(const std::string& report, const char* category) {
+  unsigned long long opens, writes;
+  if (!ParseReport(report, category, &opens, &writes)) return -1;
+  return static_cast<int>(opens);
+}
+
+TEST(IOStatsTest, DBProperty) {
+  Env* mem_env = NewMemEnv(Env::Default());
+  Options options;
+  options.env = mem_env;
+  options.create_if_missing = true;
+  DB* db;
+  ASSERT_LEVELDB_OK(DB::Open(options, "/db", &db));
+  std::string value;
+  ASSERT_TRUE(!db->GetProperty("leveldb.io-stats", &value));
+  delete db;
+
+  options.collect_io_stats = true;
+  ASSERT_LEVELDB_OK(DB::Open(options, "/db", &db));
+  ASSERT_LEVELDB_OK(db->Put(WriteOptions(), "foo", "v1"));
+  ASSERT_LEVELDB_OK(db->Put(WriteOptions(), "bar", "v2"));
+  db->CompactRange(nullptr, nullptr);
+  ASSERT_LEVELDB_OK(db->Get(ReadOptions(), "foo", &value));
+  ASSERT_EQ("v1", value);
+
+  ASSERT_TRUE(db->GetProperty("leveldb.io-stats", &value));
+  ASSERT_LT(0, ReportedWrites(value, "wal"));
+  ASSERT_LT(0, ReportedWrites(value, "flush"));
+  ASSERT_LT(0, ReportedWrites(value, "manifest"));
+  ASSERT_EQ(0, ReportedWrites(value, "user-read"));
+  delete db;
+  ASSERT_LEVELDB_OK(DestroyDB("/db", options));
+  delete mem_env;
+}
+
+TEST(IOStatsTest, CompactionInputOpens) {
+  Env* mem_env = NewMemEnv(Env::Default());
+  Options options;
+  options.env = mem_env;
+  options.create_if_missing = true;
+  DB* db;
+  // Each reopen writes the previous log to a new level-0 table.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_LEVELDB_OK(DB::Open(options, "/db", &db));
+    ASSERT_LEVELDB_OK(db->Put(WriteOptions(), "foo", "v"));
+    delete db;
+  }
+
+  // The table written by the first reopen is not open yet; compacting it
+  // opens it as a compaction input.
+  options.collect_io_stats = true;
+  ASSERT_LEVELDB_OK(DB::Open(options, "/db", &db));
+  db->CompactRange(nullptr, nullptr);
+  std::string value;
+  ASSERT_TRUE(db->GetProperty("leveldb.io-stats", &value));
+  ASSERT_EQ(1, ReportedOpens(value, "compact-in"));
+  ASSERT_EQ(0, ReportedOpens(value, "other"));
+  delete db;
+  ASSERT_LEVELDB_OK(DestroyDB("/db", options));
+  delete mem_env;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
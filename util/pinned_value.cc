@@ -0,0 +1,27 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/pinned_value.h"
+
+#include <cassert>
+
+namespace leveldb {
+
+void PinnedValue::Reset() {
+  while (!cleanups_.empty()) {
+    const Cleanup c = cleanups_.back();
+    cleanups_.pop_back();
+    (*c.function)(c.arg1, c.arg2);
+  }
+  value_ = Slice();
+  self_.clear();
+}
+
+void PinnedValue::RegisterCleanup(CleanupFunction func, void* arg1,
+                                  void* arg2) {
+  assert(func != nullptr);
+  cleanups_.push_back(Cleanup{func, arg1, arg2});
+}
+
+}  // namespace leveldb
@@ -0,0 +1,74 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/prefix_extractor.h"
+
+#include <cassert>
+#include <cstring>
+#include <string>
+
+namespace leveldb {
+
+PrefixExtractor::~PrefixExtractor() {}
+
+namespace {
+
+class FixedPrefixExtractor : public PrefixExtractor {
+ public:
+  explicit FixedPrefixExtractor(size_t prefix_length)
+      : prefix_length_(prefix_length),
+        name_("leveldb.FixedPrefix." + std::to_string(prefix_length)) {}
+
+  const char* Name() const override { return name_.c_str(); }
+
+  bool InDomain(const Slice& key) const override {
+    return key.size() >= prefix_length_;
+  }
+
+  Slice Prefix(const Slice& key) const override {
+    assert(InDomain(key));
+    return Slice(key.data(), prefix_length_);
+  }
+
+ private:
+  const size_t prefix_length_;
+  const std::string name_;
+};
+
+class DelimitedPrefixExtractor : public PrefixExtractor {
+ public:
+  explicit DelimitedPrefixExtractor(char delimiter)
+      : delimiter_(delimiter),
+        name_("leveldb.DelimitedPrefix." +
+              std::to_string(static_cast<unsigned char>(delimiter))) {}
+
+  const char* Name() const override { return name_.c_str(); }
+
+  bool InDomain(const Slice& key) const override {
+    return std::memchr(key.data(), delimiter_, key.size()) != nullptr;
+  }
+
+  Slice Prefix(const Slice& key) const override {
+    const char* end = reinterpret_cast<const char*>(
+        std::memchr(key.data(), delimiter_, key.size()));
+    assert(end != nullptr);
+    return Slice(key.data(), end - key.data() + 1);
+  }
+
+ private:
+  const char delimiter_;
+  const std::string name_;
+};
+
+}  // namespace
+
+const PrefixExtractor* NewFixedPrefixExtractor(size_t prefix_length) {
+  return new FixedPrefixExtractor(prefix_length);
+}
+
+const PrefixExtractor* NewDelimitedPrefixExtractor(char delimiter) {
+  return new DelimitedPrefixExtractor(delimiter);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,312 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+// A Ribbon filter (Dillinger & Walzer, "Ribbon filter: practically smaller
+// than Bloom and Xor", 2021) stores, for a set of keys, the solution S of
+// a system of linear equations over GF(2), one per key:
+//
+//   XOR of S[start(key) + i] over the bits i set in coeff(key) == fp(key)
+//
+// where each S[j] is a fingerprint-sized row, coeff(key) is a 64-bit
+// mask and fp(key) a fingerprint.  A key not in the set satisfies its
+// equation with probability 2^-fingerprint_bits.  Since the coefficients
+// of a key only span 64 rows from its start, the system can be solved
+// on the fly ("banding") and with little more rows than keys.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// A filter is made of blocks of 64 rows.  Each block is stored as one
+// fixed64 word per fingerprint bit, bit i of word b of a block holding
+// bit b of its row i.  The blocks are followed by the seed the filter
+// was built with (fixed32), the number of fingerprint bits and
+// kRibbonFormat, a byte each.
+//
+// Bloom filters end in their number of probes, which is at most 30, so
+// KeyMayMatch() tells the two apart by the last byte.
+static const unsigned char kRibbonFormat = 0xc1;
+static const size_t kRibbonTrailerSize = 6;
+static const size_t kRowsPerBlock = 64;
+
+// Rows in excess of the number of keys, in 1/64ths of it.  Fewer make
+// it less likely that the equations of a set of keys can be solved.
+static const size_t kSlack64ths = 4;
+
+// Seeds tried before giving up on a filter of a given size.
+static const int kSeedsPerSize = 2;
+
+// Sizes tried, each larger by kSlack64ths, before giving up altogether.
+static const int kMaxSizes = 8;
+
+static uint32_t RibbonKeyHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0x7f4a7c15);
+}
+
+// The finalizer of MurmurHash3.  A bijection on 64-bit values.
+static inline uint64_t Mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline int Parity64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_parityll(x);
+#else
+  x ^= x >> 32;
+  x ^= x >> 16;
+  x ^= x >> 8;
+  x ^= x >> 4;
+  x ^= x >> 2;
+  x ^= x >> 1;
+  return static_cast<int>(x & 1);
+#endif
+}
+
+static inline int CountTrailingZeros64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+// The equation of a key in a filter with "num_starts" possible starts.
+struct RibbonEquation {
+  RibbonEquation(uint32_t key_hash, uint32_t seed, size_t num_starts,
+                 int fingerprint_bits) {
+    const uint64_t h = Mix64((static_cast<uint64_t>(seed) << 32) | key_hash);
+    // (h * num_starts) >> 64, without 128-bit arithmetic.
+    const uint64_t n = num_starts;
+    start = static_cast<size_t>(
+        ((h >> 32) * n + (((h & 0xffffffffu) * n) >> 32)) >> 32);
+    // Bit 0 is always set, so that every equation has a pivot.
+    coeff = (h * 0x9e3779b97f4a7c15ULL) | 1;
+    result = static_cast<uint32_t>(Mix64(h ^ 0x5851f42d4c957f2dULL) >>
+                                   (64 - fingerprint_bits));
+  }
+
+  size_t start;
+  uint64_t coeff;
+  uint32_t result;
+};
+
+class RibbonFilterPolicy : public FilterPolicy {
+ public:
+  explicit RibbonFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key),
+        bloom_(NewBloomFilterPolicy(bits_per_key)) {
+    // The false positive rate of a Bloom filter with bits_per_key bits
+    // per key is about 2^-(bits_per_key * ln(2)).
+    fingerprint_bits_ = static_cast<int>(bits_per_key * 0.69 + 0.5);
+    if (fingerprint_bits_ < 1) fingerprint_bits_ = 1;
+    if (fingerprint_bits_ > 32) fingerprint_bits_ = 32;
+  }
+
+  ~RibbonFilterPolicy() override { delete bloom_; }
+
+  const char* Name() const override { return "leveldb.RibbonFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // A Ribbon filter has at least a block's worth of rows, so for few
+    // keys a Bloom filter is smaller.
+    size_t num_blocks = NumBlocks(n);
+    const size_t ribbon_bytes =
+        num_blocks * fingerprint_bits_ * 8 + kRibbonTrailerSize;
+    const size_t bloom_bytes =
+        (std::max<size_t>(n * bits_per_key_, 64) + 7) / 8 + 1;
+    if (ribbon_bytes < bloom_bytes) {
+      std::vector<uint32_t> hashes(n);
+      for (int i = 0; i < n; i++) {
+        hashes[i] = RibbonKeyHash(keys[i]);
+      }
+      for (int size = 0; size < kMaxSizes; size++) {
+        for (int s = 0; s < kSeedsPerSize; s++) {
+          const uint32_t seed = static_cast<uint32_t>(size * kSeedsPerSize + s);
+          if (Build(hashes, num_blocks, seed, dst)) {
+            return;
+          }
+        }
+        num_blocks += (num_blocks * kSlack64ths + 63) / 64;
+      }
+    }
+    // Too few keys, or (very rarely) no solution was found.
+    bloom_->CreateFilter(keys, n, dst);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    const size_t len = filter.size();
+    if (len == 0 ||
+        static_cast<unsigned char>(filter[len - 1]) != kRibbonFormat) {
+      return bloom_->KeyMayMatch(key, filter);
+    }
+    if (len < kRibbonTrailerSize) {
+      // Consider corrupted filters a match.
+      return true;
+    }
+    const int fingerprint_bits = static_cast<unsigned char>(filter[len - 2]);
+    if (fingerprint_bits < 1 || fingerprint_bits > 32) {
+      return true;
+    }
+    const size_t block_bytes = fingerprint_bits * 8;
+    const size_t bytes = len - kRibbonTrailerSize;
+    if (bytes == 0 || bytes % block_bytes != 0) {
+      return true;
+    }
+    const char* array = filter.data();
+    const uint32_t seed = DecodeFixed32(array + bytes);
+    const size_t num_blocks = bytes / block_bytes;
+    const RibbonEquation eq(RibbonKeyHash(key), seed, NumStarts(num_blocks),
+                            fingerprint_bits);
+
+    // The rows of the equation lie in the block of its start and, unless
+    // the start begins a block, the next one.
+    const size_t shift = eq.start % kRowsPerBlock;
+    const char* lo = array + (eq.start / kRowsPerBlock) * block_bytes;
+    const char* hi = lo + block_bytes;
+    for (int b = 0; b < fingerprint_bits; b++) {
+      uint64_t rows = DecodeFixed64(lo + b * 8) >> shift;
+      if (shift != 0) {
+        rows |= DecodeFixed64(hi + b * 8) << (kRowsPerBlock - shift);
+      }
+      if (Parity64(rows & eq.coeff) != static_cast<int>((eq.result >> b) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Equations may start at any row from which their 64 rows fit.
+  static size_t NumStarts(size_t num_blocks) {
+    return num_blocks * kRowsPerBlock - (kRowsPerBlock - 1);
+  }
+
+  // Returns the number of blocks of a filter of "n" keys.
+  static size_t NumBlocks(size_t n) {
+    const size_t rows = n + (n * kSlack64ths + 63) / 64 + kRowsPerBlock - 1;
+    return (rows + kRowsPerBlock - 1) / kRowsPerBlock;
+  }
+
+  // Appends a filter of "num_blocks" blocks that holds the keys of
+  // "hashes" to *dst.  Returns false, leaving *dst unchanged, if the
+  // equations for "seed" have no solution.
+  bool Build(const std::vector<uint32_t>& hashes, size_t num_blocks,
+             uint32_t seed, std::string* dst) const {
+    const size_t num_rows = num_blocks * kRowsPerBlock;
+    const size_t num_starts = NumStarts(num_blocks);
+    const int fp_bits = fingerprint_bits_;
+
+    // Order the equations by the block they start in, so that the
+    // elimination below goes through the rows about sequentially.
+    std::vector<size_t> offsets(num_blocks + 1, 0);
+    for (uint32_t key_hash : hashes) {
+      RibbonEquation eq(key_hash, seed, num_starts, fp_bits);
+      offsets[eq.start / kRowsPerBlock + 1]++;
+    }
+    for (size_t b = 1; b <= num_blocks; b++) {
+      offsets[b] += offsets[b - 1];
+    }
+    std::vector<uint32_t> sorted(hashes.size());
+    for (uint32_t key_hash : hashes) {
+      RibbonEquation eq(key_hash, seed, num_starts, fp_bits);
+      sorted[offsets[eq.start / kRowsPerBlock]++] = key_hash;
+    }
+
+    // Gaussian elimination, keeping row i for an equation whose lowest
+    // coefficient is that of row i.
+    std::vector<uint64_t> coeffs(num_rows, 0);
+    std::vector<uint32_t> results(num_rows, 0);
+    for (uint32_t key_hash : sorted) {
+      RibbonEquation eq(key_hash, seed, num_starts, fp_bits);
+      size_t i = eq.start;
+      uint64_t c = eq.coeff;
+      uint32_t r = eq.result;
+      while (true) {
+        if (coeffs[i] == 0) {
+          coeffs[i] = c;
+          results[i] = r;
+          break;
+        }
+        c ^= coeffs[i];
+        r ^= results[i];
+        if (c == 0) {
+          if (r != 0) {
+            return false;  // Inconsistent with the earlier equations
+          }
+          break;  // Implied by the earlier equations, e.g. a duplicate key
+        }
+        const int tz = CountTrailingZeros64(c);
+        i += tz;
+        c >>= tz;
+      }
+    }
+
+    // Back substitution, from the last row up.  Bit i of window[b] holds
+    // bit b of row j + i while solving row j - 1.  Rows with no equation
+    // are left zero.
+    const size_t init_size = dst->size();
+    const size_t block_bytes = fp_bits * 8;
+    dst->resize(init_size + num_blocks * block_bytes);
+    char* array = &(*dst)[init_size];
+    std::vector<uint64_t> window(fp_bits, 0);
+    std::vector<uint64_t> block(fp_bits, 0);
+    for (size_t j = num_rows; j > 0; j--) {
+      const size_t row = j - 1;
+      const uint64_t c = coeffs[row];
+      const uint32_t r = results[row];
+      const size_t pos = row % kRowsPerBlock;
+      for (int b = 0; b < fp_bits; b++) {
+        const uint64_t w = window[b] << 1;
+        uint64_t bit = 0;
+        if (c != 0) {
+          bit = static_cast<uint64_t>(Parity64(w & c) ^ ((r >> b) & 1));
+        }
+        window[b] = w | bit;
+        block[b] |= bit << pos;
+      }
+      if (pos == 0) {
+        char* p = array + (row / kRowsPerBlock) * block_bytes;
+        for (int b = 0; b < fp_bits; b++) {
+          EncodeFixed64(p + b * 8, block[b]);
+          block[b] = 0;
+        }
+      }
+    }
+    PutFixed32(dst, seed);
+    dst->push_back(static_cast<char>(fp_bits));
+    dst->push_back(static_cast<char>(kRibbonFormat));
+    return true;
+  }
+
+  size_t bits_per_key_;
+  int fingerprint_bits_;
+  const FilterPolicy* const bloom_;
+};
+
+}  // namespace
+
+const FilterPolicy* NewRibbonFilterPolicy(int bits_per_key) {
+  return new RibbonFilterPolicy(bits_per_key);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,161 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_local.h"
+
+#include <atomic>
+#include <deque>
+#include <set>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/no_destructor.h"
+
+namespace leveldb {
+
+namespace {
+
+// The slots of one thread, indexed by ThreadLocalPtr id.  A deque, so
+// that slots do not move when more are added.
+struct ThreadData {
+  ThreadData();
+  ~ThreadData();
+
+  std::deque<std::atomic<void*>> slots;
+};
+
+// Bookkeeping shared by all ThreadLocalPtrs.
+class Registry {
+ public:
+  static Registry* Instance() {
+    static NoDestructor<Registry> registry;
+    return registry.get();
+  }
+
+  uint32_t NewId(ThreadLocalPtr::UnrefHandler handler) {
+    MutexLock l(&mu_);
+    uint32_t id;
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+      handlers_[id] = handler;
+    } else {
+      id = static_cast<uint32_t>(handlers_.size());
+      handlers_.push_back(handler);
+    }
+    return id;
+  }
+
+  // Hand the pointers all threads hold in slot "id" to its handler, and
+  // let the id be reused.
+  void ReleaseId(uint32_t id) {
+    MutexLock l(&mu_);
+    for (ThreadData* t : threads_) {
+      if (id < t->slots.size()) {
+        void* ptr = t->slots[id].exchange(nullptr, std::memory_order_acquire);
+        if (ptr != nullptr && handlers_[id] != nullptr) {
+          (*handlers_[id])(ptr);
+        }
+      }
+    }
+    handlers_[id] = nullptr;
+    free_ids_.push_back(id);
+  }
+
+  void AddThread(ThreadData* t) {
+    MutexLock l(&mu_);
+    threads_.insert(t);
+  }
+
+  // Hand the pointers the exiting thread "t" holds to their handlers.
+  void RemoveThread(ThreadData* t) {
+    MutexLock l(&mu_);
+    threads_.erase(t);
+    for (uint32_t id = 0; id < t->slots.size(); id++) {
+      void* ptr = t->slots[id].exchange(nullptr, std::memory_order_acquire);
+      if (ptr != nullptr && handlers_[id] != nullptr) {
+        (*handlers_[id])(ptr);
+      }
+    }
+  }
+
+  // Make room for slot "id" in "t", which belongs to the calling thread.
+  // Other threads only read a thread's slots while holding mu_.
+  void Grow(ThreadData* t, uint32_t id) {
+    MutexLock l(&mu_);
+    while (t->slots.size() <= id) {
+      t->slots.emplace_back(nullptr);
+    }
+  }
+
+  void Scrape(uint32_t id, std::vector<void*>* ptrs, void* replacement) {
+    MutexLock l(&mu_);
+    for (ThreadData* t : threads_) {
+      if (id < t->slots.size()) {
+        void* ptr =
+            t->slots[id].exchange(replacement, std::memory_order_acquire);
+        if (ptr != nullptr) {
+          ptrs->push_back(ptr);
+        }
+      }
+    }
+  }
+
+ private:
+  friend class NoDestructor<Registry>;
+  Registry() = default;
+
+  port::Mutex mu_;
+  std::vector<ThreadLocalPtr::UnrefHandler> handlers_ GUARDED_BY(mu_);
+  std::vector<uint32_t> free_ids_ GUARDED_BY(mu_);
+  std::set<ThreadData*> threads_ GUARDED_BY(mu_);
+};
+
+ThreadData::ThreadData() { Registry::Instance()->AddThread(this); }
+
+ThreadData::~ThreadData() { Registry::Instance()->RemoveThread(this); }
+
+ThreadData* CurrentThread() {
+  thread_local ThreadData data;
+  return &data;
+}
+
+std::atomic<void*>* Slot(uint32_t id) {
+  ThreadData* t = CurrentThread();
+  if (id >= t->slots.size()) {
+    Registry::Instance()->Grow(t, id);
+  }
+  return &t->slots[id];
+}
+
+}  // namespace
+
+ThreadLocalPtr::ThreadLocalPtr(UnrefHandler handler)
+    : id_(Registry::Instance()->NewId(handler)) {}
+
+ThreadLocalPtr::~ThreadLocalPtr() { Registry::Instance()->ReleaseId(id_); }
+
+void* ThreadLocalPtr::Get() const {
+  ThreadData* t = CurrentThread();
+  if (id_ >= t->slots.size()) {
+    return nullptr;
+  }
+  return t->slots[id_].load(std::memory_order_acquire);
+}
+
+void* ThreadLocalPtr::Swap(void* ptr) {
+  return Slot(id_)->exchange(ptr, std::memory_order_acq_rel);
+}
+
+bool ThreadLocalPtr::CompareAndSwap(void* ptr, void*& expected) {
+  return Slot(id_)->compare_exchange_strong(expected, ptr,
+                                            std::memory_order_acq_rel);
+}
+
+void ThreadLocalPtr::Scrape(std::vector<void*>* ptrs, void* replacement) {
+  Registry::Instance()->Scrape(id_, ptrs, replacement);
+}
+
+}  // namespace leveldb
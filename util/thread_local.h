@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace leveldb {
+
+// A ThreadLocalPtr holds a separate pointer for each thread.  Unlike a
+// thread_local variable, any number of them can be created and destroyed,
+// e.g. one per open DB, and the owner can take back the pointers all
+// threads hold (see Scrape()).
+//
+// Each thread starts out holding nullptr.
+class ThreadLocalPtr {
+ public:
+  // Called with the non-null pointer a thread holds when the thread exits
+  // or the ThreadLocalPtr is destroyed.  Runs while an internal lock
+  // shared by all ThreadLocalPtrs is held, so it must not block.
+  using UnrefHandler = void (*)(void* ptr);
+
+  explicit ThreadLocalPtr(UnrefHandler handler = nullptr);
+
+  ThreadLocalPtr(const ThreadLocalPtr&) = delete;
+  ThreadLocalPtr& operator=(const ThreadLocalPtr&) = delete;
+
+  // Calls the handler on the pointers that are still held.
+  ~ThreadLocalPtr();
+
+  // Return the pointer the calling thread holds.
+  void* Get() const;
+
+  // Make the calling thread hold "ptr", returning the pointer it held.
+  void* Swap(void* ptr);
+
+  // If the calling thread holds "expected", make it hold "ptr" and return
+  // true.  Otherwise store the pointer it holds in "expected" and return
+  // false.
+  bool CompareAndSwap(void* ptr, void*& expected);
+
+  // Replace the pointer every thread holds with "replacement", appending
+  // the non-null ones to *ptrs.  The handler is not called on them.
+  void Scrape(std::vector<void*>* ptrs, void* replacement);
+
+ private:
+  const uint32_t id_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
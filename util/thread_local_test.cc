@@ -0,0 +1,147 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_local.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+namespace {
+
+std::atomic<int> unref_count(0);
+
+void CountUnref(void* ptr) { unref_count.fetch_add(1); }
+
+}  // namespace
+
+TEST(ThreadLocalTest, StartsNull) {
+  ThreadLocalPtr tls;
+  ASSERT_EQ(nullptr, tls.Get());
+  int x;
+  void* expected = nullptr;
+  ASSERT_TRUE(tls.CompareAndSwap(&x, expected));
+  ASSERT_EQ(&x, tls.Get());
+  ASSERT_EQ(&x, tls.Swap(nullptr));
+}
+
+TEST(ThreadLocalTest, SeparatePerThread) {
+  ThreadLocalPtr tls;
+  int a, b;
+  ASSERT_EQ(nullptr, tls.Swap(&a));
+  std::thread other([&]() {
+    ASSERT_EQ(nullptr, tls.Get());
+    ASSERT_EQ(nullptr, tls.Swap(&b));
+    ASSERT_EQ(&b, tls.Get());
+    tls.Swap(nullptr);
+  });
+  other.join();
+  ASSERT_EQ(&a, tls.Get());
+
+  // Each ThreadLocalPtr has its own slot.
+  ThreadLocalPtr tls2;
+  ASSERT_EQ(nullptr, tls2.Get());
+  tls2.Swap(&b);
+  ASSERT_EQ(&a, tls.Get());
+  ASSERT_EQ(&b, tls2.Get());
+  tls.Swap(nullptr);
+  tls2.Swap(nullptr);
+}
+
+TEST(ThreadLocalTest, CompareAndSwap) {
+  ThreadLocalPtr tls;
+  int a, b;
+  tls.Swap(&a);
+  void* expected = &b;
+  ASSERT_TRUE(!tls.CompareAndSwap(nullptr, expected));
+  ASSERT_EQ(&a, expected);
+  ASSERT_EQ(&a, tls.Get());
+  ASSERT_TRUE(tls.CompareAndSwap(&b, expected));
+  ASSERT_EQ(&b, tls.Get());
+  tls.Swap(nullptr);
+}
+
+TEST(ThreadLocalTest, HandlerCalledOnThreadExit) {
+  unref_count.store(0);
+  ThreadLocalPtr tls(&CountUnref);
+  int x;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&]() { tls.Swap(&x); });
+  }
+  threads.emplace_back([&]() {
+    // Not called on threads that end up holding nullptr.
+    tls.Swap(&x);
+    tls.Swap(nullptr);
+  });
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(4, unref_count.load());
+}
+
+TEST(ThreadLocalTest, HandlerCalledOnDestruction) {
+  unref_count.store(0);
+  int x;
+  {
+    ThreadLocalPtr tls(&CountUnref);
+    tls.Swap(&x);
+  }
+  ASSERT_EQ(1, unref_count.load());
+
+  // The slot of a destroyed ThreadLocalPtr starts out empty when reused.
+  ThreadLocalPtr tls;
+  ASSERT_EQ(nullptr, tls.Get());
+}
+
+TEST(ThreadLocalTest, Scrape) {
+  unref_count.store(0);
+  ThreadLocalPtr tls(&CountUnref);
+  int values[3];
+  int replacement;
+  std::atomic<int> ready(0);
+  std::atomic<bool> scraped(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 3; i++) {
+    threads.emplace_back([&, i]() {
+      tls.Swap(&values[i]);
+      ready.fetch_add(1);
+      while (!scraped.load()) {
+        std::this_thread::yield();
+      }
+      ASSERT_EQ(&replacement, tls.Get());
+      tls.Swap(nullptr);
+    });
+  }
+  while (ready.load() < 3) {
+    std::this_thread::yield();
+  }
+
+  std::vector<void*> ptrs;
+  tls.Scrape(&ptrs, &replacement);
+  scraped.store(true);
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  // This thread never set its slot, so only the other threads' values
+  // come back, and the handler is not called on them.
+  ASSERT_EQ(3, ptrs.size());
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(std::find(ptrs.begin(), ptrs.end(), &values[i]) != ptrs.end());
+  }
+  ASSERT_EQ(0, unref_count.load());
+  ASSERT_EQ(&replacement, tls.Swap(nullptr));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}